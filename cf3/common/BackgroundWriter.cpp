@@ -0,0 +1,178 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#include <algorithm>
+#include <exception>
+
+#include <boost/bind.hpp>
+
+#include "common/BackgroundWriter.hpp"
+#include "common/BasicExceptions.hpp"
+#include "common/Core.hpp"
+#include "common/Environment.hpp"
+#include "common/OptionList.hpp"
+
+#include "common/PE/Comm.hpp"
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+namespace cf3 {
+namespace common {
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+BackgroundWriter::BackgroundWriter() :
+  m_stop(false)
+{
+}
+
+BackgroundWriter::~BackgroundWriter()
+{
+  // Let the thread finish the queued tasks. Completion functions are not run anymore, since MPI may be gone.
+  if(is_not_null(m_thread.get()))
+  {
+    {
+      boost::mutex::scoped_lock lock(m_mutex);
+      m_stop = true;
+    }
+    m_queue_condition.notify_all();
+    m_thread->join();
+  }
+}
+
+BackgroundWriter& BackgroundWriter::instance()
+{
+  static BackgroundWriter instance;
+  return instance;
+}
+
+void BackgroundWriter::submit(const FunctionT& task, const FunctionT& completion)
+{
+  const Uint max_pending = std::max(Core::instance().environment().options().value<Uint>("max_pending_writes"), 1u);
+  while(m_pending.size() >= max_pending)
+    complete_oldest();
+
+  if(is_null(m_thread.get()))
+    m_thread.reset(new boost::thread(boost::bind(&BackgroundWriter::run, this)));
+
+  JobPtrT job(new Job());
+  job->task = task;
+  job->completion = completion;
+  m_pending.push_back(job);
+
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_queue.push_back(job);
+  }
+  m_queue_condition.notify_one();
+
+  poll();
+}
+
+void BackgroundWriter::poll()
+{
+  // The pending jobs are the same on all processes, so they all skip the reduction together
+  if(m_pending.empty())
+    return;
+
+  // Number of pending jobs, from the oldest, that are done on this process
+  Uint nb_done = 0;
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    while(nb_done != m_pending.size() && m_pending[nb_done]->done)
+      ++nb_done;
+  }
+
+  // Completion functions may be collective, so only complete the jobs that are done on all processes
+  PE::Comm& comm = PE::Comm::instance();
+  if(comm.is_active() && comm.size() > 1)
+  {
+    Uint global_nb_done = 0;
+    comm.all_reduce(PE::min(), &nb_done, 1, &global_nb_done);
+    nb_done = global_nb_done;
+  }
+
+  for(Uint i = 0; i != nb_done; ++i)
+    complete_oldest();
+}
+
+void BackgroundWriter::wait_all()
+{
+  while(!m_pending.empty())
+    complete_oldest();
+}
+
+Uint BackgroundWriter::nb_pending() const
+{
+  return m_pending.size();
+}
+
+void BackgroundWriter::run()
+{
+  while(true)
+  {
+    JobPtrT job;
+    {
+      boost::mutex::scoped_lock lock(m_mutex);
+      while(m_queue.empty() && !m_stop)
+        m_queue_condition.wait(lock);
+      if(m_queue.empty())
+        return;
+      job = m_queue.front();
+      m_queue.pop_front();
+    }
+
+    std::string error;
+    try
+    {
+      job->task();
+    }
+    catch(std::exception& e)
+    {
+      error = e.what();
+      if(error.empty())
+        error = "unknown error";
+    }
+    catch(...)
+    {
+      error = "unknown error";
+    }
+
+    {
+      boost::mutex::scoped_lock lock(m_mutex);
+      job->error = error;
+      job->done = true;
+    }
+    m_done_condition.notify_all();
+  }
+}
+
+void BackgroundWriter::complete_oldest()
+{
+  cf3_assert(!m_pending.empty());
+  const JobPtrT job = m_pending.front();
+  m_pending.pop_front();
+
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    while(!job->done)
+      m_done_condition.wait(lock);
+  }
+
+  // The completion function is called even after an error, to keep collective operations matched between processes
+  if(job->completion)
+    job->completion();
+
+  if(!job->error.empty())
+    throw FileSystemError(FromHere(), "Error in background write: " + job->error);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+} // common
+} // cf3
+
+/////////////////////////////////////////////////////////////////////////////////////
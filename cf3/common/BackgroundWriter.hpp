@@ -0,0 +1,102 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#ifndef cf3_common_BackgroundWriter_hpp
+#define cf3_common_BackgroundWriter_hpp
+
+#include <deque>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "common/CommonAPI.hpp"
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+namespace cf3 {
+namespace common {
+
+///////////////////////////////////////////////////////////////////////////////////////
+
+/// Runs file output on a background thread, so the caller can continue while the data is compressed and written.
+/// Each job consists of a task, executed on the background thread, and a completion function, executed on the main
+/// thread after the task finished. Tasks must not use MPI. Completion functions may use collective operations: they
+/// are run in submission order, at points that are the same on all processes, namely at each submit for the jobs
+/// that are done on all processes, when submitting a job would exceed the max_pending_writes option of the
+/// environment, or when poll or wait_all is called. AdvanceTime polls at each time step.
+/// wait_all is called automatically by Core::terminate and PE::Comm::finalize.
+class Common_API BackgroundWriter : public boost::noncopyable
+{
+public:
+  typedef boost::function<void ()> FunctionT;
+
+  /// Singleton implementation
+  static BackgroundWriter& instance();
+
+  ~BackgroundWriter();
+
+  /// Queue a new job, first completing the oldest pending jobs if the maximum number of pending jobs is reached.
+  /// Afterwards, the jobs that are done on all processes are completed, as in poll.
+  /// Must be called from the main thread, in the same order on all processes.
+  void submit(const FunctionT& task, const FunctionT& completion);
+
+  /// Complete the oldest pending jobs whose task is done on all processes, without waiting for the others.
+  /// Collective, must be called from the main thread.
+  void poll();
+
+  /// Complete all pending jobs. Exceptions thrown by a task are rethrown here, or from submit.
+  void wait_all();
+
+  /// Number of jobs that were submitted but not completed
+  Uint nb_pending() const;
+
+private:
+  BackgroundWriter();
+
+  struct Job
+  {
+    Job() : done(false) {}
+    FunctionT task;
+    FunctionT completion;
+    bool done;
+    /// Error message if the task threw
+    std::string error;
+  };
+  typedef boost::shared_ptr<Job> JobPtrT;
+
+  /// Loop executed by the background thread
+  void run();
+
+  /// Wait for the oldest job to finish and execute its completion function
+  void complete_oldest();
+
+  /// Jobs that are not completed yet, only accessed from the main thread
+  std::deque<JobPtrT> m_pending;
+
+  /// Jobs waiting for the background thread, protected by the mutex
+  std::deque<JobPtrT> m_queue;
+
+  boost::mutex m_mutex;
+  boost::condition_variable m_queue_condition;
+  boost::condition_variable m_done_condition;
+  bool m_stop;
+
+  boost::scoped_ptr<boost::thread> m_thread;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+} // common
+} // cf3
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+#endif // cf3_common_BackgroundWriter_hpp
@@ -0,0 +1,472 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/foreach.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include "common/BasicExceptions.hpp"
+#include "common/BinaryDataCodec.hpp"
+#include "common/StringConversion.hpp"
+
+namespace cf3 {
+namespace common {
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+/// Implementation of the fast codec. The compressed data is a sequence of tokens, each consisting of:
+///  - a byte with the number of literals in the high nibble and the match length minus min_match in the low nibble,
+///    where 15 means that the value continues in the following bytes, added until a byte is not 255
+///  - the literals
+///  - the offset of the match as 2 byte little-endian value, and the continuation of the match length if needed
+/// The last token has literals only.
+namespace fast_codec
+{
+  const std::size_t min_match = 4;
+  const std::size_t hash_bits = 14;
+  const std::size_t max_offset = 65535;
+
+  inline boost::uint32_t read32(const unsigned char* p)
+  {
+    boost::uint32_t result;
+    std::memcpy(&result, p, sizeof(result));
+    return result;
+  }
+
+  inline std::size_t hash(const boost::uint32_t sequence)
+  {
+    return (sequence * 2654435761u) >> (32 - hash_bits);
+  }
+
+  inline void write_length(std::vector<char>& out, std::size_t length)
+  {
+    while(length >= 255)
+    {
+      out.push_back(static_cast<char>(255));
+      length -= 255;
+    }
+    out.push_back(static_cast<char>(length));
+  }
+
+  void write_sequence(std::vector<char>& out, const unsigned char* literals, const std::size_t nb_literals, const std::size_t offset, const std::size_t match_length)
+  {
+    const std::size_t match_code = match_length == 0 ? 0 : match_length - min_match;
+    const unsigned char token = static_cast<unsigned char>((std::min<std::size_t>(nb_literals, 15) << 4) | std::min<std::size_t>(match_code, 15));
+    out.push_back(static_cast<char>(token));
+    if(nb_literals >= 15)
+      write_length(out, nb_literals - 15);
+    out.insert(out.end(), literals, literals + nb_literals);
+
+    if(match_length == 0)
+      return;
+
+    out.push_back(static_cast<char>(offset & 0xff));
+    out.push_back(static_cast<char>(offset >> 8));
+    if(match_code >= 15)
+      write_length(out, match_code - 15);
+  }
+
+  void compress(const char* data, const std::size_t count, std::vector<char>& out)
+  {
+    out.clear();
+    out.reserve(count + count / 255 + 16);
+
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(data);
+    std::vector<std::size_t> table(std::size_t(1) << hash_bits, count);
+
+    std::size_t pos = 0;
+    std::size_t anchor = 0;
+    while(pos + min_match <= count)
+    {
+      const boost::uint32_t sequence = read32(in + pos);
+      const std::size_t h = hash(sequence);
+      const std::size_t candidate = table[h];
+      table[h] = pos;
+
+      if(candidate < pos && pos - candidate <= max_offset && read32(in + candidate) == sequence)
+      {
+        std::size_t length = min_match;
+        while(pos + length < count && in[candidate + length] == in[pos + length])
+          ++length;
+
+        write_sequence(out, in + anchor, pos - anchor, pos - candidate, length);
+        pos += length;
+        anchor = pos;
+      }
+      else
+      {
+        ++pos;
+      }
+    }
+
+    write_sequence(out, in + anchor, count - anchor, 0, 0);
+  }
+
+  inline std::size_t read_length(const unsigned char*& in, const unsigned char* in_end)
+  {
+    std::size_t result = 0;
+    unsigned char byte = 255;
+    while(byte == 255)
+    {
+      if(in == in_end)
+        throw FileFormatError(FromHere(), "Truncated length in compressed data");
+      byte = *in++;
+      result += byte;
+    }
+    return result;
+  }
+
+  void decompress(const char* compressed, const std::size_t compressed_size, char* data, const std::size_t count)
+  {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(compressed);
+    const unsigned char* in_end = in + compressed_size;
+    unsigned char* out = reinterpret_cast<unsigned char*>(data);
+    unsigned char* out_begin = out;
+    unsigned char* out_end = out + count;
+
+    while(in != in_end)
+    {
+      const unsigned char token = *in++;
+
+      std::size_t nb_literals = token >> 4;
+      if(nb_literals == 15)
+        nb_literals += read_length(in, in_end);
+      if(nb_literals > static_cast<std::size_t>(in_end - in) || nb_literals > static_cast<std::size_t>(out_end - out))
+        throw FileFormatError(FromHere(), "Literals out of range in compressed data");
+      std::memcpy(out, in, nb_literals);
+      in += nb_literals;
+      out += nb_literals;
+
+      if(in == in_end)
+        break;
+
+      if(in_end - in < 2)
+        throw FileFormatError(FromHere(), "Truncated offset in compressed data");
+      const std::size_t offset = in[0] | (std::size_t(in[1]) << 8);
+      in += 2;
+      std::size_t length = token & 0x0f;
+      if(length == 15)
+        length += read_length(in, in_end);
+      length += min_match;
+
+      if(offset == 0 || offset > static_cast<std::size_t>(out - out_begin) || length > static_cast<std::size_t>(out_end - out))
+        throw FileFormatError(FromHere(), "Match out of range in compressed data");
+
+      // Byte by byte, since the match may overlap the output
+      const unsigned char* match = out - offset;
+      for(std::size_t i = 0; i != length; ++i)
+        out[i] = match[i];
+      out += length;
+    }
+
+    if(out != out_end)
+      throw FileFormatError(FromHere(), "Compressed data expands to " + to_str(static_cast<Uint>(out - out_begin)) + " bytes instead of " + to_str(static_cast<Uint>(count)));
+  }
+}
+
+namespace filters
+{
+  /// Byte transposition of the nb_values complete values, remaining bytes are copied
+  void shuffle(const char* in, const std::size_t count, const std::size_t element_size, char* out)
+  {
+    const std::size_t nb_values = count / element_size;
+    for(std::size_t b = 0; b != element_size; ++b)
+    {
+      char* out_row = out + b*nb_values;
+      for(std::size_t i = 0; i != nb_values; ++i)
+        out_row[i] = in[i*element_size + b];
+    }
+    std::copy(in + nb_values*element_size, in + count, out + nb_values*element_size);
+  }
+
+  void unshuffle(const char* in, const std::size_t count, const std::size_t element_size, char* out)
+  {
+    const std::size_t nb_values = count / element_size;
+    for(std::size_t b = 0; b != element_size; ++b)
+    {
+      const char* in_row = in + b*nb_values;
+      for(std::size_t i = 0; i != nb_values; ++i)
+        out[i*element_size + b] = in_row[i];
+    }
+    std::copy(in + nb_values*element_size, in + count, out + nb_values*element_size);
+  }
+
+  /// XOR each byte with the byte stride bytes before it. With the row size as stride, each value is XORed with the
+  /// same column of the previous row, since working byte per byte gives the same result as XOR on whole values.
+  void xor_delta(const char* in, const std::size_t count, const std::size_t stride, char* out)
+  {
+    std::copy(in, in + std::min(stride, count), out);
+    for(std::size_t j = stride; j < count; ++j)
+      out[j] = in[j] ^ in[j - stride];
+  }
+
+  /// Inverse of xor_delta, in place
+  void xor_undelta(char* data, const std::size_t count, const std::size_t stride)
+  {
+    for(std::size_t j = stride; j < count; ++j)
+      data[j] ^= data[j - stride];
+  }
+}
+
+/// Processes the indices begin, begin+stride, ... below n, keeping the error message of an exception
+struct ParallelForWorker
+{
+  ParallelForWorker(const std::size_t begin, const std::size_t n, const std::size_t stride, const boost::function<void (std::size_t)>& f, std::string& error) :
+    m_begin(begin),
+    m_n(n),
+    m_stride(stride),
+    m_f(f),
+    m_error(error)
+  {
+  }
+
+  void operator()()
+  {
+    try
+    {
+      for(std::size_t i = m_begin; i < m_n; i += m_stride)
+        m_f(i);
+    }
+    catch(std::exception& e)
+    {
+      m_error = e.what();
+    }
+    catch(...)
+    {
+      m_error = "unknown error";
+    }
+  }
+
+  const std::size_t m_begin;
+  const std::size_t m_n;
+  const std::size_t m_stride;
+  const boost::function<void (std::size_t)>& m_f;
+  std::string& m_error;
+};
+
+/// Call f(i) for i in [0, n), distributing the indices over nb_threads threads. Exceptions are rethrown as one error.
+void parallel_for(const std::size_t n, const Uint nb_threads, const boost::function<void (std::size_t)>& f)
+{
+  const Uint used_threads = std::min<std::size_t>(n, nb_threads == 0 ? std::max(boost::thread::hardware_concurrency(), 1u) : nb_threads);
+  if(used_threads <= 1)
+  {
+    for(std::size_t i = 0; i != n; ++i)
+      f(i);
+    return;
+  }
+
+  std::vector<std::string> errors(used_threads);
+  boost::thread_group threads;
+  for(Uint t = 0; t != used_threads; ++t)
+    threads.create_thread(ParallelForWorker(t, n, used_threads, f, errors[t]));
+  threads.join_all();
+
+  BOOST_FOREACH(const std::string& error, errors)
+  {
+    if(!error.empty())
+      throw FileFormatError(FromHere(), error);
+  }
+}
+
+void compress_chunk(const BinaryDataCodec& codec, const char* data, const std::size_t count, const std::size_t chunk_size, std::vector< std::vector<char> >& chunks, const std::size_t i)
+{
+  const std::size_t begin = i*chunk_size;
+  codec.compress(data + begin, std::min(chunk_size, count - begin), chunks[i]);
+}
+
+void decompress_chunk(const BinaryDataCodec& codec, const std::vector<const char*>& chunks, const std::vector<std::size_t>& chunk_sizes, char* data, const std::size_t count, const std::size_t chunk_size, const std::size_t i)
+{
+  const std::size_t begin = i*chunk_size;
+  codec.decompress(chunks[i], chunk_sizes[i], data + begin, std::min(chunk_size, count - begin));
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+BinaryDataCodec::BinaryDataCodec(const std::string& name, const Uint level, const std::string& filter, const Uint element_size, const Uint row_size) :
+  m_level(level),
+  m_element_size(std::max(element_size, 1u)),
+  m_row_size(row_size == 0 ? m_element_size : row_size)
+{
+  if(name == "none")
+    m_codec = NONE;
+  else if(name == "zlib")
+    m_codec = ZLIB;
+  else if(name == "fast")
+    m_codec = FAST;
+  else
+    throw BadValue(FromHere(), "Unknown compression codec " + name + ", valid codecs are none, zlib and fast");
+
+  if(m_codec == ZLIB && (m_level < 1 || m_level > 9))
+    throw BadValue(FromHere(), "Compression level for zlib must be between 1 and 9, got " + to_str(m_level));
+
+  if(filter == "none")
+    m_filter = NO_FILTER;
+  else if(filter == "shuffle")
+    m_filter = SHUFFLE;
+  else if(filter == "xor_shuffle")
+    m_filter = XOR_SHUFFLE;
+  else
+    throw BadValue(FromHere(), "Unknown compression filter " + filter + ", valid filters are none, shuffle and xor_shuffle");
+}
+
+std::string BinaryDataCodec::name() const
+{
+  switch(m_codec)
+  {
+    case NONE:
+      return "none";
+    case ZLIB:
+      return "zlib";
+    case FAST:
+      return "fast";
+  }
+  return "";
+}
+
+std::string BinaryDataCodec::filter_name() const
+{
+  switch(m_filter)
+  {
+    case NO_FILTER:
+      return "none";
+    case SHUFFLE:
+      return "shuffle";
+    case XOR_SHUFFLE:
+      return "xor_shuffle";
+  }
+  return "";
+}
+
+bool BinaryDataCodec::is_filtered(const std::size_t count) const
+{
+  if(m_filter == NO_FILTER || count == 0)
+    return false;
+  // Shuffling single bytes does nothing
+  return m_element_size != 1 || (m_filter == XOR_SHUFFLE && m_row_size != 1);
+}
+
+void BinaryDataCodec::compress(const char* data, const std::size_t count, std::vector<char>& out) const
+{
+  if(!is_filtered(count))
+  {
+    compress_raw(data, count, out);
+    return;
+  }
+
+  std::vector<char> filtered(count);
+  if(m_filter == XOR_SHUFFLE)
+  {
+    std::vector<char> delta(count);
+    filters::xor_delta(data, count, m_row_size, &delta[0]);
+    filters::shuffle(&delta[0], count, m_element_size, &filtered[0]);
+  }
+  else
+  {
+    filters::shuffle(data, count, m_element_size, &filtered[0]);
+  }
+  compress_raw(&filtered[0], count, out);
+}
+
+void BinaryDataCodec::decompress(const char* compressed, const std::size_t compressed_size, char* data, const std::size_t count) const
+{
+  if(!is_filtered(count))
+  {
+    decompress_raw(compressed, compressed_size, data, count);
+    return;
+  }
+
+  std::vector<char> filtered(count);
+  decompress_raw(compressed, compressed_size, &filtered[0], count);
+  filters::unshuffle(&filtered[0], count, m_element_size, data);
+  if(m_filter == XOR_SHUFFLE)
+    filters::xor_undelta(data, count, m_row_size);
+}
+
+void BinaryDataCodec::compress_raw(const char* data, const std::size_t count, std::vector<char>& out) const
+{
+  switch(m_codec)
+  {
+    case NONE:
+      out.assign(data, data + count);
+      break;
+    case ZLIB:
+    {
+      out.clear();
+      boost::iostreams::filtering_ostream compressing_stream;
+      compressing_stream.push(boost::iostreams::zlib_compressor(boost::iostreams::zlib_params(static_cast<int>(m_level))));
+      compressing_stream.push(boost::iostreams::back_inserter(out));
+      compressing_stream.write(data, count);
+      compressing_stream.reset();
+      break;
+    }
+    case FAST:
+      fast_codec::compress(data, count, out);
+      break;
+  }
+}
+
+void BinaryDataCodec::decompress_raw(const char* compressed, const std::size_t compressed_size, char* data, const std::size_t count) const
+{
+  switch(m_codec)
+  {
+    case NONE:
+      if(compressed_size != count)
+        throw FileFormatError(FromHere(), "Stored chunk has " + to_str(static_cast<Uint>(compressed_size)) + " bytes instead of " + to_str(static_cast<Uint>(count)));
+      std::memcpy(data, compressed, count);
+      break;
+    case ZLIB:
+    {
+      boost::iostreams::filtering_istream decompressing_stream;
+      decompressing_stream.push(boost::iostreams::zlib_decompressor());
+      decompressing_stream.push(boost::iostreams::array_source(compressed, compressed_size));
+      decompressing_stream.read(data, count);
+      if(static_cast<std::size_t>(decompressing_stream.gcount()) != count)
+        throw FileFormatError(FromHere(), "Compressed chunk expands to less than " + to_str(static_cast<Uint>(count)) + " bytes");
+      break;
+    }
+    case FAST:
+      fast_codec::decompress(compressed, compressed_size, data, count);
+      break;
+  }
+}
+
+void BinaryDataCodec::compress_chunks(const char* data, const std::size_t count, const std::size_t chunk_size, const Uint nb_threads, std::vector< std::vector<char> >& chunks) const
+{
+  cf3_assert(chunk_size != 0);
+  const std::size_t nb_chunks = (count + chunk_size - 1) / chunk_size;
+  chunks.resize(nb_chunks);
+  parallel_for(nb_chunks, nb_threads, boost::bind(&compress_chunk, boost::cref(*this), data, count, chunk_size, boost::ref(chunks), _1));
+}
+
+void BinaryDataCodec::decompress_chunks(const std::vector<const char*>& chunks, const std::vector<std::size_t>& chunk_sizes, char* data, const std::size_t count, const std::size_t chunk_size, const Uint nb_threads) const
+{
+  cf3_assert(chunk_size != 0);
+  const std::size_t nb_chunks = (count + chunk_size - 1) / chunk_size;
+  if(chunks.size() != nb_chunks || chunk_sizes.size() != nb_chunks)
+    throw FileFormatError(FromHere(), "Expected " + to_str(static_cast<Uint>(nb_chunks)) + " compressed chunks, got " + to_str(static_cast<Uint>(chunks.size())));
+  parallel_for(nb_chunks, nb_threads, boost::bind(&decompress_chunk, boost::cref(*this), boost::cref(chunks), boost::cref(chunk_sizes), data, count, chunk_size, _1));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+} // common
+} // cf3
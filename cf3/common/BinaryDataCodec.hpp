@@ -0,0 +1,95 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#ifndef cf3_common_BinaryDataCodec_hpp
+#define cf3_common_BinaryDataCodec_hpp
+
+#include <string>
+#include <vector>
+
+#include "common/CommonAPI.hpp"
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+namespace cf3 {
+namespace common {
+
+///////////////////////////////////////////////////////////////////////////////////////
+
+/// Compression used for the data blocks of BinaryDataWriter and BinaryDataReader. A block is split into chunks of a
+/// fixed size, which are compressed independently so several threads can work on them.
+/// Available codecs:
+///  - none: the data is stored as is
+///  - zlib: deflate at the configured level (1 to 9)
+///  - fast: a byte-oriented LZ77 codec in the style of LZ4, trading compression ratio for speed
+/// Before compression, a filter can rearrange the bytes of each chunk, taking into account the size of the stored
+/// values (e.g. 8 for doubles). This makes smooth floating point data much more compressible:
+///  - none: no filter
+///  - shuffle: group the first bytes of all values, then the second bytes, ...
+///  - xor_shuffle: replace each value by its bitwise XOR with the value in the same column of the previous row, then
+///    shuffle. Neighbouring values of a smooth field share sign, exponent and leading mantissa bits, which become zero
+///    bytes.
+class Common_API BinaryDataCodec
+{
+public:
+  enum Codec { NONE, ZLIB, FAST };
+  enum Filter { NO_FILTER, SHUFFLE, XOR_SHUFFLE };
+
+  /// Build a codec from its name. Throws BadValue for unknown names.
+  /// @param filter Name of the filter
+  /// @param element_size Size in bytes of the stored values, used by the filter
+  /// @param row_size Size in bytes of a row of the stored table, i.e. the distance between the values XORed by
+  ///        xor_shuffle. Zero means element_size, as for lists.
+  BinaryDataCodec(const std::string& name, const Uint level = 6, const std::string& filter = "none", const Uint element_size = 1, const Uint row_size = 0);
+
+  /// Name of the codec, as stored in the XML index
+  std::string name() const;
+
+  /// Name of the filter, as stored in the XML index
+  std::string filter_name() const;
+
+  Codec codec() const { return m_codec; }
+  Uint level() const { return m_level; }
+  Filter filter() const { return m_filter; }
+  Uint element_size() const { return m_element_size; }
+  Uint row_size() const { return m_row_size; }
+
+  /// Compress count bytes of data, replacing the contents of out
+  void compress(const char* data, const std::size_t count, std::vector<char>& out) const;
+
+  /// Decompress a chunk that must expand to exactly count bytes. Throws FileFormatError otherwise.
+  void decompress(const char* compressed, const std::size_t compressed_size, char* data, const std::size_t count) const;
+
+  /// Compress count bytes of data, split in chunks of chunk_size bytes (the last one may be smaller), using
+  /// nb_threads threads. Zero threads means the number of hardware threads.
+  void compress_chunks(const char* data, const std::size_t count, const std::size_t chunk_size, const Uint nb_threads, std::vector< std::vector<char> >& chunks) const;
+
+  /// Decompress the chunks produced by compress_chunks into data, which holds count bytes
+  void decompress_chunks(const std::vector<const char*>& chunks, const std::vector<std::size_t>& chunk_sizes, char* data, const std::size_t count, const std::size_t chunk_size, const Uint nb_threads) const;
+
+private:
+  /// True if the filter changes the data
+  bool is_filtered(const std::size_t count) const;
+  /// Compression without the filter
+  void compress_raw(const char* data, const std::size_t count, std::vector<char>& out) const;
+  /// Decompression without the filter
+  void decompress_raw(const char* compressed, const std::size_t compressed_size, char* data, const std::size_t count) const;
+
+  Codec m_codec;
+  Uint m_level;
+  Filter m_filter;
+  Uint m_element_size;
+  Uint m_row_size;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+} // common
+} // cf3
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+#endif // cf3_common_BinaryDataCodec_hpp
@@ -4,8 +4,12 @@
 // GNU Lesser General Public License version 3 (LGPLv3).
 // See doc/lgpl.txt and doc/gpl.txt for the license text.
 
+#include <cstring>
+
 #include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
 #include <boost/function.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/iostreams/filter/zlib.hpp>
@@ -16,6 +20,7 @@
 #include "common/Signal.hpp"
 #include "common/PropertyList.hpp"
 #include "common/OptionList.hpp"
+#include "common/BinaryDataCodec.hpp"
 #include "common/BinaryDataReader.hpp"
 #include "common/FindComponents.hpp"
 
@@ -36,7 +41,8 @@ struct BinaryDataReader::Implementation
     m_rank(rank)
   {
     XmlNode cfbinary(xml_doc->content->first_node("cfbinary"));
-    cf3_assert(from_str<Uint>(cfbinary.attribute_value("version")) == version());
+    if(from_str<Uint>(cfbinary.attribute_value("version")) > version())
+      throw FileFormatError(FromHere(), "Unsupported version " + cfbinary.attribute_value("version") + " for binary file " + file.path());
 
     XmlNode nodes(cfbinary.content->first_node(("nodes")));
     XmlNode node(nodes.content->first_node("node"));
@@ -62,7 +68,7 @@ struct BinaryDataReader::Implementation
 
   Uint version() const
   {
-    static const Uint current_version = 1;
+    static const Uint current_version = 2;
     return current_version;
   }
   
@@ -78,15 +84,15 @@ struct BinaryDataReader::Implementation
     throw SetupError(FromHere(), "Block with index " + to_str(block_idx) + " was not found");
   }
 
-  void read_data_block(char *data, const Uint count, const Uint block_idx)
+  void read_data_block(char *data, const Uint count, const Uint block_idx, const Uint nb_threads)
   {
     static const std::string block_prefix("__CFDATA_BEGIN");
     
     XmlNode block_node = get_block_node(block_idx);
       
-    const Uint block_begin = from_str<Uint>(block_node.attribute_value("begin"));
-    const Uint block_end = from_str<Uint>(block_node.attribute_value("end"));
-    const Uint compressed_size = block_end - block_begin - block_prefix.size();
+    const boost::uint64_t block_begin = boost::lexical_cast<boost::uint64_t>(block_node.attribute_value("begin"));
+    const boost::uint64_t block_end = boost::lexical_cast<boost::uint64_t>(block_node.attribute_value("end"));
+    const boost::uint64_t compressed_size = block_end - block_begin - block_prefix.size();
 
     // Check the prefix
     binary_file.seekg(block_begin);
@@ -96,8 +102,22 @@ struct BinaryDataReader::Implementation
     if(read_prefix != block_prefix)
       throw SetupError(FromHere(), "Bad block prefix for block " + to_str(block_idx));
    
-    if(count != 0)
+    const std::string codec_name = block_node.attribute_value("codec");
+    if(!codec_name.empty())
+    {
+      const std::string row_size = block_node.attribute_value("row_size");
+      if(row_size.empty())
+        throw FileFormatError(FromHere(), "Block " + to_str(block_idx) + " has a codec but no row_size");
+      const BinaryDataCodec codec(codec_name,
+                                  from_str<Uint>(block_node.attribute_value("level")),
+                                  block_node.attribute_value("filter"),
+                                  from_str<Uint>(block_node.attribute_value("element_size")),
+                                  from_str<Uint>(row_size));
+      read_chunks(data, count, compressed_size, codec, from_str<Uint>(block_node.attribute_value("chunk_size")), nb_threads);
+    }
+    else if(count != 0)
     {
+      // Version 1 block, compressed as a single zlib stream
       // Build a decompressing stream
       boost::iostreams::filtering_istream decompressing_stream;
       decompressing_stream.set_auto_close(false);
@@ -112,6 +132,36 @@ struct BinaryDataReader::Implementation
     cf3_assert(binary_file.tellg() == block_end);
   }
 
+  /// Read the chunks of a block and decompress them in parallel
+  void read_chunks(char* data, const Uint count, const boost::uint64_t compressed_size, const BinaryDataCodec& codec, const Uint chunk_size, const Uint nb_threads)
+  {
+    std::vector<char> buffer(compressed_size);
+    if(compressed_size != 0)
+      binary_file.read(&buffer[0], compressed_size);
+    if(!binary_file.good())
+      throw FileFormatError(FromHere(), "Error reading compressed data");
+
+    // Locate the chunks, each prefixed with its size
+    std::vector<const char*> chunks;
+    std::vector<std::size_t> chunk_sizes;
+    boost::uint64_t position = 0;
+    while(position != compressed_size)
+    {
+      boost::uint64_t chunk_bytes;
+      if(compressed_size - position < sizeof(boost::uint64_t))
+        throw FileFormatError(FromHere(), "Truncated chunk size");
+      std::memcpy(&chunk_bytes, &buffer[position], sizeof(boost::uint64_t));
+      position += sizeof(boost::uint64_t);
+      if(compressed_size - position < chunk_bytes)
+        throw FileFormatError(FromHere(), "Truncated chunk");
+      chunks.push_back(&buffer[0] + position);
+      chunk_sizes.push_back(chunk_bytes);
+      position += chunk_bytes;
+    }
+
+    codec.decompress_chunks(chunks, chunk_sizes, data, count, chunk_size, nb_threads);
+  }
+
   // XML document describing all data added
   boost::shared_ptr<XmlDoc> xml_doc;
 
@@ -138,6 +188,10 @@ BinaryDataReader::BinaryDataReader ( const std::string& name ) : Component(name)
     .pretty_name("Rank")
     .description("Rank for which to read data")
     .attach_trigger(boost::bind(&BinaryDataReader::trigger_file, this));
+
+  options().add("threads", 1u)
+    .pretty_name("Threads")
+    .description("Number of threads used for decompression. Each MPI process starts its own threads, so keep this at 1 when running one process per core. 0 uses all hardware threads.");
 }
 
 BinaryDataReader::~BinaryDataReader()
@@ -176,7 +230,7 @@ void BinaryDataReader::read_data_block(char *data, const Uint count, const Uint
   if(is_null(m_implementation.get()))
     throw SetupError(FromHere(), "No open file for BinaryDataReader at " + uri().path());
   
-  m_implementation->read_data_block(data, count, block_idx);
+  m_implementation->read_data_block(data, count, block_idx, options().value<Uint>("threads"));
 }
 
 void BinaryDataReader::trigger_file()
@@ -4,14 +4,20 @@
 // GNU Lesser General Public License version 3 (LGPLv3).
 // See doc/lgpl.txt and doc/gpl.txt for the license text.
 
+#include <algorithm>
+
 #include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/foreach.hpp>
 #include <boost/function.hpp>
 #include <boost/assign/list_of.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/filesystem/fstream.hpp>
 
-#include <boost/iostreams/filtering_stream.hpp>
-#include <boost/iostreams/filter/zlib.hpp>
-#include <boost/iostreams/device/file_descriptor.hpp>
-
+#include "common/BackgroundWriter.hpp"
+#include "common/BasicExceptions.hpp"
+#include "common/BinaryDataCodec.hpp"
 #include "common/Log.hpp"
 #include "common/Signal.hpp"
 #include "common/PropertyList.hpp"
@@ -31,16 +37,23 @@ namespace common {
 
 struct BinaryDataWriter::Implementation
 {
-  Implementation(const URI& file) :
+  Implementation(const URI& file, const bool is_asynchronous, const BinaryDataCodec& block_codec, const Uint block_chunk_size, const Uint nb_threads) :
     filename(build_filename(file, PE::Comm::instance().rank())),
     xml_filename(file),
+    asynchronous(is_asynchronous),
+    codec(block_codec),
+    chunk_size(block_chunk_size),
+    threads(nb_threads == 0 ? std::max(boost::thread::hardware_concurrency(), 1u) : nb_threads),
     index(0),
     xml_doc("1.0", "ISO-8859-1"),
-    m_total_count(0)
+    m_total_count(0),
+    m_file_size(0),
+    m_blocks_written(false),
+    m_finished(false)
   {
-    const Uint v = version();
-    out_file.open(filename, std::ios_base::out | std::ios_base::binary);
-    out_file.write(reinterpret_cast<const char*>(&v), sizeof(Uint));
+    // In asynchronous mode, the file is opened by the background thread
+    if(!asynchronous)
+      open_file();
 
     PE::Comm& comm = PE::Comm::instance();
     // Rank 0 writes out an XML file that lists all filenames for all CPUs
@@ -62,44 +75,155 @@ struct BinaryDataWriter::Implementation
 
   ~Implementation()
   {
-    CFdebug << "wrote a total of " << m_total_count << " bytes with a compression ratio of " << static_cast<Real>(out_file.tellp()) / static_cast<Real>(m_total_count) * 100. << "%" << CFendl;
-    out_file.close();
+    if(m_finished)
+      return;
+
+    // A synchronous writer is completed when it is closed
+    if(!asynchronous)
+    {
+      finish();
+      return;
+    }
+
+    // The completion of an asynchronous writer never ran, e.g. because the BackgroundWriter was destroyed with pending
+    // jobs. The background thread may already have written the blocks, and MPI may be finalized, so only close the file.
+    if(out_file.is_open())
+      out_file.close();
+  }
+
+  void open_file()
+  {
+    const Uint v = version();
+    out_file.open(filename, std::ios_base::out | std::ios_base::binary);
+    out_file.write(reinterpret_cast<const char*>(&v), sizeof(Uint));
+  }
+
+  /// Close the binary file and write the XML index. Collective.
+  void finish()
+  {
+    cf3_assert(!m_finished);
+    m_finished = true;
+
+    if(out_file.is_open())
+    {
+      m_file_size = out_file.tellp();
+      out_file.close();
+    }
+
+    // Index entries for blocks that were written in the background
+    BOOST_FOREACH(const StagedBlock& block, staged_blocks)
+    {
+      add_block_info(block.index, block.list_name, block.type_name, block.nb_rows, block.nb_cols, block.element_size, block.count, block.begin, block.end);
+    }
+    staged_blocks.clear();
+
+    CFdebug << "wrote a total of " << m_total_count << " bytes with a compression ratio of " << static_cast<Real>(m_file_size) / static_cast<Real>(m_total_count) * 100. << "%" << CFendl;
     if(PE::Comm::instance().rank() == 0)
       XML::to_file(xml_doc, xml_filename);
 
     PE::Comm::instance().barrier();
   }
 
-  Uint write_data_block(const char* data, const std::streamsize count, const std::string& list_name, const Uint nb_rows, const Uint nb_cols, const std::string& type_name)
+  Uint write_data_block(const char* data, const std::streamsize count, const std::string& list_name, const Uint nb_rows, const Uint nb_cols, const std::string& type_name, const Uint element_size)
+  {
+    cf3_assert(!m_finished);
+
+    if(asynchronous)
+    {
+      // Keep a copy of the data, so the caller may modify it while the file is written
+      staged_blocks.push_back(StagedBlock());
+      StagedBlock& block = staged_blocks.back();
+      block.data.assign(data, data + count);
+      block.list_name = list_name;
+      block.type_name = type_name;
+      block.nb_rows = nb_rows;
+      block.nb_cols = nb_cols;
+      block.element_size = element_size;
+      block.count = count;
+      block.index = index;
+    }
+    else
+    {
+      boost::uint64_t block_begin, block_end;
+      write_block(data, count, element_size, nb_cols, block_begin, block_end);
+      add_block_info(index, list_name, type_name, nb_rows, nb_cols, element_size, count, block_begin, block_end);
+    }
+
+    ++index;
+    m_total_count += count;
+
+    return index - 1;
+  }
+
+  /// Write all staged blocks to the binary file. Called from the background thread in asynchronous mode, so no MPI
+  /// or logging is allowed here.
+  void write_staged_blocks()
+  {
+    // The data of the blocks is released after writing, so writing again would truncate the file
+    if(m_blocks_written)
+      return;
+
+    open_file();
+    BOOST_FOREACH(StagedBlock& block, staged_blocks)
+    {
+      write_block(block.data.empty() ? 0 : &block.data[0], block.data.size(), block.element_size, block.nb_cols, block.begin, block.end);
+      // Release the memory as soon as possible
+      std::vector<char>().swap(block.data);
+    }
+    if(!out_file.good())
+      throw FileSystemError(FromHere(), "Error writing to file " + filename);
+    m_blocks_written = true;
+  }
+
+  /// Write a compressed data block to the binary file, returning its position.
+  /// After the prefix, each chunk is written as its compressed size (64 bit) followed by the compressed data.
+  void write_block(const char* data, const std::streamsize count, const Uint element_size, const Uint nb_cols, boost::uint64_t& block_begin, boost::uint64_t& block_end)
   {
+    // The filter shuffles the bytes of each value, and XORs the values of consecutive rows
+    const BinaryDataCodec block_codec(codec.name(), codec.level(), codec.filter_name(), element_size, element_size*nb_cols);
+
     cf3_assert(out_file.is_open());
-    PE::Comm& comm = PE::Comm::instance();
     // Prefix and suffix markers
     static const std::string block_prefix("__CFDATA_BEGIN");
 
-    const Uint block_begin = out_file.tellp();
+    block_begin = out_file.tellp();
 
     // Write the prefix
     out_file.write(block_prefix.c_str(), block_prefix.size());
-    
-    if(count != 0)
+
+    // Compress a few chunks per thread at a time, limiting the memory needed for the compressed data
+    const std::size_t round_size = static_cast<std::size_t>(chunk_size) * threads * 4;
+    std::vector< std::vector<char> > chunks;
+    for(std::size_t round_begin = 0; round_begin < static_cast<std::size_t>(count); round_begin += round_size)
     {
-      // Build a compressed stream
-      boost::iostreams::filtering_ostream compressing_stream;
-      compressing_stream.push(boost::iostreams::zlib_compressor());
-      compressing_stream.push(out_file);
-      
-      // Write the data
-      compressing_stream.write(data, count);
-      compressing_stream.pop();
+      block_codec.compress_chunks(data + round_begin, std::min(round_size, static_cast<std::size_t>(count) - round_begin), chunk_size, threads, chunks);
+      BOOST_FOREACH(const std::vector<char>& chunk, chunks)
+      {
+        const boost::uint64_t chunk_bytes = chunk.size();
+        out_file.write(reinterpret_cast<const char*>(&chunk_bytes), sizeof(boost::uint64_t));
+        if(!chunk.empty())
+          out_file.write(&chunk[0], chunk.size());
+      }
     }
 
-    const Uint block_end = out_file.tellp();
+    block_end = out_file.tellp();
+  }
+
+  /// Gather the position of a block on all CPUs and add it to the XML index
+  void add_block_info(const Uint block_index, const std::string& list_name, const std::string& type_name, const Uint nb_rows, const Uint nb_cols, const Uint element_size, const boost::uint64_t count, const boost::uint64_t block_begin, const boost::uint64_t block_end)
+  {
+    PE::Comm& comm = PE::Comm::instance();
+
+    if(count != 0)
+    {
+      const boost::uint64_t compressed_count = block_end - block_begin;
+      CFdebug << "block " << list_name << ": " << count << " bytes compressed to " << compressed_count << " bytes (" << static_cast<Real>(compressed_count) / static_cast<Real>(count) * 100. << "%)" << CFendl;
+    }
 
     // Data describing the block on the current CPU
-    const std::vector<Uint> my_block_info = boost::assign::list_of(nb_rows)(nb_cols)(block_begin)(block_end);
+    const std::vector<boost::uint64_t> my_block_info = boost::assign::list_of<boost::uint64_t>(nb_rows)(nb_cols)(block_begin)(block_end);
     const Uint block_info_size = my_block_info.size();
-    std::vector<Uint> global_block_info;
+    std::vector<boost::uint64_t> global_block_info;
     const Uint root = 0;
     if(comm.is_active())
     {
@@ -119,24 +243,25 @@ struct BinaryDataWriter::Implementation
         XmlNode block_xml = node_xml_data[i].add_node("block");
         const Uint j = i*block_info_size;
         block_xml.set_attribute("name", list_name);
-        block_xml.set_attribute("index", to_str(index));
+        block_xml.set_attribute("index", to_str(block_index));
         block_xml.set_attribute("type_name", type_name);
-        block_xml.set_attribute("nb_rows", to_str(global_block_info[j]));
-        block_xml.set_attribute("nb_cols", to_str(global_block_info[j+1]));
-        block_xml.set_attribute("begin", to_str(global_block_info[j+2]));
-        block_xml.set_attribute("end", to_str(global_block_info[j+3]));
+        block_xml.set_attribute("nb_rows", boost::lexical_cast<std::string>(global_block_info[j]));
+        block_xml.set_attribute("nb_cols", boost::lexical_cast<std::string>(global_block_info[j+1]));
+        block_xml.set_attribute("begin", boost::lexical_cast<std::string>(global_block_info[j+2]));
+        block_xml.set_attribute("end", boost::lexical_cast<std::string>(global_block_info[j+3]));
+        block_xml.set_attribute("codec", codec.name());
+        block_xml.set_attribute("level", to_str(codec.level()));
+        block_xml.set_attribute("filter", codec.filter_name());
+        block_xml.set_attribute("element_size", to_str(element_size));
+        block_xml.set_attribute("row_size", boost::lexical_cast<std::string>(element_size*global_block_info[j+1]));
+        block_xml.set_attribute("chunk_size", to_str(chunk_size));
       }
     }
-
-    ++index;
-    m_total_count += count;
-
-    return index - 1;
   }
 
   Uint version() const
   {
-    static const Uint current_version = 1;
+    static const Uint current_version = 2;
     return current_version;
   }
 
@@ -148,8 +273,30 @@ struct BinaryDataWriter::Implementation
     return result.path();
   }
 
+  /// A copy of the data of a block, waiting to be written in the background
+  struct StagedBlock
+  {
+    StagedBlock() : nb_rows(0), nb_cols(0), element_size(1), count(0), index(0), begin(0), end(0) {}
+    std::vector<char> data;
+    std::string list_name;
+    std::string type_name;
+    Uint nb_rows;
+    Uint nb_cols;
+    Uint element_size;
+    // Uncompressed size, kept after the data is released
+    boost::uint64_t count;
+    Uint index;
+    // Position in the file, set after writing
+    boost::uint64_t begin;
+    boost::uint64_t end;
+  };
+
   const std::string filename;
   const URI xml_filename;
+  const bool asynchronous;
+  const BinaryDataCodec codec;
+  const Uint chunk_size;
+  const Uint threads;
   boost::filesystem::fstream out_file;
 
   // Index of the next block to write
@@ -159,9 +306,14 @@ struct BinaryDataWriter::Implementation
   XmlDoc xml_doc;
 
   std::vector<XmlNode> node_xml_data;
-  Uint m_total_count;
+  std::vector<StagedBlock> staged_blocks;
+  boost::uint64_t m_total_count;
+  boost::uint64_t m_file_size;
+  // True once the staged blocks are in the file
+  bool m_blocks_written;
+  bool m_finished;
 };
-  
+
 ////////////////////////////////////////////////////////////////////////////////////////////
 
 BinaryDataWriter::BinaryDataWriter ( const std::string& name ) : Component(name)
@@ -170,6 +322,31 @@ BinaryDataWriter::BinaryDataWriter ( const std::string& name ) : Component(name)
     .pretty_name("File")
     .description("File name for the output file")
     .attach_trigger(boost::bind(&BinaryDataWriter::trigger_file, this));
+
+  options().add("asynchronous", false)
+    .pretty_name("Asynchronous")
+    .description("Copy the data when it is appended, and compress and write it on a background thread after the file is closed. "
+                 "The XML index is written when the BackgroundWriter completes the file.");
+
+  options().add("codec", std::string("zlib"))
+    .pretty_name("Codec")
+    .description("Compression codec for the data blocks: none, zlib or fast. The fast codec is an LZ77 variant that trades compression ratio for speed.");
+
+  options().add("filter", std::string("xor_shuffle"))
+    .pretty_name("Filter")
+    .description("Transformation of the bytes before compression: none, shuffle (group the bytes by position in the value) or xor_shuffle (XOR with the previous value, then shuffle). Improves the compression of smooth floating point fields.");
+
+  options().add("compression_level", 6u)
+    .pretty_name("Compression Level")
+    .description("Compression level for the zlib codec, from 1 (fastest) to 9 (smallest)");
+
+  options().add("chunk_size", 1u << 22)
+    .pretty_name("Chunk Size")
+    .description("Size in bytes of the chunks that are compressed independently");
+
+  options().add("threads", 1u)
+    .pretty_name("Threads")
+    .description("Number of threads used for compression. Each MPI process starts its own threads, so keep this at 1 when running one process per core. 0 uses all hardware threads.");
 }
 
 BinaryDataWriter::~BinaryDataWriter()
@@ -179,22 +356,52 @@ BinaryDataWriter::~BinaryDataWriter()
 
 void BinaryDataWriter::close()
 {
+  close(boost::function<void ()>());
+}
+
+void BinaryDataWriter::close(const boost::function<void ()>& on_completion)
+{
+  if(is_null(m_implementation.get()) || !m_implementation->asynchronous)
+  {
+    m_implementation.reset();
+    if(on_completion)
+      on_completion();
+    return;
+  }
+
+  boost::shared_ptr<Implementation> implementation = m_implementation;
   m_implementation.reset();
+  BackgroundWriter::instance().submit(boost::bind(&Implementation::write_staged_blocks, implementation),
+                                      boost::bind(&BinaryDataWriter::complete_file, implementation, on_completion));
 }
 
-Uint BinaryDataWriter::write_data_block(const char* data, const std::streamsize count, const std::string& list_name, const Uint nb_rows, const Uint nb_cols, const std::string& type_name)
+Uint BinaryDataWriter::write_data_block(const char* data, const std::streamsize count, const std::string& list_name, const Uint nb_rows, const Uint nb_cols, const std::string& type_name, const Uint element_size)
 {
   if(is_null(m_implementation.get()))
   {
-    m_implementation.reset(new Implementation(options().value<URI>("file")));
+    const Uint chunk_size = options().value<Uint>("chunk_size");
+    if(chunk_size == 0)
+      throw BadValue(FromHere(), "chunk_size for " + uri().path() + " must be positive");
+    m_implementation.reset(new Implementation(options().value<URI>("file"),
+                                              options().value<bool>("asynchronous"),
+                                              BinaryDataCodec(options().value<std::string>("codec"), options().value<Uint>("compression_level"), options().value<std::string>("filter")),
+                                              chunk_size,
+                                              options().value<Uint>("threads")));
   }
 
-  return m_implementation->write_data_block(data, count, list_name, nb_rows, nb_cols, type_name);
+  return m_implementation->write_data_block(data, count, list_name, nb_rows, nb_cols, type_name, element_size);
 }
 
 void BinaryDataWriter::trigger_file()
 {
-  m_implementation.reset();
+  close();
+}
+
+void BinaryDataWriter::complete_file(const boost::shared_ptr<Implementation>& implementation, const boost::function<void ()>& on_completion)
+{
+  implementation->finish();
+  if(on_completion)
+    on_completion();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
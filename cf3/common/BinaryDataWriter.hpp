@@ -7,7 +7,8 @@
 #ifndef cf3_common_BinaryDataWriter_hpp
 #define cf3_common_BinaryDataWriter_hpp
 
-#include <boost/scoped_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include "common/Component.hpp"
 #include "common/List.hpp"
@@ -21,7 +22,10 @@ namespace common {
 ///////////////////////////////////////////////////////////////////////////////////////
 
   
-/// Component for writing binary data collected into a single file
+/// Component for writing binary data collected into a single file.
+/// If the asynchronous option is set, the data is copied when appended and written by the BackgroundWriter after close.
+/// Each block is split in chunks that are compressed in parallel, using the codec set by the codec option, after
+/// rearranging the bytes of the values according to the filter option (see BinaryDataCodec).
 class Common_API BinaryDataWriter : public Component {
 
 public: // functions
@@ -38,28 +42,36 @@ public: // functions
   template<typename T>
   Uint append_data(const Table<T>& table)
   {
-    return write_data_block(reinterpret_cast<const char*>(table.array().data()), sizeof(T)*table.row_size()*table.size(), table.name(), table.size(), table.row_size(), class_name<T>());
+    return write_data_block(reinterpret_cast<const char*>(table.array().data()), sizeof(T)*table.row_size()*table.size(), table.name(), table.size(), table.row_size(), class_name<T>(), sizeof(T));
   }
   
   /// Append a new data block, returning the block index number for the current file
   template<typename T>
   Uint append_data(const List<T>& list)
   {
-    return write_data_block(reinterpret_cast<const char*>(list.array().data()), sizeof(T)*list.size(), list.name(), list.size(), 1, class_name<T>());
+    return write_data_block(reinterpret_cast<const char*>(list.array().data()), sizeof(T)*list.size(), list.name(), list.size(), 1, class_name<T>(), sizeof(T));
   }
 
   /// Close the current file
   void close();
 
+  /// Close the current file, calling on_completion on the main thread once the file and its index are written.
+  /// In asynchronous mode this happens when the BackgroundWriter completes the file, otherwise immediately.
+  void close(const boost::function<void ()>& on_completion);
+
 private:
   // Write a data block to the binary file
-  Uint write_data_block(const char* data, const std::streamsize count, const std::string& list_name, const Uint nb_rows, const Uint nb_cols, const std::string& type_name);
+  Uint write_data_block(const char* data, const std::streamsize count, const std::string& list_name, const Uint nb_rows, const Uint nb_cols, const std::string& type_name, const Uint element_size);
 
   // Trigger on output file change
   void trigger_file();
 
   class Implementation;
-  boost::scoped_ptr<Implementation> m_implementation;
+
+  // Completion of an asynchronously written file
+  static void complete_file(const boost::shared_ptr<Implementation>& implementation, const boost::function<void ()>& on_completion);
+
+  boost::shared_ptr<Implementation> m_implementation;
 };
 
 /////////////////////////////////////////////////////////////////////////////////////
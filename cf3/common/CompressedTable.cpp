@@ -0,0 +1,66 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#include "common/Builder.hpp"
+
+#include "common/LibCommon.hpp"
+#include "common/CompressedTable.hpp"
+
+namespace cf3 {
+namespace common {
+
+common::ComponentBuilder < CompressedTable<Uint>, Component, LibCommon > CompressedTable_Uint_Builder;
+
+common::ComponentBuilder < CompressedTable<int>, Component, LibCommon >  CompressedTable_int_Builder;
+
+common::ComponentBuilder < CompressedTable<Real>, Component, LibCommon > CompressedTable_Real_Builder;
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace detail
+{
+  template<typename T>
+  void print_compressed_table(std::ostream& os, const CompressedTable<T>& table)
+  {
+    if (table.size())
+      os << "\n";
+    for (Uint i=0; i<table.size(); ++i)
+    {
+      os << "  " << i << ":  ";
+      if (table.row_size(i) == 0)
+        os << "~";
+      else
+      {
+        boost_foreach(const T& entry, table[i])
+          os << entry << " ";
+      }
+      os << "\n";
+    }
+  }
+}
+
+std::ostream& operator<<(std::ostream& os, const CompressedTable<Uint>& table)
+{
+  detail::print_compressed_table(os, table);
+  return os;
+}
+
+std::ostream& operator<<(std::ostream& os, const CompressedTable<int>& table)
+{
+  detail::print_compressed_table(os, table);
+  return os;
+}
+
+std::ostream& operator<<(std::ostream& os, const CompressedTable<Real>& table)
+{
+  detail::print_compressed_table(os, table);
+  return os;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // common
+} // cf3
@@ -0,0 +1,235 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#ifndef cf3_common_CompressedTable_hpp
+#define cf3_common_CompressedTable_hpp
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <boost/noncopyable.hpp>
+#include <boost/range/iterator_range.hpp>
+
+#include "common/DynTable.hpp"
+
+//////////////////////////////////////////////////////////////////////////////
+
+namespace cf3 {
+namespace common {
+
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+class CompressedTableBuffer;
+
+/// Component holding a table with variable row-size per row, in compressed row storage: the values of all rows are
+/// stored one after the other in a single vector, and the start of each row is given by an offsets vector.
+/// Compared to DynTable, this avoids one allocation per row and keeps neighbouring rows close in memory, but the
+/// size of a row can not be changed on its own. Tables are filled using a CompressedTableBuilder, by assigning a
+/// vector of rows, or through a buffer with the same interface as the DynTable buffer.
+template<typename T>
+class CompressedTable : public common::Component {
+
+public:
+
+  typedef std::vector<T> ValuesT;
+  typedef boost::iterator_range<typename ValuesT::iterator> Row;
+  typedef boost::iterator_range<typename ValuesT::const_iterator> ConstRow;
+  typedef CompressedTableBuffer<T> Buffer;
+
+  /// Contructor
+  /// @param name of the component
+  CompressedTable ( const std::string& name ) : Component(name), m_offsets(1, 0) { }
+
+  ~CompressedTable () {}
+
+  /// Get the class name
+  static std::string type_name () { return "CompressedTable<"+common::class_name<T>()+">"; }
+
+  /// Number of rows
+  Uint size() const { return m_offsets.size() - 1; }
+
+  Uint row_size(const Uint i) const { return m_offsets[i+1] - m_offsets[i]; }
+
+  /// Total number of values in all rows
+  Uint nb_values() const { return m_values.size(); }
+
+  /// Remove all rows
+  void clear()
+  {
+    m_offsets.assign(1, 0);
+    ValuesT().swap(m_values);
+  }
+
+  /// Set the number of rows and the size of each row. The values are reset.
+  void set_row_sizes(const std::vector<Uint>& row_sizes)
+  {
+    m_offsets.resize(row_sizes.size() + 1);
+    m_offsets[0] = 0;
+    for (Uint i=0; i<row_sizes.size(); ++i)
+      m_offsets[i+1] = m_offsets[i] + row_sizes[i];
+    m_values.assign(m_offsets.back(), T());
+  }
+
+  /// Replace the contents with the given rows, e.g. the array of a DynTable
+  void assign(const std::vector< std::vector<T> >& rows)
+  {
+    m_offsets.resize(rows.size() + 1);
+    m_offsets[0] = 0;
+    for (Uint i=0; i<rows.size(); ++i)
+      m_offsets[i+1] = m_offsets[i] + rows[i].size();
+    ValuesT values;
+    values.reserve(m_offsets.back());
+    boost_foreach(const std::vector<T>& row, rows)
+      values.insert(values.end(), row.begin(), row.end());
+    m_values.swap(values);
+  }
+
+  /// Buffer to add and remove rows one by one. The rows are copied to the buffer, and compressed again on flush.
+  boost::shared_ptr<Buffer> create_buffer_ptr(const size_t buffersize=16384)
+  {
+    return boost::shared_ptr<Buffer> ( new Buffer (*this,buffersize) );
+  }
+
+  Row operator[] (const Uint idx)
+  {
+    cf3_assert(idx < size());
+    return Row(m_values.begin() + m_offsets[idx], m_values.begin() + m_offsets[idx+1]);
+  }
+
+  ConstRow operator[] (const Uint idx) const
+  {
+    cf3_assert(idx < size());
+    return ConstRow(m_values.begin() + m_offsets[idx], m_values.begin() + m_offsets[idx+1]);
+  }
+
+  /// Start of each row in the values, with the total number of values as last entry
+  const std::vector<Uint>& offsets() const { return m_offsets; }
+
+  /// @return A reference to the values of all rows
+  ValuesT& values() { return m_values; }
+
+  /// @return A const reference to the values of all rows
+  const ValuesT& values() const { return m_values; }
+
+private: // data
+
+  std::vector<Uint> m_offsets;
+  ValuesT m_values;
+
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+std::ostream& operator<<(std::ostream& os, const CompressedTable<Uint>& table);
+std::ostream& operator<<(std::ostream& os, const CompressedTable<int>& table);
+std::ostream& operator<<(std::ostream& os, const CompressedTable<Real>& table);
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Fills a CompressedTable in two passes. First, count is called for every value that will be added to a row.
+/// After allocate, the values are added with add, in any order of the rows. Values within a row keep the order
+/// in which they were added.
+template <typename T>
+class CompressedTableBuilder : public boost::noncopyable
+{
+public:
+
+  /// @param nb_rows Number of rows the table will have. Its current contents are discarded by allocate.
+  CompressedTableBuilder(CompressedTable<T>& table, const Uint nb_rows) :
+    m_table(table),
+    m_positions(nb_rows, 0),
+    m_allocated(false)
+  {}
+
+  /// First pass: reserve room for nb_values values in the given row
+  void count(const Uint row, const Uint nb_values=1)
+  {
+    cf3_assert(!m_allocated);
+    cf3_assert(row < m_positions.size());
+    m_positions[row] += nb_values;
+  }
+
+  /// Allocate the table, with the counted row sizes
+  void allocate()
+  {
+    cf3_assert(!m_allocated);
+    m_table.set_row_sizes(m_positions);
+    m_positions.assign(m_table.offsets().begin(), m_table.offsets().end() - 1);
+    m_allocated = true;
+  }
+
+  /// Second pass: append a value to the given row
+  void add(const Uint row, const T& value)
+  {
+    cf3_assert(m_allocated);
+    cf3_assert(m_positions[row] < m_table.offsets()[row+1]);
+    m_table.values()[m_positions[row]++] = value;
+  }
+
+private:
+
+  CompressedTable<T>& m_table;
+  /// Row sizes during the first pass, next free position of each row during the second
+  std::vector<Uint> m_positions;
+  bool m_allocated;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Buffer with the interface of DynArrayBufferT, working on a CompressedTable. The rows are expanded into a
+/// vector of rows on construction, and compressed back into the table on flush.
+template <typename T>
+class CompressedTableBuffer : public boost::noncopyable
+{
+public:
+  typedef typename DynArrayBufferT<T>::Row Row;
+
+  CompressedTableBuffer(CompressedTable<T>& table, const size_t nb_rows) :
+    m_table(table),
+    m_rows(table.size()),
+    m_buffer(m_rows, nb_rows)
+  {
+    for (Uint i=0; i<table.size(); ++i)
+      m_rows[i].assign(table[i].begin(), table[i].end());
+  }
+
+  ~CompressedTableBuffer()
+  {
+    flush();
+  }
+
+  template <typename VectorT>
+  Uint add_row(const VectorT& row) { return m_buffer.add_row(row); }
+
+  template<typename VectorT>
+  void set_row(const Uint array_idx, const VectorT& row) { m_buffer.set_row(array_idx, row); }
+
+  void rm_row(const Uint array_idx) { m_buffer.rm_row(array_idx); }
+
+  Row get_row(const Uint idx) { return m_buffer.get_row(idx); }
+
+  /// Apply the changes to the table
+  void flush()
+  {
+    m_buffer.flush();
+    m_table.assign(m_rows);
+  }
+
+private:
+
+  CompressedTable<T>& m_table;
+  std::vector< std::vector<T> > m_rows;
+  DynArrayBufferT<T> m_buffer;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
+} // common
+} // cf3
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // cf3_common_CompressedTable_hpp
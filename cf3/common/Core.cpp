@@ -6,6 +6,7 @@
 
 #include <boost/tokenizer.hpp>
 
+#include "common/BackgroundWriter.hpp"
 #include "common/PE/Comm.hpp"
 
 #include "common/Log.hpp"
@@ -54,6 +55,8 @@ Core::Core()
   Logger::instance();
   AssertionManager::instance();
   OSystem::instance().layer()->platform_name();
+  // Before Comm, so it outlives Comm, which completes the background writes when finalizing
+  BackgroundWriter::instance();
   PE::Comm::instance();
   EventHandler::instance();
 
@@ -130,6 +133,9 @@ void Core::initiate ( int argc, char** argv )
 
 void Core::terminate()
 {
+  // Complete files that are still being written in the background
+  BackgroundWriter::instance().wait_all();
+
   // terminate all
   if(is_not_null(m_libraries))
     libraries().terminate_all_libraries();
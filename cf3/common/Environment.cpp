@@ -96,6 +96,19 @@ Environment::Environment ( const std::string& name) : Component ( name )
       .description("The log level for exceptions")
       .mark_basic();
 
+  options().add("assembly_threads", 1u)
+      .pretty_name("Assembly Threads")
+      .description("Number of threads used by each process to loop over the elements in Proto expressions that enable threading, e.g. through the threaded option of a ProtoAction. Elements are colored so that concurrently processed elements never share a node.")
+      .mark_basic();
+
+  options().add("cache_geometric_factors", false)
+      .pretty_name("Cache Geometric Factors")
+      .description("Store the jacobians of the elements at each quadrature point the first time Proto expressions need them, and reuse them until the mesh or its coordinates change. Changes to the coordinates are detected with a checksum at the start of each loop. Saves computations on static meshes, at the cost of memory.");
+
+  options().add("max_pending_writes", 2u)
+      .pretty_name("Max Pending Writes")
+      .description("Maximum number of files that may be written in the background at the same time by writers in asynchronous mode. Submitting more waits for the oldest to finish. The XML index of a file is written at the first submit or time step after its data is written on all processes.");
+
   options().add("log_level", 3u)
       .pretty_name("Log Level")
       .description("The log level [SILENT=0, ERROR=1, WARNING=2, INFO=3, DEBUG=4, TRACE=5, VERBOSE=10")
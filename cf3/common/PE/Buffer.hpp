@@ -239,6 +239,14 @@ public:
   /// @param [out] recv output buffer
   inline void all_to_all(Buffer& recv);
 
+  /// @brief Sparse All To All operation for buffers.
+  ///
+  /// Same as all_to_all, but only the non-empty chunks are sent, with
+  /// point-to-point messages, so the cost scales with the number of
+  /// communicating ranks instead of the total number of ranks.
+  /// @param [out] recv output buffer
+  inline void sparse_all_to_all(Buffer& recv);
+
   //@}
 
 private:
@@ -522,6 +530,24 @@ inline void Buffer::all_to_all(PE::Buffer& recv)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+inline void Buffer::sparse_all_to_all(PE::Buffer& recv)
+{
+  cf3_assert(strides().size() == PE::Comm::instance().size());
+  recv.reset();
+  recv.strides().resize(PE::Comm::instance().size());
+  std::vector<char> recv_linear;
+  detail::sparse_all_to_allv_impl(Comm::instance().communicator(), (const char*)begin(), &strides()[0], recv_linear, &recv.strides()[0], 1);
+  recv.displs().resize(PE::Comm::instance().size());
+  recv.displs()[0]=0;
+  for (Uint pid=1; pid<Comm::instance().size(); ++pid)
+    recv.displs()[pid] = recv.displs()[pid-1] + recv.strides()[pid-1];
+  recv.resize(recv_linear.size());
+  if (!recv_linear.empty())
+    memcpy(recv.begin(),&recv_linear[0],recv_linear.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 #define CF3_COMMON_PE_BUFFER_PACK_OPERATOR(TYPE)\
   inline Buffer& operator<< (Buffer& buffer, const TYPE& data)\
   {\
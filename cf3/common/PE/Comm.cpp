@@ -6,6 +6,7 @@
 
 #include "common/Log.hpp"
 
+#include "common/BackgroundWriter.hpp"
 #include "common/BasicExceptions.hpp"
 #include "common/PE/Comm.hpp"
 
@@ -97,6 +98,8 @@ void Comm::finalize()
 {
   if( is_initialized() && !is_finalized() ) // then finalized
   {
+    // Files written in the background may need MPI to complete
+    BackgroundWriter::instance().wait_all();
     MPI_CHECK_RESULT(MPI_Finalize,());
     //  CFinfo << "MPI (version " <<  version() << ") -- finalized" << CFendl;
   }
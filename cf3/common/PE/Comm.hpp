@@ -15,6 +15,7 @@
 
 #include "common/PE/types.hpp"
 #include "common/PE/all_to_all.hpp"
+#include "common/PE/sparse_all_to_all.hpp"
 #include "common/PE/gather.hpp"
 #include "common/PE/all_gather.hpp"
 #include "common/PE/scatter.hpp"
@@ -156,6 +157,20 @@ public:
 
   //@}
 
+  /// @name Sparse all_to_all operations, for exchanges with a few neighbours only
+  //@{
+
+  template<typename T> inline void sparse_all_to_all(const std::vector<T>& in_values, const std::vector<int>& in_n, std::vector<T>& out_values, std::vector<int>& out_n, const int stride=1)
+  {
+           PE::sparse_all_to_all(communicator(), in_values, in_n, out_values, out_n, stride);
+  }
+  template<typename T> inline void sparse_all_to_all( const std::vector<std::vector<T> >& send, std::vector<std::vector<T> >& recv)
+  {
+           PE::sparse_all_to_all(communicator(), send, recv);
+  }
+
+  //@}
+
   /// @name Collective gather operations
   //@{
 
@@ -13,6 +13,7 @@
 #include "common/FindComponents.hpp"
 #include "common/Builder.hpp"
 #include "common/Log.hpp"
+#include "common/OptionList.hpp"
 
 #include "common/PE/Comm.hpp"
 #include "common/PE/CommPattern.hpp"
@@ -51,11 +52,26 @@ CommPattern::CommPattern(const std::string& name): Component(name), m_gid(alloca
   m_sendCount(PE::Comm::instance().size(),0),
   m_sendMap(0),
   m_recvCount(PE::Comm::instance().size(),0),
-  m_recvMap(0)
+  m_recvMap(0),
+  m_pointToPoint(true),
+  m_sparseSetup(true),
+  m_syncTag(0),
+  m_nbPlans(0),
+  m_version(0)
 {
   //self->regist_signal ( "update" , "Executes communication patterns on all the registered data.", "" ).connect ( boost::bind ( &CommPattern2::update, self, _1 ) );
   m_isUpToDate=false;
   m_isFreeze=false;
+
+  options().add("point_to_point", m_pointToPoint)
+      .pretty_name("Point To Point")
+      .description("If true, synchronization uses non-blocking point-to-point messages with the neighbouring ranks only. If false, a collective all_to_all over all ranks is used.")
+      .link_to(&m_pointToPoint);
+
+  options().add("sparse_setup", m_sparseSetup)
+      .pretty_name("Sparse Setup")
+      .description("If true, setup exchanges its data with sparse point-to-point messages, so its cost scales with the number of neighbours. If false, a dense all_to_all over all ranks is used.")
+      .link_to(&m_sparseSetup);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -325,7 +341,7 @@ void CommPattern::setup()
   // do the all_to_all communication
   // NOTE THAT AFTER ALLTOALL, LOCAL IS THE DISTRIBUTED ONE
   std::vector<int> recvcnt(nproc,-1);
-  PE::Comm::instance().all_to_all(local,sendcnt,local,recvcnt);
+  setup_exchange(local,sendcnt,recvcnt,1);
 
 //PEProcessSortedExecute(-1, PEDebugVectorMember(local,local.size(),.rank) );
 //PEProcessSortedExecute(-1, PEDebugVectorMember(local,local.size(),.gid) );
@@ -404,7 +420,7 @@ void CommPattern::setup()
   // send back ghosts
   // NOTE THAT AFTER ALLTOALL, LOCAL IS THE BACK-DISTRIBUTED GHOSTS
   recvcnt.assign(nproc,-1);
-  PE::Comm::instance().all_to_all(local,sendcnt,local,recvcnt,2);
+  setup_exchange(local,sendcnt,recvcnt,2);
 
   // set up ghost communication info for all_to_all, and updatables info
   m_recvCount.assign(nproc,0);
@@ -442,7 +458,7 @@ void CommPattern::setup()
   // send back ghosts
   // NOTE THAT AFTER ALLTOALL, LOCAL IS THE BACK-DISTRIBUTED GHOSTS
   recvcnt.assign(nproc,-1);
-  PE::Comm::instance().all_to_all(local,sendcnt,local,recvcnt,2);
+  setup_exchange(local,sendcnt,recvcnt,2);
 
   // set up ghost communication info for all_to_all, and updatables info
   m_sendCount.assign(nproc,0);
@@ -475,6 +491,8 @@ void CommPattern::setup()
     if (global_nelems[i]!=0)
       delete[] global[i];
 
+  build_neighbours();
+
 #undef COMPUTE_IRANK
 #undef COMPUTE_INODE
 }
@@ -564,13 +582,19 @@ void CommPattern::setup()
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void CommPattern::setup_exchange( std::vector<dist_struct>& data, std::vector<int>& sendcnt, std::vector<int>& recvcnt, const int stride )
+{
+  if (m_sparseSetup) PE::Comm::instance().sparse_all_to_all(data,sendcnt,data,recvcnt,stride);
+  else PE::Comm::instance().all_to_all(data,sendcnt,data,recvcnt,stride);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void CommPattern::synchronize_all()
 {
-  std::vector<unsigned char> sndbuf(1);
-  std::vector<unsigned char> rcvbuf(1);
   BOOST_FOREACH( CommWrapper& pobj, find_components_recursively<CommWrapper>(*this) )
   {
-    synchronize_this(pobj,sndbuf,rcvbuf);
+    synchronize_this(pobj,m_sndbuf,m_rcvbuf);
   }
 }
 
@@ -578,19 +602,15 @@ void CommPattern::synchronize_all()
 
 void CommPattern::synchronize( const std::string& name )
 {
-  std::vector<unsigned char> sndbuf(1);
-  std::vector<unsigned char> rcvbuf(1);
   Handle<CommWrapper> pobj(get_child(name));
-  synchronize_this(*pobj,sndbuf,rcvbuf);
+  synchronize_this(*pobj,m_sndbuf,m_rcvbuf);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 void CommPattern::synchronize( const CommWrapper& pobj )
 {
-  std::vector<unsigned char> sndbuf(1);
-  std::vector<unsigned char> rcvbuf(1);
-  synchronize_this(pobj,sndbuf,rcvbuf);
+  synchronize_this(pobj,m_sndbuf,m_rcvbuf);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -602,10 +622,164 @@ void CommPattern::synchronize_this( const CommWrapper& pobj, std::vector<unsigne
 //  std::cout << PERank << pobj.needs_update() << "\n" << std::flush;
   if ( pobj.needs_update() )
   {
-    pobj.pack(sndbuf,m_sendMap);
-    rcvbuf.resize(m_recvMap.size()*pobj.size_of()*pobj.stride());
-    PE::Comm::instance().all_to_all(sndbuf,m_sendCount,rcvbuf,m_recvCount,pobj.size_of()*pobj.stride());
-    pobj.unpack(rcvbuf,m_recvMap);
+    if (m_pointToPoint)
+    {
+      std::vector<MPI_Request> requests;
+      post_exchange(pobj,sndbuf,rcvbuf,requests);
+      complete_exchange(pobj,rcvbuf,requests);
+    }
+    else
+    {
+      pobj.pack(sndbuf,m_sendMap);
+      rcvbuf.resize(m_recvMap.size()*pobj.size_of()*pobj.stride());
+      PE::Comm::instance().all_to_all(sndbuf,m_sendCount,rcvbuf,m_recvCount,pobj.size_of()*pobj.stride());
+      pobj.unpack(rcvbuf,m_recvMap);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void CommPattern::begin_synchronize( const std::string& name )
+{
+  Handle<CommWrapper> pobj(get_child(name));
+  if (is_null(pobj)) throw common::ValueNotFound(FromHere(), "No parallel object named " + name + " in " + uri().path());
+  begin_synchronize(*pobj);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void CommPattern::begin_synchronize( const CommWrapper& pobj )
+{
+  if ( !pobj.needs_update() )
+    return;
+  if (m_pendingSyncs.count(&pobj)!=0)
+    throw common::IllegalCall(FromHere(), "Synchronization of " + pobj.uri().path() + " was already started.");
+
+  boost::shared_ptr<PendingSync> pending(new PendingSync());
+  post_exchange(pobj,pending->sndbuf,pending->rcvbuf,pending->requests);
+  m_pendingSyncs[&pobj]=pending;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void CommPattern::end_synchronize( const std::string& name )
+{
+  Handle<CommWrapper> pobj(get_child(name));
+  if (is_null(pobj)) throw common::ValueNotFound(FromHere(), "No parallel object named " + name + " in " + uri().path());
+  end_synchronize(*pobj);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void CommPattern::end_synchronize( const CommWrapper& pobj )
+{
+  if ( !pobj.needs_update() )
+    return;
+  PendingSyncsT::iterator pending=m_pendingSyncs.find(&pobj);
+  if (pending==m_pendingSyncs.end())
+    throw common::IllegalCall(FromHere(), "Synchronization of " + pobj.uri().path() + " was not started.");
+
+  complete_exchange(pobj,pending->second->rcvbuf,pending->second->requests);
+  m_pendingSyncs.erase(pending);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Handle<ExchangePlan> CommPattern::exchange_plan( const std::vector<std::string>& names )
+{
+  std::string plan_name="exchange_plan";
+  BOOST_FOREACH(const std::string& name, names)
+    plan_name+="_"+name;
+
+  Handle<ExchangePlan> plan(get_child(plan_name));
+  if (is_not_null(plan))
+    return plan;
+
+  std::vector< Handle<CommWrapper> > objects;
+  objects.reserve(names.size());
+  BOOST_FOREACH(const std::string& name, names)
+  {
+    Handle<CommWrapper> pobj(get_child(name));
+    if (is_null(pobj)) throw common::ValueNotFound(FromHere(), "No parallel object named " + name + " in " + uri().path());
+    objects.push_back(pobj);
+  }
+
+  // plans use the upper half of the tag range, except the two topmost tags which belong to sparse_all_to_all
+  plan=create_component<ExchangePlan>(plan_name);
+  plan->setup(*this,objects,16384+m_nbPlans%16382);
+  ++m_nbPlans;
+  return plan;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void CommPattern::post_exchange( const CommWrapper& pobj, std::vector<unsigned char>& sndbuf, std::vector<unsigned char>& rcvbuf, std::vector<MPI_Request>& requests )
+{
+  const int item_size=pobj.size_of()*pobj.stride();
+  const Communicator comm=PE::Comm::instance().communicator();
+
+  // the tag wraps around well below the minimal MPI_TAG_UB required by the standard
+  // the upper half of the tag range is reserved for the exchange plans
+  const int tag=m_syncTag;
+  m_syncTag=(m_syncTag+1)%16384;
+
+  if (!m_sendMap.empty()) pobj.pack(sndbuf,m_sendMap);
+  rcvbuf.resize(m_recvMap.size()*item_size);
+  requests.resize(m_recvNeighbours.size()+m_sendNeighbours.size());
+
+  // post the receives first, so the messages can go straight into the receive buffer
+  for (int i=0; i<(const int)m_recvNeighbours.size(); i++)
+  {
+    const CPint rank=m_recvNeighbours[i];
+    MPI_CHECK_RESULT(MPI_Irecv, (&rcvbuf[m_recvStarts[i]*item_size], m_recvCount[rank]*item_size, MPI_BYTE, rank, tag, comm, &requests[i]));
+  }
+
+  const int nrecv=m_recvNeighbours.size();
+  for (int i=0; i<(const int)m_sendNeighbours.size(); i++)
+  {
+    const CPint rank=m_sendNeighbours[i];
+    MPI_CHECK_RESULT(MPI_Isend, (&sndbuf[m_sendStarts[i]*item_size], m_sendCount[rank]*item_size, MPI_BYTE, rank, tag, comm, &requests[nrecv+i]));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void CommPattern::complete_exchange( const CommWrapper& pobj, std::vector<unsigned char>& rcvbuf, std::vector<MPI_Request>& requests )
+{
+  if (!requests.empty())
+    MPI_CHECK_RESULT(MPI_Waitall, ((int)requests.size(), &requests[0], MPI_STATUSES_IGNORE));
+  requests.clear();
+
+  if (!m_recvMap.empty()) pobj.unpack(rcvbuf,m_recvMap);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void CommPattern::build_neighbours()
+{
+  ++m_version;
+  m_sendNeighbours.clear();
+  m_sendStarts.clear();
+  m_recvNeighbours.clear();
+  m_recvStarts.clear();
+
+  CPint sendstart=0;
+  CPint recvstart=0;
+  for (int i=0; i<(const int)m_sendCount.size(); i++)
+  {
+    if (m_sendCount[i]!=0)
+    {
+      m_sendNeighbours.push_back(i);
+      m_sendStarts.push_back(sendstart);
+    }
+    if (m_recvCount[i]!=0)
+    {
+      m_recvNeighbours.push_back(i);
+      m_recvStarts.push_back(recvstart);
+    }
+    sendstart+=m_sendCount[i];
+    recvstart+=m_recvCount[i];
   }
 }
 
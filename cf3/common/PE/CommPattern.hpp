@@ -7,11 +7,16 @@
 #ifndef cf3_common_PE_CommPattern_hpp
 #define cf3_common_PE_CommPattern_hpp
 
+#include <map>
+
+#include <boost/shared_ptr.hpp>
+
 #include "common/Component.hpp"
 #include "common/BoostArray.hpp"
 #include "common/PE/Comm.hpp"
 #include "common/PE/CommWrapper.hpp"
 #include "common/PE/CommWrapperMArray.hpp"
+#include "common/PE/ExchangePlan.hpp"
 
 namespace cf3 {
 namespace common {
@@ -40,6 +45,9 @@ namespace PE {
 
 class Common_API CommPattern: public Component {
 
+  /// the exchange plans read the send and receive maps of the neighbours directly
+  friend class ExchangePlan;
+
 public:
 
   /// @name TYPEDEFS
@@ -229,6 +237,30 @@ public:
   /// @param name the name of the parallel object
   void synchronize( const CommWrapper& pobj );
 
+  /// start a non-blocking synchronization of the parallel object designated by its name
+  /// only the neighbouring ranks are contacted, using point-to-point messages
+  /// the ghost values may not be used and the updatable values may not be modified until end_synchronize is called
+  /// like synchronize, this must be called on all ranks in the same order
+  /// @param name the name of the parallel object
+  void begin_synchronize( const std::string& name );
+
+  /// start a non-blocking synchronization of the parallel object designated by its commwrapper reference
+  /// @param pobj the parallel object
+  void begin_synchronize( const CommWrapper& pobj );
+
+  /// wait for the synchronization started by begin_synchronize and copy the received values into the ghosts
+  /// @param name the name of the parallel object
+  void end_synchronize( const std::string& name );
+
+  /// wait for the synchronization started by begin_synchronize and copy the received values into the ghosts
+  /// @param pobj the parallel object
+  void end_synchronize( const CommWrapper& pobj );
+
+  /// get the persistent exchange plan synchronizing the given parallel objects together, creating it on first use
+  /// this must be called on all ranks with the same names in the same order
+  /// @param names the names of the parallel objects, the order is significant
+  Handle<ExchangePlan> exchange_plan( const std::vector<std::string>& names );
+
   /// add element to the commpattern
   /// when all changes done, all needs to be committed by calling setup
   /// if global id is not on current rank, then a ghost is automatically created on current rank
@@ -284,6 +316,15 @@ public:
   /// Return the rank associated with the given local ID
   int rank(const Uint lid) const { return m_ranks[lid]; }
 
+  /// accessor to the ranks this process sends updatable values to
+  const std::vector<CPint>& send_neighbours() const { return m_sendNeighbours; }
+
+  /// accessor to the ranks this process receives ghost values from
+  const std::vector<CPint>& recv_neighbours() const { return m_recvNeighbours; }
+
+  /// counter incremented each time the pattern is set up, used by the exchange plans to detect changes
+  Uint version() const { return m_version; }
+
   //@} END ACCESSORS
 
 protected: // helper function
@@ -295,8 +336,28 @@ protected: // helper function
   /// @param rcvbuf vector for intermediate buffer for recieve
   void synchronize_this( const CommWrapper& pobj, std::vector<unsigned char>& sndbuf, std::vector<unsigned char>& rcvbuf );
 
+  /// pack the send buffer and post the non-blocking sends and receives to the neighbouring ranks
+  /// @param pobj reference to commwrapper object to synchronize to
+  /// @param sndbuf vector for intermediate buffer for send, must stay alive until the requests complete
+  /// @param rcvbuf vector for intermediate buffer for recieve, must stay alive until the requests complete
+  /// @param requests filled with the posted requests
+  void post_exchange( const CommWrapper& pobj, std::vector<unsigned char>& sndbuf, std::vector<unsigned char>& rcvbuf, std::vector<MPI_Request>& requests );
+
+  /// wait for the posted requests and unpack the receive buffer into the ghosts
+  void complete_exchange( const CommWrapper& pobj, std::vector<unsigned char>& rcvbuf, std::vector<MPI_Request>& requests );
+
 private:
 
+  /// rebuild the neighbour lists and offsets from the send and receive counts
+  void build_neighbours();
+
+  /// all_to_all of the distributed directory during setup, dense or sparse depending on the sparse_setup option
+  /// @param data items to send, replaced by the received items
+  /// @param sendcnt number of items to send to each rank
+  /// @param recvcnt filled with the number of items received from each rank
+  /// @param stride number of items forming one entry
+  void setup_exchange( std::vector<dist_struct>& data, std::vector<int>& sendcnt, std::vector<int>& recvcnt, const int stride );
+
   /// @name PROPERTIES
   //@{
 
@@ -349,6 +410,54 @@ private:
   /// Rank for all the gids in local index space
   std::vector<int> m_ranks;
 
+  /// @name POINT-TO-POINT COMMUNICATION
+  //@{
+
+  /// if true, synchronize uses point-to-point messages to the neighbours instead of all_to_all
+  bool m_pointToPoint;
+
+  /// if true, setup uses sparse all_to_all instead of the dense one
+  bool m_sparseSetup;
+
+  /// ranks having a non-zero send count, in increasing order
+  std::vector< CPint > m_sendNeighbours;
+
+  /// start of the items for each send neighbour in m_sendMap
+  std::vector< CPint > m_sendStarts;
+
+  /// ranks having a non-zero receive count, in increasing order
+  std::vector< CPint > m_recvNeighbours;
+
+  /// start of the items for each receive neighbour in m_recvMap
+  std::vector< CPint > m_recvStarts;
+
+  /// buffers and requests of a synchronization started with begin_synchronize
+  struct PendingSync
+  {
+    std::vector<unsigned char> sndbuf;
+    std::vector<unsigned char> rcvbuf;
+    std::vector<MPI_Request> requests;
+  };
+
+  /// synchronizations in progress, by parallel object
+  typedef std::map< const CommWrapper*, boost::shared_ptr<PendingSync> > PendingSyncsT;
+  PendingSyncsT m_pendingSyncs;
+
+  /// message tag for the next exchange, so multiple pending exchanges between the same ranks can't get mixed up
+  int m_syncTag;
+
+  /// number of exchange plans created so far, determines the tag of the next plan
+  int m_nbPlans;
+
+  /// number of times the pattern was set up
+  Uint m_version;
+
+  /// intermediate buffers for synchronize, kept to avoid reallocation
+  std::vector<unsigned char> m_sndbuf;
+  std::vector<unsigned char> m_rcvbuf;
+
+  //@} END POINT-TO-POINT COMMUNICATION
+
 }; // CommPattern
 
 ////////////////////////////////////////////////////////////////////////////////////////////
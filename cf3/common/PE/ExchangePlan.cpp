@@ -0,0 +1,217 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <boost/foreach.hpp>
+
+#include "common/BasicExceptions.hpp"
+
+#include "common/PE/Comm.hpp"
+#include "common/PE/CommPattern.hpp"
+#include "common/PE/CommWrapper.hpp"
+#include "common/PE/ExchangePlan.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace cf3 {
+namespace common  {
+namespace PE {
+
+////////////////////////////////////////////////////////////////////////////////
+// Constructor & destructor
+////////////////////////////////////////////////////////////////////////////////
+
+ExchangePlan::ExchangePlan(const std::string& name) : Component(name),
+  m_tag(0),
+  m_patternVersion(0),
+  m_inProgress(false)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ExchangePlan::~ExchangePlan()
+{
+  free_requests();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Setup
+////////////////////////////////////////////////////////////////////////////////
+
+void ExchangePlan::setup(CommPattern& pattern, const std::vector< Handle<CommWrapper> >& objects, const int tag)
+{
+  if (m_inProgress)
+    throw common::IllegalCall(FromHere(), "Can't set up exchange plan " + uri().path() + " while a synchronization is in progress.");
+
+  free_requests();
+  m_pattern=Handle<CommPattern>(pattern.handle<Component>());
+  m_tag=tag;
+  m_objects.clear();
+  BOOST_FOREACH(const Handle<CommWrapper>& pobj, objects)
+  {
+    if (is_null(pobj))
+      throw common::BadValue(FromHere(), "Null parallel object passed to exchange plan " + uri().path());
+    if (pobj->needs_update())
+      m_objects.push_back(pobj);
+  }
+  build();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ExchangePlan::needs_rebuild() const
+{
+  if (m_patternVersion!=m_pattern->version())
+    return true;
+  for (int i=0; i<(const int)m_objects.size(); i++)
+    if (m_objectSizes[i]!=m_objects[i]->size_of()*m_objects[i]->stride())
+      return true;
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ExchangePlan::build()
+{
+  free_requests();
+
+  const CommPattern& pattern=*m_pattern;
+  m_patternVersion=pattern.version();
+
+  int bytes_per_item=0;
+  m_objectSizes.resize(m_objects.size());
+  for (int i=0; i<(const int)m_objects.size(); i++)
+  {
+    m_objectSizes[i]=m_objects[i]->size_of()*m_objects[i]->stride();
+    bytes_per_item+=m_objectSizes[i];
+  }
+
+  // split the maps of the pattern per neighbour, and lay out one message per neighbour holding all objects
+  const int nsend=pattern.m_sendNeighbours.size();
+  m_sendMaps.resize(nsend);
+  m_sendOffsets.resize(nsend+1);
+  m_sendOffsets[0]=0;
+  for (int i=0; i<nsend; i++)
+  {
+    const CommPattern::CPint count=pattern.m_sendCount[pattern.m_sendNeighbours[i]];
+    const std::vector<CommPattern::CPint>::const_iterator start=pattern.m_sendMap.begin()+pattern.m_sendStarts[i];
+    m_sendMaps[i].assign(start,start+count);
+    m_sendOffsets[i+1]=m_sendOffsets[i]+count*bytes_per_item;
+  }
+
+  const int nrecv=pattern.m_recvNeighbours.size();
+  m_recvMaps.resize(nrecv);
+  m_recvOffsets.resize(nrecv+1);
+  m_recvOffsets[0]=0;
+  for (int i=0; i<nrecv; i++)
+  {
+    const CommPattern::CPint count=pattern.m_recvCount[pattern.m_recvNeighbours[i]];
+    const std::vector<CommPattern::CPint>::const_iterator start=pattern.m_recvMap.begin()+pattern.m_recvStarts[i];
+    m_recvMaps[i].assign(start,start+count);
+    m_recvOffsets[i+1]=m_recvOffsets[i]+count*bytes_per_item;
+  }
+
+  // the buffers are never reallocated after this point, the persistent requests point into them
+  m_sndbuf.assign(m_sendOffsets.back()+1,0);
+  m_rcvbuf.assign(m_recvOffsets.back()+1,0);
+
+  if (m_objects.empty() || (nsend==0 && nrecv==0))
+    return;
+
+  const Communicator comm=PE::Comm::instance().communicator();
+  m_requests.resize(nrecv+nsend);
+  for (int i=0; i<nrecv; i++)
+    MPI_CHECK_RESULT(MPI_Recv_init, (&m_rcvbuf[m_recvOffsets[i]], m_recvOffsets[i+1]-m_recvOffsets[i], MPI_BYTE, pattern.m_recvNeighbours[i], m_tag, comm, &m_requests[i]));
+  for (int i=0; i<nsend; i++)
+    MPI_CHECK_RESULT(MPI_Send_init, (&m_sndbuf[m_sendOffsets[i]], m_sendOffsets[i+1]-m_sendOffsets[i], MPI_BYTE, pattern.m_sendNeighbours[i], m_tag, comm, &m_requests[nrecv+i]));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ExchangePlan::free_requests()
+{
+  if (PE::Comm::instance().is_active())
+  {
+    BOOST_FOREACH(MPI_Request& request, m_requests)
+      if (request!=MPI_REQUEST_NULL)
+        MPI_CHECK_RESULT(MPI_Request_free, (&request));
+  }
+  m_requests.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Synchronization
+////////////////////////////////////////////////////////////////////////////////
+
+void ExchangePlan::begin_synchronize()
+{
+  if (is_null(m_pattern))
+    throw common::SetupError(FromHere(), "Exchange plan " + uri().path() + " was not set up.");
+  if (m_inProgress)
+    throw common::IllegalCall(FromHere(), "Synchronization of exchange plan " + uri().path() + " was already started.");
+
+  BOOST_FOREACH(const Handle<CommWrapper>& pobj, m_objects)
+    if (is_null(pobj))
+      throw common::SetupError(FromHere(), "A parallel object of exchange plan " + uri().path() + " was removed from its pattern.");
+
+  if (needs_rebuild())
+    build();
+
+  // pack per neighbour, object after object, following the layout of build
+  for (int i=0; i<(const int)m_sendMaps.size(); i++)
+  {
+    if (m_sendMaps[i].empty()) continue;
+    Uint offset=m_sendOffsets[i];
+    for (int j=0; j<(const int)m_objects.size(); j++)
+    {
+      m_objects[j]->pack(m_sendMaps[i],&m_sndbuf[offset]);
+      offset+=m_sendMaps[i].size()*m_objectSizes[j];
+    }
+  }
+
+  if (!m_requests.empty())
+    MPI_CHECK_RESULT(MPI_Startall, ((int)m_requests.size(), &m_requests[0]));
+  m_inProgress=true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ExchangePlan::end_synchronize()
+{
+  if (!m_inProgress)
+    throw common::IllegalCall(FromHere(), "Synchronization of exchange plan " + uri().path() + " was not started.");
+
+  if (!m_requests.empty())
+    MPI_CHECK_RESULT(MPI_Waitall, ((int)m_requests.size(), &m_requests[0], MPI_STATUSES_IGNORE));
+  m_inProgress=false;
+
+  for (int i=0; i<(const int)m_recvMaps.size(); i++)
+  {
+    if (m_recvMaps[i].empty()) continue;
+    Uint offset=m_recvOffsets[i];
+    for (int j=0; j<(const int)m_objects.size(); j++)
+    {
+      m_objects[j]->unpack(&m_rcvbuf[offset],m_recvMaps[i]);
+      offset+=m_recvMaps[i].size()*m_objectSizes[j];
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ExchangePlan::synchronize()
+{
+  begin_synchronize();
+  end_synchronize();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace PE
+} // namespace common
+} // namespace cf3
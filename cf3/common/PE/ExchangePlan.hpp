@@ -0,0 +1,120 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#ifndef cf3_common_PE_ExchangePlan_hpp
+#define cf3_common_PE_ExchangePlan_hpp
+
+#include <vector>
+
+#include "common/Component.hpp"
+#include "common/PE/types.hpp"
+
+namespace cf3 {
+namespace common {
+namespace PE {
+
+class CommPattern;
+class CommWrapper;
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+  @file ExchangePlan.hpp
+  @brief Persistent halo exchange for a fixed set of parallel objects of a CommPattern.
+  All objects of the plan are packed into a single message per neighbouring rank. The send and receive buffers,
+  the per-neighbour gather and scatter index lists and the MPI persistent requests are set up once, so
+  a synchronization only packs, starts the requests, waits and unpacks.
+  The plan is rebuilt automatically when the CommPattern is set up again or the size of one of the objects changed.
+  Plans are created through CommPattern::exchange_plan, which must be called in the same order on all ranks.
+**/
+class Common_API ExchangePlan : public Component {
+
+public:
+
+  /// constructor
+  /// @param name under this name will the component be registered
+  ExchangePlan(const std::string& name);
+
+  /// destructor, frees the persistent requests
+  ~ExchangePlan();
+
+  /// Get the class name
+  static std::string type_name () { return "ExchangePlan"; }
+
+  /// set the parallel objects handled by this plan
+  /// @param pattern the CommPattern that holds the objects
+  /// @param objects the parallel objects, all children of pattern
+  /// @param tag the MPI tag used by the messages of this plan
+  void setup(CommPattern& pattern, const std::vector< Handle<CommWrapper> >& objects, const int tag);
+
+  /// pack the objects and start the persistent requests
+  void begin_synchronize();
+
+  /// wait for the requests started by begin_synchronize and unpack into the ghosts
+  void end_synchronize();
+
+  /// synchronize all objects of the plan
+  void synchronize();
+
+private:
+
+  /// (re)create buffers, index lists and persistent requests
+  void build();
+
+  /// free the persistent requests
+  void free_requests();
+
+  /// true if the pattern or the objects changed since the last build
+  bool needs_rebuild() const;
+
+  /// pattern that holds the objects
+  Handle<CommPattern> m_pattern;
+
+  /// parallel objects that are synchronized together
+  std::vector< Handle<CommWrapper> > m_objects;
+
+  /// MPI tag of the messages
+  int m_tag;
+
+  /// version of the pattern for which the plan was built
+  Uint m_patternVersion;
+
+  /// sizes of the objects for which the plan was built
+  std::vector<int> m_objectSizes;
+
+  /// per neighbour lists of local ids to pack
+  std::vector< std::vector<int> > m_sendMaps;
+
+  /// per neighbour lists of local ids to unpack
+  std::vector< std::vector<int> > m_recvMaps;
+
+  /// start of the message for each send neighbour in m_sndbuf
+  std::vector<Uint> m_sendOffsets;
+
+  /// start of the message for each receive neighbour in m_rcvbuf
+  std::vector<Uint> m_recvOffsets;
+
+  /// fixed send buffer, holding the messages for all neighbours
+  std::vector<unsigned char> m_sndbuf;
+
+  /// fixed receive buffer, holding the messages from all neighbours
+  std::vector<unsigned char> m_rcvbuf;
+
+  /// persistent requests, receives first
+  std::vector<MPI_Request> m_requests;
+
+  /// true between begin_synchronize and end_synchronize
+  bool m_inProgress;
+
+}; // ExchangePlan
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+} // PE
+} // common
+} // cf3
+
+#endif // cf3_common_PE_ExchangePlan_hpp
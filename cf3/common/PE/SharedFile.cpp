@@ -0,0 +1,143 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+
+#include "common/BasicExceptions.hpp"
+
+#include "common/PE/Comm.hpp"
+#include "common/PE/SharedFile.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace cf3 {
+namespace common  {
+namespace PE {
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+  /// Largest number of bytes passed to a single MPI call, well below the int limit of the count argument
+  const boost::uint64_t max_chunk_size = 1 << 30;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SharedFile::SharedFile(const URI& path, const Mode mode) :
+  m_path(path.path()),
+  m_use_mpi(Comm::instance().is_active()),
+  m_is_open(false)
+{
+  if(m_use_mpi)
+  {
+    const int amode = mode == WRITE ? (MPI_MODE_CREATE | MPI_MODE_WRONLY) : MPI_MODE_RDONLY;
+    MPI_CHECK_RESULT(MPI_File_open, (Comm::instance().communicator(), const_cast<char*>(m_path.c_str()), amode, MPI_INFO_NULL, &m_file));
+    if(mode == WRITE)
+      MPI_CHECK_RESULT(MPI_File_set_size, (m_file, 0));
+  }
+  else
+  {
+    const std::ios_base::openmode openmode = mode == WRITE ? (std::ios_base::out | std::ios_base::trunc | std::ios_base::binary) : (std::ios_base::in | std::ios_base::binary);
+    m_stream.reset(new std::fstream(m_path.c_str(), openmode));
+    if(!m_stream->is_open())
+      throw FileSystemError(FromHere(), "Failed to open file " + m_path);
+  }
+  m_is_open = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SharedFile::~SharedFile()
+{
+  if(m_is_open)
+    close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void SharedFile::write_at_all(const boost::uint64_t offset, const void* data, const boost::uint64_t nb_bytes)
+{
+  cf3_assert(m_is_open);
+  const char* bytes = static_cast<const char*>(data);
+
+  if(!m_use_mpi)
+  {
+    m_stream->seekp(offset);
+    m_stream->write(bytes, nb_bytes);
+    if(!m_stream->good())
+      throw FileSystemError(FromHere(), "Error writing to file " + m_path);
+    return;
+  }
+
+  const Uint nb_calls = nb_chunks(nb_bytes);
+  for(Uint i = 0; i != nb_calls; ++i)
+  {
+    const boost::uint64_t begin = std::min(i*max_chunk_size, nb_bytes);
+    const boost::uint64_t end = std::min((i+1)*max_chunk_size, nb_bytes);
+    MPI_CHECK_RESULT(MPI_File_write_at_all, (m_file, static_cast<MPI_Offset>(offset + begin), const_cast<char*>(bytes + begin), static_cast<int>(end - begin), MPI_BYTE, MPI_STATUS_IGNORE));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void SharedFile::read_at_all(const boost::uint64_t offset, void* data, const boost::uint64_t nb_bytes)
+{
+  cf3_assert(m_is_open);
+  char* bytes = static_cast<char*>(data);
+
+  if(!m_use_mpi)
+  {
+    m_stream->seekg(offset);
+    m_stream->read(bytes, nb_bytes);
+    if(!m_stream->good())
+      throw FileSystemError(FromHere(), "Error reading from file " + m_path);
+    return;
+  }
+
+  const Uint nb_calls = nb_chunks(nb_bytes);
+  for(Uint i = 0; i != nb_calls; ++i)
+  {
+    const boost::uint64_t begin = std::min(i*max_chunk_size, nb_bytes);
+    const boost::uint64_t end = std::min((i+1)*max_chunk_size, nb_bytes);
+    MPI_CHECK_RESULT(MPI_File_read_at_all, (m_file, static_cast<MPI_Offset>(offset + begin), bytes + begin, static_cast<int>(end - begin), MPI_BYTE, MPI_STATUS_IGNORE));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void SharedFile::close()
+{
+  cf3_assert(m_is_open);
+  m_is_open = false;
+  if(m_use_mpi)
+  {
+    MPI_CHECK_RESULT(MPI_File_close, (&m_file));
+  }
+  else
+  {
+    m_stream->close();
+    m_stream.reset();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Uint SharedFile::nb_chunks(const boost::uint64_t nb_bytes) const
+{
+  const Uint my_nb_chunks = static_cast<Uint>((nb_bytes + max_chunk_size - 1) / max_chunk_size);
+  Uint result = 0;
+  Comm::instance().all_reduce(PE::max(), &my_nb_chunks, 1, &result);
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // PE
+} // common
+} // cf3
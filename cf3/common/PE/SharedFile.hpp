@@ -0,0 +1,83 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#ifndef cf3_common_PE_SharedFile_hpp
+#define cf3_common_PE_SharedFile_hpp
+
+#include <fstream>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "common/CommonAPI.hpp"
+#include "common/URI.hpp"
+#include "common/PE/types.hpp"
+
+namespace cf3 {
+namespace common {
+namespace PE {
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+  @file SharedFile.hpp
+  @brief A single binary file accessed collectively by all processes.
+  Each process reads or writes its own part of the file at an explicit byte offset, using collective MPI-IO so the
+  MPI library can aggregate the requests. Without an active MPI environment a normal file stream is used.
+  All read and write calls are collective: every process must call them the same number of times, possibly with
+  zero bytes.
+**/
+class Common_API SharedFile : public boost::noncopyable {
+
+public:
+
+  /// Access modes
+  enum Mode { READ, WRITE };
+
+  /// Open the file, collective. In WRITE mode an existing file is truncated.
+  SharedFile(const URI& path, const Mode mode);
+
+  /// Closes the file if close was not called
+  ~SharedFile();
+
+  /// Write nb_bytes from data at the given offset, collective
+  void write_at_all(const boost::uint64_t offset, const void* data, const boost::uint64_t nb_bytes);
+
+  /// Read nb_bytes at the given offset into data, collective
+  void read_at_all(const boost::uint64_t offset, void* data, const boost::uint64_t nb_bytes);
+
+  /// Close the file, collective
+  void close();
+
+private:
+
+  /// Number of calls to MPI_File_*_at_all needed for nb_bytes, equal on all processes
+  Uint nb_chunks(const boost::uint64_t nb_bytes) const;
+
+  /// Path of the file, for error messages
+  std::string m_path;
+
+  /// True if MPI-IO is used
+  bool m_use_mpi;
+
+  /// True while the file is open
+  bool m_is_open;
+
+  /// The MPI file handle
+  MPI_File m_file;
+
+  /// File stream used without MPI
+  boost::scoped_ptr<std::fstream> m_stream;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+} // PE
+} // common
+} // cf3
+
+#endif // cf3_common_PE_SharedFile_hpp
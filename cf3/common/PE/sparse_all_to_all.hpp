@@ -0,0 +1,254 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#ifndef cf3_common_PE_sparse_all_to_all_hpp
+#define cf3_common_PE_sparse_all_to_all_hpp
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstring>
+#include <vector>
+
+#include "common/Assertions.hpp"
+#include "common/BasicExceptions.hpp"
+
+#include "common/PE/types.hpp"
+#include "common/PE/all_to_all.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+  @file sparse_all_to_all.hpp
+  Sparse all to all communication, for exchanges where each process talks to a few others only.
+  The interface mirrors the variable size all_to_all, but only the non-empty messages are sent, with point-to-point
+  messages, and the receive counts are discovered on the fly instead of being exchanged with a dense MPI_Alltoall.
+  The receivers are found with the non-blocking consensus algorithm (NBX): synchronous sends to the destinations,
+  probing for incoming messages and a non-blocking barrier entered once all own sends were matched.
+  The cost is thus proportional to the number of neighbours instead of the number of processes.
+  Without MPI-3 (no MPI_Ibarrier), the dense all_to_all is used instead.
+  Data is transferred as raw bytes, so T must be plain old data, as for all_to_all.
+**/
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace cf3 {
+  namespace common {
+    namespace PE {
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace detail {
+
+////////////////////////////////////////////////////////////////////////////////
+
+  /// Tag for the messages of the next sparse exchange.
+  /// Two tags are alternated: a process can only start exchange k+2 after all processes left exchange k,
+  /// so messages of consecutive exchanges can't be mistaken for each other.
+  /// The tags are at the top of the range guaranteed by the standard, the CommPattern tags stay below them.
+  inline int sparse_all_to_all_tag()
+  {
+    static int parity=0;
+    parity=1-parity;
+    return 32766+parity;
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  /**
+    Implementation of the sparse variable size all to all communication.
+    Don't call this function directly, use sparse_all_to_all instead.
+    The received items are stored in out_values in increasing order of source rank, like MPI_Alltoallv does.
+    @param comm Comm::Communicator
+    @param in_values pointer to the send buffer, of size sum(in_n[i])*stride
+    @param in_n array holding send counts of size #processes
+    @param out_values receive buffer, resized to fit the received data
+    @param out_n array of size #processes, filled with the receive counts
+    @param stride is the number of items of type T forming one array element
+  **/
+  template<typename T>
+  inline void
+  sparse_all_to_allv_impl(const Communicator& comm, const T* in_values, const int *in_n, std::vector<T>& out_values, int *out_n, const int stride)
+  {
+    int nproc;
+    MPI_CHECK_RESULT(MPI_Comm_size,(comm,&nproc));
+    cf3_assert( stride>0 );
+    const int item_size=stride*sizeof(T);
+
+#if MPI_VERSION >= 3
+    const int tag=sparse_all_to_all_tag();
+
+    // start synchronous sends for the non-empty messages only
+    std::vector<MPI_Request> send_requests;
+    int in_disp=0;
+    for (int i=0; i<nproc; i++)
+    {
+      if (in_n[i]!=0)
+      {
+        send_requests.push_back(MPI_REQUEST_NULL);
+        MPI_CHECK_RESULT(MPI_Issend, ((void*)(in_values+in_disp*stride), in_n[i]*item_size, MPI_BYTE, i, tag, comm, &send_requests.back()));
+      }
+      in_disp+=in_n[i];
+    }
+
+    // receive whatever arrives, until all processes have had their sends matched
+    std::vector< std::vector<char> > recv_buffers(0);
+    std::vector<int> recv_ranks(0);
+    MPI_Request barrier_request=MPI_REQUEST_NULL;
+    bool barrier_started=false;
+    while (true)
+    {
+      int has_message=0;
+      MPI_Status status;
+      MPI_CHECK_RESULT(MPI_Iprobe, (MPI_ANY_SOURCE, tag, comm, &has_message, &status));
+      if (has_message)
+      {
+        int nbytes=0;
+        MPI_CHECK_RESULT(MPI_Get_count, (&status, MPI_BYTE, &nbytes));
+        recv_ranks.push_back(status.MPI_SOURCE);
+        recv_buffers.push_back(std::vector<char>(nbytes+1));
+        MPI_CHECK_RESULT(MPI_Recv, (&recv_buffers.back()[0], nbytes, MPI_BYTE, status.MPI_SOURCE, tag, comm, MPI_STATUS_IGNORE));
+        recv_buffers.back().resize(nbytes);
+      }
+
+      if (barrier_started)
+      {
+        int barrier_done=0;
+        MPI_CHECK_RESULT(MPI_Test, (&barrier_request, &barrier_done, MPI_STATUS_IGNORE));
+        if (barrier_done) break;
+      }
+      else
+      {
+        int sends_done=1;
+        if (!send_requests.empty())
+          MPI_CHECK_RESULT(MPI_Testall, ((int)send_requests.size(), &send_requests[0], &sends_done, MPI_STATUSES_IGNORE));
+        if (sends_done)
+        {
+          MPI_CHECK_RESULT(MPI_Ibarrier, (comm, &barrier_request));
+          barrier_started=true;
+        }
+      }
+    }
+
+    // assemble in rank order
+    std::vector<int> recv_index(nproc,-1);
+    for (int i=0; i<nproc; i++) out_n[i]=0;
+    int out_sum=0;
+    for (int i=0; i<(const int)recv_ranks.size(); i++)
+    {
+      if (recv_index[recv_ranks[i]]!=-1) throw cf3::common::ParallelError(FromHere(),"Received more than one message from the same process in a sparse all_to_all.");
+      if (recv_buffers[i].size()%item_size!=0) throw cf3::common::ParallelError(FromHere(),"Received message size is not a multiple of the item size in a sparse all_to_all.");
+      recv_index[recv_ranks[i]]=i;
+      out_n[recv_ranks[i]]=recv_buffers[i].size()/item_size;
+      out_sum+=out_n[recv_ranks[i]];
+    }
+    out_values.resize(out_sum*stride);
+    char* out_ptr=(char*)(out_values.empty() ? nullptr : &out_values[0]);
+    for (int i=0; i<nproc; i++)
+    {
+      if (recv_index[i]==-1) continue;
+      const std::vector<char>& buf=recv_buffers[recv_index[i]];
+      if (!buf.empty()) memcpy(out_ptr,&buf[0],buf.size());
+      out_ptr+=buf.size();
+    }
+#else
+    // dense fallback: exchange the counts, then the data
+    std::vector<int> send_counts(in_n,in_n+nproc);
+    std::vector<int> recv_counts(nproc,0);
+    all_to_all(comm,send_counts,recv_counts);
+    int in_sum=0;
+    int out_sum=0;
+    for (int i=0; i<nproc; i++) { in_sum+=in_n[i]; out_sum+=recv_counts[i]; out_n[i]=recv_counts[i]; }
+    std::vector<T> in_copy(in_values,in_values+in_sum*stride);
+    in_copy.resize(in_sum*stride+1);
+    out_values.resize(out_sum*stride+1);
+    all_to_allvm_impl(comm, &in_copy[0], in_n, (const int*)0, &out_values[0], out_n, (const int*)0, stride);
+    out_values.resize(out_sum*stride);
+#endif
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // end namespace detail
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+  Interface to the sparse variable size all to all communication with specialization to std::vector.
+  Equivalent to the variable size all_to_all with unknown receive counts, but the cost scales with the number of
+  processes actually communicating instead of the total number of processes.
+  in_values and out_values may be the same vector.
+  @param comm Comm::Communicator
+  @param in_values send buffer
+  @param in_n send counts of size #processes
+  @param out_values receive buffer, resized to fit
+  @param out_n receive counts, resized to #processes and filled
+  @param stride is the number of items of type T forming one array element, for example if communicating coordinates together, then stride==3:  X0,Y0,Z0,X1,Y1,Z1,...,Xn-1,Yn-1,Zn-1
+**/
+template<typename T>
+inline void
+sparse_all_to_all(const Communicator& comm, const std::vector<T>& in_values, const std::vector<int>& in_n, std::vector<T>& out_values, std::vector<int>& out_n, const int stride=1)
+{
+  int nproc;
+  MPI_CHECK_RESULT(MPI_Comm_size,(comm,&nproc));
+  cf3_assert( (int)in_n.size() == nproc );
+  out_n.resize(nproc);
+
+  std::vector<T> out_tmp(0);
+  detail::sparse_all_to_allv_impl(comm, (in_values.empty() ? (const T*)0 : &in_values[0]), &in_n[0], out_tmp, &out_n[0], stride);
+  out_values.swap(out_tmp);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+  Interface to the sparse all to all communication of one vector per process.
+  Equivalent to the all_to_all on nested vectors, only the non-empty vectors are actually sent.
+  @param comm Comm::Communicator
+  @param send vector of size #processes holding the data to send to each process
+  @param recv resized to #processes, holding the data received from each process
+**/
+template <typename T>
+void sparse_all_to_all(const Communicator& comm, const std::vector<std::vector<T> >& send, std::vector<std::vector<T> >& recv)
+{
+  int nproc;
+  MPI_CHECK_RESULT(MPI_Comm_size,(comm,&nproc));
+  cf3_assert( (int)send.size() == nproc );
+
+  std::vector<int> send_counts(nproc);
+  int send_sum=0;
+  for (int i=0; i<nproc; ++i)
+  {
+    send_counts[i]=send[i].size();
+    send_sum+=send_counts[i];
+  }
+
+  std::vector<T> send_linear;
+  send_linear.reserve(send_sum);
+  for (int i=0; i<nproc; ++i)
+    send_linear.insert(send_linear.end(),send[i].begin(),send[i].end());
+
+  std::vector<int> recv_counts(nproc);
+  std::vector<T> recv_linear;
+  detail::sparse_all_to_allv_impl(comm, (send_linear.empty() ? (const T*)0 : &send_linear[0]), &send_counts[0], recv_linear, &recv_counts[0], 1);
+
+  recv.resize(nproc);
+  typename std::vector<T>::const_iterator recv_it=recv_linear.begin();
+  for (int i=0; i<nproc; ++i)
+  {
+    recv[i].assign(recv_it,recv_it+recv_counts[i]);
+    recv_it+=recv_counts[i];
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace PE
+} // namespace common
+} // namespace cf3
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // cf3_common_PE_sparse_all_to_all_hpp
@@ -0,0 +1,258 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#include <algorithm>
+
+#include "math/BatchFunctionParser.hpp"
+
+// The parser data and the math functions used by Eval, to get the same results
+#include "fparser/extrasrc/fpaux.hh"
+
+////////////////////////////////////////////////////////////////////////////////
+
+using namespace FUNCTIONPARSERTYPES;
+
+namespace cf3 {
+namespace math {
+
+////////////////////////////////////////////////////////////////////////////////
+
+const Uint BatchFunctionParser::block_size;
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Apply an operation to the top of the stack, or to the two values on top of it. The checked versions flag the
+// points for which Eval detects an error, or would compute a different value
+#define CF3_BATCH_UNARY(expression) \
+  { Real* x = top; for(Uint p = 0; p != nb_points; ++p) x[p] = (expression); break; }
+#define CF3_BATCH_BINARY(expression) \
+  { Real* x = top - block_size; const Real* y = top; for(Uint p = 0; p != nb_points; ++p) x[p] = (expression); top = x; break; }
+#define CF3_BATCH_UNARY_CHECKED(error, expression) \
+  { Real* x = top; for(Uint p = 0; p != nb_points; ++p) { fallback[p] |= (error); x[p] = (expression); } break; }
+#define CF3_BATCH_BINARY_CHECKED(error, expression) \
+  { Real* x = top - block_size; const Real* y = top; \
+    for(Uint p = 0; p != nb_points; ++p) { fallback[p] |= (error); x[p] = (expression); } top = x; break; }
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool BatchFunctionParser::batch_supported()
+{
+  const std::vector<unsigned>& byte_code = getParserData()->mByteCode;
+  for(Uint ip = 0; ip < byte_code.size(); ++ip)
+  {
+    switch(byte_code[ip])
+    {
+      case cIf: case cAbsIf: case cJump: case cEval: case cFCall: case cPCall:
+        return false;
+      // Instructions followed by their arguments
+      case cFetch:
+        ++ip;
+        break;
+#ifdef FP_SUPPORT_OPTIMIZER
+      case cPopNMov:
+        ip += 2;
+        break;
+#endif
+      default:
+        break;
+    }
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void BatchFunctionParser::eval_block(const Real* variables, const Uint nb_points, const Uint point_stride, const Uint variable_stride)
+{
+  const Data& data = *getParserData();
+  const std::vector<unsigned>& byte_code = data.mByteCode;
+  const Uint byte_code_size = byte_code.size();
+  Uint dp = 0;
+
+  // The first block is below the bottom of the stack, for the empty stack
+  m_stack.resize((data.mStackSize + 1) * block_size);
+  Real* const stack = &m_stack[block_size];
+  Real* top = &m_stack[0];
+  m_fallback.assign(block_size, 0);
+  char* const fallback = &m_fallback[0];
+
+  for(Uint ip = 0; ip != byte_code_size; ++ip)
+  {
+    switch(byte_code[ip])
+    {
+      case cAbs:   CF3_BATCH_UNARY(fp_abs(x[p]))
+      case cAcos:  CF3_BATCH_UNARY_CHECKED(x[p] < -1. || x[p] > 1., fp_acos(x[p]))
+      case cAcosh: CF3_BATCH_UNARY_CHECKED(x[p] < 1., fp_acosh(x[p]))
+      case cAsin:  CF3_BATCH_UNARY_CHECKED(x[p] < -1. || x[p] > 1., fp_asin(x[p]))
+      case cAsinh: CF3_BATCH_UNARY(fp_asinh(x[p]))
+      case cAtan:  CF3_BATCH_UNARY(fp_atan(x[p]))
+      case cAtan2: CF3_BATCH_BINARY(fp_atan2(x[p], y[p]))
+      case cAtanh: CF3_BATCH_UNARY_CHECKED(x[p] <= -1. || x[p] >= 1., fp_atanh(x[p]))
+      case cCbrt:  CF3_BATCH_UNARY(fp_cbrt(x[p]))
+      case cCeil:  CF3_BATCH_UNARY(fp_ceil(x[p]))
+      case cCos:   CF3_BATCH_UNARY(fp_cos(x[p]))
+      case cCosh:  CF3_BATCH_UNARY(fp_cosh(x[p]))
+      case cCot:   CF3_BATCH_UNARY_CHECKED(fp_tan(x[p]) == 0., 1. / fp_tan(x[p]))
+      case cCsc:   CF3_BATCH_UNARY_CHECKED(fp_sin(x[p]) == 0., 1. / fp_sin(x[p]))
+      case cExp:   CF3_BATCH_UNARY(fp_exp(x[p]))
+      case cExp2:  CF3_BATCH_UNARY(fp_exp2(x[p]))
+      case cFloor: CF3_BATCH_UNARY(fp_floor(x[p]))
+      case cHypot: CF3_BATCH_BINARY(fp_hypot(x[p], y[p]))
+      case cInt:   CF3_BATCH_UNARY(fp_int(x[p]))
+      case cLog:   CF3_BATCH_UNARY_CHECKED(!(x[p] > 0.), fp_log(x[p]))
+      case cLog10: CF3_BATCH_UNARY_CHECKED(!(x[p] > 0.), fp_log10(x[p]))
+      case cLog2:  CF3_BATCH_UNARY_CHECKED(!(x[p] > 0.), fp_log2(x[p]))
+      case cMax:   CF3_BATCH_BINARY(fp_max(x[p], y[p]))
+      case cMin:   CF3_BATCH_BINARY(fp_min(x[p], y[p]))
+      case cPow:   CF3_BATCH_BINARY_CHECKED(x[p] == 0. && y[p] < 0., fp_pow(x[p], y[p]))
+      case cSec:   CF3_BATCH_UNARY_CHECKED(fp_cos(x[p]) == 0., 1. / fp_cos(x[p]))
+      case cSin:   CF3_BATCH_UNARY(fp_sin(x[p]))
+      case cSinh:  CF3_BATCH_UNARY(fp_sinh(x[p]))
+      case cSqrt:  CF3_BATCH_UNARY_CHECKED(x[p] < 0., fp_sqrt(x[p]))
+      case cTan:   CF3_BATCH_UNARY(fp_tan(x[p]))
+      case cTanh:  CF3_BATCH_UNARY(fp_tanh(x[p]))
+      case cTrunc: CF3_BATCH_UNARY(fp_trunc(x[p]))
+
+      case cImmed:
+        top += block_size;
+        std::fill(top, top + nb_points, data.mImmed[dp++]);
+        break;
+
+      case cNeg:         CF3_BATCH_UNARY(-x[p])
+      case cAdd:         CF3_BATCH_BINARY(x[p] + y[p])
+      case cSub:         CF3_BATCH_BINARY(x[p] - y[p])
+      case cMul:         CF3_BATCH_BINARY(x[p] * y[p])
+      case cDiv:         CF3_BATCH_BINARY_CHECKED(y[p] == 0., x[p] / y[p])
+      case cMod:         CF3_BATCH_BINARY_CHECKED(y[p] == 0., fp_mod(x[p], y[p]))
+      case cEqual:       CF3_BATCH_BINARY(fp_equal(x[p], y[p]))
+      case cNEqual:      CF3_BATCH_BINARY(fp_nequal(x[p], y[p]))
+      case cLess:        CF3_BATCH_BINARY(fp_less(x[p], y[p]))
+      case cLessOrEq:    CF3_BATCH_BINARY(fp_lessOrEq(x[p], y[p]))
+      case cGreater:     CF3_BATCH_BINARY(fp_less(y[p], x[p]))
+      case cGreaterOrEq: CF3_BATCH_BINARY(fp_lessOrEq(y[p], x[p]))
+      case cNot:         CF3_BATCH_UNARY(fp_not(x[p]))
+      case cNotNot:      CF3_BATCH_UNARY(fp_notNot(x[p]))
+      case cAnd:         CF3_BATCH_BINARY(fp_and(x[p], y[p]))
+      case cOr:          CF3_BATCH_BINARY(fp_or(x[p], y[p]))
+      case cDeg:         CF3_BATCH_UNARY(RadiansToDegrees(x[p]))
+      case cRad:         CF3_BATCH_UNARY(DegreesToRadians(x[p]))
+
+      case cFetch:
+      {
+        const Real* source = stack + byte_code[++ip] * block_size;
+        top += block_size;
+        std::copy(source, source + nb_points, top);
+        break;
+      }
+
+#ifdef FP_SUPPORT_OPTIMIZER
+      case cPopNMov:
+      {
+        Real* target = stack + byte_code[++ip] * block_size;
+        const Real* source = stack + byte_code[++ip] * block_size;
+        std::copy(source, source + nb_points, target);
+        top = target;
+        break;
+      }
+
+      case cLog2by: CF3_BATCH_BINARY_CHECKED(!(x[p] > 0.), fp_log2(x[p]) * y[p])
+      case cNop:    break;
+#endif
+
+      case cSinCos:
+      case cSinhCosh:
+      {
+        Real* x = top;
+        Real* second = top + block_size;
+        for(Uint p = 0; p != nb_points; ++p)
+        {
+          if(byte_code[ip] == cSinCos)
+            fp_sinCos(x[p], second[p], x[p]);
+          else
+            fp_sinhCosh(x[p], second[p], x[p]);
+        }
+        top = second;
+        break;
+      }
+
+      case cAbsNot:    CF3_BATCH_UNARY(fp_absNot(x[p]))
+      case cAbsNotNot: CF3_BATCH_UNARY(fp_absNotNot(x[p]))
+      case cAbsAnd:    CF3_BATCH_BINARY(fp_absAnd(x[p], y[p]))
+      case cAbsOr:     CF3_BATCH_BINARY(fp_absOr(x[p], y[p]))
+
+      case cDup:
+        std::copy(top, top + nb_points, top + block_size);
+        top += block_size;
+        break;
+
+      case cInv:   CF3_BATCH_UNARY_CHECKED(x[p] == 0., 1. / x[p])
+      case cSqr:   CF3_BATCH_UNARY(x[p] * x[p])
+      case cRDiv:  CF3_BATCH_BINARY_CHECKED(x[p] == 0., y[p] / x[p])
+      case cRSub:  CF3_BATCH_BINARY(y[p] - x[p])
+      case cRSqrt: CF3_BATCH_UNARY_CHECKED(x[p] == 0., 1. / fp_sqrt(x[p]))
+
+      default:
+      {
+        cf3_assert(byte_code[ip] >= VarBegin);
+        const Real* var = variables + (byte_code[ip] - VarBegin) * variable_stride;
+        top += block_size;
+        for(Uint p = 0; p != nb_points; ++p)
+          top[p] = var[p * point_stride];
+        break;
+      }
+    }
+  }
+
+  cf3_assert(top == stack);
+}
+
+#undef CF3_BATCH_UNARY
+#undef CF3_BATCH_BINARY
+#undef CF3_BATCH_UNARY_CHECKED
+#undef CF3_BATCH_BINARY_CHECKED
+
+////////////////////////////////////////////////////////////////////////////////
+
+void BatchFunctionParser::eval_batch(const Real* variables, const Uint nb_points, const Uint point_stride, const Uint variable_stride,
+                                     Real* result, const Uint result_stride)
+{
+  const Uint nb_vars = getParserData()->mVariablesAmount;
+  m_point.resize(std::max(nb_vars, 1u));
+
+  if(GetParseErrorType() != FP_NO_ERROR || !batch_supported())
+  {
+    for(Uint p = 0; p != nb_points; ++p)
+    {
+      for(Uint v = 0; v != nb_vars; ++v)
+        m_point[v] = variables[p*point_stride + v*variable_stride];
+      result[p*result_stride] = Eval(&m_point[0]);
+    }
+    return;
+  }
+
+  for(Uint begin = 0; begin < nb_points; begin += block_size)
+  {
+    const Uint nb_block_points = std::min(block_size, nb_points - begin);
+    const Real* block_variables = variables + begin*point_stride;
+    eval_block(block_variables, nb_block_points, point_stride, variable_stride);
+    for(Uint p = 0; p != nb_block_points; ++p)
+    {
+      Real& value = result[(begin + p)*result_stride];
+      value = m_stack[block_size + p];
+      if(m_fallback[p])
+      {
+        for(Uint v = 0; v != nb_vars; ++v)
+          m_point[v] = block_variables[p*point_stride + v*variable_stride];
+        value = Eval(&m_point[0]);
+      }
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // math
+} // cf3
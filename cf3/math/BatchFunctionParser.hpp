@@ -0,0 +1,75 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#ifndef cf3_math_BatchFunctionParser_hpp
+#define cf3_math_BatchFunctionParser_hpp
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+
+#include "fparser/fparser.hh"
+
+#include "math/LibMath.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace cf3 {
+namespace math {
+
+//////////////////////////////////////////////////////////////////////////////
+
+/// @brief Function parser that evaluates its bytecode for many points at once
+///
+/// Eval() interprets the whole bytecode for every point, so for the short expressions of boundary conditions and
+/// initial fields most of the time goes to the dispatch on the opcodes. eval_batch() dispatches each instruction
+/// once for a block of points, and applies it to all of them in a tight loop that the compiler can vectorize.
+///
+/// Expressions with conditionals, user defined functions or eval() are evaluated point by point with Eval().
+/// Points for which Eval() would detect an error, such as a division by zero, are also evaluated with Eval(), so
+/// they get the same result (zero) in both paths.
+class Math_API BatchFunctionParser : public FunctionParser
+{
+public:
+
+  /// Number of points evaluated together
+  static const Uint block_size = 64;
+
+  /// Evaluate the function for nb_points points.
+  /// The value of variable v for point p is variables[p*point_stride + v*variable_stride], so a row-major table
+  /// of points has point_stride equal to its row size and variable_stride 1, while a column-major matrix has
+  /// point_stride 1 and variable_stride equal to the number of points.
+  /// @param result the value for point p is stored in result[p*result_stride]
+  void eval_batch(const Real* variables, const Uint nb_points, const Uint point_stride, const Uint variable_stride,
+                  Real* result, const Uint result_stride);
+
+private:
+
+  /// True if every instruction of the bytecode can be evaluated for a block
+  bool batch_supported();
+
+  /// Evaluate the bytecode for a block of at most block_size points, storing the result in m_stack and flagging
+  /// the points that must be evaluated with Eval() in m_fallback
+  void eval_block(const Real* variables, const Uint nb_points, const Uint point_stride, const Uint variable_stride);
+
+  /// Stack of the interpreter, holding block_size values for each level
+  std::vector<Real> m_stack;
+
+  /// Nonzero for the points of the block that must be evaluated with Eval()
+  std::vector<char> m_fallback;
+
+  /// Variables of one point, for the evaluation with Eval()
+  std::vector<Real> m_point;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // math
+} // cf3
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // cf3_math_BatchFunctionParser_hpp
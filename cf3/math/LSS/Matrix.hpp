@@ -9,10 +9,14 @@
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 
+#include <map>
+
+#include <boost/thread/mutex.hpp>
 #include <boost/utility.hpp>
 
 #include "math/LSS/LibLSS.hpp"
 #include "common/PE/CommPattern.hpp"
+#include "common/BasicExceptions.hpp"
 #include "common/Log.hpp"
 #include "math/LSS/BlockAccumulator.hpp"
 #include "math/LSS/Vector.hpp"
@@ -91,6 +95,26 @@ public:
   /// eigen, templatization on top level
   virtual void add_values(const BlockAccumulator& values) = 0;
 
+  /// Add a list of values, may be called from several threads at the same time without locking
+  /// Only available if supports_concurrent_add returns true
+  virtual void add_values_concurrent(const BlockAccumulator& values)
+  {
+    throw common::NotImplemented(FromHere(), "Concurrent addition of values is not supported by " + derived_type_name());
+  }
+
+  /// Add a list of values, addressing the value storage of the matrix directly through offsets.
+  /// If offsets does not match the size of the block, it is filled first, so repeated calls for the same block indices
+  /// skip all index lookups. Only used if use_cached_offsets returns true, the default just calls add_values or add_values_concurrent.
+  /// @param offsets Storage for the offsets of the entries of this block, to be kept by the caller between calls
+  /// @param concurrent If true, the values may be added from several threads at the same time
+  virtual void add_values_cached(const BlockAccumulator& values, std::vector<int>& offsets, const bool concurrent = false)
+  {
+    if(concurrent)
+      add_values_concurrent(values);
+    else
+      add_values(values);
+  }
+
   /// Add a list of values
   virtual void get_values(BlockAccumulator& values) = 0;
 
@@ -142,6 +166,27 @@ public:
   /// Accessor to the state of create
   virtual const bool is_created() = 0;
 
+  /// True if add_values_concurrent can be used, allowing multi-threaded assembly without a lock
+  virtual const bool supports_concurrent_add() { return false; }
+
+  /// True if assembly should go through add_values_cached
+  virtual const bool use_cached_offsets() { return false; }
+
+  /// Offsets storage for add_values_cached, for a series of nb_blocks blocks identified by key.
+  /// The returned storage is cleared when the structure of the matrix changes, or when nb_blocks changes.
+  /// This may be called from several threads, but the returned storage for a given block may only be accessed by one thread at a time.
+  std::vector< std::vector<int> >& cached_offsets(const std::string& key, const Uint nb_blocks)
+  {
+    boost::mutex::scoped_lock lock(m_cached_offsets_mutex);
+    std::vector< std::vector<int> >& result = m_cached_offsets[key];
+    if(result.size() != nb_blocks)
+    {
+      result.clear();
+      result.resize(nb_blocks);
+    }
+    return result;
+  }
+
   /// Accessor to the number of equations
   virtual const Uint neq() = 0;
 
@@ -177,6 +222,18 @@ public:
 
   //@} END TEST ONLY
 
+protected:
+  /// Invalidate all storage returned by cached_offsets, to be called by implementations when the value storage changes
+  void clear_cached_offsets()
+  {
+    boost::mutex::scoped_lock lock(m_cached_offsets_mutex);
+    m_cached_offsets.clear();
+  }
+
+private:
+  /// Offsets for add_values_cached, for each key
+  std::map< std::string, std::vector< std::vector<int> > > m_cached_offsets;
+  boost::mutex m_cached_offsets_mutex;
 
 }; // end of class Matrix
 
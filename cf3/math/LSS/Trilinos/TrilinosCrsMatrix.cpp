@@ -6,10 +6,13 @@
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
 #include <iostream>
 #include <set>
 
+#include <boost/integer.hpp>
 #include <boost/pointer_cast.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include "Teuchos_ConfigDefs.hpp"
 #include "Teuchos_RCP.hpp"
@@ -70,9 +73,15 @@ TrilinosCrsMatrix::TrilinosCrsMatrix(const std::string& name) :
   m_num_my_elements(0),
   m_p2m(0),
   m_converted_indices(0),
-  m_comm(common::PE::Comm::instance().communicator())
+  m_comm(common::PE::Comm::instance().communicator()),
+  m_cache_offsets(false)
 {
   properties().add("vector_type", std::string("cf3.math.LSS.TrilinosVector"));
+
+  options().add("cache_offsets", m_cache_offsets)
+    .pretty_name("Cache Offsets")
+    .description("Remember the position of each element block in the matrix storage during the first assembly, and use it for subsequent assemblies into the same sparsity pattern")
+    .link_to(&m_cache_offsets);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
@@ -91,6 +100,7 @@ void TrilinosCrsMatrix::create_blocked(common::PE::CommPattern& cp, const Variab
 {
   // if already created
   if (m_is_created) destroy();
+  clear_cached_offsets();
 
   // Copy node connectivity
   m_node_connectivity.resize(node_connectivity.size());
@@ -159,6 +169,7 @@ void TrilinosCrsMatrix::destroy()
   m_neq=0;
   m_num_my_elements=0;
   m_is_created=false;
+  clear_cached_offsets();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
@@ -251,6 +262,176 @@ void TrilinosCrsMatrix::add_values(const BlockAccumulator& values)
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 
+namespace detail
+{
+  /// Atomic addition to a Real, using a compare-and-swap loop on an integer of the same size
+  template<int RealSize, bool HasInteger = (RealSize == 4 || RealSize == 8)>
+  struct AtomicAdd
+  {
+    static void apply(Real& target, const Real value)
+    {
+      typedef typename boost::uint_t<8*RealSize>::exact IntegerT;
+      union { Real real; IntegerT integer; } old_value, new_value;
+      IntegerT* target_integer = reinterpret_cast<IntegerT*>(&target);
+      do
+      {
+        old_value.real = *static_cast<volatile Real*>(&target);
+        new_value.real = old_value.real + value;
+      } while(!__sync_bool_compare_and_swap(target_integer, old_value.integer, new_value.integer));
+    }
+  };
+
+  /// Fall back to a lock if there is no compare-and-swap for the size of Real
+  template<int RealSize>
+  struct AtomicAdd<RealSize, false>
+  {
+    static void apply(Real& target, const Real value)
+    {
+      static boost::mutex mutex;
+      boost::mutex::scoped_lock lock(mutex);
+      target += value;
+    }
+  };
+
+#if !defined(__GNUC__)
+  template<> struct AtomicAdd<4, true> : AtomicAdd<4, false> {};
+  template<> struct AtomicAdd<8, true> : AtomicAdd<8, false> {};
+#endif
+
+  inline void atomic_add(Real& target, const Real value)
+  {
+    AtomicAdd<sizeof(Real)>::apply(target, value);
+  }
+}
+
+void TrilinosCrsMatrix::add_values_concurrent(const BlockAccumulator& values)
+{
+  cf3_assert(m_is_created);
+  const Uint nb_nodes = values.indices.size();
+  const int num_entries = nb_nodes*m_neq;
+  cf3_assert(values.mat.rows() == num_entries);
+
+  std::vector<int>* converted_indices = m_thread_converted_indices.get();
+  if(converted_indices == nullptr)
+  {
+    converted_indices = new std::vector<int>();
+    m_thread_converted_indices.reset(converted_indices);
+  }
+  converted_indices->resize(num_entries);
+
+  // Convert the index vector
+  for(Uint i = 0; i != nb_nodes; ++i)
+  {
+    const Uint local_start_idx = values.indices[i]*m_neq;
+    for(int j = 0; j != m_neq; ++j)
+      (*converted_indices)[i*m_neq+j] = m_p2m[local_start_idx+j];
+  }
+
+  // add the values directly into the storage of each row
+  const bool sorted = m_mat->Sorted();
+  for(int row = 0; row != num_entries; ++row)
+  {
+    const int matrix_row = (*converted_indices)[row];
+    if(matrix_row >= m_num_my_elements)
+      continue;
+
+    int row_nb_entries;
+    Real* row_values;
+    int* row_indices;
+    TRILINOS_THROW(m_mat->ExtractMyRowView(matrix_row, row_nb_entries, row_values, row_indices));
+    const Real* block_row = values.mat.data() + num_entries*row;
+    int* const row_end = row_indices + row_nb_entries;
+    for(int col = 0; col != num_entries; ++col)
+    {
+      const int matrix_col = (*converted_indices)[col];
+      int* const col_it = sorted ? std::lower_bound(row_indices, row_end, matrix_col) : std::find(row_indices, row_end, matrix_col);
+      if(col_it == row_end || *col_it != matrix_col)
+        throw common::BadValue(FromHere(), "Trying to add to an entry that is not in the sparsity pattern.");
+      detail::atomic_add(row_values[col_it - row_indices], block_row[col]);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosCrsMatrix::add_values_cached(const BlockAccumulator& values, std::vector<int>& offsets, const bool concurrent)
+{
+  cf3_assert(m_is_created);
+  // Offsets are only meaningful if the values are stored in a single array
+  if(!m_mat->StorageOptimized())
+  {
+    if(concurrent)
+      add_values_concurrent(values);
+    else
+      add_values(values);
+    return;
+  }
+
+  const Uint nb_nodes = values.indices.size();
+  const int num_entries = nb_nodes*m_neq;
+  cf3_assert(values.mat.rows() == num_entries);
+
+  int* index_offsets;
+  int* column_indices;
+  Real* matrix_values;
+  TRILINOS_THROW(m_mat->ExtractCrsDataPointers(index_offsets, column_indices, matrix_values));
+
+  // First pass for this block: look up the position of each entry
+  if(offsets.size() != num_entries*num_entries)
+  {
+    std::vector<int> converted_indices(num_entries);
+    for(Uint i = 0; i != nb_nodes; ++i)
+    {
+      const Uint local_start_idx = values.indices[i]*m_neq;
+      for(int j = 0; j != m_neq; ++j)
+        converted_indices[i*m_neq+j] = m_p2m[local_start_idx+j];
+    }
+
+    const bool sorted = m_mat->Sorted();
+    offsets.assign(num_entries*num_entries, -1);
+    for(int row = 0; row != num_entries; ++row)
+    {
+      const int matrix_row = converted_indices[row];
+      if(matrix_row >= m_num_my_elements)
+        continue;
+
+      int* const row_begin = column_indices + index_offsets[matrix_row];
+      int* const row_end = column_indices + index_offsets[matrix_row+1];
+      for(int col = 0; col != num_entries; ++col)
+      {
+        const int matrix_col = converted_indices[col];
+        int* const col_it = sorted ? std::lower_bound(row_begin, row_end, matrix_col) : std::find(row_begin, row_end, matrix_col);
+        if(col_it == row_end || *col_it != matrix_col)
+          throw common::BadValue(FromHere(), "Trying to add to an entry that is not in the sparsity pattern.");
+        offsets[row*num_entries + col] = col_it - column_indices;
+      }
+    }
+  }
+
+  // Add the values, skipping the rows that are not owned by this process
+  const Real* block_values = values.mat.data();
+  const int nb_values = num_entries*num_entries;
+  for(int i = 0; i != nb_values; i += num_entries)
+  {
+    if(offsets[i] < 0)
+      continue;
+    const int* row_offsets = &offsets[i];
+    const Real* block_row = block_values + i;
+    if(concurrent)
+    {
+      for(int col = 0; col != num_entries; ++col)
+        detail::atomic_add(matrix_values[row_offsets[col]], block_row[col]);
+    }
+    else
+    {
+      for(int col = 0; col != num_entries; ++col)
+        matrix_values[row_offsets[col]] += block_row[col];
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
 void TrilinosCrsMatrix::get_values(BlockAccumulator& values)
 {
   cf3_assert(m_is_created);
@@ -533,6 +714,7 @@ void TrilinosCrsMatrix::clone_to(Matrix &other)
   other_ptr->m_node_connectivity = m_node_connectivity;
   other_ptr->m_starting_indices = m_starting_indices;
   other_ptr->m_symmetric_dirichlet_values = m_symmetric_dirichlet_values;
+  other_ptr->clear_cached_offsets();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
@@ -540,6 +722,7 @@ void TrilinosCrsMatrix::clone_to(Matrix &other)
 void TrilinosCrsMatrix::read_native(const common::URI& file)
 {  
   EpetraExt::readEpetraLinearSystem(file.path(), m_comm, &m_mat);
+  clear_cached_offsets();
   
   m_is_created = true;
 }
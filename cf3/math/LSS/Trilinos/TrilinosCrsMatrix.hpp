@@ -13,6 +13,8 @@
 #include <Epetra_CrsMatrix.h>
 #include <Teuchos_RCP.hpp>
 
+#include <boost/thread/tss.hpp>
+
 #include "math/LSS/LibLSS.hpp"
 #include "math/LSS/BlockAccumulator.hpp"
 #include "math/LSS/Vector.hpp"
@@ -89,6 +91,14 @@ public:
   /// eigen, templatization on top level
   void add_values(const BlockAccumulator& values);
 
+  /// Add a list of values, thread-safe version of add_values
+  /// Each thread uses its own index scratch, and the values are added atomically into the CSR storage of the matrix
+  void add_values_concurrent(const BlockAccumulator& values);
+
+  /// Add a list of values directly to the CSR value storage, at offsets that are looked up on the first call for the block only
+  /// Offsets of rows that are not owned by this process are stored as -1
+  void add_values_cached(const BlockAccumulator& values, std::vector<int>& offsets, const bool concurrent = false);
+
   /// Add a list of values
   void get_values(BlockAccumulator& values);
 
@@ -138,6 +148,12 @@ public:
   /// Accessor to the state of create
   const bool is_created() { return m_is_created; }
 
+  /// add_values_concurrent is supported
+  const bool supports_concurrent_add() { return true; }
+
+  /// Controlled by the cache_offsets option
+  const bool use_cached_offsets() { return m_cache_offsets; }
+
   /// Accessor to the number of equations
   const Uint neq() { cf3_assert(m_is_created); return m_neq; }
 
@@ -163,6 +179,7 @@ public:
   void replace_epetra_matrix(const Teuchos::RCP<Epetra_CrsMatrix>& mat)
   {
     m_mat = mat;
+    clear_cached_offsets();
   }
   
   /// Store the local matrix GIDs belonging to each variable in the given vector
@@ -225,6 +242,9 @@ private:
   /// a helper array used in set/add/get_values to avoid frequent new+free combo
   std::vector<int> m_converted_indices;
 
+  /// per-thread equivalent of m_converted_indices, used by add_values_concurrent
+  boost::thread_specific_ptr< std::vector<int> > m_thread_converted_indices;
+
   /// Copy of the connectivity data
   std::vector<int> m_node_connectivity, m_starting_indices;
 
@@ -234,6 +254,9 @@ private:
   DirichletMapT m_symmetric_dirichlet_values;
 
   std::vector< std::pair<Uint,Uint> > m_dirichlet_nodes;
+
+  /// True if the assembly should use add_values_cached
+  bool m_cache_offsets;
 }; // end of class Matrix
 
 ////////////////////////////////////////////////////////////////////////////////////////////
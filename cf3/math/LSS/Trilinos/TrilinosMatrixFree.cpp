@@ -0,0 +1,547 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <fstream>
+#include <iostream>
+
+#include "Epetra_MultiVector.h"
+
+#include "Thyra_EpetraLinearOp.hpp"
+
+#include "common/Builder.hpp"
+#include "common/Log.hpp"
+#include "common/OptionList.hpp"
+#include "common/PE/Comm.hpp"
+#include "common/PropertyList.hpp"
+#include "math/LSS/Trilinos/TrilinosDetail.hpp"
+#include "math/LSS/Trilinos/TrilinosMatrixFree.hpp"
+#include "math/VariablesDescriptor.hpp"
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+  @file TrilinosMatrixFree.cpp implementation of LSS::TrilinosMatrixFree
+**/
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace cf3;
+using namespace cf3::math;
+using namespace cf3::math::LSS;
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+common::ComponentBuilder < LSS::TrilinosMatrixFree, LSS::Matrix, LSS::LibLSS > TrilinosMatrixFree_Builder;
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace detail
+{
+  /// Epetra interface to the matrix-free operator, forwarding Apply
+  class MatrixFreeEpetraOperator : public Epetra_Operator
+  {
+  public:
+    MatrixFreeEpetraOperator(TrilinosMatrixFree& matrix, const Epetra_Map& map, const Epetra_Comm& comm) :
+      m_matrix(matrix),
+      m_map(map),
+      m_comm(comm)
+    {
+    }
+
+    int SetUseTranspose(bool UseTranspose)
+    {
+      return UseTranspose ? -1 : 0;
+    }
+
+    int Apply(const Epetra_MultiVector& X, Epetra_MultiVector& Y) const
+    {
+      m_matrix.apply_epetra(X, Y);
+      return 0;
+    }
+
+    int ApplyInverse(const Epetra_MultiVector& X, Epetra_MultiVector& Y) const
+    {
+      return -1;
+    }
+
+    double NormInf() const
+    {
+      return 0.;
+    }
+
+    const char* Label() const
+    {
+      return "cf3 matrix-free operator";
+    }
+
+    bool UseTranspose() const
+    {
+      return false;
+    }
+
+    bool HasNormInf() const
+    {
+      return false;
+    }
+
+    const Epetra_Comm& Comm() const
+    {
+      return m_comm;
+    }
+
+    const Epetra_Map& OperatorDomainMap() const
+    {
+      return m_map;
+    }
+
+    const Epetra_Map& OperatorRangeMap() const
+    {
+      return m_map;
+    }
+
+  private:
+    TrilinosMatrixFree& m_matrix;
+    const Epetra_Map& m_map;
+    const Epetra_Comm& m_comm;
+  };
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+TrilinosMatrixFree::TrilinosMatrixFree(const std::string& name) :
+  LSS::Matrix(name),
+  m_comm(common::PE::Comm::instance().communicator()),
+  m_is_created(false),
+  m_neq(0),
+  m_num_my_elements(0),
+  m_result(nullptr),
+  m_diagonal_only(false)
+{
+  properties().add("vector_type", std::string("cf3.math.LSS.TrilinosVector"));
+
+  options().add("action", m_action)
+    .pretty_name("Action")
+    .description("Action that assembles the system matrix, executed each time the operator is applied. It should not apply boundary conditions or reset the system.")
+    .mark_basic()
+    .link_to(&m_action);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::create(cf3::common::PE::CommPattern& cp, const Uint neq, const std::vector<Uint>& node_connectivity, const std::vector<Uint>& starting_indices, LSS::Vector& solution, LSS::Vector& rhs, const std::vector<Uint>& periodic_links_nodes, const std::vector<bool>& periodic_links_active)
+{
+  boost::shared_ptr<VariablesDescriptor> single_var_descriptor = common::allocate_component<VariablesDescriptor>("SingleVariableDescriptor");
+  single_var_descriptor->options().set(common::Tags::dimension(), neq);
+  single_var_descriptor->push_back("LSSvars", VariablesDescriptor::Dimensionalities::VECTOR);
+  create_blocked(cp, *single_var_descriptor, node_connectivity, starting_indices, solution, rhs, periodic_links_nodes, periodic_links_active);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::create_blocked(common::PE::CommPattern& cp, const VariablesDescriptor& vars, const std::vector< Uint >& node_connectivity, const std::vector< Uint >& starting_indices, Vector& solution, Vector& rhs, const std::vector<Uint>& periodic_links_nodes, const std::vector<bool>& periodic_links_active)
+{
+  // if already created
+  if (m_is_created) destroy();
+
+  m_rhs = Handle<TrilinosVector>(rhs.handle<Component>());
+  if(is_null(m_rhs))
+    throw common::SetupError(FromHere(), "TrilinosMatrixFree needs a TrilinosVector as RHS, but a " + rhs.derived_type_name() + " was supplied instead.");
+
+  std::vector<int> my_global_elements;
+  std::vector<Uint> my_ranks;
+  create_map_data(cp, vars, m_p2m, my_global_elements, my_ranks, m_num_my_elements, periodic_links_nodes, periodic_links_active);
+
+  // rowmap, ghosts not present
+  m_row_map = Teuchos::rcp(new Epetra_Map(-1,m_num_my_elements,&my_global_elements[0],0,m_comm));
+
+  // colmap, has ghosts at the end
+  m_col_map = Teuchos::rcp(new Epetra_Map(-1,my_global_elements.size(),&my_global_elements[0],0,m_comm));
+
+  m_importer = Teuchos::rcp(new Epetra_Import(*m_col_map, *m_row_map));
+  m_x_col = Teuchos::rcp(new Epetra_Vector(*m_col_map));
+  m_rhs_backup = Teuchos::rcp(new Epetra_Vector(*m_row_map));
+  m_operator = Teuchos::rcp(new detail::MatrixFreeEpetraOperator(*this, *m_row_map, m_comm));
+
+  m_diagonal.clear();
+  m_dirichlet_rows.clear();
+
+  m_is_created=true;
+  m_neq=vars.size();
+  CFdebug << "Rank " << common::PE::Comm::instance().rank() << ": Created a matrix-free operator with " << m_num_my_elements << " local rows" << CFendl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::destroy()
+{
+  m_operator.reset();
+  m_x_col.reset();
+  m_rhs_backup.reset();
+  m_importer.reset();
+  m_col_map.reset();
+  m_row_map.reset();
+  m_p2m.resize(0);
+  m_p2m.reserve(0);
+  m_diagonal.clear();
+  m_dirichlet_rows.clear();
+  m_neq=0;
+  m_num_my_elements=0;
+  m_is_created=false;
+  clear_cached_offsets();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::throw_not_available(const std::string& function) const
+{
+  throw common::NotImplemented(FromHere(), function + " is not available for the matrix-free operator " + uri().string());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::set_value(const Uint icol, const Uint irow, const Real value)
+{
+  throw_not_available("set_value");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::add_value(const Uint icol, const Uint irow, const Real value)
+{
+  throw_not_available("add_value");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::get_value(const Uint icol, const Uint irow, Real& value)
+{
+  throw_not_available("get_value");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::set_values(const BlockAccumulator& values)
+{
+  throw_not_available("set_values");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::add_values(const BlockAccumulator& values)
+{
+  cf3_assert(m_is_created);
+
+  // Regular assembly: nothing is stored
+  if(is_null(m_result))
+    return;
+
+  const Uint nb_nodes = values.indices.size();
+  const int num_entries = nb_nodes*m_neq;
+  cf3_assert(values.mat.rows() == num_entries);
+
+  // Convert the index vector
+  m_converted_indices.resize(num_entries);
+  for(Uint i = 0; i != nb_nodes; ++i)
+  {
+    const Uint local_start_idx = values.indices[i]*m_neq;
+    for(int j = 0; j != m_neq; ++j)
+      m_converted_indices[i*m_neq+j] = m_p2m[local_start_idx+j];
+  }
+
+  const Real* x = m_x_col->Values();
+  for(int row = 0; row != num_entries; ++row)
+  {
+    const int matrix_row = m_converted_indices[row];
+    if(matrix_row >= m_num_my_elements)
+      continue;
+
+    const Real* block_row = values.mat.data() + num_entries*row;
+    if(m_diagonal_only)
+    {
+      for(int col = 0; col != num_entries; ++col)
+      {
+        if(m_converted_indices[col] == matrix_row)
+          m_result[matrix_row] += block_row[col];
+      }
+    }
+    else
+    {
+      Real row_result = 0.;
+      for(int col = 0; col != num_entries; ++col)
+        row_result += block_row[col] * x[m_converted_indices[col]];
+      m_result[matrix_row] += row_result;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::get_values(BlockAccumulator& values)
+{
+  throw_not_available("get_values");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::set_row(const Uint iblockrow, const Uint ieq, Real diagval, Real offdiagval)
+{
+  cf3_assert(m_is_created);
+  if(offdiagval != 0.)
+    throw common::NotImplemented(FromHere(), "set_row with non-zero off-diagonal values is not available for the matrix-free operator " + uri().string());
+
+  const int row = m_p2m[iblockrow*m_neq+ieq];
+  if(row >= m_num_my_elements)
+    return;
+
+  m_dirichlet_rows[row] = diagval;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::get_column_and_replace_to_zero(const Uint iblockcol, Uint ieq, std::vector<Real>& values)
+{
+  throw_not_available("get_column_and_replace_to_zero");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::symmetric_dirichlet(const Uint blockrow, const Uint ieq, const Real value, Vector& rhs)
+{
+  set_row(blockrow, ieq, 1., 0.);
+  rhs.set_value(blockrow, ieq, value);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::tie_blockrow_pairs (const Uint iblockrow_to, const Uint iblockrow_from)
+{
+  throw_not_available("tie_blockrow_pairs");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::set_diagonal(const std::vector<Real>& diag)
+{
+  cf3_assert(m_is_created);
+  cf3_assert(diag.size() == m_p2m.size());
+  m_diagonal.assign(m_num_my_elements, 0.);
+  add_diagonal(diag);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::add_diagonal(const std::vector<Real>& diag)
+{
+  cf3_assert(m_is_created);
+  cf3_assert(diag.size() == m_p2m.size());
+  m_diagonal.resize(m_num_my_elements, 0.);
+  const Uint nb_entries = m_p2m.size();
+  for(Uint i = 0; i != nb_entries; ++i)
+  {
+    if(m_p2m[i] < m_num_my_elements)
+      m_diagonal[m_p2m[i]] += diag[i];
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::get_diagonal(std::vector<Real>& diag)
+{
+  cf3_assert(m_is_created);
+  std::vector<Real> my_diag(m_num_my_elements, 0.);
+  if(!my_diag.empty())
+  {
+    m_result = &my_diag[0];
+    m_diagonal_only = true;
+  }
+  execute_action();
+  m_diagonal_only = false;
+
+  if(!m_diagonal.empty())
+  {
+    for(int i = 0; i != m_num_my_elements; ++i)
+      my_diag[i] += m_diagonal[i];
+  }
+  for(std::map<int, Real>::const_iterator it = m_dirichlet_rows.begin(); it != m_dirichlet_rows.end(); ++it)
+    my_diag[it->first] = it->second;
+
+  const int nb_col_entries = m_p2m.size();
+  diag.resize(nb_col_entries);
+  for(Uint i = 0; i != nb_col_entries; ++i)
+  {
+    diag[i] = m_p2m[i] < m_num_my_elements ? my_diag[m_p2m[i]] : 0.;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::reset(Real reset_to)
+{
+  cf3_assert(m_is_created);
+  if(reset_to != 0.)
+    throw common::NotImplemented(FromHere(), "The matrix-free operator " + uri().string() + " can only be reset to 0");
+  m_diagonal.clear();
+  m_dirichlet_rows.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::execute_action()
+{
+  if(is_null(m_action))
+    throw common::SetupError(FromHere(), "No assembly action set for the matrix-free operator " + uri().string());
+
+  // The RHS is assembled by the same action, keep the real one
+  Epetra_Vector& rhs = *m_rhs->epetra_vector();
+  *m_rhs_backup = rhs;
+
+  try
+  {
+    m_action->execute();
+  }
+  catch(...)
+  {
+    m_result = nullptr;
+    rhs = *m_rhs_backup;
+    throw;
+  }
+
+  m_result = nullptr;
+  rhs = *m_rhs_backup;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::apply_epetra(const Epetra_MultiVector& x, Epetra_MultiVector& y)
+{
+  cf3_assert(m_is_created);
+  cf3_assert(x.NumVectors() == y.NumVectors());
+  // the RHS is restored after each execution of the action, so it can't hold the result
+  cf3_assert(y.Values() != m_rhs->epetra_vector()->Values());
+
+  const int nb_vectors = x.NumVectors();
+  for(int k = 0; k != nb_vectors; ++k)
+  {
+    TRILINOS_THROW(m_x_col->Import(*x(k), *m_importer, Insert));
+    Real* result = y[k];
+    TRILINOS_THROW(y(k)->PutScalar(0.));
+
+    m_result = result;
+    execute_action();
+
+    const Real* x_values = m_x_col->Values();
+    if(!m_diagonal.empty())
+    {
+      for(int i = 0; i != m_num_my_elements; ++i)
+        result[i] += m_diagonal[i] * x_values[i];
+    }
+    for(std::map<int, Real>::const_iterator it = m_dirichlet_rows.begin(); it != m_dirichlet_rows.end(); ++it)
+      result[it->first] = it->second * x_values[it->first];
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::apply(const Handle< Vector >& y, const Handle< const Vector >& x, const Real alpha, const Real beta)
+{
+  cf3_assert(m_is_created);
+  apply_matrix(*m_operator, y, x, alpha, beta);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+Teuchos::RCP< const Thyra::LinearOpBase< Real > > TrilinosMatrixFree::thyra_operator() const
+{
+  return Thyra::epetraLinearOp(m_operator);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+Teuchos::RCP< Thyra::LinearOpBase< Real > > TrilinosMatrixFree::thyra_operator()
+{
+  return Thyra::nonconstEpetraLinearOp(m_operator);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::clone_to(Matrix& other)
+{
+  throw_not_available("clone_to");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::read_native(const common::URI& file)
+{
+  throw_not_available("read_native");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::print(common::LogStream& stream)
+{
+  if (m_is_created)
+  {
+    stream << "# name:                 " << name() << "\n";
+    stream << "# type_name:            " << type_name() << "\n";
+    stream << "# process:              " << m_comm.MyPID() << "\n";
+    stream << "# number of equations:  " << m_neq << "\n";
+    stream << "# number of rows:       " << m_num_my_elements << "\n";
+    stream << "# number of cols:       " << m_p2m.size() << "\n";
+    stream << "# number of block rows: " << m_num_my_elements/neq() << "\n";
+    stream << "# number of block cols: " << m_p2m.size()/neq() << "\n";
+    stream << "# dirichlet rows:       " << m_dirichlet_rows.size() << "\n";
+  } else {
+    stream << name() << " of type " << type_name() << "::is_created() is false, nothing is printed.";
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::print(std::ostream& stream)
+{
+  if (m_is_created)
+  {
+    stream << "# name:                 " << name() << "\n";
+    stream << "# type_name:            " << type_name() << "\n";
+    stream << "# process:              " << m_comm.MyPID() << "\n";
+    stream << "# number of equations:  " << m_neq << "\n";
+    stream << "# number of rows:       " << m_num_my_elements << "\n";
+    stream << "# number of cols:       " << m_p2m.size() << "\n";
+    stream << "# number of block rows: " << m_num_my_elements/neq() << "\n";
+    stream << "# number of block cols: " << m_p2m.size()/neq() << "\n";
+    stream << "# dirichlet rows:       " << m_dirichlet_rows.size() << "\n";
+  } else {
+    stream << name() << " of type " << type_name() << "::is_created() is false, nothing is printed.";
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::print(const std::string& filename, std::ios_base::openmode mode )
+{
+  std::ofstream stream(filename.c_str(),mode);
+  print(stream);
+  stream.close();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::print_native(std::ostream& stream)
+{
+  print(stream);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void TrilinosMatrixFree::debug_data(std::vector<Uint>& row_indices, std::vector<Uint>& col_indices, std::vector<Real>& values)
+{
+  throw_not_available("debug_data");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
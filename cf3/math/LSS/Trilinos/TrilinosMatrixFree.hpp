@@ -0,0 +1,263 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#ifndef cf3_Math_LSS_TrilinosMatrixFree_hpp
+#define cf3_Math_LSS_TrilinosMatrixFree_hpp
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <map>
+
+#include <Epetra_Import.h>
+#include <Epetra_Map.h>
+#include <Epetra_MpiComm.h>
+#include <Epetra_Operator.h>
+#include <Epetra_Vector.h>
+#include <Teuchos_RCP.hpp>
+
+#include "common/Action.hpp"
+
+#include "math/LSS/LibLSS.hpp"
+#include "math/LSS/BlockAccumulator.hpp"
+#include "math/LSS/Vector.hpp"
+#include "math/LSS/Matrix.hpp"
+#include "math/LSS/Trilinos/TrilinosVector.hpp"
+
+#include "ThyraOperator.hpp"
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+  @file TrilinosMatrixFree.hpp definition of LSS::TrilinosMatrixFree
+
+  Matrix that never stores its entries. Applying it executes an assembly action (typically a Proto element
+  expression adding to the system matrix) with the add_values calls redirected to an element-by-element
+  matrix-vector product.
+**/
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace cf3 {
+namespace math {
+namespace LSS {
+
+/// Matrix-free operator for the Trilinos solvers. The action set in the "action" option is executed each time the
+/// operator is applied, and each block it adds to the matrix is multiplied with the corresponding entries of the
+/// input vector instead of being stored. The action must only assemble the system, any RHS contributions it makes
+/// are discarded during an apply.
+/// Dirichlet conditions replace the row by the identity, so the operator is not symmetric and solvers that don't
+/// need the matrix entries must be used (e.g. Belos GMRES without preconditioner or with a matrix-free preconditioner).
+class LSS_API TrilinosMatrixFree : public LSS::Matrix, public ThyraOperator {
+public:
+
+  /// @name CREATION, DESTRUCTION AND COMPONENT SYSTEM
+  //@{
+
+  /// name of the type
+  static std::string type_name () { return "TrilinosMatrixFree"; }
+
+  /// Accessor to solver type
+  const std::string solvertype() { return "Trilinos"; }
+
+  /// Accessor to the flag if matrix, solution and rhs are tied together or not
+  const bool is_swappable(const LSS::Vector& solution, const LSS::Vector& rhs) { return true; }
+
+  /// Default constructor
+  TrilinosMatrixFree(const std::string& name);
+
+  /// Setup the maps. The connectivity is not used, since nothing is stored.
+  void create(cf3::common::PE::CommPattern& cp, const Uint neq, const std::vector<Uint>& node_connectivity, const std::vector<Uint>& starting_indices, LSS::Vector& solution, LSS::Vector& rhs, const std::vector<Uint>& periodic_links_nodes = std::vector<Uint>(), const std::vector<bool>& periodic_links_active = std::vector<bool>());
+  virtual void create_blocked(common::PE::CommPattern& cp, const VariablesDescriptor& vars, const std::vector< Uint >& node_connectivity, const std::vector< Uint >& starting_indices, Vector& solution, Vector& rhs, const std::vector<Uint>& periodic_links_nodes = std::vector<Uint>(), const std::vector<bool>& periodic_links_active = std::vector<bool>());
+
+  /// Deallocate underlying data
+  void destroy();
+
+  //@} END CREATION, DESTRUCTION AND COMPONENT SYSTEM
+
+  /// @name INDIVIDUAL ACCESS
+  //@{
+
+  /// Not available without stored entries
+  void set_value(const Uint icol, const Uint irow, const Real value);
+
+  /// Not available without stored entries
+  void add_value(const Uint icol, const Uint irow, const Real value);
+
+  /// Not available without stored entries
+  void get_value(const Uint icol, const Uint irow, Real& value);
+
+  //@} END INDIVIDUAL ACCESS
+
+  /// @name EFFICCIENT ACCESS
+  //@{
+
+  /// Not available without stored entries
+  void set_values(const BlockAccumulator& values);
+
+  /// Multiply the block with the current input vector, if the operator is being applied. Ignored otherwise.
+  void add_values(const BlockAccumulator& values);
+
+  /// Not available without stored entries
+  void get_values(BlockAccumulator& values);
+
+  /// Replace the row by diagval on the diagonal. Only offdiagval = 0 is supported.
+  void set_row(const Uint iblockrow, const Uint ieq, Real diagval, Real offdiagval);
+
+  /// Not available without stored entries
+  void get_column_and_replace_to_zero(const Uint iblockcol, Uint ieq, std::vector<Real>& values);
+
+  /// Replace the row by the identity and set the RHS to value. The column is kept, so symmetry is not preserved,
+  /// but the solution is the same.
+  void symmetric_dirichlet(const Uint blockrow, const Uint ieq, const Real value, Vector& rhs);
+
+  /// Not available without stored entries
+  void tie_blockrow_pairs (const Uint iblockrow_to, const Uint iblockrow_from);
+
+  /// Set the extra diagonal, added to the result of the action
+  void set_diagonal(const std::vector<Real>& diag);
+
+  /// Add to the extra diagonal
+  void add_diagonal(const std::vector<Real>& diag);
+
+  /// Get the diagonal, by executing the action once and keeping only the diagonal entries of each block
+  void get_diagonal(std::vector<Real>& diag);
+
+  /// Clear the extra diagonal and the dirichlet rows. Only a reset to 0 is possible.
+  void reset(Real reset_to=0.);
+
+  //@} END EFFICCIENT ACCESS
+
+  /// @name MISCELLANEOUS
+  //@{
+
+  /// Print to wherever
+  void print(common::LogStream& stream);
+
+  /// Print to wherever
+  void print(std::ostream& stream);
+
+  /// Print to file given by filename
+  void print(const std::string& filename, std::ios_base::openmode mode = std::ios_base::out );
+
+  /// Print the same information as print
+  void print_native(std::ostream& stream);
+
+  /// Accessor to the state of create
+  const bool is_created() { return m_is_created; }
+
+  /// Accessor to the number of equations
+  const Uint neq() { cf3_assert(m_is_created); return m_neq; }
+
+  /// Accessor to the number of block rows
+  const Uint blockrow_size() {  cf3_assert(m_is_created); return m_num_my_elements/neq(); }
+
+  /// Accessor to the number of block columns
+  const Uint blockcol_size() {  cf3_assert(m_is_created); return m_p2m.size()/neq(); }
+
+  /// The wrapped epetra operator
+  Teuchos::RCP<Epetra_Operator> epetra_operator()
+  {
+    return m_operator;
+  }
+
+  virtual Teuchos::RCP< const Thyra::LinearOpBase< Real > > thyra_operator() const;
+  virtual Teuchos::RCP< Thyra::LinearOpBase< Real > > thyra_operator();
+
+  /// Not available without stored entries
+  virtual void clone_to(Matrix &other);
+
+  /// Not available without stored entries
+  virtual void read_native(const common::URI& file);
+
+  //@} END MISCELLANEOUS
+
+  /// @name LINEAR ALGEBRA
+  //@{
+
+  /// Compute y = alpha*A*x + beta*y
+  void apply(const Handle<Vector>& y, const Handle<Vector const>& x, const Real alpha = 1., const Real beta = 0.);
+
+  /// Compute y = A*x for each vector of the epetra multivectors, both using the row map. y may not be the RHS of the system.
+  void apply_epetra(const Epetra_MultiVector& x, Epetra_MultiVector& y);
+
+  //@} END LINEAR ALGEBRA
+
+  /// @name TEST ONLY
+  //@{
+
+  /// Not available without stored entries
+  void debug_data(std::vector<Uint>& row_indices, std::vector<Uint>& col_indices, std::vector<Real>& values);
+
+  //@} END TEST ONLY
+
+private:
+
+  /// Execute the action, redirecting the additions to m_result, and restoring the RHS afterwards
+  void execute_action();
+
+  /// Throws the exception for the operations that need stored entries
+  void throw_not_available(const std::string& function) const;
+
+  /// epetra mpi environment
+  Epetra_MpiComm m_comm;
+
+  /// state of creation
+  bool m_is_created;
+
+  /// number of equations
+  Uint m_neq;
+
+  /// number of local elements (rows)
+  int m_num_my_elements;
+
+  /// mapper array, maps from process local numbering to matrix local numbering (because ghost nodes need to be ordered to the back)
+  std::vector<int> m_p2m;
+
+  /// a helper array used in add_values to avoid frequent new+free combo
+  std::vector<int> m_converted_indices;
+
+  /// Map of the owned rows, the same as the map of the vectors
+  Teuchos::RCP<Epetra_Map> m_row_map;
+
+  /// Map of all rows used locally, ghosts at the end
+  Teuchos::RCP<Epetra_Map> m_col_map;
+
+  /// Import of the input vector into m_x_col
+  Teuchos::RCP<Epetra_Import> m_importer;
+
+  /// Input vector, including the ghosts
+  Teuchos::RCP<Epetra_Vector> m_x_col;
+
+  /// Epetra interface to the operator
+  Teuchos::RCP<Epetra_Operator> m_operator;
+
+  /// Result of the additions during execute_action, null outside of it
+  Real* m_result;
+
+  /// If true, only the diagonal of each block is added to m_result, without multiplication
+  bool m_diagonal_only;
+
+  /// Extra diagonal, set through set_diagonal and add_diagonal
+  std::vector<Real> m_diagonal;
+
+  /// Rows that are replaced by a diagonal value (matrix local numbering)
+  std::map<int, Real> m_dirichlet_rows;
+
+  /// RHS of the system, restored after each execution of the action
+  Handle<TrilinosVector> m_rhs;
+  Teuchos::RCP<Epetra_Vector> m_rhs_backup;
+
+  /// The action that assembles the system
+  Handle<common::Action> m_action;
+}; // end of class TrilinosMatrixFree
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+} // namespace LSS
+} // namespace math
+} // namespace cf3
+
+#endif // cf3_Math_LSS_TrilinosMatrixFree_hpp
@@ -65,7 +65,7 @@ void VectorialFunction::clear()
   for(Uint i = 0; i < m_parsers.size(); i++) {
       delete_ptr(m_parsers[i]);
   }
-  vector<FunctionParser*>().swap(m_parsers);
+  vector<BatchFunctionParser*>().swap(m_parsers);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -156,7 +156,7 @@ void VectorialFunction::parse()
 
   for(Uint i = 0; i < m_functions.size(); ++i)
   {
-    FunctionParser* ptr = new FunctionParser();
+    BatchFunctionParser* ptr = new BatchFunctionParser();
     ptr->AddConstant("pi", Consts::pi());
     m_parsers.push_back(ptr);
 
@@ -185,8 +185,8 @@ RealVector& VectorialFunction::operator()( const VariablesT& var_values)
   cf3_assert(var_values.size() == m_nbvars);
 
   // evaluate and store the functions line by line in the result vector
-  std::vector<FunctionParser*>::const_iterator parser = m_parsers.begin();
-  std::vector<FunctionParser*>::const_iterator end = m_parsers.end();
+  std::vector<BatchFunctionParser*>::const_iterator parser = m_parsers.begin();
+  std::vector<BatchFunctionParser*>::const_iterator end = m_parsers.end();
   Uint i = 0;
   for( ; parser != end ; ++parser, ++i )
     m_result[i] = (*parser)->Eval(&var_values[0]);
@@ -202,8 +202,8 @@ RealVector& VectorialFunction::operator()( const RealVector& var_values)
   cf3_assert(var_values.size() == m_nbvars);
 
   // evaluate and store the functions line by line in the result vector
-  std::vector<FunctionParser*>::const_iterator parser = m_parsers.begin();
-  std::vector<FunctionParser*>::const_iterator end = m_parsers.end();
+  std::vector<BatchFunctionParser*>::const_iterator parser = m_parsers.begin();
+  std::vector<BatchFunctionParser*>::const_iterator end = m_parsers.end();
   Uint i = 0;
   for( ; parser != end ; ++parser, ++i )
     m_result[i] = (*parser)->Eval(&var_values[0]);
@@ -213,6 +213,23 @@ RealVector& VectorialFunction::operator()( const RealVector& var_values)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void VectorialFunction::evaluate_batch(const RealMatrix& var_values, RealMatrix& ret_values) const
+{
+  cf3_assert(m_is_parsed);
+  cf3_assert(var_values.cols() == m_nbvars);
+
+  const Uint nb_points = var_values.rows();
+  ret_values.resize(nb_points, m_parsers.size());
+  if(nb_points == 0)
+    return;
+
+  // Both matrices are column major, so each variable and each result is a contiguous column
+  for(Uint i = 0; i != m_parsers.size(); ++i)
+    m_parsers[i]->eval_batch(var_values.data(), nb_points, 1, nb_points, ret_values.col(i).data(), 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 } // math
 } // cf3
 
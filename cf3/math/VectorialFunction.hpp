@@ -9,10 +9,9 @@
 
 ////////////////////////////////////////////////////////////////////////////////
 
-#include "fparser/fparser.hh"
-
 #include "common/BasicExceptions.hpp"
 
+#include "math/BatchFunctionParser.hpp"
 #include "math/LibMath.hpp"
 #include "math/MatrixTypes.hpp"
 
@@ -71,6 +70,12 @@ public: // functions
   /// @param var_values values of the variables to substitute in the function.
   RealVector& operator()(const RealVector& var_values);
 
+  /// Evaluate the Vectorial Function for many points at once, which is much faster than
+  /// calling evaluate() for each point.
+  /// @param var_values one row with the values of the variables for each point
+  /// @param ret_values one row with the values of the functions for each point, resized if needed
+  void evaluate_batch(const RealMatrix& var_values, RealMatrix& ret_values) const;
+
   /// @return if the VectorialFunctionParser has been parsed yet.
   bool is_parsed() const { return m_is_parsed; }
 
@@ -120,7 +125,7 @@ private: // data
   std::vector<std::string> m_functions;
 
   /// vector holding the parsers, one for each entry in the vector
-  std::vector<FunctionParser*> m_parsers;
+  std::vector<BatchFunctionParser*> m_parsers;
 
   /// storage of the result for using the class as functor
   RealVector m_result;
@@ -136,8 +141,8 @@ void VectorialFunction::evaluate(const var_t& var_values, ret_t& ret_value) cons
   cf3_assert(var_values.size() == m_nbvars);
 
   // evaluate and store the functions line by line in the vector
-  std::vector<FunctionParser*>::const_iterator parser = m_parsers.begin();
-  std::vector<FunctionParser*>::const_iterator end = m_parsers.end();
+  std::vector<BatchFunctionParser*>::const_iterator parser = m_parsers.begin();
+  std::vector<BatchFunctionParser*>::const_iterator end = m_parsers.end();
   for(Uint i=0 ; parser != end ; ++parser, ++i )
   {
     // It is possible this function signals a FloatingPointException (FPE)
@@ -0,0 +1,313 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+
+#include <boost/filesystem/operations.hpp>
+
+#include "common/BasicExceptions.hpp"
+#include "common/Foreach.hpp"
+#include "common/PE/Comm.hpp"
+#include "common/StringConversion.hpp"
+
+#include "mesh/DistributedFileReader.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace cf3 {
+namespace mesh {
+
+  using namespace common;
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace detail
+{
+  /// Orders node indices by their position in the file
+  struct FileIdxLess
+  {
+    FileIdxLess(const std::vector<Uint>& file_idx) : m_file_idx(file_idx) {}
+    bool operator()(const Uint a, const Uint b) const { return m_file_idx[a] < m_file_idx[b]; }
+    const std::vector<Uint>& m_file_idx;
+  };
+
+  template <typename T>
+  void permute(std::vector<T>& values, const std::vector<Uint>& order, const Uint stride)
+  {
+    std::vector<T> sorted(values.size());
+    for (Uint i=0; i<order.size(); ++i)
+      std::copy(values.begin()+order[i]*stride, values.begin()+(order[i]+1)*stride, sorted.begin()+i*stride);
+    values.swap(sorted);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void NodeRecords::add(const Uint idx, const Uint nb, const Uint owner, const Real* coords)
+{
+  file_idx.push_back(idx);
+  number.push_back(nb);
+  part.push_back(owner);
+  coordinates.insert(coordinates.end(), coords, coords+dimension);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void NodeRecords::sort_by_file_idx()
+{
+  std::vector<Uint> order(size());
+  for (Uint i=0; i<order.size(); ++i)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), detail::FileIdxLess(file_idx));
+  detail::permute(file_idx, order, 1);
+  detail::permute(number, order, 1);
+  detail::permute(part, order, 1);
+  detail::permute(coordinates, order, dimension);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+DistributedFileReader::DistributedFileReader(const boost::filesystem::path& path)
+{
+  if( !boost::filesystem::exists(path) )
+    throw boost::filesystem::filesystem_error( path.string() + " does not exist", boost::system::error_code() );
+  m_size = boost::filesystem::file_size(path);
+  m_file.open(path, std::ios_base::in | std::ios_base::binary);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+DistributedFileReader::Position DistributedFileReader::first_line_from(const Position position, const Position end)
+{
+  if (position == 0)
+    return 0;
+  m_file.clear();
+  m_file.seekg(static_cast<std::streamoff>(position-1), std::ios::beg);
+  std::string rest_of_line;
+  getline(m_file, rest_of_line);
+  return std::min(end, position + rest_of_line.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+DistributedFileReader::Position DistributedFileReader::next_line(const Position line)
+{
+  m_file.clear();
+  m_file.seekg(static_cast<std::streamoff>(line), std::ios::beg);
+  std::string text;
+  getline(m_file, text);
+  return std::min(m_size, line + text.size() + 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void DistributedFileReader::find_markers(const std::vector<std::string>& markers, std::vector< std::vector<Position> >& positions)
+{
+  const Position nb_ranks = PE::Comm::instance().size();
+  const Position rank = PE::Comm::instance().rank();
+  const Position share_begin = m_size * rank / nb_ranks;
+  const Position share_end = m_size * (rank+1) / nb_ranks;
+
+  // pairs of (marker, position) found by this rank
+  std::vector<Position> found;
+  std::string line;
+  Position pos = first_line_from(share_begin, share_end);
+  m_file.clear();
+  m_file.seekg(static_cast<std::streamoff>(pos), std::ios::beg);
+  while (pos < share_end && getline(m_file, line))
+  {
+    for (Uint m=0; m<markers.size(); ++m)
+    {
+      if (line.find(markers[m]) != std::string::npos)
+      {
+        found.push_back(m);
+        found.push_back(pos);
+        break;
+      }
+    }
+    pos += line.size() + 1;
+  }
+
+  std::vector< std::vector<Position> > found_on_rank;
+  PE::Comm::instance().all_gather(found, found_on_rank);
+
+  positions.assign(markers.size(), std::vector<Position>());
+  for (Uint r=0; r<found_on_rank.size(); ++r)
+    for (Uint i=0; i<found_on_rank[r].size(); i+=2)
+      positions[found_on_rank[r][i]].push_back(found_on_rank[r][i+1]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Uint DistributedFileReader::read_records(const Position begin, const Position end, std::vector<std::string>& records,
+                                         bool (*is_continuation)(const std::string&))
+{
+  const Position nb_ranks = PE::Comm::instance().size();
+  const Position rank = PE::Comm::instance().rank();
+  const Position share_begin = begin + (end-begin) * rank / nb_ranks;
+  const Position share_end = begin + (end-begin) * (rank+1) / nb_ranks;
+
+  records.clear();
+  std::string line;
+  Position pos = share_begin == begin ? begin : first_line_from(share_begin, share_end);
+  m_file.clear();
+  m_file.seekg(static_cast<std::streamoff>(pos), std::ios::beg);
+
+  // Records starting in the share of this rank. Leading continuation lines belong to a record of the previous rank.
+  while (pos < share_end && getline(m_file, line))
+  {
+    pos += line.size() + 1;
+    if (is_continuation && is_continuation(line))
+    {
+      if (records.size())
+        records.back() += " " + line;
+    }
+    else
+    {
+      records.push_back(line);
+    }
+  }
+
+  // The last record may continue beyond the share
+  if (is_continuation && records.size())
+  {
+    while (pos < end && getline(m_file, line) && is_continuation(line))
+    {
+      pos += line.size() + 1;
+      records.back() += " " + line;
+    }
+  }
+
+  // Index of the first record: the number of records read by the lower ranks
+  std::vector<Uint> nb_records_on_rank;
+  PE::Comm::instance().all_gather(static_cast<Uint>(records.size()), nb_records_on_rank);
+  Uint first_record = 0;
+  for (Uint r=0; r<rank; ++r)
+    first_record += nb_records_on_rank[r];
+  return first_record;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void DistributedFileReader::distribute_nodes(const NodeRecords& read_nodes, const std::vector<Uint>& needed_numbers, NodeRecords& local_nodes)
+{
+  enum { OWNER=1, DIRECTORY=2 };
+  const Uint nb_ranks = PE::Comm::instance().size();
+  const Uint dim = read_nodes.dimension;
+
+  // 1) Send every node to its owner and to the directory rank of its number, as (role, file_idx, number, part)
+  std::vector< std::vector<Uint> > send_idx(nb_ranks);
+  std::vector< std::vector<Real> > send_coords(nb_ranks);
+  for (Uint n=0; n<read_nodes.size(); ++n)
+  {
+    const Uint owner = read_nodes.part[n];
+    const Uint directory = read_nodes.number[n] % nb_ranks;
+    for (Uint i=0; i<2; ++i)
+    {
+      const Uint dest = i==0 ? owner : directory;
+      if (i==1 && dest == owner)
+        break;
+      const Uint role = (dest==owner ? OWNER : 0) | (dest==directory ? DIRECTORY : 0);
+      send_idx[dest].push_back(role);
+      send_idx[dest].push_back(read_nodes.file_idx[n]);
+      send_idx[dest].push_back(read_nodes.number[n]);
+      send_idx[dest].push_back(owner);
+      send_coords[dest].insert(send_coords[dest].end(), read_nodes.coordinates.begin()+n*dim, read_nodes.coordinates.begin()+(n+1)*dim);
+    }
+  }
+  std::vector< std::vector<Uint> > recv_idx;
+  std::vector< std::vector<Real> > recv_coords;
+  PE::Comm::instance().all_to_all(send_idx, recv_idx);
+  PE::Comm::instance().all_to_all(send_coords, recv_coords);
+
+  local_nodes = NodeRecords(dim);
+  NodeRecords directory(dim);
+  std::map<Uint,Uint> directory_idx;
+  for (Uint r=0; r<nb_ranks; ++r)
+  {
+    for (Uint i=0, c=0; i<recv_idx[r].size(); i+=4, c+=dim)
+    {
+      if (recv_idx[r][i] & OWNER)
+        local_nodes.add(recv_idx[r][i+1], recv_idx[r][i+2], recv_idx[r][i+3], &recv_coords[r][c]);
+      if (recv_idx[r][i] & DIRECTORY)
+      {
+        directory_idx[recv_idx[r][i+2]] = directory.size();
+        directory.add(recv_idx[r][i+1], recv_idx[r][i+2], recv_idx[r][i+3], &recv_coords[r][c]);
+      }
+    }
+  }
+
+  // 2) Ask the directory for the needed nodes that are owned by another part
+  std::vector<Uint> owned_numbers(local_nodes.number);
+  std::sort(owned_numbers.begin(), owned_numbers.end());
+  std::vector<Uint> ghost_numbers;
+  std::set_difference(needed_numbers.begin(), needed_numbers.end(), owned_numbers.begin(), owned_numbers.end(), std::back_inserter(ghost_numbers));
+
+  std::vector< std::vector<Uint> > send_requests(nb_ranks);
+  for (Uint n=0; n<ghost_numbers.size(); ++n)
+    send_requests[ghost_numbers[n] % nb_ranks].push_back(ghost_numbers[n]);
+  std::vector< std::vector<Uint> > recv_requests;
+  PE::Comm::instance().all_to_all(send_requests, recv_requests);
+
+  // 3) Reply with the requested nodes, as (file_idx, number, part)
+  Uint nb_missing = 0;
+  Uint missing_number = 0;
+  for (Uint r=0; r<nb_ranks; ++r)
+  {
+    send_idx[r].clear();
+    send_coords[r].clear();
+    boost_foreach(const Uint number, recv_requests[r])
+    {
+      std::map<Uint,Uint>::const_iterator it = directory_idx.find(number);
+      if (it == directory_idx.end())
+      {
+        missing_number = number;
+        ++nb_missing;
+        continue;
+      }
+      const Uint n = it->second;
+      send_idx[r].push_back(directory.file_idx[n]);
+      send_idx[r].push_back(directory.number[n]);
+      send_idx[r].push_back(directory.part[n]);
+      send_coords[r].insert(send_coords[r].end(), directory.coordinates.begin()+n*dim, directory.coordinates.begin()+(n+1)*dim);
+    }
+  }
+  const Uint total_missing = global_sum(nb_missing);
+  if (total_missing != 0)
+    throw ParsingFailed(FromHere(), to_str(total_missing)+" nodes are used by an element, but are not defined in the file"
+                        + (nb_missing != 0 ? " (e.g. node "+to_str(missing_number)+")" : std::string()));
+
+  PE::Comm::instance().all_to_all(send_idx, recv_idx);
+  PE::Comm::instance().all_to_all(send_coords, recv_coords);
+
+  for (Uint r=0; r<nb_ranks; ++r)
+    for (Uint i=0, c=0; i<recv_idx[r].size(); i+=3, c+=dim)
+      local_nodes.add(recv_idx[r][i], recv_idx[r][i+1], recv_idx[r][i+2], &recv_coords[r][c]);
+
+  local_nodes.sort_by_file_idx();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Uint DistributedFileReader::global_sum(const Uint value)
+{
+  PE::Comm& comm = PE::Comm::instance();
+  if (!comm.is_active())
+    return value;
+
+  Uint result;
+  comm.all_reduce(PE::plus(), &value, 1, &result);
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // mesh
+} // cf3
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,110 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#ifndef cf3_mesh_DistributedFileReader_hpp
+#define cf3_mesh_DistributedFileReader_hpp
+
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/noncopyable.hpp>
+
+#include "mesh/LibMesh.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace cf3 {
+namespace mesh {
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Nodes read from a mesh file, stored column by column: their index in the node section of the file, their
+/// number as used by the element records, the part that owns them and their coordinates
+struct Mesh_API NodeRecords
+{
+  NodeRecords(const Uint dim = 0) : dimension(dim) {}
+
+  Uint size() const { return file_idx.size(); }
+
+  void add(const Uint idx, const Uint nb, const Uint owner, const Real* coords);
+
+  /// Put the nodes in the order of the file, which is the order used by the serial readers
+  void sort_by_file_idx();
+
+  Uint dimension;
+  std::vector<Uint> file_idx;
+  std::vector<Uint> number;
+  std::vector<Uint> part;
+  std::vector<Real> coordinates;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Reads an ASCII mesh file with all ranks of the communicator together, so that every byte of the node and element
+/// sections is parsed by a single rank. The sections of the file are located with find_markers, after which
+/// read_records gives every rank the records that start in its share of the bytes of a section. The records then
+/// have to be sent to the part that owns them; distribute_nodes does this for the nodes, including the ghost nodes
+/// used by the elements of each part.
+/// All functions are collective.
+class Mesh_API DistributedFileReader : public boost::noncopyable
+{
+public:
+
+  typedef boost::uint64_t Position;
+
+  DistributedFileReader(const boost::filesystem::path& path);
+
+  /// Size of the file in bytes
+  Position size() const { return m_size; }
+
+  /// Find the lines containing one of the markers, each rank scanning an equal share of the file.
+  /// A line is attributed to the first marker it contains.
+  /// @param [out] positions Start of every line containing markers[m], in increasing order, on all ranks
+  void find_markers(const std::vector<std::string>& markers, std::vector< std::vector<Position> >& positions);
+
+  /// Read the records of the section [begin,end) that start in the share of this rank. A record is one line,
+  /// followed by the lines for which is_continuation returns true, which are appended to it.
+  /// @param begin Start of the first record line
+  /// @param end Start of the line following the section
+  /// @return Index in the section of the first record read by this rank
+  Uint read_records(const Position begin, const Position end, std::vector<std::string>& records,
+                    bool (*is_continuation)(const std::string&) = 0);
+
+  /// Start of the line following the given line
+  Position next_line(const Position line);
+
+  /// Send every node read by this rank to the part owning it, and fetch the nodes with the needed numbers from the
+  /// ranks that read them. The node numbers are spread over the ranks in a directory, so they don't have to be
+  /// consecutive.
+  /// @param [in] read_nodes Nodes read by this rank, with their owner filled in
+  /// @param [in] needed_numbers Numbers of the nodes used by the elements of this part, in increasing order
+  /// @param [out] local_nodes Nodes owned by this part followed by the other needed nodes, in the order of the file
+  /// Throws ParsingFailed on all ranks if an element uses a node that is not defined in the file.
+  static void distribute_nodes(const NodeRecords& read_nodes, const std::vector<Uint>& needed_numbers, NodeRecords& local_nodes);
+
+  /// Sum of value over all ranks, also without MPI. Errors found by a single rank are counted and summed with this
+  /// before the next exchange, so that all ranks throw instead of leaving the others waiting in the exchange.
+  static Uint global_sum(const Uint value);
+
+private:
+
+  /// First line starting at or after the given position, or end if there is none before end
+  Position first_line_from(const Position position, const Position end);
+
+  boost::filesystem::ifstream m_file;
+  Position m_size;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // mesh
+} // cf3
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // cf3_mesh_DistributedFileReader_hpp
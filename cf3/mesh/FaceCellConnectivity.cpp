@@ -4,6 +4,11 @@
 // GNU Lesser General Public License version 3 (LGPLv3).
 // See doc/lgpl.txt and doc/gpl.txt for the license text.
 
+#include <algorithm>
+
+#include <boost/cstdint.hpp>
+#include <boost/thread/thread.hpp>
+
 #include "common/Log.hpp"
 #include "common/OptionList.hpp"
 #include "common/OptionT.hpp"
@@ -17,6 +22,7 @@
 #include "math/Consts.hpp"
 
 #include "mesh/FaceCellConnectivity.hpp"
+#include "mesh/FaceHashTable.hpp"
 #include "mesh/NodeElementConnectivity.hpp"
 #include "mesh/Dictionary.hpp"
 #include "mesh/Mesh.hpp"
@@ -39,6 +45,123 @@ common::ComponentBuilder < FaceCellConnectivity , Component, LibMesh > FaceCellC
 
 ////////////////////////////////////////////////////////////////////////////////
 
+namespace detail
+{
+
+/// Element block used to build the faces
+struct FaceBuildBlock
+{
+  Elements* elements;
+  const Connectivity* connectivity;
+  /// Elements of the block whose faces are built
+  std::vector<Uint> elems;
+  /// For each face of the element type, the element nodes it consists of
+  std::vector< std::vector<Uint> > face_nodes;
+  /// Index of the first face occurrence of this block
+  Uint begin;
+
+  Uint nb_occurrences() const { return elems.size() * face_nodes.size(); }
+
+  /// One past the last face occurrence of this block
+  Uint end() const { return begin + nb_occurrences(); }
+
+  /// Copy the nodes of a face occurrence of this block to nodes, returning the number of nodes
+  Uint nodes(const Uint occurrence, Uint* nodes) const
+  {
+    const Uint local_occurrence = occurrence - begin;
+    const std::vector<Uint>& local_nodes = face_nodes[local_occurrence % face_nodes.size()];
+    const Connectivity::ConstRow elem_nodes = (*connectivity)[elems[local_occurrence / face_nodes.size()]];
+    const Uint nb_nodes = local_nodes.size();
+    for (Uint i = 0; i != nb_nodes; ++i)
+      nodes[i] = elem_nodes[local_nodes[i]];
+    return nb_nodes;
+  }
+};
+
+/// Computes the hash of the faces occurrences in a range
+struct FaceHashWorker
+{
+  FaceHashWorker(const std::vector<FaceBuildBlock>& blocks, std::vector<Uint>& hashes, const Uint key_width, const Uint begin, const Uint end) :
+    m_blocks(blocks),
+    m_hashes(hashes),
+    m_key_width(key_width),
+    m_begin(begin),
+    m_end(end)
+  {
+  }
+
+  void operator()()
+  {
+    std::vector<Uint> nodes(m_key_width);
+    Uint block_idx = 0;
+    for (Uint occurrence = m_begin; occurrence != m_end; ++occurrence)
+    {
+      while (occurrence >= m_blocks[block_idx].end())
+        ++block_idx;
+      const Uint nb_nodes = m_blocks[block_idx].nodes(occurrence, &nodes[0]);
+      m_hashes[occurrence] = FaceHashTable::make_key(&nodes[0], nb_nodes);
+    }
+  }
+
+  const std::vector<FaceBuildBlock>& m_blocks;
+  std::vector<Uint>& m_hashes;
+  const Uint m_key_width;
+  const Uint m_begin;
+  const Uint m_end;
+};
+
+/// For each face occurrence with a hash in the given partition, finds the first occurrence of the same face.
+/// Each partition has its own hash table, so partitions can be handled concurrently.
+struct FaceMatchWorker
+{
+  FaceMatchWorker(const std::vector<FaceBuildBlock>& blocks, const std::vector<Uint>& hashes, const Uint key_width, const Uint partition, const Uint nb_partitions, std::vector<Uint>& first_occurrence) :
+    m_blocks(blocks),
+    m_hashes(hashes),
+    m_key_width(key_width),
+    m_partition(partition),
+    m_nb_partitions(nb_partitions),
+    m_first_occurrence(first_occurrence)
+  {
+  }
+
+  /// Partition of a hash, taken from the high bits since the hash table uses the low bits
+  static Uint partition(const Uint hash, const Uint nb_partitions)
+  {
+    return static_cast<Uint>((static_cast<boost::uint64_t>(hash) * nb_partitions) >> 32);
+  }
+
+  void operator()()
+  {
+    const Uint nb_occurrences = m_hashes.size();
+    // Interior faces occur twice, so about half of the occurrences are distinct faces
+    FaceHashTable table(m_key_width, nb_occurrences / (2 * m_nb_partitions));
+    std::vector<Uint> nodes(m_key_width);
+    Uint block_idx = 0;
+    for (Uint occurrence = 0; occurrence != nb_occurrences; ++occurrence)
+    {
+      const Uint hash = m_hashes[occurrence];
+      if (m_nb_partitions != 1 && partition(hash, m_nb_partitions) != m_partition)
+        continue;
+      while (occurrence >= m_blocks[block_idx].end())
+        ++block_idx;
+      const Uint nb_nodes = m_blocks[block_idx].nodes(occurrence, &nodes[0]);
+      std::sort(nodes.begin(), nodes.begin() + nb_nodes);
+      m_first_occurrence[occurrence] = table.insert(&nodes[0], nb_nodes, hash, occurrence);
+    }
+  }
+
+  const std::vector<FaceBuildBlock>& m_blocks;
+  const std::vector<Uint>& m_hashes;
+  const Uint m_key_width;
+  const Uint m_partition;
+  const Uint m_nb_partitions;
+  std::vector<Uint>& m_first_occurrence;
+};
+
+} // detail
+
+////////////////////////////////////////////////////////////////////////////////
+
 FaceCellConnectivity::FaceCellConnectivity ( const std::string& name ) :
   Component(name),
   m_nb_faces(0),
@@ -49,6 +172,10 @@ FaceCellConnectivity::FaceCellConnectivity ( const std::string& name ) :
       .link_to(&m_face_building_algorithm)
       .description("Improves efficiency for face building algorithm");
 
+  options().add("threads", 1u)
+      .pretty_name("Threads")
+      .description("Number of threads used to match the faces. Each MPI process starts its own threads, so keep this at 1 when running one process per core. 0 uses all hardware threads.");
+
   m_used_components = create_static_component<Group>("used_components");
   m_connectivity = create_static_component<common::Table<Entity> >(mesh::Tags::connectivity_table());
   m_face_nb_in_elem = create_static_component<common::Table<Uint> >("face_number");
@@ -117,32 +244,6 @@ void FaceCellConnectivity::build_connectivity()
     return;
   }
 
-  // declartions
-  m_connectivity->resize(0);
-  common::Table<Entity>::Buffer f2c = m_connectivity->create_buffer();
-  common::Table<Uint>::Buffer face_number = m_face_nb_in_elem->create_buffer();
-  common::List<bool>::Buffer is_bdry_face = m_is_bdry_face->create_buffer();
-  common::Table<Uint>::Buffer cell_rotation = m_cell_rotation->create_buffer();
-  common::Table<bool>::Buffer cell_orientation = m_cell_orientation->create_buffer();
-
-  Dictionary& geometry_fields = find_parent_component<Mesh>(*used()[0]).geometry_fields();
-  Uint tot_nb_nodes = geometry_fields.size();
-  std::vector < std::vector<Uint> > mapNodeFace(tot_nb_nodes);
-  std::vector<Uint> face_nodes;  face_nodes.reserve(100);
-  std::vector<Entity> dummy_element_row(2);
-  std::vector<Uint> tmp_row(2);
-  Uint max_nb_faces(0);
-
-  // calculate max_nb_faces
-  boost_foreach ( Handle< Component > elements_comp, used() )
-  {
-    Handle<Elements> elements(elements_comp);
-    if (elements->element_type().dimensionality() != elements->element_type().dimension() )
-      continue;
-    const Uint nb_faces = elements->element_type().nb_faces();
-    max_nb_faces += nb_faces * elements->size() ;
-  }
-
   if (m_face_building_algorithm)
   {
     // allocate storage if doesn't exist that says if the element is at the boundary of a region
@@ -165,178 +266,168 @@ void FaceCellConnectivity::build_connectivity()
     }
   }
 
-  // Declarations to save frequent allocations in the loop algorithm
-  Uint nb_inner_faces = 0;
-  Uint nb_matched_nodes = 1;
-  Uint face_node_idx;
-  Uint face_node;
-  Uint face;
-  Uint connected_face;
-  Uint node;
-  Uint nb_nodes;
-  bool found_face = false;
-  Handle< Component > elem_location_comp;
-  Uint elem_location_idx;
-
-  // loop over the element types
-  m_nb_faces=0;
+  // Collect the element blocks. Each face of each element is a face occurrence, numbered block by block.
+  std::vector<detail::FaceBuildBlock> blocks;
+  Uint nb_occurrences = 0;
+  Uint key_width = 1;
   boost_foreach (Handle< Component > elements_comp, used() )
   {
     Elements& elements = dynamic_cast<Elements&>(*elements_comp);
-    const Uint nb_faces_in_elem = elements.element_type().nb_faces();
+    const ElementType& etype = elements.element_type();
+
+    blocks.push_back(detail::FaceBuildBlock());
+    detail::FaceBuildBlock& block = blocks.back();
+    block.elements = &elements;
+    block.connectivity = &elements.geometry_space().connectivity();
+    block.begin = nb_occurrences;
+    block.face_nodes.resize(etype.nb_faces());
+    for (Uint face_idx = 0; face_idx != etype.nb_faces(); ++face_idx)
+    {
+      boost_foreach(const Uint face_node_idx, etype.faces().nodes_range(face_idx))
+        block.face_nodes[face_idx].push_back(face_node_idx);
+      key_width = std::max(key_width, static_cast<Uint>(block.face_nodes[face_idx].size()));
+    }
 
     Handle< common::List<bool> > is_bdry_elem;
-
     if (m_face_building_algorithm)
       is_bdry_elem = Handle< common::List<bool> >(elements.get_child("is_bdry"));
 
-    // loop over the elements of this type
-    Uint loc_elem_idx=0;
-    boost_foreach(Connectivity::ConstRow elem_nodes, elements.geometry_space().connectivity().array() )
+    const Uint nb_elems = elements.size();
+    block.elems.reserve(nb_elems);
+    for (Uint e = 0; e != nb_elems; ++e)
     {
-      if ( is_not_null(is_bdry_elem) )
-        if ( (*is_bdry_elem)[loc_elem_idx] == false )
-          continue;
+      if ( is_null(is_bdry_elem) || (*is_bdry_elem)[e] )
+        block.elems.push_back(e);
+    }
+    nb_occurrences += block.nb_occurrences();
+  }
 
-      Entity element(elements,loc_elem_idx);
+  const Uint configured_threads = options().value<Uint>("threads");
+  const Uint nb_threads = std::max(1u, std::min(nb_occurrences, configured_threads == 0 ? boost::thread::hardware_concurrency() : configured_threads));
 
-      // loop over the faces in the current element
-      for (Uint face_idx = 0; face_idx != nb_faces_in_elem; ++face_idx)
-      {
-        // construct sets of nodes that make the corresponding face in this element
-        nb_nodes = elements.element_type().face_type(face_idx).nb_nodes();
-        face_nodes.resize(nb_nodes);
+  // Hash the sorted nodes of each face occurrence, splitting the occurrences over the threads
+  std::vector<Uint> hashes(nb_occurrences);
+  if (nb_threads == 1)
+  {
+    detail::FaceHashWorker(blocks, hashes, key_width, 0, nb_occurrences)();
+  }
+  else
+  {
+    boost::thread_group threads;
+    for (Uint i = 0; i != nb_threads; ++i)
+      threads.create_thread(detail::FaceHashWorker(blocks, hashes, key_width, (nb_occurrences / nb_threads) * i + std::min(i, nb_occurrences % nb_threads),
+                                                   (nb_occurrences / nb_threads) * (i+1) + std::min(i+1, nb_occurrences % nb_threads)));
+    threads.join_all();
+  }
 
-        Uint i(0);
-        boost_foreach(const Uint face_node_idx, elements.element_type().faces().nodes_range(face_idx))
-            face_nodes[i++] = elem_nodes[face_node_idx];
+  // Find the first occurrence of each face. Each thread handles the faces with hashes in its own partition,
+  // visiting the occurrences in order, so the result does not depend on the number of threads.
+  std::vector<Uint> first_occurrence(nb_occurrences);
+  if (nb_threads == 1)
+  {
+    detail::FaceMatchWorker(blocks, hashes, key_width, 0, 1, first_occurrence)();
+  }
+  else
+  {
+    boost::thread_group threads;
+    for (Uint i = 0; i != nb_threads; ++i)
+      threads.create_thread(detail::FaceMatchWorker(blocks, hashes, key_width, i, nb_threads, first_occurrence));
+    threads.join_all();
+  }
+  std::vector<Uint>().swap(hashes);
 
+  // Faces are numbered in the order of their first occurrence
+  m_nb_faces = 0;
+  for (Uint occurrence = 0; occurrence != nb_occurrences; ++occurrence)
+  {
+    if (first_occurrence[occurrence] == occurrence)
+      ++m_nb_faces;
+  }
 
-        // consider the first node belonging to the current face
-        // check if you find a face ID shared between all the other
-        // nodes building a face
-        node = face_nodes[0];
-        cf3_assert(node<tot_nb_nodes);
+  common::Table<Entity>& f2c = *m_connectivity;
+  common::Table<Uint>& face_number = *m_face_nb_in_elem;
+  common::List<bool>& is_bdry_face = *m_is_bdry_face;
+  common::Table<Uint>& cell_rotation = *m_cell_rotation;
+  common::Table<bool>& cell_orientation = *m_cell_orientation;
+  f2c.resize(0);
+  f2c.resize(m_nb_faces);
+  face_number.resize(m_nb_faces);
+  is_bdry_face.resize(m_nb_faces);
+  cell_rotation.resize(m_nb_faces);
+  cell_orientation.resize(m_nb_faces);
+
+  // first_occurrence is overwritten with the face index of each occurrence
+  std::vector<Uint> face_nodes(key_width);
+  Uint nb_inner_faces = 0;
+  Uint face = 0;
+  Uint block_idx = 0;
+  for (Uint occurrence = 0; occurrence != nb_occurrences; ++occurrence)
+  {
+    while (occurrence >= blocks[block_idx].end())
+      ++block_idx;
+    const detail::FaceBuildBlock& block = blocks[block_idx];
+    const Uint local_occurrence = occurrence - block.begin;
+    const Entity element(*block.elements, block.elems[local_occurrence / block.face_nodes.size()]);
+    const Uint face_idx = local_occurrence % block.face_nodes.size();
+
+    if (first_occurrence[occurrence] == occurrence)
+    {
+      // a new face has been found
+      first_occurrence[occurrence] = face;
+      f2c[face][0] = element;
+      face_number[face][0] = face_idx;
+      face_number[face][1] = 0;
+      cell_orientation[face][0] = MATCHED;
+      cell_orientation[face][1] = INVERTED;
+      cell_rotation[face][0] = 0;
+      cell_rotation[face][1] = 0;
+      is_bdry_face[face] = true;
+      ++face;
+      continue;
+    }
 
-        found_face = false;
-        // search for matching face if they are registered to the node yet
-        boost_foreach( face, mapNodeFace[node] )
-        {
-          nb_matched_nodes = 1;
-          if (nb_nodes > 1)
-          {
-            for (face_node_idx=1; face_node_idx!=nb_nodes; ++face_node_idx)
-            {
-              boost_foreach (connected_face, mapNodeFace[face_nodes[face_node_idx]])
-              {
-                if (connected_face == face)
-                {
-                  ++nb_matched_nodes;
-                  break;
-                }
-              }
-
-
-              if (nb_matched_nodes == nb_nodes) // face matches the nodes
-              {
-                // the corresponding face already exists, meaning
-                // that the face is an internal one, shared by two elements
-                // here you set the second element (==state) neighbor of the face
-                found_face = true;
-                f2c.get_row(face)[1]=element;
-                face_number.get_row(face)[1]=face_idx;
-                // since it has two neighbor cells,
-                // this face is surely NOT a boundary face
-                is_bdry_face.get_row(face)=false;
-
-                // First node in first face element:
-                Uint first_node_loc_idx = f2c.get_row(face)[0].get_nodes()[
-                                            f2c.get_row(face)[0].element_type().faces().nodes_range(
-                                              face_number.get_row(face)[0])[0]
-                                          ];
-
-                // Find orientation ( or find match between first face-nodes of both neighbouring elements )
-                Uint rotation;
-                for (rotation=0; rotation<=nb_nodes; ++rotation)
-                {
-                  if (face_nodes[rotation] == first_node_loc_idx)
-                  {
-                    cell_rotation.get_row(face)[1]=rotation;
-                    break;
-                  }
-                }
-                // Following assertion fails, it means the correct orientation was not found! This should never happen!
-                cf3_always_assert(rotation != nb_nodes);
-
-                // increment number of inner faces (they always have 2 states)
-                ++nb_inner_faces;
-                break;
-              }
-            }
-          }
-          else // this only applies to the 1D case
-          {
-            // the corresponding faceID already exists, meaning
-            // that the face is an internal one, shared by two elements
-            // here you set the second element (==state) neighbor of the face
-            found_face = true;
-            //(*elem_to_face)[elemID][iFace] = currFaceID;
-            f2c.get_row(face)[1]=element;
-            face_number.get_row(face)[1]=face_idx;
-            is_bdry_face.get_row(face)=false;
-
-            // increment number of inner faces (they always have 2 states)
-            ++nb_inner_faces;
-            break;
-          }
-        }
-        if (found_face == false)
+    // the corresponding face already exists, meaning
+    // that the face is an internal one, shared by two elements
+    const Uint matched_face = first_occurrence[first_occurrence[occurrence]];
+    first_occurrence[occurrence] = matched_face;
+    f2c[matched_face][1] = element;
+    face_number[matched_face][1] = face_idx;
+    // since it has two neighbor cells,
+    // this face is surely NOT a boundary face
+    is_bdry_face[matched_face] = false;
+
+    const Uint nb_nodes = block.nodes(occurrence, &face_nodes[0]);
+    if (nb_nodes > 1)
+    {
+      // First node in first face element:
+      const Entity first_element = f2c[matched_face][0];
+      const Uint first_node_loc_idx = first_element.get_nodes()[
+                                        first_element.element_type().faces().nodes_range(
+                                          face_number[matched_face][0])[0]
+                                      ];
+
+      // Find orientation ( or find match between first face-nodes of both neighbouring elements )
+      Uint rotation;
+      for (rotation=0; rotation!=nb_nodes; ++rotation)
+      {
+        if (face_nodes[rotation] == first_node_loc_idx)
         {
-          // a new face has been found
-          // add the ID of the new face in the corresponding nodes
-          // referencing it
-          boost_foreach (face_node, face_nodes)
-          {
-            mapNodeFace[face_node].push_back(m_nb_faces);
-          }
-
-          // increment the number of faces
-          dummy_element_row[0]=element;
-          f2c.add_row(dummy_element_row);
-
-          tmp_row[0]=face_idx;
-          face_number.add_row(tmp_row);
-          tmp_row[0] = MATCHED;
-          tmp_row[1] = INVERTED;
-          cell_orientation.add_row(tmp_row);
-          tmp_row[0] = 0;
-          tmp_row[1] = 0;
-          cell_rotation.add_row(tmp_row);
-          is_bdry_face.add_row(true);
-          ++m_nb_faces;
+          cell_rotation[matched_face][1]=rotation;
+          break;
         }
       }
-      ++loc_elem_idx;
-    } // end foreach element
-  } // end foreach elements component
+      // Following assertion fails, it means the correct orientation was not found! This should never happen!
+      cf3_always_assert(rotation != nb_nodes);
+    }
 
-  f2c.flush();
-  face_number.flush();
-  is_bdry_face.flush();
-  cell_rotation.flush();
-  cell_orientation.flush();
+    // increment number of inner faces (they always have 2 states)
+    ++nb_inner_faces;
+  }
 
   // CFinfo << "Total nb faces [" << m_nb_faces << "]" << CFendl;
   // CFinfo << "Inner nb faces [" << nb_inner_faces << "]" << CFendl;
 
-  // total number of boundary + partition boundary faces
-  //const Uint nb_bdry_plus_partition_faces = m_nb_faces - nb_inner_faces;
-  //CFinfo << "Boundary and Partition faces [" << nb_bdry_plus_partition_faces << "]" << CFendl;
-
-  cf3_assert(m_nb_faces <= max_nb_faces);
-  cf3_assert(nb_inner_faces <= max_nb_faces);
-
-
+  cf3_assert(nb_inner_faces <= m_nb_faces);
   cf3_assert(m_nb_faces == m_connectivity->size());
 
   if (m_face_building_algorithm)
@@ -349,7 +440,7 @@ void FaceCellConnectivity::build_connectivity()
         if ( is_not_null(elem.comp) )
         {
           common::List<bool>& is_bdry_elem = *Handle< common::List<bool> >(elem.comp->get_child("is_bdry"));
-          is_bdry_elem[elem.idx] = is_bdry_elem[elem.idx] || is_bdry_face.get_row(f) ;
+          is_bdry_elem[elem.idx] = is_bdry_elem[elem.idx] || is_bdry_face[f] ;
         }
       }
     }
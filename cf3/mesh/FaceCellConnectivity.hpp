@@ -60,7 +60,9 @@ public:
   void setup(Region& region);
 
   /// Build the connectivity table
-  /// Build the connectivity table as a DynTable<Uint>
+  /// Faces are matched with a FaceHashTable on their sorted nodes. The faces are hashed in parallel, and matched
+  /// in parallel by partitioning the hashes, using the number of threads given by the "threads" option.
+  /// Faces are numbered in the order they are first encountered, independent of the number of threads.
   /// @pre set_nodes() and set_elements() must have been called
 
   void build_connectivity();
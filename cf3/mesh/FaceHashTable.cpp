@@ -0,0 +1,142 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#include <algorithm>
+
+#include "common/Assertions.hpp"
+
+#include "math/Consts.hpp"
+
+#include "mesh/FaceHashTable.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace cf3 {
+namespace mesh {
+
+////////////////////////////////////////////////////////////////////////////////
+
+FaceHashTable::FaceHashTable(const Uint key_width, const Uint expected_size) :
+  m_key_width(key_width),
+  m_size(0)
+{
+  cf3_assert(key_width > 0);
+  Uint capacity = 16;
+  while(capacity < expected_size + expected_size / 2)
+    capacity *= 2;
+  m_keys.resize(static_cast<std::size_t>(capacity) * m_key_width, math::Consts::uint_max());
+  m_hashes.resize(capacity, 0);
+  m_values.resize(capacity, math::Consts::uint_max());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Uint FaceHashTable::make_key(Uint* nodes, const Uint nb_nodes)
+{
+  std::sort(nodes, nodes + nb_nodes);
+
+  // FNV-1a on the node numbers, followed by the MurmurHash3 finalizer to spread the bits
+  Uint hash = 2166136261u;
+  for(Uint i = 0; i != nb_nodes; ++i)
+  {
+    hash ^= nodes[i];
+    hash *= 16777619u;
+  }
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6bu;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35u;
+  hash ^= hash >> 16;
+  return hash;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Uint FaceHashTable::slot(const Uint* sorted_nodes, const Uint nb_nodes, const Uint hash) const
+{
+  cf3_assert(nb_nodes <= m_key_width);
+  const Uint mask = m_values.size() - 1;
+  Uint i = hash & mask;
+  while(true)
+  {
+    if(m_values[i] == math::Consts::uint_max())
+      return i;
+    if(m_hashes[i] == hash)
+    {
+      const Uint* key = &m_keys[static_cast<std::size_t>(i) * m_key_width];
+      bool equal = std::equal(sorted_nodes, sorted_nodes + nb_nodes, key);
+      for(Uint j = nb_nodes; equal && j != m_key_width; ++j)
+        equal = key[j] == math::Consts::uint_max();
+      if(equal)
+        return i;
+    }
+    i = (i + 1) & mask;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Uint FaceHashTable::insert(const Uint* sorted_nodes, const Uint nb_nodes, const Uint hash, const Uint value)
+{
+  cf3_assert(value != math::Consts::uint_max());
+  Uint i = slot(sorted_nodes, nb_nodes, hash);
+  if(m_values[i] != math::Consts::uint_max())
+    return m_values[i];
+
+  if(10 * (m_size + 1) > 7 * m_values.size())
+  {
+    grow();
+    i = slot(sorted_nodes, nb_nodes, hash);
+  }
+
+  std::copy(sorted_nodes, sorted_nodes + nb_nodes, &m_keys[static_cast<std::size_t>(i) * m_key_width]);
+  m_hashes[i] = hash;
+  m_values[i] = value;
+  ++m_size;
+  return value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Uint FaceHashTable::find(const Uint* sorted_nodes, const Uint nb_nodes, const Uint hash) const
+{
+  if(nb_nodes > m_key_width)
+    return math::Consts::uint_max();
+  return m_values[slot(sorted_nodes, nb_nodes, hash)];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void FaceHashTable::grow()
+{
+  std::vector<Uint> old_keys(static_cast<std::size_t>(2) * m_values.size() * m_key_width, math::Consts::uint_max());
+  std::vector<Uint> old_hashes(2 * m_values.size(), 0);
+  std::vector<Uint> old_values(2 * m_values.size(), math::Consts::uint_max());
+  old_keys.swap(m_keys);
+  old_hashes.swap(m_hashes);
+  old_values.swap(m_values);
+
+  const Uint mask = m_values.size() - 1;
+  for(Uint old_slot = 0; old_slot != old_values.size(); ++old_slot)
+  {
+    if(old_values[old_slot] == math::Consts::uint_max())
+      continue;
+    Uint i = old_hashes[old_slot] & mask;
+    while(m_values[i] != math::Consts::uint_max())
+      i = (i + 1) & mask;
+    const Uint* old_key = &old_keys[static_cast<std::size_t>(old_slot) * m_key_width];
+    std::copy(old_key, old_key + m_key_width, &m_keys[static_cast<std::size_t>(i) * m_key_width]);
+    m_hashes[i] = old_hashes[old_slot];
+    m_values[i] = old_values[old_slot];
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // mesh
+} // cf3
+
+////////////////////////////////////////////////////////////////////////////////
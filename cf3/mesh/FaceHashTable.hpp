@@ -0,0 +1,78 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#ifndef cf3_mesh_FaceHashTable_hpp
+#define cf3_mesh_FaceHashTable_hpp
+
+#include <vector>
+
+#include "mesh/LibMesh.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace cf3 {
+namespace mesh {
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Open-addressing hash table that identifies faces by their node numbers, independent of the order of the nodes.
+/// Each slot stores the sorted nodes of a face, padded to a fixed key width, its hash and a value (e.g. a face index),
+/// so the memory use is (key_width + 2) * capacity Uints. The capacity is a power of two, doubled when the table
+/// becomes 70% full. Lookups use linear probing.
+class Mesh_API FaceHashTable
+{
+public:
+
+  /// @param key_width Maximum number of nodes in a face
+  /// @param expected_size Expected number of faces, used to choose the initial capacity
+  FaceHashTable(const Uint key_width, const Uint expected_size);
+
+  /// Sort the given nodes in place and return the hash of the resulting key
+  static Uint make_key(Uint* nodes, const Uint nb_nodes);
+
+  /// Insert a face, unless a face with the same nodes is already present
+  /// @param sorted_nodes Nodes sorted by make_key
+  /// @param hash Hash returned by make_key
+  /// @param value Value to store for a new face
+  /// @return The value of the existing face with the same nodes, or value if the face is new
+  Uint insert(const Uint* sorted_nodes, const Uint nb_nodes, const Uint hash, const Uint value);
+
+  /// Value stored for the face with the given sorted nodes, or math::Consts::uint_max() if there is none
+  Uint find(const Uint* sorted_nodes, const Uint nb_nodes, const Uint hash) const;
+
+  /// Number of faces in the table
+  Uint size() const { return m_size; }
+
+  /// Number of slots in the table
+  Uint capacity() const { return m_values.size(); }
+
+  Uint key_width() const { return m_key_width; }
+
+private:
+
+  /// Slot holding the given key, or the empty slot where it should be inserted
+  Uint slot(const Uint* sorted_nodes, const Uint nb_nodes, const Uint hash) const;
+
+  /// Double the capacity and reinsert all faces
+  void grow();
+
+  const Uint m_key_width;
+  Uint m_size;
+  /// Keys of all slots, key_width values per slot, padded with uint_max
+  std::vector<Uint> m_keys;
+  std::vector<Uint> m_hashes;
+  /// Values of all slots. uint_max marks an empty slot.
+  std::vector<Uint> m_values;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // mesh
+} // cf3
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // cf3_mesh_FaceHashTable_hpp
@@ -122,8 +122,18 @@ public: // functions
 
   common::PE::CommPattern& parallelize();
 
+  /// The pattern used to synchronize this field, applying the default parallelization from the dict if needed
+  common::PE::CommPattern& comm_pattern();
+
   void synchronize();
 
+  /// Start a non-blocking synchronization of the ghost values, so local work can overlap with the communication.
+  /// The ghost values may only be used after the matching end_synchronize.
+  void begin_synchronize();
+
+  /// Complete the synchronization started by begin_synchronize
+  void end_synchronize();
+
   math::VariablesDescriptor& descriptor() const { return *m_descriptor; }
 
   void set_descriptor(math::VariablesDescriptor& descriptor);
@@ -0,0 +1,315 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#ifndef cf3_mesh_Integrators_SumFactorization_hpp
+#define cf3_mesh_Integrators_SumFactorization_hpp
+
+#include <algorithm>
+#include <cmath>
+
+#include <boost/mpl/assert.hpp>
+
+#include "common/BasicExceptions.hpp"
+
+#include "math/MatrixTypes.hpp"
+
+#include "mesh/GeoShape.hpp"
+#include "mesh/Integrators/GaussImplementation.hpp"
+
+namespace cf3 {
+namespace mesh {
+namespace Integrators {
+
+namespace detail
+{
+  /// Compile-time integer power
+  template<Uint Base, Uint Exponent>
+  struct Pow
+  {
+    static const Uint value = Base * Pow<Base, Exponent-1>::value;
+  };
+
+  template<Uint Base>
+  struct Pow<Base, 0>
+  {
+    static const Uint value = 1;
+  };
+
+  /// Contract axis "axis" of the tensor in (with extents[axis] == cols) with the rows x cols matrix a, stored column-major.
+  /// The result has extent rows along axis, and the same extents as in for the other axes. Tensors are stored with the first index varying fastest.
+  /// If transpose is true, a is interpreted as a cols x rows matrix and its transpose is used.
+  inline void contract(const Real* a, const Uint rows, const Uint cols, const bool transpose, const Real* in, const Uint* extents, const Uint dim, const Uint axis, Real* out)
+  {
+    Uint pre = 1;
+    for(Uint d = 0; d != axis; ++d)
+      pre *= extents[d];
+    Uint post = 1;
+    for(Uint d = axis+1; d < dim; ++d)
+      post *= extents[d];
+
+    for(Uint k = 0; k != post; ++k)
+    {
+      const Real* in_k = in + pre*cols*k;
+      Real* out_k = out + pre*rows*k;
+      for(Uint r = 0; r != rows; ++r)
+      {
+        Real* out_r = out_k + pre*r;
+        std::fill(out_r, out_r + pre, 0.);
+        for(Uint c = 0; c != cols; ++c)
+        {
+          const Real coeff = transpose ? a[c + cols*r] : a[r + rows*c];
+          const Real* in_c = in_k + pre*c;
+          for(Uint i = 0; i != pre; ++i)
+            out_r[i] += coeff * in_c[i];
+        }
+      }
+    }
+  }
+}
+
+/// Sum-factorized evaluation for tensor-product Lagrange shape functions (lines, quads and hexahedra) on a tensor grid of
+/// Gauss points. Values and gradients at all quadrature points, and integrals against all shape functions (or their
+/// gradients) are computed by applying 1D operators one direction at a time. For order p this costs O(p^(dim+1))
+/// per element instead of the O(p^(2 dim)) of evaluating every shape function at every point.
+/// Quadrature points are ordered with the first mapped coordinate varying fastest, use coords() to get them.
+/// @tparam SF The shape function
+/// @tparam NbPoints1D The number of Gauss points in each direction, as in GaussPoints
+template<typename SF, Uint NbPoints1D>
+class SumFactorization
+{
+  BOOST_MPL_ASSERT_RELATION(SF::order, >, 0);
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  static const Uint dimension = SF::dimensionality;
+  static const Uint nb_nodes = SF::nb_nodes;
+  static const Uint nb_nodes_1d = SF::order + 1;
+  static const Uint nb_points_1d = NbPoints1D;
+  static const Uint nb_points = detail::Pow<NbPoints1D, dimension>::value;
+
+  /// Storage for scalar nodal values
+  typedef Eigen::Matrix<Real, nb_nodes, 1> NodalT;
+  /// Storage for scalar values at the quadrature points
+  typedef Eigen::Matrix<Real, nb_points, 1> PointValuesT;
+  /// Storage for vectors at the quadrature points, one column per point
+  typedef Eigen::Matrix<Real, dimension, nb_points> PointVectorsT;
+  /// Storage for 1D operators, rows are points and columns 1D nodes
+  typedef Eigen::Matrix<Real, NbPoints1D, nb_nodes_1d> Operator1DT;
+
+  static const SumFactorization& instance()
+  {
+    static const SumFactorization sf;
+    return sf;
+  }
+
+  /// Values at the quadrature points, from the nodal values
+  void interpolate(const NodalT& nodal, PointValuesT& result) const
+  {
+    Real tensor[tensor_size];
+    to_tensor(nodal, tensor);
+    apply(tensor, 0, false, result.data());
+  }
+
+  /// Gradient in mapped coordinates at the quadrature points, from the nodal values
+  void interpolate_gradient(const NodalT& nodal, PointVectorsT& result) const
+  {
+    Real tensor[tensor_size];
+    to_tensor(nodal, tensor);
+    Real component[tensor_size];
+    for(Uint d = 0; d != dimension; ++d)
+    {
+      apply(tensor, d+1, false, component);
+      for(Uint q = 0; q != nb_points; ++q)
+        result(d, q) = component[q];
+    }
+  }
+
+  /// result_i = sum_q values_q N_i(x_q). Multiply values by the weights and jacobian determinants first to get an integral.
+  void integrate(const PointValuesT& values, NodalT& result) const
+  {
+    Real tensor[tensor_size];
+    std::copy(values.data(), values.data() + nb_points, tensor);
+    Real nodal_tensor[tensor_size];
+    apply(tensor, 0, true, nodal_tensor);
+    from_tensor(nodal_tensor, result);
+  }
+
+  /// result_i = sum_q sum_d values_dq dN_i/dxi_d(x_q), with values given in mapped coordinates
+  void integrate_gradient(const PointVectorsT& values, NodalT& result) const
+  {
+    Real sum[tensor_size];
+    std::fill(sum, sum + tensor_size, 0.);
+    Real tensor[tensor_size];
+    Real nodal_tensor[tensor_size];
+    for(Uint d = 0; d != dimension; ++d)
+    {
+      for(Uint q = 0; q != nb_points; ++q)
+        tensor[q] = values(d, q);
+      apply(tensor, d+1, true, nodal_tensor);
+      for(Uint i = 0; i != nb_tensor_nodes; ++i)
+        sum[i] += nodal_tensor[i];
+    }
+    from_tensor(sum, result);
+  }
+
+  /// Mapped coordinates of the quadrature points, one column per point
+  const Eigen::Matrix<Real, dimension, nb_points>& coords() const
+  {
+    return m_coords;
+  }
+
+  /// Weights of the quadrature points
+  const PointValuesT& weights() const
+  {
+    return m_weights;
+  }
+
+  /// 1D shape function values, rows are points and columns 1D nodes
+  const Operator1DT& values_1d() const
+  {
+    return m_values;
+  }
+
+  /// 1D shape function derivatives, rows are points and columns 1D nodes
+  const Operator1DT& derivatives_1d() const
+  {
+    return m_derivatives;
+  }
+
+private:
+  static const Uint nb_tensor_nodes = detail::Pow<nb_nodes_1d, dimension>::value;
+  static const Uint max_1d = nb_nodes_1d > NbPoints1D ? nb_nodes_1d : NbPoints1D;
+  static const Uint tensor_size = detail::Pow<max_1d, dimension>::value;
+
+  SumFactorization()
+  {
+    // 1D Gauss points in increasing order
+    Real points[NbPoints1D];
+    Real weights[NbPoints1D];
+    for(Uint i = 0; i != NbPoints1D/2; ++i)
+    {
+      points[NbPoints1D/2 - 1 - i] = -GaussPoints<NbPoints1D>::x()[i];
+      points[NbPoints1D/2 + i] = GaussPoints<NbPoints1D>::x()[i];
+      weights[NbPoints1D/2 - 1 - i] = GaussPoints<NbPoints1D>::w()[i];
+      weights[NbPoints1D/2 + i] = GaussPoints<NbPoints1D>::w()[i];
+    }
+
+    // 1D Lagrange basis on equidistant nodes
+    Real nodes[nb_nodes_1d];
+    for(Uint j = 0; j != nb_nodes_1d; ++j)
+      nodes[j] = -1. + 2.*Real(j)/Real(SF::order);
+
+    for(Uint q = 0; q != NbPoints1D; ++q)
+    {
+      const Real x = points[q];
+      for(Uint j = 0; j != nb_nodes_1d; ++j)
+      {
+        Real value = 1.;
+        Real derivative = 0.;
+        for(Uint m = 0; m != nb_nodes_1d; ++m)
+        {
+          if(m == j)
+            continue;
+          value *= (x - nodes[m]) / (nodes[j] - nodes[m]);
+          Real term = 1. / (nodes[j] - nodes[m]);
+          for(Uint k = 0; k != nb_nodes_1d; ++k)
+          {
+            if(k != j && k != m)
+              term *= (x - nodes[k]) / (nodes[j] - nodes[k]);
+          }
+          derivative += term;
+        }
+        m_values(q, j) = value;
+        m_derivatives(q, j) = derivative;
+      }
+    }
+
+    // Tensor grid of quadrature points
+    for(Uint q = 0; q != nb_points; ++q)
+    {
+      Uint idx = q;
+      m_weights[q] = 1.;
+      for(Uint d = 0; d != dimension; ++d)
+      {
+        m_coords(d, q) = points[idx % NbPoints1D];
+        m_weights[q] *= weights[idx % NbPoints1D];
+        idx /= NbPoints1D;
+      }
+    }
+
+    // Element node at each position of the tensor grid of nodes
+    std::fill(m_node_index, m_node_index + nb_tensor_nodes, static_cast<Uint>(nb_nodes));
+    const RealMatrix& local_coords = SF::local_coordinates();
+    if(nb_tensor_nodes != nb_nodes || local_coords.rows() != nb_nodes)
+      throw common::NotSupported(FromHere(), "Shape function " + SF::type_name() + " is not a tensor product of 1D Lagrange polynomials");
+    for(Uint node = 0; node != nb_nodes; ++node)
+    {
+      Uint tensor_idx = 0;
+      Uint stride = 1;
+      for(Uint d = 0; d != dimension; ++d)
+      {
+        const Real position = (local_coords(node, d) + 1.) * 0.5 * Real(SF::order);
+        tensor_idx += stride * static_cast<Uint>(position + 0.5);
+        stride *= nb_nodes_1d;
+      }
+      if(tensor_idx >= nb_tensor_nodes || m_node_index[tensor_idx] != nb_nodes)
+        throw common::NotSupported(FromHere(), "Shape function " + SF::type_name() + " is not a tensor product of 1D Lagrange polynomials");
+      m_node_index[tensor_idx] = node;
+    }
+  }
+
+  /// Apply the 1D operators in all directions. derivative_direction is 0 for values only, or 1 + the direction in
+  /// which derivatives are taken. If transpose is true, in holds point values and the result holds nodal values.
+  void apply(const Real* in, const Uint derivative_direction, const bool transpose, Real* out) const
+  {
+    Uint extents[3];
+    for(Uint d = 0; d != dimension; ++d)
+      extents[d] = transpose ? NbPoints1D : nb_nodes_1d;
+
+    Real buffers[2][tensor_size];
+    const Real* current = in;
+    for(Uint d = 0; d != dimension; ++d)
+    {
+      const Operator1DT& op = (derivative_direction == d+1) ? m_derivatives : m_values;
+      Real* target = (d == dimension-1) ? out : buffers[d % 2];
+      if(transpose)
+      {
+        detail::contract(op.data(), nb_nodes_1d, NbPoints1D, true, current, extents, dimension, d, target);
+        extents[d] = nb_nodes_1d;
+      }
+      else
+      {
+        detail::contract(op.data(), NbPoints1D, nb_nodes_1d, false, current, extents, dimension, d, target);
+        extents[d] = NbPoints1D;
+      }
+      current = target;
+    }
+  }
+
+  void to_tensor(const NodalT& nodal, Real* tensor) const
+  {
+    for(Uint i = 0; i != nb_tensor_nodes; ++i)
+      tensor[i] = nodal[m_node_index[i]];
+  }
+
+  void from_tensor(const Real* tensor, NodalT& nodal) const
+  {
+    for(Uint i = 0; i != nb_tensor_nodes; ++i)
+      nodal[m_node_index[i]] = tensor[i];
+  }
+
+  Operator1DT m_values;
+  Operator1DT m_derivatives;
+  Eigen::Matrix<Real, dimension, nb_points> m_coords;
+  PointValuesT m_weights;
+  Uint m_node_index[nb_tensor_nodes];
+};
+
+} // Integrators
+} // mesh
+} // cf3
+
+#endif // cf3_mesh_Integrators_SumFactorization_hpp
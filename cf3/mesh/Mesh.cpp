@@ -533,6 +533,28 @@ void Mesh::raise_mesh_changed()
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void Mesh::raise_coordinates_changed()
+{
+  SignalOptions options;
+  options.add("mesh_uri", uri());
+
+  SignalArgs f= options.create_frame();
+  Core::instance().event_handler().raise_event( Tags::event_coordinates_changed(), f );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Mesh::raise_periodic_links_changed()
+{
+  SignalOptions options;
+  options.add("mesh_uri", uri());
+
+  SignalArgs f= options.create_frame();
+  Core::instance().event_handler().raise_event( Tags::event_periodic_links_changed(), f );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void Mesh::block_mesh_changed ( const bool block )
 {
   m_block_mesh_changed = block;
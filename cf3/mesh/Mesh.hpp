@@ -96,6 +96,13 @@ public: // functions
   void raise_mesh_loaded();
 
   void raise_mesh_changed();
+
+  /// Signal that the node coordinates were modified without changing the connectivity (e.g. by moving the mesh),
+  /// so data derived from the geometry can be recomputed.
+  void raise_coordinates_changed();
+
+  /// Signal that the periodic links between the geometry nodes were modified
+  void raise_periodic_links_changed();
   
   /// If true, block subsequent raise_mesh_changed event.
   void block_mesh_changed(const bool block);
@@ -662,7 +662,7 @@ void MeshAdaptor::send_elements(const std::vector< std::vector< std::vector<Uint
   //////PECheckArrivePoint(100,"Send/receive elements");
 
   // Send/Receive the elements.
-  send_buffer.all_to_all(receive_buffer);
+  send_buffer.sparse_all_to_all(receive_buffer);
 
   // 2) Add the elements
 
@@ -758,7 +758,7 @@ void MeshAdaptor::send_nodes(const std::vector< std::vector< std::vector<Uint> >
   //////PECheckArrivePoint(100,"nodes packed");
 
   // Send/Receive buffers
-  send_buffer.all_to_all(receive_buffer);
+  send_buffer.sparse_all_to_all(receive_buffer);
 
   //////PECheckArrivePoint(100,"nodes sent/received");
 
@@ -12,6 +12,7 @@
 #include "common/OptionList.hpp"
 #include "common/OptionT.hpp"
 #include "common/OptionURI.hpp"
+#include "common/PropertyList.hpp"
 #include "common/PE/Comm.hpp"
 #include "common/PE/datatype.hpp"
 #include "common/PE/Buffer.hpp"
@@ -29,6 +30,7 @@
 #include "mesh/Region.hpp"
 #include "mesh/MeshAdaptor.hpp"
 #include "mesh/MeshElements.hpp"
+#include "mesh/ElementType.hpp"
 
 namespace cf3 {
 namespace mesh {
@@ -51,6 +53,24 @@ MeshPartitioner::MeshPartitioner ( const std::string& name ) :
       .link_to(&m_nb_parts)
       .mark_basic();
 
+  options().add("node_weight", 1.)
+      .description("Computational weight of a node, relative to a linear simplex element")
+      .pretty_name("Node Weight");
+
+  options().add("element_weights", std::vector<std::string>())
+      .description("Computational weight of the elements, as 'key:weight', where key is the name of an Elements component, "
+                   "of one of its parent regions (e.g. a wall with a wall model) or of an element shape (e.g. Hexa). "
+                   "A component or region name takes precedence over a shape. Elements without a match get "
+                   "(nb_nodes/(dimensionality+1))^2, so that a linear simplex weighs 1 and a linear hexahedron 4.")
+      .pretty_name("Element Weights")
+      .mark_basic();
+
+  options().add("timing_property", std::string())
+      .description("Name of a Real property of the Elements components holding their measured assembly time. "
+                   "Timed Elements are weighted by their time per element, scaled so that all timed Elements keep "
+                   "the same total weight. Leave empty to use the configured weights only.")
+      .pretty_name("Timing Property");
+
   m_global_to_local = create_static_component<common::Map<Uint,Uint> >("global_to_local");
   m_lookup = create_static_component<UnifiedData >("lookup");
 
@@ -184,10 +204,14 @@ void MeshPartitioner::initialize(Mesh& mesh)
     start_id += nb_obj_per_proc[p];
   }
 
-  m_nodes_to_export.resize(m_nb_parts);
-  m_elements_to_export.resize(m_nb_parts,std::vector< std::vector<Uint> >(mesh.elements().size()));
+  // start from empty lists, as the partitioner can be executed again after the mesh changed
+  m_nodes_to_export.assign(m_nb_parts,std::vector<Uint>());
+  m_elements_to_export.assign(m_nb_parts,std::vector< std::vector<Uint> >(mesh.elements().size()));
+  m_lookup->reset();
+  m_global_to_local->clear();
 
   build_global_to_local_index(mesh);
+  compute_object_weights(mesh);
   build_graph();
 
 //  mesh.update_statistics();
@@ -270,6 +294,76 @@ void MeshPartitioner::build_global_to_local_index(Mesh& mesh)
 
 //////////////////////////////////////////////////////////////////////////////
 
+Real MeshPartitioner::configured_element_weight(const Entities& entities, const std::map<std::string,Real>& weights) const
+{
+  // Entities name, then the names of its parent regions
+  for (Handle<Component const> comp = entities.handle(); is_not_null(comp) && comp != m_mesh; comp = comp->parent())
+  {
+    std::map<std::string,Real>::const_iterator it = weights.find(comp->name());
+    if (it != weights.end())
+      return it->second;
+  }
+
+  const ElementType& etype = entities.element_type();
+  std::map<std::string,Real>::const_iterator it = weights.find(etype.shape_name());
+  if (it != weights.end())
+    return it->second;
+
+  const Real relative_nb_nodes = static_cast<Real>(etype.nb_nodes()) / static_cast<Real>(etype.dimensionality()+1);
+  return relative_nb_nodes*relative_nb_nodes;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void MeshPartitioner::compute_object_weights(Mesh& mesh)
+{
+  std::map<std::string,Real> weights;
+  boost_foreach(const std::string& entry, options().value< std::vector<std::string> >("element_weights"))
+  {
+    const std::size_t colon = entry.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon+1 == entry.size())
+      throw BadValue(FromHere(), "Element weight \""+entry+"\" is not of the form key:weight");
+    const Real weight = from_str<Real>(entry.substr(colon+1));
+    if (weight <= 0.)
+      throw BadValue(FromHere(), "Element weight \""+entry+"\" must be positive");
+    weights[entry.substr(0,colon)] = weight;
+  }
+
+  const std::vector< Handle<Component> >& components = m_lookup->components();
+  m_weight_per_component.assign(components.size(), options().value<Real>("node_weight"));
+
+  // Weights from the configuration, and the measured time of the Elements that have one
+  const std::string timing_property = options().value<std::string>("timing_property");
+  std::vector<Real> measured_time(components.size(), -1.);
+  std::vector<Real> sums(2, 0.); // total time and total configured weight of the timed elements
+  for (Uint c=1; c<components.size(); ++c)
+  {
+    const Entities& entities = *Handle<Entities>(components[c]);
+    m_weight_per_component[c] = configured_element_weight(entities, weights);
+    if (!timing_property.empty() && entities.size() && entities.properties().check(timing_property))
+    {
+      measured_time[c] = entities.properties().value<Real>(timing_property);
+      sums[0] += measured_time[c];
+      sums[1] += m_weight_per_component[c] * static_cast<Real>(entities.size());
+    }
+  }
+
+  // Convert times to weights so that the timed elements of all processors keep their total configured weight
+  std::vector<Real> global_sums(sums);
+  if (PE::Comm::instance().is_active())
+    PE::Comm::instance().all_reduce(PE::plus(), sums, global_sums);
+  if (global_sums[0] <= 0.)
+    return;
+  const Real weight_per_second = global_sums[1] / global_sums[0];
+  for (Uint c=1; c<components.size(); ++c)
+  {
+    if (measured_time[c] > 0.)
+      m_weight_per_component[c] = weight_per_second * measured_time[c] / static_cast<Real>(Handle<Entities>(components[c])->size());
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
 void MeshPartitioner::show_changes()
 {
   Uint nb_changes(0);
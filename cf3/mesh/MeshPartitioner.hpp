@@ -9,6 +9,8 @@
 
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <map>
+
 #include <boost/tuple/tuple.hpp>
 
 #include "common/FindComponents.hpp"
@@ -92,6 +94,10 @@ public: // functions
   template <typename VectorT>
   void list_of_objects_owned_by_part(const Uint part, VectorT& obj_list) const;
 
+  /// Computational weight of the objects owned by the part, in the order of list_of_objects_owned_by_part
+  template <typename VectorT>
+  void list_of_object_weights_in_part(const Uint part, VectorT& obj_weights) const;
+
   template <typename VectorT>
   Uint nb_connected_objects_in_part(const Uint part, VectorT& nb_connections_per_obj) const;
 
@@ -139,6 +145,15 @@ protected: // functions
   
   Uint periodic_target_node(Uint node) const;
 
+  /// Weight of each element of the given Entities, from the "element_weights" option or else from the element type
+  Real configured_element_weight(const Entities& entities, const std::map<std::string,Real>& weights) const;
+
+  /// Compute m_weight_per_component, using the measured timings where available
+  void compute_object_weights(Mesh& mesh);
+
+  /// Weight of the objects of each component: the nodes, followed by the elements of each Entities in mesh.elements()
+  const std::vector<Real>& weight_per_component() const { return m_weight_per_component; }
+
 protected: // data
 
   /// nodes_to_export[part][loc_node_idx]
@@ -167,6 +182,9 @@ private: // data
 
   Handle< UnifiedData > m_lookup;
 
+  /// Weight of the objects of each component in m_lookup, nodes first
+  std::vector<Real> m_weight_per_component;
+
   std::vector< std::pair<bool, Uint > > m_periodic_links;
   std::vector< std::vector<Uint> > m_inverse_periodic_links;
 };
@@ -196,6 +214,22 @@ void MeshPartitioner::list_of_objects_owned_by_part(const Uint part, VectorT& ob
 
 //////////////////////////////////////////////////////////////////////////////
 
+template <typename VectorT>
+void MeshPartitioner::list_of_object_weights_in_part(const Uint part, VectorT& obj_weights) const
+{
+  Uint idx=0;
+  foreach_container((const Uint glb_obj)(const Uint loc_obj),*m_global_to_local)
+  {
+    if (part_of_obj(glb_obj) == part)
+    {
+      if(!(glb_obj < m_end_node_per_part[part] && m_periodic_links[m_lookup->location(loc_obj).get<1>()].first))
+        obj_weights[idx++] = m_weight_per_component[m_lookup->location_idx(loc_obj).get<0>()];
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
 template <typename VectorT>
 Uint MeshPartitioner::nb_connected_objects_in_part(const Uint part, VectorT& nb_connections_per_obj) const
 {
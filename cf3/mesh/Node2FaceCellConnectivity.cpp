@@ -9,7 +9,7 @@
 #include "common/Link.hpp"
 #include "common/Builder.hpp"
 #include "mesh/Node2FaceCellConnectivity.hpp"
-#include "common/DynTable.hpp"
+#include "common/CompressedTable.hpp"
 #include "mesh/Dictionary.hpp"
 #include "mesh/Region.hpp"
 
@@ -28,7 +28,7 @@ Node2FaceCellConnectivity::Node2FaceCellConnectivity ( const std::string& name )
   m_used_components = create_static_component<Group>("used_components");
 
   m_nodes = create_static_component<common::Link>(mesh::Tags::nodes());
-  m_connectivity = create_static_component<DynTable<Face2Cell> >(mesh::Tags::connectivity_table());
+  m_connectivity = create_static_component<CompressedTable<Face2Cell> >(mesh::Tags::connectivity_table());
   mark_basic();
 }
 
@@ -78,7 +78,7 @@ void Node2FaceCellConnectivity::add_used (FaceCellConnectivity& used_comp)
 void Node2FaceCellConnectivity::set_nodes(Dictionary& nodes)
 {
   m_nodes->link_to(nodes);
-  m_connectivity->resize(nodes.size());
+  m_connectivity->set_row_sizes(std::vector<Uint>(nodes.size(), 0));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -87,8 +87,8 @@ void Node2FaceCellConnectivity::build_connectivity()
 {
   Dictionary const& nodes = *Handle<Dictionary>(m_nodes->follow());
 
-  // Reserve memory in m_connectivity->array()
-  std::vector<Uint> connectivity_sizes(nodes.size());
+  // Count the boundary faces connected to each node
+  CompressedTableBuilder<Face2Cell> builder(*m_connectivity, nodes.size());
   boost_foreach(Handle< FaceCellConnectivity > face_cell_connectivity_comp, used() )
   {
     FaceCellConnectivity& face_cell_connectivity = *face_cell_connectivity_comp;
@@ -100,19 +100,15 @@ void Node2FaceCellConnectivity::build_connectivity()
       {
         boost_foreach (const Uint node_idx, face.nodes())
         {
-          ++connectivity_sizes[node_idx];
+          builder.count(node_idx);
         }
 
       }
     }
   }
-  Uint i(0);
-  boost_foreach (DynTable<Face2Cell>::Row row, m_connectivity->array() )
-  {
-    row.reserve(connectivity_sizes[i++]);
-  }
+  builder.allocate();
 
-  // fill m_connectivity->array()
+  // fill m_connectivity
   boost_foreach(Handle< FaceCellConnectivity > face_cell_connectivity_comp, used() )
   {
     FaceCellConnectivity& face_cell_connectivity = *face_cell_connectivity_comp;
@@ -124,7 +120,7 @@ void Node2FaceCellConnectivity::build_connectivity()
       {
         boost_foreach (const Uint node_idx, face.nodes())
         {
-          m_connectivity->array()[node_idx].push_back(face);
+          builder.add(node_idx, face);
         }
       }
     }
@@ -9,7 +9,7 @@
 
 #include "mesh/Elements.hpp"
 #include "mesh/UnifiedData.hpp"
-#include "common/DynTable.hpp"
+#include "common/CompressedTable.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -51,7 +51,7 @@ public:
   void setup(Region& region);
 
   /// Build the connectivity table
-  /// Build the connectivity table as a DynTable<Uint>
+  /// Build the connectivity table as a CompressedTable<Uint>, counting the elements of each node first
   /// @pre set_nodes() and set_elements() must have been called
   void build_connectivity();
 
@@ -60,8 +60,8 @@ public:
 
 
   /// const access to the node to element connectivity table in unified indices
-  common::DynTable<Uint>& connectivity() { return *m_connectivity; }
-  const common::DynTable<Uint>& connectivity() const { return *m_connectivity; }
+  common::CompressedTable<Uint>& connectivity() { return *m_connectivity; }
+  const common::CompressedTable<Uint>& connectivity() const { return *m_connectivity; }
 
 private: //functions
 
@@ -78,7 +78,7 @@ private: // data
   Handle< UnifiedData > m_elements;
 
   /// Actual connectivity table
-  Handle< common::DynTable<Uint> > m_connectivity;
+  Handle< common::CompressedTable<Uint> > m_connectivity;
 
 }; // NodeElementConnectivity
 
@@ -40,6 +40,8 @@ const char * Tags::connectivity_table () { return "connectivity_table"; }
 
 const char * Tags::event_mesh_loaded() { return "mesh_loaded"; }
 const char * Tags::event_mesh_changed() { return "mesh_changed"; }
+const char * Tags::event_coordinates_changed() { return "coordinates_changed"; }
+const char * Tags::event_periodic_links_changed() { return "periodic_links_changed"; }
 
 //const char * Tags::geometry_elements () { return "geometry_elements"; }
 
@@ -52,6 +52,8 @@ public:
 
   static const char * event_mesh_loaded();
   static const char * event_mesh_changed();
+  static const char * event_coordinates_changed();
+  static const char * event_periodic_links_changed();
 
 //  static const char * geometry_elements ();
 
@@ -7,7 +7,7 @@
 #include <set>
 
 #include <boost/foreach.hpp>
-#include <boost/functional/hash.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include "common/Log.hpp"
 #include "common/Builder.hpp"
@@ -31,8 +31,8 @@
 #include "mesh/Region.hpp"
 #include "mesh/MeshElements.hpp"
 #include "mesh/FaceCellConnectivity.hpp"
+#include "mesh/FaceHashTable.hpp"
 #include "mesh/NodeElementConnectivity.hpp"
-#include "mesh/Node2FaceCellConnectivity.hpp"
 #include "mesh/Cells.hpp"
 #include "mesh/Mesh.hpp"
 #include "mesh/Connectivity.hpp"
@@ -51,21 +51,47 @@ namespace actions {
   using namespace common;
   using namespace math::Functions;
 
-struct FaceCompare
+namespace detail
 {
-  bool operator()(const Face2Cell& face1, const Face2Cell& face2) const
+
+/// Hash table of the faces of all FaceCellConnectivity components tagged as inner faces in a region.
+/// The value of each face is its index in the faces vector.
+struct InnerFaceTable
+{
+  InnerFaceTable(Region& region)
+  {
+    std::vector< std::vector<Uint> > face_nodes;
+    Uint key_width = 1;
+    boost_foreach(FaceCellConnectivity& f2c, find_components_recursively_with_tag<FaceCellConnectivity>(region,mesh::Tags::inner_faces()))
+    {
+      for (Uint idx=0; idx<f2c.size(); ++idx)
+      {
+        faces.push_back(Face2Cell(f2c,idx));
+        face_nodes.push_back(faces.back().nodes());
+        key_width = std::max(key_width, static_cast<Uint>(face_nodes.back().size()));
+      }
+    }
+
+    table.reset(new FaceHashTable(key_width, faces.size()));
+    for (Uint i=0; i<faces.size(); ++i)
+    {
+      std::vector<Uint>& nodes = face_nodes[i];
+      table->insert(&nodes[0], nodes.size(), FaceHashTable::make_key(&nodes[0], nodes.size()), i);
+    }
+  }
+
+  /// Index in faces of the face with the given nodes, or math::Consts::uint_max() if there is none
+  Uint find(std::vector<Uint> nodes) const
   {
-    std::size_t seed1=0;
-    std::size_t seed2=0;
-
-    boost::hash_combine(seed1,face1.comp->uri().string());
-    boost::hash_combine(seed2,face2.comp->uri().string());
-    boost::hash_combine(seed1,face1.idx);
-    boost::hash_combine(seed2,face2.idx);
-    return seed1 < seed2;
+    return table->find(&nodes[0], nodes.size(), FaceHashTable::make_key(&nodes[0], nodes.size()));
   }
+
+  std::vector<Face2Cell> faces;
+  boost::scoped_ptr<FaceHashTable> table;
 };
 
+} // detail
+
 ////////////////////////////////////////////////////////////////////////////////
 
 common::ComponentBuilder < BuildFaces, MeshTransformer, mesh::actions::LibActions> BuildFaces_Builder;
@@ -90,6 +116,10 @@ BuildFaces::BuildFaces( const std::string& name )
       .pretty_name("Store Cell to Face")
       .mark_basic()
       .link_to(&m_store_cell2face);
+
+  options().add("threads", 1u)
+      .description("Number of threads used to match the faces. Each MPI process starts its own threads, so keep this at 1 when running one process per core. 0 uses all hardware threads.")
+      .pretty_name("Threads");
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -198,6 +228,7 @@ void BuildFaces::build_face_cell_connectivity_bottom_up(Component& parent)
 //      CFdebug << PERank << "building face_cell connectivity for region " << region.uri().path() << CFendl;
       Handle<FaceCellConnectivity> face_to_cell = region.create_component<FaceCellConnectivity>("face_to_cell");
       face_to_cell->options().set("face_building_algorithm",true);
+      face_to_cell->options().set("threads",options().value<Uint>("threads"));
       face_to_cell->add_tag(mesh::Tags::inner_faces());
       face_to_cell->setup(region);
       PE::Comm::instance().barrier();
@@ -449,7 +480,6 @@ boost::shared_ptr< FaceCellConnectivity > BuildFaces::match_faces(Region& region
 
   CFdebug << "matching faces between regions " << region1.uri().path() << "  and  " << region2.uri().path() << CFendl;
 
-  Mesh& mesh = *m_mesh;
   // interface connectivity
   boost::shared_ptr<FaceCellConnectivity> interface = allocate_component<FaceCellConnectivity>("interface_connectivity");
   interface->options().set("face_building_algorithm",true);
@@ -467,9 +497,7 @@ boost::shared_ptr< FaceCellConnectivity > BuildFaces::match_faces(Region& region
   std::map<FaceCellConnectivity*,boost::shared_ptr<common::Table<bool>::Buffer> > buf_cell_orientation;
   std::map<FaceCellConnectivity*,boost::shared_ptr<common::Table<Uint>::Buffer> > buf_cell_rotation;
 
-  // Build a node to face connectivity matching faces2
-  boost::shared_ptr<Node2FaceCellConnectivity> node2faces2_ptr = allocate_component<Node2FaceCellConnectivity>("node2faces");
-  Node2FaceCellConnectivity& node2faces2 = *node2faces2_ptr;
+  // Hash the faces of region2 on their nodes
   boost_foreach(FaceCellConnectivity& faces2, find_components_recursively_with_tag<FaceCellConnectivity>(region2,mesh::Tags::inner_faces()))
   {
     buf_fnb [&faces2] = boost::shared_ptr<common::Table<Uint>::Buffer> ( new common::Table<Uint>::Buffer(faces2.face_number().create_buffer()));
@@ -477,13 +505,9 @@ boost::shared_ptr< FaceCellConnectivity > BuildFaces::match_faces(Region& region
     buf_f2c [&faces2] = boost::shared_ptr<ElementConnectivity::Buffer> ( new ElementConnectivity::Buffer(faces2.connectivity().create_buffer()));
     buf_cell_rotation [&faces2] = boost::shared_ptr<common::Table<Uint>::Buffer> ( new common::Table<Uint>::Buffer(faces2.cell_rotation().create_buffer()));
     buf_cell_orientation [&faces2] = boost::shared_ptr<common::Table<bool>::Buffer> ( new common::Table<bool>::Buffer(faces2.cell_orientation().create_buffer()));
-    node2faces2.add_used(faces2); // it is assumed this is only face types
   }
-  node2faces2.set_nodes(mesh.geometry_fields());
-  node2faces2.build_connectivity();
+  const detail::InnerFaceTable faces2_table(region2);
 
-  Uint f1(0);
-  Uint faces1_idx(0);
   boost_foreach(FaceCellConnectivity& faces1, find_components_recursively_with_tag<FaceCellConnectivity>(region1,mesh::Tags::inner_faces()))
   {
     buf_fnb [&faces1] = boost::shared_ptr<common::Table<Uint>::Buffer> ( new common::Table<Uint>::Buffer(faces1.face_number().create_buffer()));
@@ -500,8 +524,6 @@ boost::shared_ptr< FaceCellConnectivity > BuildFaces::match_faces(Region& region
     std::vector<Uint> rotation(2);
     std::vector<bool> orientation(2);
     enum {LEFT=0,RIGHT=1};
-    Uint nb_matches(0);
-
 
     for (Uint idx=0; idx<faces1.size(); ++idx)
     {
@@ -509,79 +531,54 @@ boost::shared_ptr< FaceCellConnectivity > BuildFaces::match_faces(Region& region
       face1_nodes = face1.nodes();
       const Uint nb_nodes_per_face = face1_nodes.size();
 
-      std::map<Face2Cell,Uint,FaceCompare> found_faces;
-      std::map<Face2Cell,Uint,FaceCompare>::iterator not_found = found_faces.end();
+      const Uint match = faces2_table.find(face1_nodes);
+      if (match == math::Consts::uint_max())
+        continue;
+
+      Face2Cell face2 = faces2_table.faces[match];
+      elems[LEFT]  = face1.cells()[0];
+      elems[RIGHT] = face2.cells()[0];
+      face_nb[LEFT] = face1.face_nb_in_cells()[0];
+      face_nb[RIGHT] = face2.face_nb_in_cells()[0];
+      orientation[LEFT] = FaceCellConnectivity::MATCHED;
+      orientation[RIGHT] = FaceCellConnectivity::INVERTED;
+      rotation[LEFT] = 0;
+
+      // NOW find the rotation and orientation of this new face to the RIGHT cell
+
+      // Find orientation ( or find match between first face-nodes of both neighbouring elements )
+      face2_nodes = face2.nodes();
 
-      bool match_found = false;
-      boost_foreach(const Uint face1_node, face1_nodes)
+      Uint rot;
+      for (rot=0; rot!=nb_nodes_per_face; ++rot)
       {
-        boost_foreach(Face2Cell face2, node2faces2.connectivity()[face1_node])
+        if (face2_nodes[rot] == face1_nodes[0])
         {
-          std::map<Face2Cell,Uint,FaceCompare>::iterator it = found_faces.find(face2);
-          if ( it == not_found)
-          {
-            found_faces[face2]=1;
-          }
-          else
-          {
-            Uint& nb_faces = it->second;
-            ++nb_faces;
-            if (nb_faces == nb_nodes_per_face)
-            {
-              match_found = true;
-              elems[LEFT]  = face1.cells()[0];
-              elems[RIGHT] = face2.cells()[0];
-              face_nb[LEFT] = face1.face_nb_in_cells()[0];
-              face_nb[RIGHT] = face2.face_nb_in_cells()[0];
-              orientation[LEFT] = FaceCellConnectivity::MATCHED;
-              orientation[RIGHT] = FaceCellConnectivity::INVERTED;
-              rotation[LEFT] = 0;
-
-              // NOW find the rotation and orientation of this new face to the RIGHT cell
-
-              // Find orientation ( or find match between first face-nodes of both neighbouring elements )
-              face2_nodes = face2.nodes();
-
-              Uint rot;
-              for (rot=0; rot<=nb_nodes_per_face; ++rot)
-              {
-                if (face2_nodes[rot] == face1_nodes[0])
-                {
-                  rotation[RIGHT] = rot;
-                  break;
-                }
-              }
-              cf3_assert(rot != nb_nodes_per_face); // means that the break worked and the rotation was found
-
-
-              // Remove matches from the 2 connectivity tables and add to the interface
-              i2c.add_row(elems);
-              fnb.add_row(face_nb);
-              bdry.add_row(false);
-              cell_rotation.add_row(rotation);
-              cell_orientation.add_row(orientation);
-
-              buf_f2c [face1.comp]->rm_row(face1.idx);
-              buf_f2c [face2.comp]->rm_row(face2.idx);
-              buf_fnb [face1.comp]->rm_row(face1.idx);
-              buf_fnb [face2.comp]->rm_row(face2.idx);
-              buf_bdry[face1.comp]->rm_row(face1.idx);
-              buf_bdry[face2.comp]->rm_row(face2.idx);
-              buf_cell_orientation[face1.comp]->rm_row(face1.idx);
-              buf_cell_orientation[face2.comp]->rm_row(face2.idx);
-              buf_cell_rotation[face1.comp]->rm_row(face1.idx);
-              buf_cell_rotation[face2.comp]->rm_row(face2.idx);
-              ++nb_matches;
-              break;
-            }
-          }
-        }
-        if (match_found)
+          rotation[RIGHT] = rot;
           break;
+        }
       }
-      ++f1;
+      cf3_assert(rot != nb_nodes_per_face); // means that the break worked and the rotation was found
+
+
+      // Remove matches from the 2 connectivity tables and add to the interface
+      i2c.add_row(elems);
+      fnb.add_row(face_nb);
+      bdry.add_row(false);
+      cell_rotation.add_row(rotation);
+      cell_orientation.add_row(orientation);
+
+      buf_f2c [face1.comp]->rm_row(face1.idx);
+      buf_f2c [face2.comp]->rm_row(face2.idx);
+      buf_fnb [face1.comp]->rm_row(face1.idx);
+      buf_fnb [face2.comp]->rm_row(face2.idx);
+      buf_bdry[face1.comp]->rm_row(face1.idx);
+      buf_bdry[face2.comp]->rm_row(face2.idx);
+      buf_cell_orientation[face1.comp]->rm_row(face1.idx);
+      buf_cell_orientation[face2.comp]->rm_row(face2.idx);
+      buf_cell_rotation[face1.comp]->rm_row(face1.idx);
+      buf_cell_rotation[face2.comp]->rm_row(face2.idx);
     }
-    ++faces1_idx;
   }
 
   return interface;
@@ -592,7 +589,6 @@ boost::shared_ptr< FaceCellConnectivity > BuildFaces::match_faces(Region& region
 
 void BuildFaces::match_boundary(Region& bdry_region, Region& inner_region)
 {
-  Mesh& mesh = *m_mesh;
   const Uint INNER=0;
   // create buffers for each face_cell_connectivity of unified_inner_faces_to_cells
   std::map<FaceCellConnectivity*,boost::shared_ptr<common::Table<Uint>::Buffer> >  buf_inner_face_nb;
@@ -601,9 +597,6 @@ void BuildFaces::match_boundary(Region& bdry_region, Region& inner_region)
   std::map<FaceCellConnectivity*,boost::shared_ptr<common::Table<bool>::Buffer> >  buf_inner_orientation;
   std::map<FaceCellConnectivity*,boost::shared_ptr<common::Table<Uint>::Buffer> >  buf_inner_rotation;
 
-  // Build a node to face connectivity matching faces2
-  boost::shared_ptr<Node2FaceCellConnectivity> nodes_to_inner_faces_ptr = allocate_component<Node2FaceCellConnectivity>("node2faces");
-  Node2FaceCellConnectivity& nodes_to_inner_faces = *nodes_to_inner_faces_ptr;
   boost_foreach(FaceCellConnectivity& f2c, find_components_recursively_with_tag<FaceCellConnectivity>(inner_region,mesh::Tags::inner_faces()))
   {
     buf_inner_face_nb          [&f2c] = boost::shared_ptr<common::Table<Uint>::Buffer> ( new common::Table<Uint>::Buffer(f2c.face_number().create_buffer()));
@@ -611,11 +604,10 @@ void BuildFaces::match_boundary(Region& bdry_region, Region& inner_region)
     buf_inner_face_connectivity[&f2c] = boost::shared_ptr<ElementConnectivity::Buffer> ( new ElementConnectivity::Buffer(f2c.connectivity().create_buffer()));
     buf_inner_rotation          [&f2c] = boost::shared_ptr<common::Table<Uint>::Buffer> ( new common::Table<Uint>::Buffer(f2c.cell_rotation().create_buffer()));
     buf_inner_orientation       [&f2c] = boost::shared_ptr<common::Table<bool>::Buffer> ( new common::Table<bool>::Buffer(f2c.cell_orientation().create_buffer()));
-
-    nodes_to_inner_faces.add_used(f2c);
   }
-  nodes_to_inner_faces.set_nodes(mesh.geometry_fields());
-  nodes_to_inner_faces.build_connectivity();
+
+  // Hash the inner faces on their nodes
+  const detail::InnerFaceTable inner_faces(inner_region);
 
   boost_foreach(Elements& bdry_faces, find_components<Elements>(bdry_region))
   {
@@ -645,101 +637,61 @@ void BuildFaces::match_boundary(Region& bdry_region, Region& inner_region)
     // the bdry_face_connectivity table
     std::vector<Entity> elems(1);
 
-    // initialize a counter for see if matches are found.
-    // A match is found if every node of a boundary face is also found in an inner_face
-    Uint nb_matches(0);
+    // A match is found if the nodes of a boundary face are the nodes of an inner face
+    std::vector<Uint> bdry_face_nodes;
     for (Uint idx=0; idx<bdry_faces.size(); ++idx)
     {
       Entity bdry_entity(bdry_faces,idx);
-      Connectivity::ConstRow bdry_face_nodes = bdry_entity.get_nodes();
+      Connectivity::ConstRow bdry_face_row = bdry_entity.get_nodes();
+      bdry_face_nodes.assign(bdry_face_row.begin(), bdry_face_row.end());
       const Uint nb_nodes_per_face = bdry_face_nodes.size();
 
-      std::map<Face2Cell,Uint,FaceCompare> found_faces;
-      std::map<Face2Cell,Uint,FaceCompare>::iterator not_found = found_faces.end();
+      const Uint match = inner_faces.find(bdry_face_nodes);
+      if (match == math::Consts::uint_max())
+        continue;
+
+      Face2Cell inner_face = inner_faces.faces[match];
+      elems[INNER] = inner_face.cells()[INNER];
 
-      bool match_found = false;
-      boost_foreach(const Uint bdry_face_node, bdry_face_nodes)
+      // Remove matches from the inner_faces_connectivity tables and add to the boundary
+      bdry_face_connectivity.set_row(bdry_entity.idx,elems);
+      bdry_face_nb[bdry_entity.idx][INNER] = inner_face.face_nb_in_cells()[INNER];
+      bdry_face_is_bdry[bdry_entity.idx] = true;
+
+      if (nb_nodes_per_face == 1)
       {
-        boost_foreach( Face2Cell& inner_face, nodes_to_inner_faces.connectivity()[bdry_face_node])
+        bdry_rotation[bdry_entity.idx][INNER] = 0;
+        bdry_orientation[bdry_entity.idx][INNER] = FaceCellConnectivity::MATCHED;
+      }
+      else
+      {
+        std::vector<Uint> inner_face_nodes = inner_face.nodes();
+        Uint rot;
+        for (rot=0; rot!=nb_nodes_per_face; ++rot)
         {
-          std::map<Face2Cell,Uint,FaceCompare>::iterator it = found_faces.find(inner_face);
-          if ( it == not_found)
+          if (inner_face_nodes[rot] == bdry_face_nodes[0])
           {
-            found_faces[inner_face]=1;
-
-            it = found_faces.find(inner_face);
-
-            if (nb_nodes_per_face == 1)
-            {
-              match_found = true;
-              elems[INNER] = inner_face.cells()[INNER];
-
-              // Remove matches from the inner_faces_connectivity tables and add to the boundary
-              bdry_face_connectivity.set_row(bdry_entity.idx,elems);
-              bdry_face_nb[bdry_entity.idx][INNER] = inner_face.face_nb_in_cells()[INNER];
-              bdry_face_is_bdry[bdry_entity.idx] = true;
-              bdry_rotation[bdry_entity.idx][INNER] = 0;
-              bdry_orientation[bdry_entity.idx][INNER] = FaceCellConnectivity::MATCHED;
-
-              buf_inner_face_connectivity[inner_face.comp]->rm_row(inner_face.idx);
-              buf_inner_face_nb[inner_face.comp]->rm_row(inner_face.idx);
-              buf_inner_face_is_bdry[inner_face.comp]->rm_row(inner_face.idx);
-              buf_inner_orientation[inner_face.comp]->rm_row(inner_face.idx);
-              buf_inner_rotation[inner_face.comp]->rm_row(inner_face.idx);
-
-              ++nb_matches;
-              break;
-            }
-          }
-          else
-          {
-            Uint& nb_faces = it->second;
-            ++nb_faces;
-
-            if (nb_faces == nb_nodes_per_face)
-            {
-              match_found = true;
-              elems[0] = inner_face.cells()[INNER];
-
-              // Remove matches from the inner_faces_connectivity tables and add to the boundary
-              bdry_face_connectivity.set_row(bdry_entity.idx,elems);
-              bdry_face_nb[bdry_entity.idx][INNER] = inner_face.face_nb_in_cells()[INNER];
-              bdry_face_is_bdry[bdry_entity.idx] = true;
-
-              std::vector<Uint> inner_face_nodes = inner_face.nodes();
-              Uint rot;
-              for (rot=0; rot<=nb_nodes_per_face; ++rot)
-              {
-                if (inner_face_nodes[rot] == bdry_face_nodes[0])
-                {
-                  bdry_rotation[bdry_entity.idx][INNER] = rot;
-                  break;
-                }
-              }
-
-              // Now find the orientation (outward or inward)
-              Uint next_node = rot+1;
-              if (next_node == nb_nodes_per_face)
-                next_node = 0;
-              if (inner_face_nodes[next_node]==bdry_face_nodes[1])
-                bdry_orientation[bdry_entity.idx][INNER] = FaceCellConnectivity::MATCHED;
-              else
-                bdry_orientation[bdry_entity.idx][INNER] = FaceCellConnectivity::INVERTED;
-
-              buf_inner_face_connectivity[inner_face.comp]->rm_row(inner_face.idx);
-              buf_inner_face_nb[inner_face.comp]->rm_row(inner_face.idx);
-              buf_inner_face_is_bdry[inner_face.comp]->rm_row(inner_face.idx);
-              buf_inner_orientation[inner_face.comp]->rm_row(inner_face.idx);
-              buf_inner_rotation[inner_face.comp]->rm_row(inner_face.idx);
-
-              ++nb_matches;
-              break;
-            }
+            bdry_rotation[bdry_entity.idx][INNER] = rot;
+            break;
           }
         }
-        if (match_found)
-          break;
+        cf3_assert(rot != nb_nodes_per_face);
+
+        // Now find the orientation (outward or inward)
+        Uint next_node = rot+1;
+        if (next_node == nb_nodes_per_face)
+          next_node = 0;
+        if (inner_face_nodes[next_node]==bdry_face_nodes[1])
+          bdry_orientation[bdry_entity.idx][INNER] = FaceCellConnectivity::MATCHED;
+        else
+          bdry_orientation[bdry_entity.idx][INNER] = FaceCellConnectivity::INVERTED;
       }
+
+      buf_inner_face_connectivity[inner_face.comp]->rm_row(inner_face.idx);
+      buf_inner_face_nb[inner_face.comp]->rm_row(inner_face.idx);
+      buf_inner_face_is_bdry[inner_face.comp]->rm_row(inner_face.idx);
+      buf_inner_orientation[inner_face.comp]->rm_row(inner_face.idx);
+      buf_inner_rotation[inner_face.comp]->rm_row(inner_face.idx);
     }
   }
 
@@ -17,7 +17,6 @@
 #include "common/OptionT.hpp"
 
 #include "math/VariablesDescriptor.hpp"
-#include "math/VectorialFunction.hpp"
 
 #include "mesh/AInterpolator.hpp"
 #include "mesh/LoadMesh.hpp"
@@ -212,17 +212,26 @@ Handle<Field> CreateField::create_field(const std::string& name, Dictionary& dic
   vectorial_function.parse();
 
 
-  // Evaluate function
+  // Evaluate function, for a chunk of points at a time
 
-  std::vector<Real> params(var_names.size());
-  for (Uint pt=0; pt<new_field.size(); ++pt)
+  const Uint chunk_size = 1024;
+  RealMatrix params;
+  RealMatrix values;
+  for (Uint begin=0; begin<new_field.size(); begin+=chunk_size)
   {
-    for (Uint v=0; v<params.size(); ++v)
+    const Uint nb_points = std::min(chunk_size, static_cast<Uint>(new_field.size())-begin);
+    params.resize(nb_points, var_names.size());
+    for (Uint v=0; v<var_names.size(); ++v)
     {
-      params[v] = (*var_arrays[v])[pt][var_array_idx[v]];
+      for (Uint pt=0; pt<nb_points; ++pt)
+        params(pt,v) = (*var_arrays[v])[begin+pt][var_array_idx[v]];
+    }
+    vectorial_function.evaluate_batch(params,values);
+    for (Uint pt=0; pt<nb_points; ++pt)
+    {
+      for (Uint f=0; f<new_field.row_size(); ++f)
+        new_field.array()[begin+pt][f] = values(pt,f);
     }
-    Table<Real>::ArrayT::reference ref = new_field.array()[pt];
-    vectorial_function.evaluate(params,ref);
   }
 
   return new_field.handle<Field>();
@@ -0,0 +1,261 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#include <algorithm>
+
+#include "common/Builder.hpp"
+#include "common/Foreach.hpp"
+#include "common/OptionList.hpp"
+#include "common/PropertyList.hpp"
+#include "common/PE/Comm.hpp"
+
+#include "math/Hilbert.hpp"
+
+#include "mesh/BoundingBox.hpp"
+#include "mesh/ElementType.hpp"
+#include "mesh/Entities.hpp"
+#include "mesh/Mesh.hpp"
+#include "mesh/Space.hpp"
+
+#include "mesh/actions/HilbertPartitioner.hpp"
+
+//////////////////////////////////////////////////////////////////////////////
+
+namespace cf3 {
+namespace mesh {
+namespace actions {
+
+using namespace common;
+
+////////////////////////////////////////////////////////////////////////////////
+
+common::ComponentBuilder < HilbertPartitioner, MeshTransformer, mesh::actions::LibActions> HilbertPartitioner_Builder;
+
+//////////////////////////////////////////////////////////////////////////////
+
+namespace detail
+{
+  /// Orders local elements by their key, and by their index for equal keys
+  struct KeyLess
+  {
+    KeyLess(const std::vector<boost::uint64_t>& keys) : m_keys(keys) {}
+    bool operator()(const Uint a, const Uint b) const { return m_keys[a] < m_keys[b] || (m_keys[a] == m_keys[b] && a < b); }
+    const std::vector<boost::uint64_t>& m_keys;
+  };
+
+  /// Element received during the sample sort, with the rank it came from and its position in the message
+  struct CurvePoint
+  {
+    boost::uint64_t key;
+    Uint rank;
+    Uint idx;
+    Real weight;
+    bool operator<(const CurvePoint& other) const
+    {
+      if (key != other.key)
+        return key < other.key;
+      if (rank != other.rank)
+        return rank < other.rank;
+      return idx < other.idx;
+    }
+  };
+
+  /// Maximum number of samples taken by each processor to compute the splitters
+  const Uint max_nb_samples = 64;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+HilbertPartitioner::HilbertPartitioner( const std::string& name ) : MeshPartitioner(name)
+{
+  properties()["brief"] = std::string("Partition the mesh along a Hilbert space filling curve");
+  properties()["description"] = std::string("Elements are sorted in parallel by the Hilbert code of their centroid, "
+                                            "and the curve is cut in parts of equal weight.");
+
+  options().add("weighted", true)
+      .description("Balance the element weights (see element_weights and timing_property) instead of the number of elements")
+      .pretty_name("Weighted")
+      .mark_basic();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void HilbertPartitioner::build_graph()
+{
+  const Mesh& mesh = *m_mesh;
+  const bool weighted = options().value<bool>("weighted");
+  math::Hilbert hilbert(*mesh.global_bounding_box(), 20);
+
+  m_keys.clear();
+  m_weights.clear();
+  m_entities_idx.clear();
+  m_element_idx.clear();
+  for (Uint c=0; c<mesh.elements().size(); ++c)
+  {
+    const Entities& entities = *mesh.elements()[c];
+    const ElementType& etype = entities.element_type();
+    const Real weight = weighted ? weight_per_component()[c+1] : 1.;
+    RealMatrix element_coordinates(etype.nb_nodes(), etype.dimension());
+    RealVector centroid(etype.dimension());
+    for (Uint e=0; e<entities.size(); ++e)
+    {
+      entities.geometry_space().put_coordinates(element_coordinates, e);
+      etype.compute_centroid(element_coordinates, centroid);
+      m_keys.push_back(hilbert(centroid));
+      m_weights.push_back(weight);
+      m_entities_idx.push_back(c);
+      m_element_idx.push_back(e);
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void HilbertPartitioner::compute_splitters(const std::vector<Uint>& order, std::vector<boost::uint64_t>& splitters) const
+{
+  const Uint nb_ranks = PE::Comm::instance().size();
+
+  // Keys at regular intervals of the local weight, each representing an equal share of it
+  Real local_weight = 0.;
+  boost_foreach(const Real w, m_weights)
+    local_weight += w;
+  const Uint nb_samples = order.empty() ? 0 : std::min(2*nb_ranks, detail::max_nb_samples);
+  std::vector<boost::uint64_t> sample_keys;
+  std::vector<Real> sample_weights;
+  Real cumulative_weight = 0.;
+  for (Uint i=0, s=0; i<order.size() && s<nb_samples; ++i)
+  {
+    cumulative_weight += m_weights[order[i]];
+    while (s < nb_samples && cumulative_weight >= (s+0.5)*local_weight/nb_samples)
+    {
+      sample_keys.push_back(m_keys[order[i]]);
+      sample_weights.push_back(local_weight/nb_samples);
+      ++s;
+    }
+  }
+
+  std::vector< std::vector<boost::uint64_t> > all_sample_keys;
+  std::vector< std::vector<Real> > all_sample_weights;
+  PE::Comm::instance().all_gather(sample_keys, all_sample_keys);
+  PE::Comm::instance().all_gather(sample_weights, all_sample_weights);
+
+  std::vector< std::pair<boost::uint64_t,Real> > samples;
+  for (Uint r=0; r<nb_ranks; ++r)
+    for (Uint s=0; s<all_sample_keys[r].size(); ++s)
+      samples.push_back(std::make_pair(all_sample_keys[r][s], all_sample_weights[r][s]));
+  std::sort(samples.begin(), samples.end());
+
+  Real total_weight = 0.;
+  for (Uint s=0; s<samples.size(); ++s)
+    total_weight += samples[s].second;
+
+  // Processor p receives the keys in [splitters[p-1], splitters[p])
+  splitters.clear();
+  cumulative_weight = 0.;
+  for (Uint s=0; s<samples.size() && splitters.size()+1<nb_ranks; ++s)
+  {
+    cumulative_weight += samples[s].second;
+    while (splitters.size()+1 < nb_ranks && cumulative_weight >= (splitters.size()+1)*total_weight/nb_ranks)
+      splitters.push_back(samples[s].first);
+  }
+  splitters.resize(nb_ranks-1, samples.empty() ? 0 : samples.back().first);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void HilbertPartitioner::partition_graph()
+{
+  const Uint nb_ranks = PE::Comm::instance().size();
+  const Uint rank = PE::Comm::instance().rank();
+  const Uint nb_parts = options().value<Uint>("nb_parts");
+
+  // 1) Sort the local elements along the curve, and send them to the processor sorting their range of keys
+  std::vector<Uint> order(m_keys.size());
+  for (Uint i=0; i<order.size(); ++i)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), detail::KeyLess(m_keys));
+
+  std::vector<boost::uint64_t> splitters;
+  compute_splitters(order, splitters);
+
+  std::vector< std::vector<boost::uint64_t> > send_keys(nb_ranks);
+  std::vector< std::vector<Real> > send_weights(nb_ranks);
+  for (Uint i=0; i<order.size(); ++i)
+  {
+    const Uint dest = std::upper_bound(splitters.begin(), splitters.end(), m_keys[order[i]]) - splitters.begin();
+    send_keys[dest].push_back(m_keys[order[i]]);
+    send_weights[dest].push_back(m_weights[order[i]]);
+  }
+  std::vector< std::vector<boost::uint64_t> > recv_keys;
+  std::vector< std::vector<Real> > recv_weights;
+  PE::Comm::instance().all_to_all(send_keys, recv_keys);
+  PE::Comm::instance().all_to_all(send_weights, recv_weights);
+
+  // 2) Sort the received range of the curve
+  std::vector<detail::CurvePoint> points;
+  for (Uint r=0; r<nb_ranks; ++r)
+  {
+    for (Uint j=0; j<recv_keys[r].size(); ++j)
+    {
+      detail::CurvePoint point;
+      point.key = recv_keys[r][j];
+      point.rank = r;
+      point.idx = j;
+      point.weight = recv_weights[r][j];
+      points.push_back(point);
+    }
+  }
+  std::sort(points.begin(), points.end());
+
+  // 3) Cut the curve in parts of equal weight, using the weight of the ranges sorted by the lower processors
+  Real local_weight = 0.;
+  boost_foreach(const detail::CurvePoint& point, points)
+    local_weight += point.weight;
+  std::vector<Real> weight_per_rank;
+  PE::Comm::instance().all_gather(local_weight, weight_per_rank);
+  Real offset = 0.;
+  Real total_weight = 0.;
+  for (Uint r=0; r<nb_ranks; ++r)
+  {
+    if (r < rank)
+      offset += weight_per_rank[r];
+    total_weight += weight_per_rank[r];
+  }
+
+  std::vector< std::vector<Uint> > send_parts(nb_ranks);
+  for (Uint r=0; r<nb_ranks; ++r)
+    send_parts[r].resize(recv_keys[r].size());
+  Real cumulative_weight = offset;
+  boost_foreach(const detail::CurvePoint& point, points)
+  {
+    const Real middle = cumulative_weight + 0.5*point.weight;
+    send_parts[point.rank][point.idx] = std::min(nb_parts-1, static_cast<Uint>(middle / total_weight * nb_parts));
+    cumulative_weight += point.weight;
+  }
+
+  // 4) Return the parts, in the order the elements were sent
+  std::vector< std::vector<Uint> > recv_parts;
+  PE::Comm::instance().all_to_all(send_parts, recv_parts);
+
+  Uint i = 0;
+  for (Uint r=0; r<nb_ranks; ++r)
+  {
+    cf3_assert(recv_parts[r].size() == send_keys[r].size());
+    boost_foreach(const Uint part, recv_parts[r])
+    {
+      const Uint elem = order[i++];
+      if (part != rank)
+        m_elements_to_export[part][m_entities_idx[elem]].push_back(m_element_idx[elem]);
+    }
+  }
+  cf3_assert(i == order.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // actions
+} // mesh
+} // cf3
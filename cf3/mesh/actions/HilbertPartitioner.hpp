@@ -0,0 +1,73 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#ifndef cf3_mesh_actions_HilbertPartitioner_hpp
+#define cf3_mesh_actions_HilbertPartitioner_hpp
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <boost/cstdint.hpp>
+
+#include "mesh/MeshPartitioner.hpp"
+
+#include "mesh/actions/LibActions.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace cf3 {
+namespace mesh {
+namespace actions {
+
+//////////////////////////////////////////////////////////////////////////////
+
+/// @brief Partition the mesh along a Hilbert space filling curve, without external library
+///
+/// The elements are keyed by the Hilbert code of their centroid in the global bounding box, as in GlobalNumbering.
+/// A parallel sample sort then distributes the keys over the processors in curve order, after which the curve is
+/// cut in nb_parts chunks of equal total weight. The weights are the element weights of MeshPartitioner, or 1 if
+/// the "weighted" option is off. The nodes are not partitioned, they follow the elements when migrating.
+/// This is cheaper than graph partitioning, so it can be used for frequent repartitioning, at the cost of a
+/// larger interface between the parts.
+class mesh_actions_API HilbertPartitioner : public MeshPartitioner
+{
+public: // functions
+
+  /// constructor
+  HilbertPartitioner( const std::string& name );
+
+  /// Gets the Class name
+  static std::string type_name() { return "HilbertPartitioner"; }
+
+  /// Compute the Hilbert key and weight of every local element
+  virtual void build_graph();
+
+  /// Sort the keys over all processors and assign the elements to the parts
+  virtual void partition_graph();
+
+private: // functions
+
+  /// Splitters between the keys sent to consecutive processors, from a weighted sample of the sorted local keys
+  void compute_splitters(const std::vector<Uint>& order, std::vector<boost::uint64_t>& splitters) const;
+
+private: // data
+
+  /// Hilbert key, weight, Entities index in mesh.elements() and element index of every local element
+  std::vector<boost::uint64_t> m_keys;
+  std::vector<Real> m_weights;
+  std::vector<Uint> m_entities_idx;
+  std::vector<Uint> m_element_idx;
+
+}; // end HilbertPartitioner
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // actions
+} // mesh
+} // cf3
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // cf3_mesh_actions_HilbertPartitioner_hpp
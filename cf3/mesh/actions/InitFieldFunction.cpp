@@ -17,7 +17,6 @@
 #include "common/PropertyList.hpp"
 #include "common/Signal.hpp"
 #include "common/XML/SignalOptions.hpp"
-#include "math/AnalyticalFunction.hpp"
 
 #include "mesh/actions/InitFieldFunction.hpp"
 #include "mesh/Elements.hpp"
@@ -186,36 +185,49 @@ void InitFieldFunction::execute()
   }
 
   // create the functions
-  std::vector<math::AnalyticalFunction> functions(option_functions.size());
-  for (Uint f=0; f<functions.size(); ++f)
+  for (Uint f=0; f<option_functions.size(); ++f)
   {
     // check: columns must be of index smaller than index of field
     if (cols[f] >= m_field->row_size()) throw SetupError(FromHere(), "Specified column ["+to_str(cols[f])+"] doesn't exist. (field has only "+to_str(m_field->row_size())+" cols)");
-    functions[f].parse(option_functions[f],variable_names);
   }
+  math::VectorialFunction functions;
+  functions.functions(option_functions);
+  functions.variables(variable_names);
+  functions.parse();
 
   std::vector<Real> constants;
   constants.push_back( options().value<Real>("time") );
 
-  std::vector<Real> variables(variable_names.size());
-
-  for (Uint pt=0; pt<dict.size(); ++pt)
+  // Evaluate the functions for a chunk of points at a time
+  const Uint chunk_size = 1024;
+  RealMatrix variables;
+  RealMatrix values;
+  for (Uint begin=0; begin<dict.size(); begin+=chunk_size)
   {
+    const Uint nb_points = std::min(chunk_size, dict.size()-begin);
+
     // Assemble variables per point
+    variables.resize(nb_points, variable_names.size());
     Uint c=0;
     for (Uint j=0; j<field_comps.size(); ++j, ++c)
     {
-      variables[c] = field_comps[j]->array()[pt][field_cols[j]];
+      const Table<Real>::ArrayT& array = field_comps[j]->array();
+      for (Uint pt=0; pt<nb_points; ++pt)
+        variables(pt,c) = array[begin+pt][field_cols[j]];
     }
     for (Uint j=0; j<constants.size(); ++j, ++c)
     {
-      variables[c] = constants[j];
+      variables.col(c).setConstant(constants[j]);
     }
 
     // Evaluate functions
-    for (Uint f=0; f<cols.size(); ++f)
+    functions.evaluate_batch(variables, values);
+    for (Uint pt=0; pt<nb_points; ++pt)
     {
-      m_field->array()[pt][f] = functions[f](variables);
+      for (Uint f=0; f<cols.size(); ++f)
+      {
+        m_field->array()[begin+pt][f] = values(pt,f);
+      }
     }
   }
 }
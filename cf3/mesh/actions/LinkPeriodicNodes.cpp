@@ -279,6 +279,8 @@ void LinkPeriodicNodes::execute()
     periodic_link->link_to(const_cast<Elements&>(*elements_to_link));
     cf3_always_assert(nb_elements == elements_to_link->size());
   }
+
+  mesh.raise_periodic_links_changed();
 }
 
 //////////////////////////////////////////////////////////////////////////////
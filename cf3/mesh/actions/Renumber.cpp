@@ -0,0 +1,517 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#include <algorithm>
+
+#include "common/Builder.hpp"
+#include "common/CompressedTable.hpp"
+#include "common/DynTable.hpp"
+#include "common/FindComponents.hpp"
+#include "common/Foreach.hpp"
+#include "common/Link.hpp"
+#include "common/List.hpp"
+#include "common/OptionList.hpp"
+#include "common/PropertyList.hpp"
+
+#include "math/Consts.hpp"
+#include "math/Hilbert.hpp"
+#include "math/MatrixTypesConversion.hpp"
+
+#include "mesh/BoundingBox.hpp"
+#include "mesh/Connectivity.hpp"
+#include "mesh/Dictionary.hpp"
+#include "mesh/ElementType.hpp"
+#include "mesh/Entities.hpp"
+#include "mesh/FaceCellConnectivity.hpp"
+#include "mesh/Field.hpp"
+#include "mesh/Mesh.hpp"
+#include "mesh/Space.hpp"
+
+#include "mesh/actions/Renumber.hpp"
+
+//////////////////////////////////////////////////////////////////////////////
+
+namespace cf3 {
+namespace mesh {
+namespace actions {
+
+  using namespace common;
+  using namespace math::Consts;
+
+////////////////////////////////////////////////////////////////////////////////
+
+common::ComponentBuilder < Renumber, MeshTransformer, mesh::actions::LibActions> Renumber_Builder;
+
+//////////////////////////////////////////////////////////////////////////////
+
+namespace detail
+{
+
+/// Copy row i of the table to row new_idx[i]
+template<typename T>
+void permute_rows(Table<T>& table, const std::vector<Uint>& new_idx)
+{
+  cf3_assert(table.size() == new_idx.size());
+  const typename Table<T>::ArrayT old_rows(table.array());
+  for (Uint i=0; i<new_idx.size(); ++i)
+    table[new_idx[i]] = old_rows[i];
+}
+
+/// Copy entry i of the list to entry new_idx[i]. Lists of another size are not indexed by these rows and are skipped.
+template<typename T>
+void permute_list(List<T>& list, const std::vector<Uint>& new_idx)
+{
+  if (list.size() != new_idx.size())
+    return;
+  const std::vector<T> old_values(list.array().begin(), list.array().end());
+  for (Uint i=0; i<new_idx.size(); ++i)
+    list[new_idx[i]] = old_values[i];
+}
+
+/// Remove a cached child component, which would refer to the old numbering
+void remove_child(Component& parent, const std::string& name)
+{
+  if (is_not_null(parent.get_child(name)))
+    parent.remove_component(name);
+}
+
+/// Orders graph nodes by increasing degree
+struct DegreeLess
+{
+  DegreeLess(const CompressedTable<Uint>& graph) : m_graph(graph) {}
+
+  bool operator()(const Uint a, const Uint b) const
+  {
+    const Uint degree_a = m_graph.row_size(a);
+    const Uint degree_b = m_graph.row_size(b);
+    return degree_a < degree_b || (degree_a == degree_b && a < b);
+  }
+
+  const CompressedTable<Uint>& m_graph;
+};
+
+/// Breadth-first search from root, visiting the neighbours of each node in order of increasing degree.
+/// Nodes with a level different from uint_max are considered as visited already.
+/// The visited nodes are appended to visited_nodes.
+/// @return The number of levels
+Uint breadth_first(const CompressedTable<Uint>& graph, const Uint root, std::vector<Uint>& level, std::vector<Uint>& visited_nodes)
+{
+  cf3_assert(level[root] == uint_max());
+  const Uint begin = visited_nodes.size();
+  level[root] = 0;
+  visited_nodes.push_back(root);
+  std::vector<Uint> neighbours;
+  for (Uint i=begin; i<visited_nodes.size(); ++i)
+  {
+    const Uint node = visited_nodes[i];
+    neighbours.clear();
+    boost_foreach(const Uint neighbour, graph[node])
+    {
+      if (level[neighbour] == uint_max())
+      {
+        level[neighbour] = level[node] + 1;
+        neighbours.push_back(neighbour);
+      }
+    }
+    std::sort(neighbours.begin(), neighbours.end(), DegreeLess(graph));
+    visited_nodes.insert(visited_nodes.end(), neighbours.begin(), neighbours.end());
+  }
+  return level[visited_nodes.back()] + 1;
+}
+
+/// Node with the lowest degree in the last level of a breadth-first search
+Uint lowest_degree_in_last_level(const CompressedTable<Uint>& graph, const std::vector<Uint>& visited_nodes, const std::vector<Uint>& level)
+{
+  const Uint last_level = level[visited_nodes.back()];
+  Uint result = visited_nodes.back();
+  for (Uint i=visited_nodes.size(); i-- != 0 && level[visited_nodes[i]] == last_level; )
+  {
+    if (DegreeLess(graph)(visited_nodes[i], result))
+      result = visited_nodes[i];
+  }
+  return result;
+}
+
+void reset_levels(const std::vector<Uint>& visited_nodes, std::vector<Uint>& level)
+{
+  boost_foreach(const Uint node, visited_nodes)
+    level[node] = uint_max();
+}
+
+/// Convert an ordering of the rows of a dictionary to the new index of each row, placing the ghost rows last
+void ordering_to_new_idx(const Dictionary& dict, const std::vector<Uint>& ordering, std::vector<Uint>& new_idx)
+{
+  new_idx.assign(ordering.size(), uint_max());
+  Uint next_idx = 0;
+  boost_foreach(const Uint row, ordering)
+  {
+    if (!dict.is_ghost(row))
+      new_idx[row] = next_idx++;
+  }
+  boost_foreach(const Uint row, ordering)
+  {
+    if (dict.is_ghost(row))
+      new_idx[row] = next_idx++;
+  }
+  cf3_assert(next_idx == dict.size());
+}
+
+/// Convert a list of (key, old index) pairs to the new index of each entry, in order of increasing key
+template<typename KeyT>
+void sorted_keys_to_new_idx(std::vector< std::pair<KeyT, Uint> >& keys, std::vector<Uint>& new_idx)
+{
+  std::sort(keys.begin(), keys.end());
+  new_idx.resize(keys.size());
+  for (Uint i=0; i<keys.size(); ++i)
+    new_idx[keys[i].second] = i;
+}
+
+} // detail
+
+//////////////////////////////////////////////////////////////////////////////
+
+Renumber::Renumber( const std::string& name )
+: MeshTransformer(name)
+{
+  properties()["brief"] = std::string("Reorder nodes and elements to improve memory locality");
+  properties()["description"] = std::string("Nodes are ordered using Reverse Cuthill-McKee or a Hilbert curve, "
+                                            "elements are sorted within each Entities accordingly");
+
+  options().add("ordering", std::string("rcm"))
+      .pretty_name("Ordering")
+      .description("Node ordering: rcm (Reverse Cuthill-McKee) or hilbert (Hilbert space filling curve)")
+      .mark_basic();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Renumber::execute()
+{
+  Mesh& mesh = *m_mesh;
+
+  const std::string ordering = options().value<std::string>("ordering");
+  if (ordering != "rcm" && ordering != "hilbert")
+    throw BadValue(FromHere(), "Unknown ordering " + ordering + " for " + uri().path() + ", use rcm or hilbert");
+
+  if (is_not_null(find_component_ptr_recursively<FaceCellConnectivity>(mesh)))
+    throw SetupError(FromHere(), "Mesh " + mesh.uri().path() + " has face connectivities, which are not renumbered. " + uri().path() + " must be executed before BuildFaces");
+
+  std::vector<Uint> new_idx;
+
+  // Geometry nodes
+  if (ordering == "rcm")
+    rcm_node_ordering(new_idx);
+  else
+    hilbert_node_ordering(new_idx);
+  permute_nodes(mesh.geometry_fields(), new_idx);
+
+  // Elements
+  boost_foreach(const Handle<Entities>& elements, mesh.elements())
+  {
+    if (ordering == "rcm")
+      lowest_node_element_ordering(*elements, new_idx);
+    else
+      hilbert_element_ordering(*elements, new_idx);
+    permute_elements(*elements, new_idx);
+  }
+
+  // Other dictionaries follow the elements
+  boost_foreach(const Handle<Dictionary>& dict, mesh.dictionaries())
+  {
+    if (dict.get() == &mesh.geometry_fields())
+      continue;
+    first_use_ordering(*dict, new_idx);
+    permute_nodes(*dict, new_idx);
+  }
+
+  // Cached lookup structures refer to the old numbering
+  std::vector< Handle< List<Uint> > > used_nodes_lists;
+  boost_foreach(List<Uint>& used_nodes, find_components_recursively_with_tag< List<Uint> >(mesh, mesh::Tags::nodes_used()))
+    used_nodes_lists.push_back(used_nodes.handle< List<Uint> >());
+  boost_foreach(const Handle< List<Uint> >& used_nodes, used_nodes_lists)
+    used_nodes->parent()->remove_component(*used_nodes);
+  detail::remove_child(mesh, "octtree");
+
+  mesh.raise_mesh_changed();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Renumber::permute_nodes(Dictionary& dict, const std::vector<Uint>& new_idx)
+{
+  const Uint nb_rows = dict.size();
+  cf3_assert(new_idx.size() == nb_rows);
+
+  boost_foreach(const Handle<Field>& field, dict.fields())
+    detail::permute_rows(*field, new_idx);
+  detail::permute_list(dict.glb_idx(), new_idx);
+  detail::permute_list(dict.rank(), new_idx);
+
+  Handle< DynTable<Uint> > glb_elem_connectivity(dict.get_child("glb_elem_connectivity"));
+  if (is_not_null(glb_elem_connectivity) && glb_elem_connectivity->size() == nb_rows)
+  {
+    DynTable<Uint>::ArrayT old_rows(nb_rows);
+    old_rows.swap(glb_elem_connectivity->array());
+    for (Uint i=0; i<nb_rows; ++i)
+      glb_elem_connectivity->array()[new_idx[i]].swap(old_rows[i]);
+  }
+
+  // Periodic links refer to other rows of the same dictionary
+  Handle< List<Uint> > periodic_links_nodes(dict.get_child("periodic_links_nodes"));
+  Handle< List<bool> > periodic_links_active(dict.get_child("periodic_links_active"));
+  if (is_not_null(periodic_links_nodes) && is_not_null(periodic_links_active))
+  {
+    for (Uint i=0; i<periodic_links_nodes->size(); ++i)
+    {
+      if ((*periodic_links_active)[i])
+        (*periodic_links_nodes)[i] = new_idx[(*periodic_links_nodes)[i]];
+    }
+    detail::permute_list(*periodic_links_nodes, new_idx);
+    detail::permute_list(*periodic_links_active, new_idx);
+  }
+
+  boost_foreach(const Handle<Space>& space, dict.spaces())
+  {
+    Connectivity& connectivity = space->connectivity();
+    const Uint row_size = connectivity.row_size();
+    for (Uint e=0; e<connectivity.size(); ++e)
+    {
+      Connectivity::Row row = connectivity[e];
+      for (Uint j=0; j<row_size; ++j)
+        row[j] = new_idx[row[j]];
+    }
+  }
+
+  detail::remove_child(dict, "CommPattern");
+  detail::remove_child(dict, "hilbert_indices");
+  detail::remove_child(dict, "glb_node_hash");
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Renumber::permute_elements(Entities& elements, const std::vector<Uint>& new_idx)
+{
+  cf3_assert(new_idx.size() == elements.size());
+
+  boost_foreach(const Handle<Space>& space, elements.spaces())
+    detail::permute_rows(space->connectivity(), new_idx);
+  detail::permute_list(elements.glb_idx(), new_idx);
+  detail::permute_list(elements.rank(), new_idx);
+
+  Handle< List<Uint> > periodic_links_elements(elements.get_child("periodic_links_elements"));
+  if (is_not_null(periodic_links_elements))
+    detail::permute_list(*periodic_links_elements, new_idx);
+
+  // Periodic links from other elements to these elements
+  boost_foreach(Entities& linked_elements, find_components_recursively<Entities>(find_parent_component<Mesh>(elements)))
+  {
+    Handle< List<Uint> > links(linked_elements.get_child("periodic_links_elements"));
+    if (is_null(links))
+      continue;
+    Handle<Link> periodic_link(links->get_child("periodic_link"));
+    if (is_null(periodic_link) || periodic_link->follow() != elements.handle<Component>())
+      continue;
+    for (Uint i=0; i<links->size(); ++i)
+      (*links)[i] = new_idx[(*links)[i]];
+  }
+
+  detail::remove_child(elements, "hilbert_indices");
+  detail::remove_child(elements, "glb_elem_hash");
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Renumber::rcm_node_ordering(std::vector<Uint>& new_idx)
+{
+  const Dictionary& nodes = m_mesh->geometry_fields();
+  const Uint nb_nodes = nodes.size();
+
+  // Node graph, with each pair of nodes sharing an element as edge. Pairs shared by several elements are
+  // listed more than once.
+  boost::shared_ptr< CompressedTable<Uint> > node_pairs = allocate_component< CompressedTable<Uint> >("node_pairs");
+  CompressedTableBuilder<Uint> pairs_builder(*node_pairs, nb_nodes);
+  boost_foreach(const Handle<Entities>& elements, m_mesh->elements())
+  {
+    const Connectivity& connectivity = elements->geometry_space().connectivity();
+    const Uint nb_elem_nodes = connectivity.row_size();
+    boost_foreach(Connectivity::ConstRow row, connectivity.array())
+    {
+      for (Uint a=0; a<nb_elem_nodes; ++a)
+        pairs_builder.count(row[a], nb_elem_nodes-1);
+    }
+  }
+  pairs_builder.allocate();
+  boost_foreach(const Handle<Entities>& elements, m_mesh->elements())
+  {
+    const Connectivity& connectivity = elements->geometry_space().connectivity();
+    const Uint nb_elem_nodes = connectivity.row_size();
+    boost_foreach(Connectivity::ConstRow row, connectivity.array())
+    {
+      for (Uint a=0; a<nb_elem_nodes; ++a)
+      {
+        for (Uint b=0; b<nb_elem_nodes; ++b)
+        {
+          if (a != b)
+            pairs_builder.add(row[a], row[b]);
+        }
+      }
+    }
+  }
+
+  // Remove the duplicate edges, so the row size is the degree of each node
+  std::vector<Uint> nb_unique(nb_nodes);
+  for (Uint n=0; n<nb_nodes; ++n)
+  {
+    CompressedTable<Uint>::Row row = (*node_pairs)[n];
+    std::sort(row.begin(), row.end());
+    nb_unique[n] = std::unique(row.begin(), row.end()) - row.begin();
+  }
+  boost::shared_ptr< CompressedTable<Uint> > graph = allocate_component< CompressedTable<Uint> >("node_graph");
+  CompressedTableBuilder<Uint> graph_builder(*graph, nb_nodes);
+  for (Uint n=0; n<nb_nodes; ++n)
+    graph_builder.count(n, nb_unique[n]);
+  graph_builder.allocate();
+  for (Uint n=0; n<nb_nodes; ++n)
+  {
+    CompressedTable<Uint>::ConstRow row = (*node_pairs)[n];
+    for (Uint i=0; i<nb_unique[n]; ++i)
+      graph_builder.add(n, row[i]);
+  }
+  node_pairs.reset();
+
+  // Cuthill-McKee ordering of each connected component, starting from a pseudo-peripheral node
+  std::vector<Uint> start_candidates(nb_nodes);
+  for (Uint n=0; n<nb_nodes; ++n)
+    start_candidates[n] = n;
+  std::sort(start_candidates.begin(), start_candidates.end(), detail::DegreeLess(*graph));
+
+  std::vector<Uint> level(nb_nodes, uint_max());
+  std::vector<Uint> ordering;
+  ordering.reserve(nb_nodes);
+  std::vector<Uint> trial;
+  boost_foreach(const Uint start, start_candidates)
+  {
+    if (level[start] != uint_max())
+      continue;
+
+    Uint root = start;
+    trial.clear();
+    Uint nb_levels = detail::breadth_first(*graph, root, level, trial);
+    while (true)
+    {
+      const Uint candidate = detail::lowest_degree_in_last_level(*graph, trial, level);
+      detail::reset_levels(trial, level);
+      trial.clear();
+      const Uint candidate_levels = detail::breadth_first(*graph, candidate, level, trial);
+      if (candidate_levels <= nb_levels)
+      {
+        detail::reset_levels(trial, level);
+        break;
+      }
+      root = candidate;
+      nb_levels = candidate_levels;
+    }
+
+    detail::breadth_first(*graph, root, level, ordering);
+  }
+  cf3_assert(ordering.size() == nb_nodes);
+
+  std::reverse(ordering.begin(), ordering.end());
+  detail::ordering_to_new_idx(nodes, ordering, new_idx);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Renumber::hilbert_node_ordering(std::vector<Uint>& new_idx)
+{
+  const Dictionary& nodes = m_mesh->geometry_fields();
+  const Field& coordinates = nodes.coordinates();
+  math::Hilbert hilbert(*m_mesh->local_bounding_box(), 20);
+
+  std::vector< std::pair<boost::uint64_t, Uint> > keys(nodes.size());
+  RealVector coord_vec(coordinates.row_size());
+  for (Uint n=0; n<nodes.size(); ++n)
+  {
+    math::copy(coordinates[n], coord_vec);
+    keys[n] = std::make_pair(hilbert(coord_vec), n);
+  }
+  std::sort(keys.begin(), keys.end());
+
+  std::vector<Uint> ordering(nodes.size());
+  for (Uint i=0; i<keys.size(); ++i)
+    ordering[i] = keys[i].second;
+  detail::ordering_to_new_idx(nodes, ordering, new_idx);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Renumber::hilbert_element_ordering(const Entities& elements, std::vector<Uint>& new_idx)
+{
+  math::Hilbert hilbert(*m_mesh->local_bounding_box(), 20);
+
+  std::vector< std::pair<boost::uint64_t, Uint> > keys(elements.size());
+  RealMatrix element_coordinates(elements.element_type().nb_nodes(), elements.element_type().dimension());
+  RealVector centroid(elements.element_type().dimension());
+  for (Uint e=0; e<elements.size(); ++e)
+  {
+    elements.geometry_space().put_coordinates(element_coordinates, e);
+    elements.element_type().compute_centroid(element_coordinates, centroid);
+    keys[e] = std::make_pair(hilbert(centroid), e);
+  }
+  detail::sorted_keys_to_new_idx(keys, new_idx);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Renumber::lowest_node_element_ordering(const Entities& elements, std::vector<Uint>& new_idx)
+{
+  const Connectivity& connectivity = elements.geometry_space().connectivity();
+  std::vector< std::pair<Uint, Uint> > keys(connectivity.size());
+  for (Uint e=0; e<connectivity.size(); ++e)
+  {
+    Connectivity::ConstRow row = connectivity[e];
+    keys[e] = std::make_pair(*std::min_element(row.begin(), row.end()), e);
+  }
+  detail::sorted_keys_to_new_idx(keys, new_idx);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void Renumber::first_use_ordering(const Dictionary& dict, std::vector<Uint>& new_idx)
+{
+  std::vector<bool> is_used(dict.size(), false);
+  std::vector<Uint> ordering;
+  ordering.reserve(dict.size());
+  boost_foreach(const Handle<Space>& space, dict.spaces())
+  {
+    boost_foreach(Connectivity::ConstRow row, space->connectivity().array())
+    {
+      boost_foreach(const Uint i, row)
+      {
+        if (!is_used[i])
+        {
+          is_used[i] = true;
+          ordering.push_back(i);
+        }
+      }
+    }
+  }
+
+  // Rows that are not used by any element keep their relative order, at the end
+  for (Uint i=0; i<is_used.size(); ++i)
+  {
+    if (!is_used[i])
+      ordering.push_back(i);
+  }
+
+  detail::ordering_to_new_idx(dict, ordering, new_idx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // actions
+} // mesh
+} // cf3
@@ -0,0 +1,84 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#ifndef cf3_mesh_actions_Renumber_hpp
+#define cf3_mesh_actions_Renumber_hpp
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include "mesh/MeshTransformer.hpp"
+
+#include "mesh/actions/LibActions.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace cf3 {
+namespace mesh {
+
+  class Dictionary;
+  class Entities;
+
+namespace actions {
+
+//////////////////////////////////////////////////////////////////////////////
+
+/// @brief Reorder the local nodes and elements of a mesh to improve memory locality
+///
+/// The geometry nodes are ordered using either Reverse Cuthill-McKee on the node graph ("rcm"), which reduces the
+/// bandwidth of the system matrix, or the Hilbert space filling curve through the node coordinates ("hilbert").
+/// The elements of each Entities are then sorted by their lowest node (rcm) or the Hilbert code of their centroid
+/// (hilbert), and the rows of the other dictionaries are numbered in the order in which the elements first use them.
+/// In every dictionary the owned rows are placed before the ghost rows, keeping the above order within each group,
+/// so the owned rows remain a contiguous range at the start.
+/// Fields, glb_idx, rank, periodic links and all connectivities are permuted along, and the comm patterns are
+/// rebuilt on first use. The global numbering is not changed.
+/// Face connectivities are not updated, so this must be executed before BuildFaces.
+class mesh_actions_API Renumber : public MeshTransformer
+{
+public: // functions
+
+  /// constructor
+  Renumber( const std::string& name );
+
+  /// Gets the Class name
+  static std::string type_name() { return "Renumber"; }
+
+  virtual void execute();
+
+  /// Move row i of the dictionary to row new_idx[i], updating all data indexed by or referring to its rows
+  void permute_nodes(Dictionary& dict, const std::vector<Uint>& new_idx);
+
+  /// Move element i to position new_idx[i], updating all data indexed by or referring to the elements
+  void permute_elements(Entities& elements, const std::vector<Uint>& new_idx);
+
+private: // functions
+
+  /// New index of each geometry node, using Reverse Cuthill-McKee
+  void rcm_node_ordering(std::vector<Uint>& new_idx);
+
+  /// New index of each geometry node, following the Hilbert curve
+  void hilbert_node_ordering(std::vector<Uint>& new_idx);
+
+  /// New index of each element, following the Hilbert curve through the centroids
+  void hilbert_element_ordering(const Entities& elements, std::vector<Uint>& new_idx);
+
+  /// New index of each element, sorted by the lowest node index
+  void lowest_node_element_ordering(const Entities& elements, std::vector<Uint>& new_idx);
+
+  /// New index of each row of a dictionary, in order of first use by the elements, with the owned rows first
+  void first_use_ordering(const Dictionary& dict, std::vector<Uint>& new_idx);
+
+}; // end Renumber
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // actions
+} // mesh
+} // cf3
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // cf3_mesh_actions_Renumber_hpp
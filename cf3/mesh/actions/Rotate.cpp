@@ -115,6 +115,8 @@ void Rotate::execute()
   {
     throw common::InvalidStructure(FromHere(),"Cannot rotate a mesh of dimension "+common::to_str(m_mesh->dimension()));
   }
+
+  m_mesh->raise_coordinates_changed();
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -69,6 +69,8 @@ void Translate::execute()
         point[d] += vec[d];
     }
   }
+
+  m_mesh->raise_coordinates_changed();
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -4,30 +4,28 @@
 // GNU Lesser General Public License version 3 (LGPLv3).
 // See doc/lgpl.txt and doc/gpl.txt for the license text.
 
-#include <set>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <boost/thread/thread.hpp>
 
 #include "common/Builder.hpp"
 
 #include "common/FindComponents.hpp"
 #include "common/Foreach.hpp"
+#include "common/Log.hpp"
 #include "common/Option.hpp"
 #include "common/OptionList.hpp"
-#include "common/List.hpp"
 
-#include "mesh/ConnectivityData.hpp"
-#include "mesh/DiscontinuousDictionary.hpp"
-#include "mesh/ElementData.hpp"
-#include "mesh/Faces.hpp"
+#include "common/PE/Comm.hpp"
+
 #include "mesh/Region.hpp"
 #include "mesh/Space.hpp"
 #include "mesh/Mesh.hpp"
 #include "mesh/Field.hpp"
-#include "mesh/Functions.hpp"
 #include "mesh/Connectivity.hpp"
-#include "mesh/ElementData.hpp"
-
-#include "mesh/LagrangeP1/Triag2D.hpp"
-#include "mesh/LagrangeP1/Quad2D.hpp"
+#include "mesh/ElementType.hpp"
 
 #include "WallDistance.hpp"
 
@@ -46,156 +44,288 @@ common::ComponentBuilder < WallDistance, MeshTransformer, mesh::actions::LibActi
 namespace detail
 {
 
-/// Helper struct to handle projection to the wall near a given surface node
-struct WallProjection
+/// Number of reals used to store a wall primitive: 3 points in 3D. Segments (in 2D) use the first two points only.
+const Uint primitive_size = 9;
+
+inline Real squared_norm(const Real* a)
+{
+  return a[0]*a[0] + a[1]*a[1] + a[2]*a[2];
+}
+
+inline Real dot(const Real* a, const Real* b)
 {
-  WallProjection(const Field& coordinates, const CNodeConnectivity& node_connectivity) :
-    m_coords(coordinates),
-    m_node_connectivity(node_connectivity)
+  return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+/// Squared distance from p to the segment ab
+Real segment_distance2(const Real* p, const Real* a, const Real* b)
+{
+  const Real ab[3] = {b[0]-a[0], b[1]-a[1], b[2]-a[2]};
+  const Real ap[3] = {p[0]-a[0], p[1]-a[1], p[2]-a[2]};
+  const Real len2 = squared_norm(ab);
+  const Real t = len2 > 0. ? std::max(0., std::min(1., dot(ap, ab) / len2)) : 0.;
+  const Real d[3] = {ap[0]-t*ab[0], ap[1]-t*ab[1], ap[2]-t*ab[2]};
+  return squared_norm(d);
+}
+
+/// Squared distance from p to the triangle abc, following the closest point computation by region of Ericson,
+/// "Real-Time Collision Detection", section 5.1.5
+Real triangle_distance2(const Real* p, const Real* a, const Real* b, const Real* c)
+{
+  const Real ab[3] = {b[0]-a[0], b[1]-a[1], b[2]-a[2]};
+  const Real ac[3] = {c[0]-a[0], c[1]-a[1], c[2]-a[2]};
+  const Real ap[3] = {p[0]-a[0], p[1]-a[1], p[2]-a[2]};
+
+  const Real d1 = dot(ab, ap);
+  const Real d2 = dot(ac, ap);
+  if(d1 <= 0. && d2 <= 0.)
+    return squared_norm(ap);
+
+  const Real bp[3] = {p[0]-b[0], p[1]-b[1], p[2]-b[2]};
+  const Real d3 = dot(ab, bp);
+  const Real d4 = dot(ac, bp);
+  if(d3 >= 0. && d4 <= d3)
+    return squared_norm(bp);
+
+  const Real vc = d1*d4 - d3*d2;
+  if(vc <= 0. && d1 >= 0. && d3 <= 0.)
+    return segment_distance2(p, a, b);
+
+  const Real cp[3] = {p[0]-c[0], p[1]-c[1], p[2]-c[2]};
+  const Real d5 = dot(ab, cp);
+  const Real d6 = dot(ac, cp);
+  if(d6 >= 0. && d5 <= d6)
+    return squared_norm(cp);
+
+  const Real vb = d5*d2 - d1*d6;
+  if(vb <= 0. && d2 >= 0. && d6 <= 0.)
+    return segment_distance2(p, a, c);
+
+  const Real va = d3*d6 - d5*d4;
+  if(va <= 0. && (d4 - d3) >= 0. && (d5 - d6) >= 0.)
+    return segment_distance2(p, b, c);
+
+  // Inside the face region
+  const Real denom = va + vb + vc;
+  if(denom <= 0.) // degenerate triangle
+    return std::min(segment_distance2(p, a, b), std::min(segment_distance2(p, a, c), segment_distance2(p, b, c)));
+  const Real v = vb / denom;
+  const Real w = vc / denom;
+  const Real d[3] = {ap[0] - ab[0]*v - ac[0]*w, ap[1] - ab[1]*v - ac[1]*w, ap[2] - ab[2]*v - ac[2]*w};
+  return squared_norm(d);
+}
+
+/// Bounding volume hierarchy of wall primitives (segments in 2D, triangles in 3D), used to find the closest wall
+/// point for any point in space
+class WallBVH
+{
+public:
+  /// @param primitives Coordinates of the primitives, primitive_size values each
+  /// @param is_segment True if the primitives are segments, false for triangles
+  WallBVH(const std::vector<Real>& primitives, const bool is_segment) :
+    m_primitives(primitives),
+    m_is_segment(is_segment),
+    m_nb_points(is_segment ? 2 : 3)
   {
+    const Uint nb_primitives = m_primitives.size() / primitive_size;
+    m_order.resize(nb_primitives);
+    m_centroids.resize(3*nb_primitives);
+    for(Uint i = 0; i != nb_primitives; ++i)
+    {
+      m_order[i] = i;
+      for(Uint d = 0; d != 3; ++d)
+      {
+        Real sum = 0.;
+        for(Uint pt = 0; pt != m_nb_points; ++pt)
+          sum += m_primitives[i*primitive_size + 3*pt + d];
+        m_centroids[3*i + d] = sum / static_cast<Real>(m_nb_points);
+      }
+    }
+
+    if(nb_primitives != 0)
+    {
+      m_nodes.reserve(2*nb_primitives / leaf_size + 1);
+      build(0, nb_primitives);
+    }
   }
 
-  // Get the wall distance for an inner node, looking at the elements that are adjacent to the given surface node
-  Real operator()(const Uint inner_node_idx, const Uint surface_node_idx)
+  /// Distance from p to the closest primitive
+  Real distance(const Real* p) const
   {
-    RealMatrix elem_coords;
-    const Uint dim = m_coords.row_size();
-    const RealVector inner_coord = to_vector(m_coords[inner_node_idx]);
-    std::vector<Uint> neighbor_nodes; // Collect neighboring nodes, so we can project onto a sharp corner in 3D if needed (i.e. near a step)
-    // Loop over all surface elements around the given node
-    BOOST_FOREACH(const Uint elem_idx, m_node_connectivity.node_element_range(surface_node_idx))
+    if(m_nodes.empty())
+      return std::numeric_limits<Real>::max();
+
+    Real best = std::numeric_limits<Real>::max();
+    Uint stack[64];
+    Uint stack_size = 0;
+    stack[stack_size++] = 0;
+    while(stack_size != 0)
     {
-      // Get the element coordinates
-      const CNodeConnectivity::ElementReferenceT element_ref = m_node_connectivity.element(elem_idx);
-      const ElementType& etype = element_ref.first->element_type();
-      const Uint element_nb_nodes = etype.nb_nodes();
-      elem_coords.resize(element_nb_nodes, dim);
-      const Connectivity::ConstRow conn_row = element_ref.first->geometry_space().connectivity()[element_ref.second];
-      fill(elem_coords, m_coords, conn_row);
+      const Node& node = m_nodes[stack[--stack_size]];
+      if(box_distance2(p, node) >= best)
+        continue;
 
-      // We consider lines, triangles and quads as viable surface elements
-      if(element_nb_nodes < 2 || element_nb_nodes > 4 || etype.order() != 1)
+      if(node.count != 0)
       {
-        throw common::SetupError(FromHere(), "Unsupported surface element of type " + etype.name() + " in surface region " + element_ref.first->uri().path());
+        for(Uint i = node.first; i != node.first + node.count; ++i)
+          best = std::min(best, primitive_distance2(p, m_order[i]));
+        continue;
       }
-      
-      bool in_element = false;
 
-      if(element_nb_nodes == 2) // line segment
-      {
-        cf3_assert(dim == 2);
-        cf3_assert(etype.shape() == GeoShape::LINE);
-        RealVector e1 = elem_coords.row(1) - elem_coords.row(0); // line segment vector
-        Real e1_len = e1.norm();
-        e1 /= e1_len;
-        const Real projection = e1.dot(inner_coord - elem_coords.row(0).transpose());
-        // If the projection of the node along the normal fits inside the element, we can take the normal distance
-        in_element = projection > 0 && projection < e1_len;
-      }
-      if(element_nb_nodes == 3)
+      // Visit the closest child first
+      const Uint left = node.left;
+      const Uint right = node.right;
+      const bool left_first = box_distance2(p, m_nodes[left]) < box_distance2(p, m_nodes[right]);
+      cf3_assert(stack_size + 2 <= 64);
+      stack[stack_size++] = left_first ? right : left;
+      stack[stack_size++] = left_first ? left : right;
+    }
+
+    return std::sqrt(best);
+  }
+
+private:
+  static const Uint leaf_size = 4;
+
+  struct Node
+  {
+    Real lo[3];
+    Real hi[3];
+    /// Range in m_order for leaves, count is zero for internal nodes
+    Uint first;
+    Uint count;
+    Uint left;
+    Uint right;
+  };
+
+  /// Build the node for the primitives in m_order[begin, end), returning its index
+  Uint build(const Uint begin, const Uint end)
+  {
+    const Uint node_idx = m_nodes.size();
+    m_nodes.push_back(Node());
+    Node node;
+    Real centroid_lo[3], centroid_hi[3];
+    for(Uint d = 0; d != 3; ++d)
+    {
+      node.lo[d] = centroid_lo[d] = std::numeric_limits<Real>::max();
+      node.hi[d] = centroid_hi[d] = -std::numeric_limits<Real>::max();
+    }
+    for(Uint i = begin; i != end; ++i)
+    {
+      const Uint prim = m_order[i];
+      for(Uint d = 0; d != 3; ++d)
       {
-        cf3_assert(dim == 3);
-        cf3_assert(etype.shape() == GeoShape::TRIAG);
-        RealVector3 e1 = (elem_coords.row(1) - elem_coords.row(0)).normalized();
-        RealVector3 en = elem_coords.row(2) - elem_coords.row(0);
-        RealVector3 e2 = (e1.cross(en)).cross(e1).normalized();
-        RealVector3 p = inner_coord - elem_coords.row(0).transpose();
-        
-        // Construct 2D coordinates for the boundary element
-        Eigen::Matrix<Real, 3, 2> triag_coords_2d;
-        triag_coords_2d.row(0).setZero();
-        triag_coords_2d(1,0) = e1.dot(elem_coords.row(1) - elem_coords.row(0));
-        triag_coords_2d(1,1) = 0.;
-        triag_coords_2d(2,0) = e1.dot(elem_coords.row(2) - elem_coords.row(0));
-        triag_coords_2d(2,1) = e2.dot(elem_coords.row(2) - elem_coords.row(0));
-        
-        RealVector2 p_proj(2);
-        p_proj[0] = p.dot(e1);
-        p_proj[1] = p.dot(e2);
-        
-        in_element = LagrangeP1::Triag2D::is_coord_in_element(p_proj, triag_coords_2d);
-        const Uint origin_corner = std::find(conn_row.begin(), conn_row.end(), surface_node_idx) - conn_row.begin();
-        if(origin_corner == 0)
-        {
-          neighbor_nodes.push_back(conn_row[1]);
-          neighbor_nodes.push_back(conn_row[2]);
-        }
-        else if(origin_corner == 1)
-        {
-          neighbor_nodes.push_back(conn_row[0]);
-          neighbor_nodes.push_back(conn_row[2]);
-        }
-        else
+        for(Uint pt = 0; pt != m_nb_points; ++pt)
         {
-          neighbor_nodes.push_back(conn_row[0]);
-          neighbor_nodes.push_back(conn_row[1]);
+          const Real x = m_primitives[prim*primitive_size + 3*pt + d];
+          node.lo[d] = std::min(node.lo[d], x);
+          node.hi[d] = std::max(node.hi[d], x);
         }
+        centroid_lo[d] = std::min(centroid_lo[d], m_centroids[3*prim + d]);
+        centroid_hi[d] = std::max(centroid_hi[d], m_centroids[3*prim + d]);
       }
-      if(element_nb_nodes == 4)
-      {
-        cf3_assert(dim == 3);
-        cf3_assert(etype.shape() == GeoShape::QUAD);
-        RealVector3 e1 = (elem_coords.row(1) - elem_coords.row(0)).normalized();
-        RealVector3 en = elem_coords.row(3) - elem_coords.row(0);
-        RealVector3 e2 = (e1.cross(en)).cross(e1).normalized();
-        RealVector3 p = inner_coord - elem_coords.row(0).transpose();
-
-        // Construct 2D coordinates for the boundary element
-        Eigen::Matrix<Real, 4, 2> quad_coords_2d;
-        quad_coords_2d.row(0).setZero();
-        for(int i = 1; i != 4; ++i)
-        {
-          quad_coords_2d(i, 0) = e1.dot(elem_coords.row(i) - elem_coords.row(0));
-          quad_coords_2d(i, 1) = e2.dot(elem_coords.row(i) - elem_coords.row(0));
-        }
+    }
 
-        RealVector2 p_proj(2);
-        p_proj[0] = p.dot(e1);
-        p_proj[1] = p.dot(e2);
+    if(end - begin <= leaf_size)
+    {
+      node.first = begin;
+      node.count = end - begin;
+      node.left = node.right = 0;
+      m_nodes[node_idx] = node;
+      return node_idx;
+    }
 
-        in_element = LagrangeP1::Quad2D::is_coord_in_element(p_proj, quad_coords_2d);
-        const Uint origin_corner = std::find(conn_row.begin(), conn_row.end(), surface_node_idx) - conn_row.begin();
-        if(origin_corner == 0 || origin_corner == 2)
-        {
-          neighbor_nodes.push_back(conn_row[1]);
-          neighbor_nodes.push_back(conn_row[3]);
-        }
-        else
-        {
-          neighbor_nodes.push_back(conn_row[0]);
-          neighbor_nodes.push_back(conn_row[2]);
-        }
-      }
-      
-      // If the projection was in an element, we can just proceed to compute the normal distance
-      if(in_element)
-      {
-        RealVector n(dim); // normal vector
-        etype.compute_normal(elem_coords, n);
-        return fabs((n/n.norm()).dot(inner_coord - elem_coords.row(0).transpose()));
-      }
+    // Median split along the largest extent of the centroids
+    Uint axis = 0;
+    for(Uint d = 1; d != 3; ++d)
+    {
+      if(centroid_hi[d] - centroid_lo[d] > centroid_hi[axis] - centroid_lo[axis])
+        axis = d;
     }
-    // If we got here, no projections on the elements gave a result
-    // First, verify the 3D case where we need to project on "step" edges
-    BOOST_FOREACH(const Uint neighbor_node, neighbor_nodes)
+    const Uint mid = begin + (end - begin) / 2;
+    std::nth_element(m_order.begin() + begin, m_order.begin() + mid, m_order.begin() + end, CentroidLess(m_centroids, axis));
+
+    node.first = 0;
+    node.count = 0;
+    node.left = build(begin, mid);
+    node.right = build(mid, end);
+    m_nodes[node_idx] = node;
+    return node_idx;
+  }
+
+  struct CentroidLess
+  {
+    CentroidLess(const std::vector<Real>& centroids, const Uint axis) : m_centroids(centroids), m_axis(axis) {}
+    bool operator()(const Uint a, const Uint b) const { return m_centroids[3*a + m_axis] < m_centroids[3*b + m_axis]; }
+    const std::vector<Real>& m_centroids;
+    const Uint m_axis;
+  };
+
+  static Real box_distance2(const Real* p, const Node& node)
+  {
+    Real result = 0.;
+    for(Uint d = 0; d != 3; ++d)
     {
-      const RealVector surface_coord = to_vector(m_coords[surface_node_idx]);
-      const RealVector neighbor_coord = to_vector(m_coords[neighbor_node]);
-      RealVector e1 = neighbor_coord - surface_coord;
-      Real e1_len = e1.norm();
-      e1 /= e1_len;
-      const Real projection = e1.dot(inner_coord - surface_coord);
-      if(projection > 0 && projection < e1_len)
-      {
-        return (inner_coord - (surface_coord + e1*projection)).norm();
-      }
+      const Real delta = p[d] < node.lo[d] ? node.lo[d] - p[d] : (p[d] > node.hi[d] ? p[d] - node.hi[d] : 0.);
+      result += delta*delta;
     }
-    return (inner_coord - to_vector(m_coords[surface_node_idx])).norm();
+    return result;
   }
 
+  Real primitive_distance2(const Real* p, const Uint prim) const
+  {
+    const Real* coords = &m_primitives[prim*primitive_size];
+    return m_is_segment ? segment_distance2(p, coords, coords + 3) : triangle_distance2(p, coords, coords + 3, coords + 6);
+  }
+
+  const std::vector<Real>& m_primitives;
+  const bool m_is_segment;
+  const Uint m_nb_points;
+  std::vector<Uint> m_order;
+  std::vector<Real> m_centroids;
+  std::vector<Node> m_nodes;
+};
+
+/// Compute the distance for the nodes begin, begin+stride, ... below end
+struct DistanceWorker
+{
+  DistanceWorker(const WallBVH& bvh, const Field& coords, Field& distance, const Uint begin, const Uint stride) :
+    m_bvh(bvh),
+    m_coords(coords),
+    m_distance(distance),
+    m_begin(begin),
+    m_stride(stride)
+  {
+  }
+
+  void operator()()
+  {
+    const Uint nb_nodes = m_coords.size();
+    const Uint dim = m_coords.row_size();
+    Real p[3] = {0., 0., 0.};
+    for(Uint i = m_begin; i < nb_nodes; i += m_stride)
+    {
+      for(Uint d = 0; d != dim; ++d)
+        p[d] = m_coords[i][d];
+      m_distance[i][0] = m_bvh.distance(p);
+    }
+  }
+
+  const WallBVH& m_bvh;
   const Field& m_coords;
-  const CNodeConnectivity& m_node_connectivity;
+  Field& m_distance;
+  const Uint m_begin;
+  const Uint m_stride;
 };
+
+/// Append the coordinates of a wall point, padded to 3D
+inline void add_point(std::vector<Real>& primitives, const Field& coords, const Uint node)
+{
+  const Uint dim = coords.row_size();
+  for(Uint d = 0; d != 3; ++d)
+    primitives.push_back(d < dim ? coords[node][d] : 0.);
+}
+
 }
 
 WallDistance::WallDistance(const std::string& name) : MeshTransformer(name)
@@ -205,6 +335,10 @@ WallDistance::WallDistance(const std::string& name) : MeshTransformer(name)
       .description("Regions that are to be considered as part of the wall")
       .link_to(&m_regions)
       .mark_basic();
+
+  options().add("threads", 1u)
+      .pretty_name("Threads")
+      .description("Number of threads used to compute the distances. Each MPI process starts its own threads, so keep this at 1 when running one process per core. 0 uses all hardware threads.");
 }
 
 void WallDistance::execute()
@@ -215,49 +349,87 @@ void WallDistance::execute()
   d.add_tag("wall_distance");
   const Field& coords = mesh.geometry_fields().coordinates();
   const Uint nb_nodes = coords.size();
+  const Uint dim = coords.row_size();
+  const bool is_segment = dim == 2;
 
-  boost::shared_ptr<CNodeConnectivity> node_connectivity = common::allocate_component<CNodeConnectivity>("NodeConnectivity");
-  std::vector< Handle<Entities const> > surface_entities;
+  // Collect the local wall faces, splitting quads into triangles
+  std::vector<Real> local_primitives;
   BOOST_FOREACH(const Handle<Region const>& region, m_regions)
   {
     BOOST_FOREACH(const mesh::Elements& elements, common::find_components_recursively_with_filter<mesh::Elements>(*region, IsElementsSurface()))
     {
-      surface_entities.push_back(elements.handle<Entities const>());
-    }
-  }
-
-  node_connectivity->initialize(nb_nodes, surface_entities);
-
-  boost::shared_ptr< common::List< Uint > > surface_nodes_ptr = build_used_nodes_list(surface_entities, mesh.geometry_fields(), true);
-  const common::List<Uint>& surface_nodes = *surface_nodes_ptr;
-  const Uint nb_surface_nodes = surface_nodes.size();
-
-  detail::WallProjection normal_distance(coords, *node_connectivity);
-
-  for(Uint inner_node_idx = 0; inner_node_idx != nb_nodes; ++inner_node_idx)
-  {
-    bool is_surface_node = false;
-    Real shortest_distance = 1e20;
-    Uint closest_surface_node = 0;
-    for(Uint j = 0; j != nb_surface_nodes; ++j)
-    {
-      const Uint surface_node_idx = surface_nodes[j];
-      if(surface_node_idx == inner_node_idx)
+      const ElementType& etype = elements.element_type();
+      const Uint element_nb_nodes = etype.nb_nodes();
+      // We consider lines, triangles and quads as viable surface elements
+      if(element_nb_nodes < 2 || element_nb_nodes > 4 || etype.order() != 1 || (element_nb_nodes == 2) != is_segment)
       {
-        is_surface_node = true;
-        break;
+        throw common::SetupError(FromHere(), "Unsupported surface element of type " + etype.name() + " in surface region " + elements.uri().path());
       }
-      const Real d2 = (to_vector(coords[inner_node_idx]) - to_vector(coords[surface_node_idx])).squaredNorm();
-      if(d2 < shortest_distance)
+
+      const Connectivity& connectivity = elements.geometry_space().connectivity();
+      const Uint nb_elements = connectivity.size();
+      for(Uint elem_idx = 0; elem_idx != nb_elements; ++elem_idx)
       {
-        shortest_distance = d2;
-        closest_surface_node = surface_node_idx;
+        const Connectivity::ConstRow conn_row = connectivity[elem_idx];
+        if(element_nb_nodes == 2)
+        {
+          detail::add_point(local_primitives, coords, conn_row[0]);
+          detail::add_point(local_primitives, coords, conn_row[1]);
+          detail::add_point(local_primitives, coords, conn_row[1]);
+        }
+        else
+        {
+          detail::add_point(local_primitives, coords, conn_row[0]);
+          detail::add_point(local_primitives, coords, conn_row[1]);
+          detail::add_point(local_primitives, coords, conn_row[2]);
+          if(element_nb_nodes == 4)
+          {
+            detail::add_point(local_primitives, coords, conn_row[0]);
+            detail::add_point(local_primitives, coords, conn_row[2]);
+            detail::add_point(local_primitives, coords, conn_row[3]);
+          }
+        }
       }
     }
+  }
 
-    d[inner_node_idx][0] = is_surface_node ? 0. : normal_distance(inner_node_idx, closest_surface_node);
+  // The wall of all processes is needed for the distances to be correct near partition boundaries
+  std::vector<Real> primitives;
+  common::PE::Comm& comm = common::PE::Comm::instance();
+  if(comm.is_active())
+  {
+    std::vector< std::vector<Real> > gathered_primitives;
+    comm.all_gather(local_primitives, gathered_primitives);
+    BOOST_FOREACH(const std::vector<Real>& proc_primitives, gathered_primitives)
+    {
+      primitives.insert(primitives.end(), proc_primitives.begin(), proc_primitives.end());
+    }
+  }
+  else
+  {
+    primitives.swap(local_primitives);
   }
 
+  if(primitives.empty())
+    throw common::SetupError(FromHere(), "No wall faces found for " + uri().path());
+
+  CFdebug << "WallDistance: computing the distance to " << primitives.size() / detail::primitive_size << " wall faces for " << nb_nodes << " nodes" << CFendl;
+
+  const detail::WallBVH bvh(primitives, is_segment);
+
+  const Uint configured_threads = options().value<Uint>("threads");
+  const Uint nb_threads = std::max(1u, std::min(nb_nodes, configured_threads == 0 ? boost::thread::hardware_concurrency() : configured_threads));
+  if(nb_threads == 1)
+  {
+    detail::DistanceWorker(bvh, coords, d, 0, 1)();
+  }
+  else
+  {
+    boost::thread_group threads;
+    for(Uint i = 0; i != nb_threads; ++i)
+      threads.create_thread(detail::DistanceWorker(bvh, coords, d, i, nb_threads));
+    threads.join_all();
+  }
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -22,6 +22,10 @@ namespace actions {
 
 //////////////////////////////////////////////////////////////////////////////
 
+/// Computes the distance from each node to the closest point on the wall regions, stored in the wall_distance field.
+/// The wall faces of all processes are gathered into a bounding volume hierarchy, so the result does not depend on
+/// the partitioning. Lines (2D), triangles and quads (3D) of order 1 are supported as wall faces; quads are split
+/// into two triangles.
 class WallDistance : public MeshTransformer
 {
 public:
@@ -4,6 +4,8 @@
 // GNU Lesser General Public License version 3 (LGPLv3).
 // See doc/lgpl.txt and doc/gpl.txt for the license text.
 
+#include <algorithm>
+
 #include <boost/foreach.hpp>
 #include <boost/tokenizer.hpp>
 #include <boost/regex.hpp>
@@ -33,6 +35,7 @@
 #include "mesh/Field.hpp"
 #include "mesh/Space.hpp"
 #include "mesh/Cells.hpp"
+#include "mesh/DistributedFileReader.hpp"
 
 #include "mesh/gmsh/Reader.hpp"
 
@@ -71,6 +74,12 @@ Reader::Reader( const std::string& name )
       .pretty_name("Read Fields")
       .mark_basic();
 
+  options().add("parallel_read", false)
+      .description("Divide the reading of the nodes and elements over the processors, each parsing only its share of "
+                   "the file, and send them to the part that owns them afterwards. "
+                   "Requires one part per processor. The field data is still read by every processor.")
+      .pretty_name("Parallel Read");
+
   // properties
 
   properties()["brief"] = std::string("Gmsh file reader component");
@@ -121,15 +130,25 @@ void Reader::do_read_mesh_into(const URI& file, Mesh& mesh)
   // NOTE: since gmsh contains several 'physical entities' in one mesh, we create one region per physical entity
   m_region = Handle<Region>(m_mesh->topology().handle<Component>());
 
-  // Read file once and store positions
-  get_file_positions();
-  cf3_assert(m_hash);
+  if (options().value<bool>("parallel_read") && PE::Comm::instance().is_active())
+  {
+    if (options().value<Uint>("part") != PE::Comm::instance().rank() || options().value<Uint>("nb_parts") != PE::Comm::instance().size())
+      throw SetupError(FromHere(), "Option parallel_read requires part to be the rank and nb_parts the number of processors");
 
-  m_mesh->initialize_nodes(0, m_mesh_dimension);
+    read_distributed(fp);
+  }
+  else
+  {
+    // Read file once and store positions
+    get_file_positions();
+    cf3_assert(m_hash);
 
-  find_used_nodes();
-  read_coordinates();
-  read_connectivity();
+    m_mesh->initialize_nodes(0, m_mesh_dimension);
+
+    find_used_nodes();
+    read_coordinates();
+    read_connectivity();
+  }
 
   fix_negative_volumes(*m_mesh);
 
@@ -178,31 +197,7 @@ void Reader::get_file_positions()
     getline(m_file,line);
     if (line.find(region_names)!=std::string::npos) {
       m_region_names_position=p;
-      m_file >> m_nb_regions;
-      m_region_list.resize(m_nb_regions);
-
-      m_nb_gmsh_elem_in_region.resize(m_nb_regions);
-      for(Uint ir = 0; ir < m_nb_regions; ++ir)
-      {
-        m_nb_gmsh_elem_in_region[ir].resize(Shared::nb_gmsh_types);
-        for(Uint type = 0; type < Shared::nb_gmsh_types; ++ type)
-           (m_nb_gmsh_elem_in_region[ir])[type] = 0;
-      }
-
-      m_mesh_dimension = options().value<Uint>("dimension");
-      for(Uint ir = 0; ir < m_nb_regions; ++ir)
-      {
-        Uint phys_group_dimensionality;
-        Uint phys_group_index;
-        std::string phys_group_name;
-        m_file >> phys_group_dimensionality >> phys_group_index >> phys_group_name;
-        m_region_list[phys_group_index-1].dim=phys_group_dimensionality;
-        m_region_list[phys_group_index-1].index=phys_group_index;
-        //The original name of the region in the mesh file has quotes, we want to strip them off
-        m_region_list[phys_group_index-1].name=phys_group_name.substr(1,phys_group_name.length()-2);
-        m_region_list[phys_group_index-1].region = create_region(m_region_list[phys_group_index-1].name);
-        m_mesh_dimension = std::max(m_region_list[phys_group_index-1].dim,m_mesh_dimension);
-      }
+      read_physical_names();
     }
     else if (line.find(nodes)!=std::string::npos) {
       m_coordinates_position=p;
@@ -262,6 +257,37 @@ void Reader::get_file_positions()
   m_file.clear();
 }
 
+//////////////////////////////////////////////////////////////////////////////
+
+void Reader::read_physical_names()
+{
+  m_file >> m_nb_regions;
+  m_region_list.resize(m_nb_regions);
+
+  m_nb_gmsh_elem_in_region.resize(m_nb_regions);
+  for(Uint ir = 0; ir < m_nb_regions; ++ir)
+  {
+    m_nb_gmsh_elem_in_region[ir].resize(Shared::nb_gmsh_types);
+    for(Uint type = 0; type < Shared::nb_gmsh_types; ++ type)
+       (m_nb_gmsh_elem_in_region[ir])[type] = 0;
+  }
+
+  m_mesh_dimension = options().value<Uint>("dimension");
+  for(Uint ir = 0; ir < m_nb_regions; ++ir)
+  {
+    Uint phys_group_dimensionality;
+    Uint phys_group_index;
+    std::string phys_group_name;
+    m_file >> phys_group_dimensionality >> phys_group_index >> phys_group_name;
+    m_region_list[phys_group_index-1].dim=phys_group_dimensionality;
+    m_region_list[phys_group_index-1].index=phys_group_index;
+    //The original name of the region in the mesh file has quotes, we want to strip them off
+    m_region_list[phys_group_index-1].name=phys_group_name.substr(1,phys_group_name.length()-2);
+    m_region_list[phys_group_index-1].region = create_region(m_region_list[phys_group_index-1].name);
+    m_mesh_dimension = std::max(m_region_list[phys_group_index-1].dim,m_mesh_dimension);
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 Handle< Region > Reader::create_region(std::string const& relative_path)
@@ -498,29 +524,18 @@ void Reader::read_coordinates()
 
 //////////////////////////////////////////////////////////////////////////////
 
-void Reader::read_connectivity()
+void Reader::allocate_element_tables(std::vector<std::map<Uint, Entities*> >& conn_table_idx)
 {
-
   Dictionary& nodes = m_mesh->geometry_fields();
 
-
-  Uint part = options().value<Uint>("part");
-
   //Each entry of this vector holds a map (gmsh_type_idx, pointer to connectivity table of this gmsh type).
  //Each row corresponds to one region of the mesh
- std::vector<std::map<Uint, Entities* > > conn_table_idx;
  conn_table_idx.resize(m_nb_regions);
  for(Uint ir = 0; ir < m_nb_regions; ++ir)
  {
     conn_table_idx[ir].clear();
  }
 
- std::map<Uint, Entities*>::iterator elem_table_iter;
-
-// std::vector<std::map<std::string,Handle< Elements > > > elements(m_nb_regions);
-// std::vector<std::map<std::string,Handle< Connectivity::Buffer > > > buffer(m_nb_regions);
-
-
  m_elem_idx_gmsh_to_cf.clear();
  //Loop over all regions and allocate a connectivity table of proper size for each element type that
  //is present in each region. Counting of elements was done during the first pass in the function
@@ -530,10 +545,6 @@ void Reader::read_connectivity()
    // create new region
    Handle< Region > region = m_region_list[ir].region;
 
-//   elements[ir] = create_cells_in_region(*region,m_mesh->geometry_fields(),m_supported_types);
-//   buffer[ir] = create_connectivity_buffermap(elements[ir]);
-
-
    // Take the gmsh element types present in this region and generate new names of elements which correspond
    // to coolfuid naming:
    for(Uint etype = 0; etype < Shared::nb_gmsh_types; ++etype)
@@ -563,36 +574,60 @@ void Reader::read_connectivity()
    }
  }
 
-   std::string etype_CF;
-   std::set<Uint>::const_iterator it;
-   std::vector<Uint> cf_element;
-   Uint element_number, gmsh_element_type, nb_element_nodes;
-   Uint gmsh_node_number, nb_tags, phys_tag, other_tag;
-   Uint cf_node_number;
-   Uint cf_idx;
-
-   m_file.seekg(m_elements_position,std::ios::beg);
-   // skip next line
-   std::string line;
-   //Re-read the line that contains the keyword '$Elements':
-   getline(m_file,line);
-   //Parse the following line (containing the actual number of elements)
-   getline(m_file,line);
-
-   for(Uint ir = 0; ir < m_nb_regions; ++ir)
-     for(Uint etype = 0; etype < Shared::nb_gmsh_types; ++etype)
-      (m_nb_gmsh_elem_in_region[ir])[etype] = 0;
+ // The counters are used again to fill the tables
+ for(Uint ir = 0; ir < m_nb_regions; ++ir)
+   for(Uint etype = 0; etype < Shared::nb_gmsh_types; ++etype)
+    (m_nb_gmsh_elem_in_region[ir])[etype] = 0;
+}
 
-  for (Uint i=0; i<m_total_nb_elements; ++i)
+//////////////////////////////////////////////////////////////////////////////
+
+void Reader::add_element(const std::vector<std::map<Uint, Entities*> >& conn_table_idx, const Uint element_number,
+                         const Uint gmsh_element_type, const Uint phys_tag, const std::vector<Uint>& gmsh_element_nodes)
+{
+  const Uint nb_element_nodes = Shared::m_nodes_in_gmsh_elem[gmsh_element_type];
+
+  std::map<Uint, Entities*>::const_iterator elem_table_iter = conn_table_idx[phys_tag-1].find(gmsh_element_type);
+  const Uint row_idx = (m_nb_gmsh_elem_in_region[phys_tag-1])[gmsh_element_type];
+
+  Handle< Elements > elements_region = Handle<Elements>(elem_table_iter->second->handle<Component>());
+  Connectivity::Row element_nodes = elements_region->geometry_space().connectivity()[row_idx];
+
+  m_elem_idx_gmsh_to_cf[element_number] = std::make_pair( elements_region , row_idx);
+
+  for (Uint j=0; j<nb_element_nodes; ++j)
   {
-//    if (m_total_nb_elements > 100000)
-//    {
-//      if(i%(m_total_nb_elements/20)==0)
-//        CFinfo << 100*i/m_total_nb_elements << "% " << CFflush;
-//      if(i==m_total_nb_elements-1)
-//        CFinfo << CFendl;
-//    }
+    const Uint cf_idx = Shared::m_nodes_gmsh_to_cf[gmsh_element_type][j];
+    element_nodes[cf_idx] = m_node_idx_gmsh_to_cf[gmsh_element_nodes[j]];
+  }
+
+  elements_region->rank()[row_idx] = options().value<Uint>("part");
+  elements_region->glb_idx()[row_idx] = element_number-1;
+
+  (m_nb_gmsh_elem_in_region[phys_tag-1])[gmsh_element_type]++;
+}
 
+//////////////////////////////////////////////////////////////////////////////
+
+void Reader::read_connectivity()
+{
+  std::vector<std::map<Uint, Entities* > > conn_table_idx;
+  allocate_element_tables(conn_table_idx);
+
+  std::vector<Uint> gmsh_element_nodes;
+  Uint element_number, gmsh_element_type, nb_element_nodes;
+  Uint nb_tags, phys_tag, other_tag;
+
+  m_file.seekg(m_elements_position,std::ios::beg);
+  // skip next line
+  std::string line;
+  //Re-read the line that contains the keyword '$Elements':
+  getline(m_file,line);
+  //Parse the following line (containing the actual number of elements)
+  getline(m_file,line);
+
+  for (Uint i=0; i<m_total_nb_elements; ++i)
+  {
     // element description
     m_file >> element_number >> gmsh_element_type;
 
@@ -606,49 +641,191 @@ void Reader::read_connectivity()
       for(Uint itag = 0; itag < (nb_tags-1); ++itag)
           m_file >> other_tag;
 
-//      CFinfo << "Reading element " << element_number << " of type " << gmsh_element_type;
-//      CFinfo << " in region " << phys_tag << " with " << nb_element_nodes << " nodes " << CFendl;
+      gmsh_element_nodes.resize(nb_element_nodes);
+      for (Uint j=0; j<nb_element_nodes; ++j)
+        m_file >> gmsh_element_nodes[j];
 
-//      if (PE::Comm::instance().rank()==IO_rank)
-//        std::cout << element_number << "   -->   ";
+      add_element(conn_table_idx, element_number, gmsh_element_type, phys_tag, gmsh_element_nodes);
+    }
 
-      cf_element.resize(nb_element_nodes);
-      for (Uint j=0; j<nb_element_nodes; ++j)
-      {
-        cf_idx = Shared::m_nodes_gmsh_to_cf[gmsh_element_type][j];
-        m_file >> gmsh_node_number;
-        cf_node_number = m_node_idx_gmsh_to_cf[gmsh_node_number];
-        cf_element[cf_idx] = cf_node_number;
-//        if (PE::Comm::instance().rank()==IO_rank)
-//          std::cout << "  " << gmsh_node_number << "("<<m_node_idx_gmsh_to_cf[gmsh_node_number]<<")";
-      }
-//      if (PE::Comm::instance().rank()==IO_rank)
-//        std::cout << std::endl;
+    // finish the line
+    getline(m_file,line);
+  }
+  getline(m_file,line);  // ENDOFSECTION
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+namespace detail
+{
+  /// Order of the element records received from other processors: their index in the file
+  bool file_idx_less(const std::pair<Uint,const Uint*>& a, const std::pair<Uint,const Uint*>& b)
+  {
+    return a.first < b.first;
+  }
+}
+
+void Reader::read_distributed(const boost::filesystem::path& fp)
+{
+  enum { PHYSICAL_NAMES, NODES_BEGIN, NODES_END, ELEMENTS_BEGIN, ELEMENTS_END, ELEMENT_DATA, NODE_DATA, ELEMENT_NODE_DATA };
+  std::vector<std::string> markers(8);
+  markers[PHYSICAL_NAMES]    = "$PhysicalNames";
+  markers[NODES_BEGIN]       = "$Nodes";
+  markers[NODES_END]         = "$EndNodes";
+  markers[ELEMENTS_BEGIN]    = "$Elements";
+  markers[ELEMENTS_END]      = "$EndElements";
+  markers[ELEMENT_DATA]      = "$ElementData";
+  markers[NODE_DATA]         = "$NodeData";
+  markers[ELEMENT_NODE_DATA] = "$ElementNodeData";
+
+  DistributedFileReader file(fp);
+  std::vector< std::vector<DistributedFileReader::Position> > positions;
+  file.find_markers(markers, positions);
+
+  if (positions[ELEMENTS_BEGIN].empty() || positions[ELEMENTS_END].empty())
+    throw ParsingFailed(FromHere(),"File does not contain any elements");
+  if (positions[NODES_BEGIN].empty() || positions[NODES_END].empty())
+    throw ParsingFailed(FromHere(),"File contains no nodes");
+
+  m_element_data_positions.assign(positions[ELEMENT_DATA].begin(), positions[ELEMENT_DATA].end());
+  m_node_data_positions.assign(positions[NODE_DATA].begin(), positions[NODE_DATA].end());
+  m_element_node_data_positions.assign(positions[ELEMENT_NODE_DATA].begin(), positions[ELEMENT_NODE_DATA].end());
+  const DistributedFileReader::Position nodes_position = positions[NODES_BEGIN][0];
+  const DistributedFileReader::Position elements_position = positions[ELEMENTS_BEGIN][0];
+  m_coordinates_position = nodes_position;
+  m_elements_position = elements_position;
+
+  // The small sections are read by every processor
+  std::string line;
+  if (positions[PHYSICAL_NAMES].size())
+  {
+    m_region_names_position = positions[PHYSICAL_NAMES][0];
+    m_file.seekg(m_region_names_position,std::ios::beg);
+    getline(m_file,line);
+    read_physical_names();
+  }
 
-      elem_table_iter = conn_table_idx[phys_tag-1].find(gmsh_element_type);
-      const Uint row_idx = (m_nb_gmsh_elem_in_region[phys_tag-1])[gmsh_element_type];
+  m_file.seekg(m_coordinates_position,std::ios::beg);
+  getline(m_file,line);
+  m_file >> m_total_nb_nodes;
+  if (m_total_nb_nodes == 0) throw ParsingFailed(FromHere(),"File contains no nodes");
 
-      Handle< Elements > elements_region = Handle<Elements>(elem_table_iter->second->handle<Component>());
-      Connectivity::Row element_nodes = elements_region->geometry_space().connectivity()[row_idx];
+  m_file.seekg(m_elements_position,std::ios::beg);
+  getline(m_file,line);
+  m_file >> m_total_nb_elements;
+  if (m_total_nb_elements == 0) throw ParsingFailed(FromHere(),"File contains no elements");
 
-      m_elem_idx_gmsh_to_cf[element_number] = std::make_pair( elements_region , row_idx);
+  m_hash = create_component<MergedParallelDistribution>("hash");
+  std::vector<Uint> num_obj(2);
+  num_obj[0] = m_total_nb_nodes;
+  num_obj[1] = m_total_nb_elements;
+  m_hash->options().set("nb_parts",options().value<Uint>("nb_parts"));
+  m_hash->options().set("nb_obj",num_obj);
 
-      for(Uint node = 0; node < nb_element_nodes; ++node)
-      {
-         element_nodes[node] = cf_element[node];
-      }
+  m_mesh->initialize_nodes(0, m_mesh_dimension);
 
-      elements_region->rank()[row_idx] = part;
-      elements_region->glb_idx()[row_idx] = element_number-1;
+  const Uint nb_procs = PE::Comm::instance().size();
+  std::vector<std::string> records;
+
+  // Each processor reads its share of the nodes
+  const Uint first_node = file.read_records(file.next_line(file.next_line(nodes_position)), positions[NODES_END][0], records);
+  NodeRecords read_nodes(m_mesh_dimension);
+  std::vector<Real> coords(m_mesh_dimension);
+  Uint gmsh_node_number;
+  for (Uint n=0; n<records.size(); ++n)
+  {
+    std::stringstream ss(records[n]);
+    ss >> gmsh_node_number;
+    for (Uint dim=0; dim<m_mesh_dimension; ++dim)
+      ss >> coords[dim];
+    read_nodes.add(first_node+n, gmsh_node_number, m_hash->subhash(NODES).part_of_obj(first_node+n), &coords[0]);
+  }
 
-      (m_nb_gmsh_elem_in_region[phys_tag-1])[gmsh_element_type]++;
+  // Each processor reads its share of the elements, and sends them to their part as
+  // (file index, element number, type, physical tag, nodes)
+  const Uint first_elem = file.read_records(file.next_line(file.next_line(elements_position)), positions[ELEMENTS_END][0], records);
+  std::vector< std::vector<Uint> > send_elems(nb_procs);
+  Uint element_number, gmsh_element_type, nb_element_nodes;
+  Uint nb_tags, phys_tag, other_tag;
+  for (Uint e=0; e<records.size(); ++e)
+  {
+    std::stringstream ss(records[e]);
+    ss >> element_number >> gmsh_element_type >> nb_tags >> phys_tag;
+    for(Uint itag = 0; itag < (nb_tags-1); ++itag)
+      ss >> other_tag;
+    nb_element_nodes = Shared::m_nodes_in_gmsh_elem[gmsh_element_type];
 
+    std::vector<Uint>& send = send_elems[m_hash->subhash(ELEMS).part_of_obj(first_elem+e)];
+    send.push_back(first_elem+e);
+    send.push_back(element_number);
+    send.push_back(gmsh_element_type);
+    send.push_back(phys_tag);
+    for (Uint j=0; j<nb_element_nodes; ++j)
+    {
+      ss >> gmsh_node_number;
+      send.push_back(gmsh_node_number);
+    }
+  }
+  records.clear();
+  std::vector< std::vector<Uint> > recv_elems;
+  PE::Comm::instance().all_to_all(send_elems, recv_elems);
+  send_elems.clear();
+
+  // Put the received elements in the order of the file, count them per region and type, and collect their nodes
+  std::vector< std::pair<Uint,const Uint*> > elems;
+  std::vector<Uint> used_nodes;
+  std::vector<Uint> types_in_region(m_nb_regions*Shared::nb_gmsh_types, 0);
+  for (Uint p=0; p<nb_procs; ++p)
+  {
+    Uint i=0;
+    while (i<recv_elems[p].size())
+    {
+      const Uint* elem = &recv_elems[p][i];
+      nb_element_nodes = Shared::m_nodes_in_gmsh_elem[elem[2]];
+      elems.push_back(std::make_pair(elem[0],elem));
+      (m_nb_gmsh_elem_in_region[elem[3]-1])[elem[2]]++;
+      types_in_region[(elem[3]-1)*Shared::nb_gmsh_types+elem[2]] = 1;
+      used_nodes.insert(used_nodes.end(), elem+4, elem+4+nb_element_nodes);
+      i += 4+nb_element_nodes;
     }
+  }
+  std::sort(elems.begin(), elems.end(), detail::file_idx_less);
+  std::sort(used_nodes.begin(), used_nodes.end());
+  used_nodes.erase(std::unique(used_nodes.begin(), used_nodes.end()), used_nodes.end());
+
+  // Every processor creates the element types found in the whole file, as in serial
+  std::vector<Uint> types_in_file(types_in_region.size());
+  PE::Comm::instance().all_reduce(PE::max(), types_in_region, types_in_file);
+  for(Uint ir = 0; ir < m_nb_regions; ++ir)
+    for(Uint etype = 0; etype < Shared::nb_gmsh_types; ++etype)
+      if (types_in_file[ir*Shared::nb_gmsh_types+etype])
+        m_region_list[ir].element_types.insert(etype);
+
+  // Owned nodes and the ghost nodes used by the elements
+  NodeRecords local_nodes;
+  DistributedFileReader::distribute_nodes(read_nodes, used_nodes, local_nodes);
+  read_nodes = NodeRecords();
 
-    // finish the line
-    getline(m_file,line);
+  Dictionary& nodes = m_mesh->geometry_fields();
+  nodes.resize(local_nodes.size());
+  for (Uint coord_idx=0; coord_idx<local_nodes.size(); ++coord_idx)
+  {
+    m_node_idx_gmsh_to_cf[local_nodes.number[coord_idx]]=coord_idx;
+    for (Uint dim=0; dim<m_mesh_dimension; ++dim)
+      nodes.coordinates()[coord_idx][dim] = local_nodes.coordinates[coord_idx*m_mesh_dimension+dim];
+    nodes.rank()[coord_idx] = local_nodes.part[coord_idx];
+    nodes.glb_idx()[coord_idx] = local_nodes.number[coord_idx]-1;
+  }
+
+  std::vector<std::map<Uint, Entities* > > conn_table_idx;
+  allocate_element_tables(conn_table_idx);
+  std::vector<Uint> gmsh_element_nodes;
+  for (Uint e=0; e<elems.size(); ++e)
+  {
+    const Uint* elem = elems[e].second;
+    gmsh_element_nodes.assign(elem+4, elem+4+Shared::m_nodes_in_gmsh_elem[elem[2]]);
+    add_element(conn_table_idx, elem[1], elem[2], elem[3], gmsh_element_nodes);
   }
-  getline(m_file,line);  // ENDOFSECTION
 }
 
 ////////////////////////////////////////////////////////////////////////////////
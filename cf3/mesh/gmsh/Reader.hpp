@@ -23,6 +23,7 @@ namespace cf3 {
 namespace mesh {
 
 class Elements;
+class Entities;
 class Region;
 class MergedParallelDistribution;
 class Dictionary;
@@ -53,6 +54,8 @@ private: // functions
 
   void get_file_positions();
 
+  void read_physical_names();
+
   Handle<Region> create_region(std::string const& relative_path);
 
   void find_used_nodes();
@@ -61,6 +64,16 @@ private: // functions
 
   void read_connectivity();
 
+  /// Create the elements of each region and type counted in m_nb_gmsh_elem_in_region, and reset the counters
+  void allocate_element_tables(std::vector<std::map<Uint, Entities*> >& conn_table_idx);
+
+  /// Add an element to the next row of its table, with its nodes numbered as in the file
+  void add_element(const std::vector<std::map<Uint, Entities*> >& conn_table_idx, const Uint element_number,
+                   const Uint gmsh_element_type, const Uint phys_tag, const std::vector<Uint>& gmsh_element_nodes);
+
+  /// Read the nodes and elements with all processors together, each parsing only its share of the file
+  void read_distributed(const boost::filesystem::path& fp);
+
   void read_element_node_data();
 
   void read_element_data();
@@ -4,6 +4,7 @@
 // GNU Lesser General Public License version 3 (LGPLv3).
 // See doc/lgpl.txt and doc/gpl.txt for the license text.
 
+#include <algorithm>
 #include <set>
 
 #include "common/Log.hpp"
@@ -66,6 +67,12 @@ Reader::Reader( const std::string& name )
       .description("Read the surface elements for the boundary")
       .pretty_name("Read Boundaries");
 
+  options().add("parallel_read", false)
+      .description("Divide the reading of the nodes and elements over the processors, each parsing only its share of "
+                   "the file, and send them to the part that owns them afterwards. "
+                   "Requires one part per processor. The groups and boundaries are still read by every processor.")
+      .pretty_name("Parallel Read");
+
   properties()["brief"] = std::string("neutral file mesh reader component");
 
   std::string desc;
@@ -105,8 +112,21 @@ void Reader::do_read_mesh_into(const URI& file, Mesh& mesh)
   // set the internal mesh pointer
   m_mesh = Handle<Mesh>(mesh.handle<Component>());
 
-  // Read file once and store positions
-  get_file_positions();
+  const bool distributed = options().value<bool>("parallel_read") && PE::Comm::instance().is_active();
+  if (distributed)
+  {
+    if (options().value<Uint>("part") != PE::Comm::instance().rank() || options().value<Uint>("nb_parts") != PE::Comm::instance().size())
+      throw SetupError(FromHere(), "Option parallel_read requires part to be the rank and nb_parts the number of processors");
+
+    // Scan the file with all processors together and store positions
+    m_distributed_file.reset(new DistributedFileReader(fp));
+    find_sections();
+  }
+  else
+  {
+    // Read file once and store positions
+    get_file_positions();
+  }
 
   // Read mesh information
   read_headerData();
@@ -128,9 +148,17 @@ void Reader::do_read_mesh_into(const URI& file, Mesh& mesh)
   //else
   //  m_region = m_mesh->create_region(m_headerData.mesh_name,!option("Serial Handle<Region>(Merge").value<bool>()).handle<Component>());
 
-  find_ghost_nodes();
-  read_coordinates();
-  read_connectivity();
+  if (distributed)
+  {
+    read_distributed();
+    m_distributed_file.reset();
+  }
+  else
+  {
+    find_ghost_nodes();
+    read_coordinates();
+    read_connectivity();
+  }
   if (options().value<bool>("read_boundaries"))
     read_boundaries();
 
@@ -203,6 +231,31 @@ void Reader::get_file_positions()
 
 //////////////////////////////////////////////////////////////////////////////
 
+void Reader::find_sections()
+{
+  enum { NODAL_COORDINATES, ELEMENTS_CELLS, ELEMENT_GROUP, BOUNDARY_CONDITION, END_OF_SECTION };
+  std::vector<std::string> markers(5);
+  markers[NODAL_COORDINATES]  = "NODAL COORDINATES";
+  markers[ELEMENTS_CELLS]     = "ELEMENTS/CELLS";
+  markers[ELEMENT_GROUP]      = "ELEMENT GROUP";
+  markers[BOUNDARY_CONDITION] = "BOUNDARY CONDITIONS";
+  markers[END_OF_SECTION]     = "ENDOFSECTION";
+
+  std::vector< std::vector<DistributedFileReader::Position> > positions;
+  m_distributed_file->find_markers(markers, positions);
+
+  if (positions[NODAL_COORDINATES].empty() || positions[ELEMENTS_CELLS].empty())
+    throw ParsingFailed(FromHere(), "Failed to read neutral file: no NODAL COORDINATES or ELEMENTS/CELLS section");
+
+  m_nodal_coordinates_position = positions[NODAL_COORDINATES].back();
+  m_elements_cells_position = positions[ELEMENTS_CELLS].back();
+  m_element_group_positions.assign(positions[ELEMENT_GROUP].begin(), positions[ELEMENT_GROUP].end());
+  m_boundary_condition_positions.assign(positions[BOUNDARY_CONDITION].begin(), positions[BOUNDARY_CONDITION].end());
+  m_end_of_section_positions.swap(positions[END_OF_SECTION]);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
 void Reader::read_headerData()
 {
   m_file.seekg(0,std::ios::beg);
@@ -376,12 +429,8 @@ void Reader::read_connectivity()
   getline(m_file,line);
 
   // read every line and store the connectivity in the correct region through the buffer
-  std::string etype_CF;
-  std::vector<Uint> cf_element;
+  std::vector<Uint> neu_element;
   Uint neu_node_number;
-  Uint cf_node_number;
-  Uint cf_idx;
-  Uint table_idx;
 
   for (Uint i=0; i<m_headerData.NELEM; ++i)
   {
@@ -401,19 +450,10 @@ void Reader::read_connectivity()
     // get element nodes
     if (m_hash->subhash(ELEMS).owns(i))
     {
-      cf_element.resize(nbElementNodes);
+      neu_element.resize(nbElementNodes);
       for (Uint j=0; j<nbElementNodes; ++j)
-      {
-        cf_idx = m_nodes_neu_to_cf[elementType][j];
-        m_file >> neu_node_number;
-        cf3_assert(m_neu_node_to_coord_idx.count(neu_node_number));
-        cf_node_number = m_neu_node_to_coord_idx[neu_node_number];
-        cf3_assert(cf_node_number < nodes.size());
-        cf_element[cf_idx] = cf_node_number;
-      }
-      etype_CF = element_type(elementType,nbElementNodes);
-      table_idx = buffer[etype_CF]->add_row(cf_element);
-      m_global_to_tmp[elementNumber] = std::make_pair(elements[etype_CF],table_idx);
+        m_file >> neu_element[j];
+      add_element(elements,buffer,elementNumber,elementType,neu_element);
     }
     else
     {
@@ -434,6 +474,167 @@ void Reader::read_connectivity()
 
 //////////////////////////////////////////////////////////////////////////////
 
+void Reader::add_element(std::map<std::string,Handle<Elements> >& elements,
+                         std::map<std::string,boost::shared_ptr<Connectivity::Buffer> >& buffer,
+                         const Uint elementNumber, const Uint elementType, const std::vector<Uint>& neu_element)
+{
+  std::vector<Uint> cf_element(neu_element.size());
+  for (Uint j=0; j<neu_element.size(); ++j)
+  {
+    const Uint cf_idx = m_nodes_neu_to_cf[elementType][j];
+    cf3_assert(m_neu_node_to_coord_idx.count(neu_element[j]));
+    const Uint cf_node_number = m_neu_node_to_coord_idx[neu_element[j]];
+    cf3_assert(cf_node_number < m_mesh->geometry_fields().size());
+    cf_element[cf_idx] = cf_node_number;
+  }
+  const std::string etype_CF = element_type(elementType,neu_element.size());
+  const Uint table_idx = buffer[etype_CF]->add_row(cf_element);
+  m_global_to_tmp[elementNumber] = std::make_pair(elements[etype_CF],table_idx);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+namespace detail
+{
+  /// Records of the ELEMENTS/CELLS section are written with format (I8,1X,I2,1X,I2,1X,7I8:/(15X,7I8:)), so the
+  /// lines continuing the nodes of an element start with 15 blanks
+  bool is_continuation_line(const std::string& line)
+  {
+    return line.find_first_not_of(" \t") >= 15;
+  }
+
+  /// Start of the ENDOFSECTION line of the section starting at begin
+  DistributedFileReader::Position section_end(const std::vector<DistributedFileReader::Position>& end_of_section_positions,
+                                              const DistributedFileReader::Position begin)
+  {
+    std::vector<DistributedFileReader::Position>::const_iterator end = std::upper_bound(end_of_section_positions.begin(), end_of_section_positions.end(), begin);
+    if (end == end_of_section_positions.end())
+      throw ParsingFailed(FromHere(), "Failed to read neutral file: section without ENDOFSECTION");
+    return *end;
+  }
+
+  /// Order of the element records received from other processors: their index in the file
+  bool file_idx_less(const std::pair<Uint,const Uint*>& a, const std::pair<Uint,const Uint*>& b)
+  {
+    return a.first < b.first;
+  }
+}
+
+void Reader::read_distributed()
+{
+  const Uint nb_procs = PE::Comm::instance().size();
+  const Uint dim = m_headerData.NDFCD;
+  std::vector<std::string> records;
+
+  // Each processor reads its share of the nodes
+  DistributedFileReader::Position begin = m_distributed_file->next_line(m_nodal_coordinates_position);
+  DistributedFileReader::Position end = detail::section_end(m_end_of_section_positions, begin);
+  const Uint first_node = m_distributed_file->read_records(begin, end, records);
+  NodeRecords read_nodes(dim);
+  std::vector<Real> coords(dim);
+  Uint nodeNumber;
+  for (Uint n=0; n<records.size(); ++n)
+  {
+    std::stringstream ss(records[n]);
+    ss >> nodeNumber;
+    for (Uint d=0; d<dim; ++d)
+      ss >> coords[d];
+    read_nodes.add(first_node+n, nodeNumber, m_hash->subhash(NODES).part_of_obj(first_node+n), &coords[0]);
+  }
+
+  // Each processor reads its share of the elements, and sends them to their part as
+  // (file index, element number, type, number of nodes, nodes)
+  begin = m_distributed_file->next_line(m_elements_cells_position);
+  end = detail::section_end(m_end_of_section_positions, begin);
+  const Uint first_elem = m_distributed_file->read_records(begin, end, records, detail::is_continuation_line);
+  std::vector< std::vector<Uint> > send_elems(nb_procs);
+  Uint elementNumber, elementType, nbElementNodes, neu_node_number;
+  Uint nb_unsupported = 0;
+  Uint unsupported_type = 0;
+  for (Uint e=0; e<records.size(); ++e)
+  {
+    std::stringstream ss(records[e]);
+    ss >> elementNumber >> elementType >> nbElementNodes;
+    if(!m_supported_neu_types.count(elementType))
+    {
+      unsupported_type = elementType;
+      ++nb_unsupported;
+      continue;
+    }
+
+    std::vector<Uint>& send = send_elems[m_hash->subhash(ELEMS).part_of_obj(first_elem+e)];
+    send.push_back(first_elem+e);
+    send.push_back(elementNumber);
+    send.push_back(elementType);
+    send.push_back(nbElementNodes);
+    for (Uint j=0; j<nbElementNodes; ++j)
+    {
+      ss >> neu_node_number;
+      send.push_back(neu_node_number);
+    }
+  }
+  records.clear();
+  // Every rank throws, so that none is left waiting in the exchange
+  if(DistributedFileReader::global_sum(nb_unsupported) != 0)
+    throw common::NotSupported(FromHere(), "Failed to read neutral file: unsupported element type"
+                               + (nb_unsupported != 0 ? " " + common::to_str(unsupported_type) : std::string(" on another process")));
+
+  std::vector< std::vector<Uint> > recv_elems;
+  PE::Comm::instance().all_to_all(send_elems, recv_elems);
+  send_elems.clear();
+
+  // Put the received elements in the order of the file, and collect their nodes
+  std::vector< std::pair<Uint,const Uint*> > elems;
+  std::vector<Uint> used_nodes;
+  for (Uint p=0; p<nb_procs; ++p)
+  {
+    Uint i=0;
+    while (i<recv_elems[p].size())
+    {
+      const Uint* elem = &recv_elems[p][i];
+      elems.push_back(std::make_pair(elem[0],elem));
+      used_nodes.insert(used_nodes.end(), elem+4, elem+4+elem[3]);
+      i += 4+elem[3];
+    }
+  }
+  std::sort(elems.begin(), elems.end(), detail::file_idx_less);
+  std::sort(used_nodes.begin(), used_nodes.end());
+  used_nodes.erase(std::unique(used_nodes.begin(), used_nodes.end()), used_nodes.end());
+
+  // Owned nodes and the ghost nodes used by the elements
+  NodeRecords local_nodes;
+  DistributedFileReader::distribute_nodes(read_nodes, used_nodes, local_nodes);
+  read_nodes = NodeRecords();
+
+  Dictionary& nodes = m_mesh->geometry_fields();
+  nodes.resize(local_nodes.size());
+  for (Uint coord_idx=0; coord_idx<local_nodes.size(); ++coord_idx)
+  {
+    m_neu_node_to_coord_idx[local_nodes.number[coord_idx]]=coord_idx;
+    for (Uint d=0; d<dim; ++d)
+      nodes.coordinates()[coord_idx][d] = local_nodes.coordinates[coord_idx*dim+d];
+    nodes.rank()[coord_idx] = local_nodes.part[coord_idx];
+    nodes.glb_idx()[coord_idx] = local_nodes.number[coord_idx];
+  }
+
+  // Store the connectivity in the correct region through the buffer
+  m_tmp = Handle<Region>(m_region->create_region("main").handle<Component>());
+  m_global_to_tmp.clear();
+  std::map<std::string,Handle< Elements > > elements = create_cells_in_region(*m_tmp,nodes,m_supported_types);
+  std::map<std::string,boost::shared_ptr< Connectivity::Buffer > > buffer = create_connectivity_buffermap(elements);
+  std::vector<Uint> neu_element;
+  for (Uint e=0; e<elems.size(); ++e)
+  {
+    const Uint* elem = elems[e].second;
+    neu_element.assign(elem+4, elem+4+elem[3]);
+    add_element(elements,buffer,elem[1],elem[2],neu_element);
+  }
+
+  m_neu_node_to_coord_idx.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
 void Reader::read_groups()
 {
   Dictionary& nodes = m_mesh->geometry_fields();
@@ -12,6 +12,8 @@
 #include "mesh/MeshReader.hpp"
 #include "common/Table.hpp"
 #include "mesh/Dictionary.hpp"
+#include "mesh/Connectivity.hpp"
+#include "mesh/DistributedFileReader.hpp"
 
 #include "mesh/neu/LibNeu.hpp"
 #include "mesh/neu/Shared.hpp"
@@ -64,6 +66,17 @@ private: // functions
 
   void get_file_positions();
 
+  /// Find the sections of the file with all processors together
+  void find_sections();
+
+  /// Read the nodes and elements with all processors together, each parsing only its share of the file
+  void read_distributed();
+
+  /// Add an element to the temporary region, with its nodes numbered as in the file
+  void add_element(std::map<std::string,Handle<Elements> >& elements,
+                   std::map<std::string,boost::shared_ptr<Connectivity::Buffer> >& buffer,
+                   const Uint elementNumber, const Uint elementType, const std::vector<Uint>& neu_element);
+
   std::string element_type(const Uint neu_type, const Uint nb_nodes);
 
 private: // data
@@ -77,6 +90,7 @@ private: // data
   std::map<Uint,Region_TableIndex_pair> m_global_to_tmp;
 
   boost::filesystem::fstream m_file;
+  boost::shared_ptr<DistributedFileReader> m_distributed_file;
   Handle<Mesh> m_mesh;
   Handle<Region> m_region;
   Handle< Region > m_tmp;
@@ -88,6 +102,7 @@ private: // data
   Uint m_elements_cells_position;
   std::vector<Uint> m_element_group_positions;
   std::vector<Uint> m_boundary_condition_positions;
+  std::vector<DistributedFileReader::Position> m_end_of_section_positions;
 
   struct HeaderData
   {
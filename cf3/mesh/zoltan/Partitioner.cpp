@@ -220,6 +220,10 @@ void Partitioner::set_partitioning_params()
 
   zoltan_handle().Set_Param("EDGE_WEIGHT_DIM", "1");
 
+  zoltan_handle().Set_Param("OBJ_WEIGHT_DIM", "1");
+  // The number of weights per object, given in query_list_of_objects. The weights come from MeshPartitioner,
+  // so that the parts balance the computational cost of nodes and elements rather than their number.
+
   /// zoltan Query functions
 
   zoltan_handle().Set_Num_Obj_Fn(&Partitioner::query_nb_of_objects, this);
@@ -248,7 +252,8 @@ void Partitioner::query_list_of_objects(void *data, int sizeGID, int sizeLID,
   *ierr = ZOLTAN_OK;
 
   p.list_of_objects_owned_by_part(PE::Comm::instance().rank(),globalID);
-
+  if (wgt_dim > 0)
+    p.list_of_object_weights_in_part(PE::Comm::instance().rank(),obj_wgts);
 
   // for debugging
 #if 0
@@ -0,0 +1,155 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#include "python/BoostPython.hpp"
+
+#include <cstring>
+
+#include <boost/lexical_cast.hpp>
+
+#include "common/BasicExceptions.hpp"
+#include "common/Component.hpp"
+
+#include "python/ArrayInterface.hpp"
+
+namespace cf3 {
+namespace python {
+
+using namespace boost::python;
+
+namespace detail
+{
+
+/// Byte order character of the typestr
+char byte_order()
+{
+  const Uint one = 1;
+  return *reinterpret_cast<const char*>(&one) == 1 ? '<' : '>';
+}
+
+/// Release a Py_buffer when going out of scope
+struct BufferGuard
+{
+  BufferGuard(Py_buffer& buffer) : m_buffer(buffer) {}
+  ~BufferGuard() { PyBuffer_Release(&m_buffer); }
+  Py_buffer& m_buffer;
+};
+
+/// Check if the struct module format of a buffer matches the kind ('f' or 'u') of the typestr
+bool format_matches(const char* format, const char kind)
+{
+  if(format == 0)
+    format = "B";
+  if(*format == '@' || *format == '=')
+    ++format;
+  else if(*format == '<' || *format == '>' || *format == '!')
+  {
+    const char order = *format == '!' ? '>' : *format;
+    if(order != byte_order())
+      return false;
+    ++format;
+  }
+  if(format[0] == '\0' || format[1] != '\0')
+    return false;
+  return std::strchr(kind == 'f' ? "fdg" : "BHILQN", format[0]) != 0;
+}
+
+} // detail
+
+ArrayInterface::ArrayInterface(common::Component& owner, void* data, const std::string& typestr, const std::vector<Py_ssize_t>& shape, const std::vector<Py_ssize_t>& strides) :
+  m_owner(owner.shared_from_this()),
+  m_data(data),
+  m_typestr(typestr),
+  m_shape(shape),
+  m_strides(strides)
+{
+}
+
+dict ArrayInterface::array_interface() const
+{
+  list shape, strides;
+  for(Uint i = 0; i != m_shape.size(); ++i)
+  {
+    shape.append(m_shape[i]);
+    strides.append(m_strides[i]);
+  }
+
+  dict result;
+  result["shape"] = tuple(shape);
+  result["strides"] = tuple(strides);
+  result["typestr"] = m_typestr;
+  result["data"] = make_tuple(object(handle<>(PyLong_FromVoidPtr(m_data))), false);
+  result["version"] = 3;
+  return result;
+}
+
+template<>
+std::string array_typestr<Real>()
+{
+  return detail::byte_order() + std::string("f") + boost::lexical_cast<std::string>(sizeof(Real));
+}
+
+template<>
+std::string array_typestr<Uint>()
+{
+  return detail::byte_order() + std::string("u") + boost::lexical_cast<std::string>(sizeof(Uint));
+}
+
+object numpy_view(common::Component& owner, void* data, const std::string& typestr, const std::vector<Py_ssize_t>& shape, const std::vector<Py_ssize_t>& strides)
+{
+  // numpy keeps the ArrayInterface as base of the array
+  return import("numpy").attr("asarray")(object(ArrayInterface(owner, data, typestr, shape, strides)));
+}
+
+void copy_from_buffer(const object& values, void* data, const std::string& typestr, const std::vector<Py_ssize_t>& shape)
+{
+  if(!PyObject_CheckBuffer(values.ptr()))
+    throw common::BadValue(FromHere(), "Assigned object does not support the buffer protocol, use e.g. a numpy array");
+
+  Py_buffer buffer;
+  if(PyObject_GetBuffer(values.ptr(), &buffer, PyBUF_STRIDES | PyBUF_FORMAT) != 0)
+    throw_error_already_set();
+  detail::BufferGuard guard(buffer);
+
+  // typestr is the byte order, the kind and the size in bytes
+  const char kind = typestr[1];
+  const Uint itemsize = boost::lexical_cast<Uint>(typestr.substr(2));
+  if(buffer.itemsize != static_cast<Py_ssize_t>(itemsize) || !detail::format_matches(buffer.format, kind))
+    throw common::BadValue(FromHere(), "Assigned array has format " + std::string(buffer.format == 0 ? "B" : buffer.format) + ", which does not match type " + typestr.substr(1) + " of the destination. Use numpy.astype to convert it.");
+
+  if(buffer.ndim != static_cast<int>(shape.size()))
+    throw common::BadValue(FromHere(), "Assigned array has " + boost::lexical_cast<std::string>(buffer.ndim) + " dimensions, expected " + boost::lexical_cast<std::string>(shape.size()));
+  for(Uint i = 0; i != shape.size(); ++i)
+  {
+    if(buffer.shape[i] != shape[i])
+      throw common::BadValue(FromHere(), "Assigned array has size " + boost::lexical_cast<std::string>(buffer.shape[i]) + " in dimension " + boost::lexical_cast<std::string>(i) + ", expected " + boost::lexical_cast<std::string>(shape[i]));
+  }
+
+  if(PyBuffer_IsContiguous(&buffer, 'C'))
+  {
+    // memmove, since a view of the destination may be assigned
+    std::memmove(data, buffer.buf, buffer.len);
+    return;
+  }
+
+  // Gather strided arrays first, since they may also overlap the destination
+  std::vector<char> contiguous(buffer.len);
+  if(buffer.len != 0)
+  {
+    if(PyBuffer_ToContiguous(&contiguous[0], &buffer, buffer.len, 'C') != 0)
+      throw_error_already_set();
+    std::memcpy(data, &contiguous[0], buffer.len);
+  }
+}
+
+void def_array_interface()
+{
+  class_<ArrayInterface>("ArrayInterface", "Description of coolfluid memory for numpy", no_init)
+    .add_property("__array_interface__", &ArrayInterface::array_interface);
+}
+
+} // python
+} // cf3
@@ -0,0 +1,97 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#ifndef CF3_Python_ArrayInterface_hpp
+#define CF3_Python_ArrayInterface_hpp
+
+#include "python/BoostPython.hpp"
+
+#include <string>
+#include <vector>
+
+#include <boost/multi_array.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "common/Assertions.hpp"
+#include "common/CF.hpp"
+
+namespace cf3 {
+namespace common { class Component; }
+namespace python {
+
+/// Describes memory owned by a component through the numpy __array_interface__ protocol, so numpy can
+/// use it without copying. numpy keeps this object as the base of the array, and this object keeps the
+/// component alive, so the memory remains valid when the component is removed from the tree.
+/// Resizing the table or list reallocates its memory however, so arrays created before a resize must not be used after it.
+class ArrayInterface
+{
+public:
+  ArrayInterface(common::Component& owner, void* data, const std::string& typestr, const std::vector<Py_ssize_t>& shape, const std::vector<Py_ssize_t>& strides);
+
+  /// The __array_interface__ dictionary
+  boost::python::dict array_interface() const;
+
+private:
+  /// Keeps the component owning the memory alive
+  boost::shared_ptr<common::Component> m_owner;
+  void* m_data;
+  std::string m_typestr;
+  std::vector<Py_ssize_t> m_shape;
+  std::vector<Py_ssize_t> m_strides;
+};
+
+/// Data type of ValueT, in the typestr format of __array_interface__
+template<typename ValueT>
+std::string array_typestr();
+
+template<> std::string array_typestr<Real>();
+template<> std::string array_typestr<Uint>();
+
+/// Return a numpy array sharing the memory described by the arguments
+/// @param strides Strides in bytes
+boost::python::object numpy_view(common::Component& owner, void* data, const std::string& typestr, const std::vector<Py_ssize_t>& shape, const std::vector<Py_ssize_t>& strides);
+
+/// Copy the values of a python object supporting the buffer protocol (e.g. a numpy array) to the memory described by the arguments,
+/// which must be contiguous in C order. The shape and the data type must match.
+void copy_from_buffer(const boost::python::object& values, void* data, const std::string& typestr, const std::vector<Py_ssize_t>& shape);
+
+/// Shape and strides in bytes of a multi_array
+template<typename ValueT, std::size_t NumDims>
+void array_layout(const boost::multi_array<ValueT, NumDims>& array, std::vector<Py_ssize_t>& shape, std::vector<Py_ssize_t>& strides)
+{
+  shape.assign(array.shape(), array.shape() + NumDims);
+  strides.resize(NumDims);
+  for(Uint i = 0; i != NumDims; ++i)
+    strides[i] = array.strides()[i] * sizeof(ValueT);
+}
+
+/// Return a numpy array sharing the memory of the given multi_array, which is owned by owner
+template<typename ValueT, std::size_t NumDims>
+boost::python::object numpy_view(common::Component& owner, boost::multi_array<ValueT, NumDims>& array)
+{
+  std::vector<Py_ssize_t> shape, strides;
+  array_layout(array, shape, strides);
+  return numpy_view(owner, array.data(), array_typestr<ValueT>(), shape, strides);
+}
+
+/// Copy the values of a python object supporting the buffer protocol to the given multi_array
+template<typename ValueT, std::size_t NumDims>
+void copy_from_buffer(const boost::python::object& values, boost::multi_array<ValueT, NumDims>& array)
+{
+  cf3_assert(array.num_elements() == 0 || array.storage_order() == boost::c_storage_order());
+  std::vector<Py_ssize_t> shape(array.shape(), array.shape() + NumDims);
+  copy_from_buffer(values, array.data(), array_typestr<ValueT>(), shape);
+}
+
+/// Register the ArrayInterface class with python
+void def_array_interface();
+
+} // python
+} // cf3
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // CF3_Python_ArrayInterface_hpp
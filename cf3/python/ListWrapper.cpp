@@ -15,6 +15,7 @@
 
 #include "common/List.hpp"
 
+#include "python/ArrayInterface.hpp"
 #include "python/ComponentWrapper.hpp"
 #include "python/ListWrapper.hpp"
 #include "python/Utility.hpp"
@@ -75,6 +76,17 @@ struct ListMethods
   {
     wrapped.component< common::List<ValueT> >().resize(nb_rows);
   }
+
+  static object array(ComponentWrapper& wrapped)
+  {
+    common::List<ValueT>& component = wrapped.component< common::List<ValueT> >();
+    return numpy_view(component, component.array());
+  }
+
+  static void assign(ComponentWrapper& wrapped, const object& values)
+  {
+    copy_from_buffer(values, wrapped.component< common::List<ValueT> >().array());
+  }
 };
 
 template<typename ValueT>
@@ -89,6 +101,8 @@ void add_clist_methods(ComponentWrapper& wrapped, boost::python::api::object& py
     // Extra methods
     typedef ListMethods<ValueT> ExtraMethodsT;
     add_function(py_obj, ExtraMethodsT::resize, "resize", "Set the size of the table, i.e. the number of rows");
+    add_function(py_obj, ExtraMethodsT::array, "array", "Return a numpy array sharing the memory of the list. It must not be used after the list is resized");
+    add_function(py_obj, ExtraMethodsT::assign, "assign", "Copy all values from an array with the same size and type, e.g. a numpy array");
   }
 }
 
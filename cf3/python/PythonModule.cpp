@@ -6,6 +6,7 @@
 
 #include "python/BoostPython.hpp"
 
+#include "python/ArrayInterface.hpp"
 #include "python/ComponentWrapper.hpp"
 #include "python/CoreWrapper.hpp"
 #include "python/TableWrapper.hpp"
@@ -21,6 +22,7 @@ using namespace boost::python;
 
 BOOST_PYTHON_MODULE(libcoolfluid_python)
 {
+  def_array_interface();
   def_component();
   def_core();
   def_ctable_types();
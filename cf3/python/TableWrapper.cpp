@@ -15,6 +15,7 @@
 
 #include "common/Table.hpp"
 
+#include "python/ArrayInterface.hpp"
 #include "python/ComponentWrapper.hpp"
 #include "python/TableWrapper.hpp"
 #include "python/Utility.hpp"
@@ -131,6 +132,17 @@ struct TableMethods
   {
     wrapped.component< common::Table<ValueT> >().set_row_size(nb_cols);
   }
+
+  static object array(ComponentWrapper& wrapped)
+  {
+    common::Table<ValueT>& component = wrapped.component< common::Table<ValueT> >();
+    return numpy_view(component, component.array());
+  }
+
+  static void assign(ComponentWrapper& wrapped, const object& values)
+  {
+    copy_from_buffer(values, wrapped.component< common::Table<ValueT> >().array());
+  }
 };
 
 template<typename ValueT>
@@ -147,6 +159,8 @@ void add_ctable_methods(ComponentWrapper& wrapped, boost::python::api::object& p
     add_function(py_obj, ExtraMethodsT::row_size, "row_size", "Return the number of columns the table can hold");
     add_function(py_obj, ExtraMethodsT::resize, "resize", "Set the size of the table, i.e. the number of rows");
     add_function(py_obj, ExtraMethodsT::set_row_size, "set_row_size", "Set the size of a row, i.e. the number of columns in the table");
+    add_function(py_obj, ExtraMethodsT::array, "array", "Return a numpy array sharing the memory of the table. It must not be used after the table is resized");
+    add_function(py_obj, ExtraMethodsT::assign, "assign", "Copy all values from an array with the same shape and type, e.g. a numpy array");
   }
 }
 
@@ -4,6 +4,7 @@
 // GNU Lesser General Public License version 3 (LGPLv3).
 // See doc/lgpl.txt and doc/gpl.txt for the license text.
 
+#include "common/BackgroundWriter.hpp"
 #include "common/OptionComponent.hpp"
 #include "common/OptionList.hpp"
 #include "common/PropertyList.hpp"
@@ -74,6 +75,9 @@ void AdvanceTime::execute ()
     mesh().metadata()["time"] = time.current_time();
     mesh().metadata()["iter"] = time.iter();
   }
+
+  // Complete the files that were written in the background during the previous step
+  BackgroundWriter::instance().poll();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,179 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#include <algorithm>
+
+#include "common/Builder.hpp"
+#include "common/FindComponents.hpp"
+#include "common/Foreach.hpp"
+#include "common/Log.hpp"
+#include "common/OptionList.hpp"
+#include "common/PropertyList.hpp"
+#include "common/Timer.hpp"
+#include "common/PE/Comm.hpp"
+#include "common/PE/CommPattern.hpp"
+
+#include "mesh/Dictionary.hpp"
+#include "mesh/Elements.hpp"
+#include "mesh/Field.hpp"
+#include "mesh/Mesh.hpp"
+#include "mesh/MeshTransformer.hpp"
+#include "mesh/Region.hpp"
+
+#include "DynamicLoadBalance.hpp"
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+using namespace cf3::common;
+using namespace cf3::mesh;
+
+namespace cf3 {
+namespace solver {
+namespace actions {
+
+///////////////////////////////////////////////////////////////////////////////////////
+
+common::ComponentBuilder < DynamicLoadBalance, common::Action, LibActions > DynamicLoadBalance_Builder;
+
+///////////////////////////////////////////////////////////////////////////////////////
+
+DynamicLoadBalance::DynamicLoadBalance ( const std::string& name ) :
+  solver::ActionDirector(name),
+  m_elapsed(0.),
+  m_nb_executions(0)
+{
+  properties()["brief"] = std::string("Repartition the mesh when the child actions take longer on some processors");
+  properties()["imbalance"] = Real(1.);
+  properties()["nb_rebalances"] = Uint(0);
+
+  options().add("imbalance_threshold", 1.2)
+      .description("Repartition when the time of the slowest processor divided by the mean time exceeds this value")
+      .pretty_name("Imbalance Threshold")
+      .mark_basic();
+
+  options().add("check_interval", 10u)
+      .description("Number of executions between two comparisons of the processor times")
+      .pretty_name("Check Interval")
+      .mark_basic();
+
+  options().add("timing_property", std::string("measured_time"))
+      .description("Property of the Elements holding their measured time, passed on to the partitioner")
+      .pretty_name("Timing Property");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void DynamicLoadBalance::execute()
+{
+  Timer timer;
+  solver::ActionDirector::execute();
+  m_elapsed += timer.elapsed();
+
+  PE::Comm& comm = PE::Comm::instance();
+  if(++m_nb_executions < options().value<Uint>("check_interval") || !comm.is_active() || comm.size() == 1)
+    return;
+
+  std::vector<Real> times;
+  comm.all_gather(m_elapsed, times);
+  const Real max_time = *std::max_element(times.begin(), times.end());
+  Real mean_time = 0.;
+  boost_foreach(const Real t, times)
+    mean_time += t;
+  mean_time /= static_cast<Real>(times.size());
+
+  const Real imbalance = mean_time > 0. ? max_time / mean_time : 1.;
+  properties()["imbalance"] = imbalance;
+  if(imbalance > options().value<Real>("imbalance_threshold"))
+  {
+    CFinfo << uri().path() << ": slowest processor took " << imbalance << " times the mean time, rebalancing" << CFendl;
+    rebalance();
+  }
+
+  m_elapsed = 0.;
+  m_nb_executions = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void DynamicLoadBalance::set_element_times()
+{
+  const std::string timing_property = options().value<std::string>("timing_property");
+
+  // Forget the times of a previous rebalance, for elements that may no longer be in the regions
+  boost_foreach(Elements& elements, find_components_recursively<Elements>(mesh().topology()))
+  {
+    if(elements.properties().check(timing_property))
+      elements.properties().erase(timing_property);
+  }
+
+  std::vector< Handle<Elements> > timed_elements;
+  if(m_loop_regions.empty())
+  {
+    boost_foreach(Elements& elements, find_components_recursively<Elements>(mesh().topology()))
+      timed_elements.push_back(elements.handle<Elements>());
+  }
+  else
+  {
+    boost_foreach(const Handle<Region>& region, m_loop_regions)
+    {
+      boost_foreach(Elements& elements, find_components_recursively<Elements>(*region))
+      {
+        if(std::find(timed_elements.begin(), timed_elements.end(), elements.handle<Elements>()) == timed_elements.end())
+          timed_elements.push_back(elements.handle<Elements>());
+      }
+    }
+  }
+
+  Real nb_elements = 0.;
+  boost_foreach(const Handle<Elements>& elements, timed_elements)
+    nb_elements += elements->size();
+
+  boost_foreach(const Handle<Elements>& elements, timed_elements)
+  {
+    if(elements->size() != 0)
+      elements->properties()[timing_property] = m_elapsed * static_cast<Real>(elements->size()) / nb_elements;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void DynamicLoadBalance::rebalance()
+{
+  Mesh& mesh = this->mesh();
+
+  set_element_times();
+
+  // Migrate the elements, nodes and field values, as PeriodicMeshPartitioner does for a distributed mesh
+  build_component_abstract_type<MeshTransformer>("cf3.mesh.actions.RemoveGhostElements","remove_ghosts")->transform(mesh);
+  boost::shared_ptr<MeshTransformer> load_balance = build_component_abstract_type<MeshTransformer>("cf3.mesh.actions.LoadBalance","load_balance");
+  load_balance->get_child("partitioner")->options().set("timing_property", options().value<std::string>("timing_property"));
+  load_balance->transform(mesh);
+
+  // The comm patterns refer to the old ghost nodes, and the ghost nodes added by the overlap have no values yet
+  std::vector< Handle<Field> > fields;
+  boost_foreach(Dictionary& dict, find_components_recursively<Dictionary>(mesh))
+  {
+    if(is_not_null(dict.get_child("CommPattern")))
+      dict.remove_component("CommPattern");
+    boost_foreach(Field& field, find_components<Field>(dict))
+    {
+      field.parallelize_with(dict.comm_pattern());
+      fields.push_back(field.handle<Field>());
+    }
+  }
+  boost_foreach(const Handle<Field>& field, fields)
+    field->begin_synchronize();
+  boost_foreach(const Handle<Field>& field, fields)
+    field->end_synchronize();
+
+  properties()["nb_rebalances"] = properties().value<Uint>("nb_rebalances") + 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // actions
+} // solver
+} // cf3
@@ -0,0 +1,76 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#ifndef cf3_solver_actions_DynamicLoadBalance_hpp
+#define cf3_solver_actions_DynamicLoadBalance_hpp
+
+#include "solver/ActionDirector.hpp"
+
+#include "solver/actions/LibActions.hpp"
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+namespace cf3 {
+namespace solver {
+namespace actions {
+
+/// @brief Execute the child actions, and repartition the mesh when their execution time is unbalanced between processors
+///
+/// The children are timed on each processor, so they should be the actions doing the local work (e.g. the assembly),
+/// without the collective operations that make all processors wait for the slowest one.
+/// Every check_interval executions the accumulated times are compared, and if the slowest processor exceeds
+/// imbalance_threshold times the mean, the mesh is repartitioned:
+///   - the time of each processor is spread over its elements in the regions, and stored in the timing_property
+///     of each Elements, so the partitioner weighs the elements by their measured cost
+///   - the overlap is removed, and LoadBalance migrates the elements, nodes and field values using the
+///     MeshAdaptor, before growing the overlap again
+///   - the comm patterns of the dictionaries are rebuilt, and all fields are parallelized and synchronized, so the
+///     new ghost nodes get their values
+///
+/// Linear systems built on the mesh are not touched here, since only their owner knows how to build them again.
+/// The MeshAdaptor raises the mesh_changed event during the migration, and a component owning a math::LSS::System
+/// must then consider its system invalid and rebuild it before its next use, as UFEM::LSSAction does. The rebuild
+/// must not happen in the event handler itself, because the comm patterns are only rebuilt after the event.
+class solver_actions_API DynamicLoadBalance : public solver::ActionDirector {
+
+public: // functions
+  /// Contructor
+  /// @param name of the component
+  DynamicLoadBalance ( const std::string& name );
+
+  /// Virtual destructor
+  virtual ~DynamicLoadBalance() {}
+
+  /// Get the class name
+  static std::string type_name () { return "DynamicLoadBalance"; }
+
+  /// Execute and time the child actions, and rebalance if needed
+  virtual void execute ();
+
+  /// Repartition the mesh using the time measured since the last check
+  void rebalance();
+
+private: // helper functions
+
+  /// Store the measured time of this processor in the Elements of the regions, in proportion to their size
+  void set_element_times();
+
+private: // data
+
+  /// Time spent in the child actions since the last check
+  Real m_elapsed;
+
+  /// Number of executions since the last check
+  Uint m_nb_executions;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // actions
+} // solver
+} // cf3
+
+#endif // cf3_solver_actions_DynamicLoadBalance_hpp
@@ -0,0 +1,380 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include "common/BasicExceptions.hpp"
+#include "common/Builder.hpp"
+#include "common/Core.hpp"
+#include "common/EventHandler.hpp"
+#include "common/FindComponents.hpp"
+#include "common/Foreach.hpp"
+#include "common/Log.hpp"
+#include "common/OptionList.hpp"
+#include "common/PropertyList.hpp"
+#include "common/StringConversion.hpp"
+
+#include "common/PE/Comm.hpp"
+#include "common/XML/FileOperations.hpp"
+#include "common/XML/SignalOptions.hpp"
+
+#include "math/VariablesDescriptor.hpp"
+
+#include "mesh/Dictionary.hpp"
+#include "mesh/Field.hpp"
+#include "mesh/Mesh.hpp"
+#include "mesh/PointInterpolator.hpp"
+#include "mesh/Space.hpp"
+#include "mesh/Tags.hpp"
+
+#include "solver/Tags.hpp"
+#include "solver/Time.hpp"
+#include "solver/actions/ProbeArray.hpp"
+
+namespace cf3 {
+namespace solver {
+namespace actions {
+
+using namespace common;
+using namespace mesh;
+
+common::ComponentBuilder < ProbeArray, common::Action, solver::actions::LibActions > ProbeArray_Builder;
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+ProbeArray::ProbeArray( const std::string& name  ) :
+  common::Action(name),
+  m_located(false),
+  m_dimension(0),
+  m_row_size(0),
+  m_nb_written(0),
+  m_file_started(false),
+  m_step(0)
+{
+  properties()["brief"] = std::string("Record field values at a large number of points");
+  std::string description =
+      "Interpolates the fields of a dictionary to a list of points, locating the points only once,\n"
+      "and writes the values of all points to a binary file, buffered on rank 0.";
+  properties()["description"] = description;
+
+  options().add("coordinates", std::vector<Real>())
+    .pretty_name("Coordinates")
+    .description("Coordinates of the probes, one after the other (x0 y0 x1 y1 ... in 2D)")
+    .attach_trigger( boost::bind( &ProbeArray::trigger_reset, this ) )
+    .mark_basic();
+
+  options().add("dict", m_dict)
+    .pretty_name("Dictionary")
+    .description("Dictionary that will be probed")
+    .link_to(&m_dict)
+    .attach_trigger( boost::bind( &ProbeArray::trigger_reset, this ) )
+    .mark_basic();
+
+  options().add("fields", std::vector< Handle<mesh::Field> >())
+    .pretty_name("Fields")
+    .description("Fields to probe. All fields of the dictionary are probed if this is empty.")
+    .attach_trigger( boost::bind( &ProbeArray::trigger_reset, this ) )
+    .mark_basic();
+
+  options().add("file", URI("probes.xml"))
+    .pretty_name("File")
+    .description("XML file describing the output. The values are written to a file with the same base name and extension cfprobes.")
+    .attach_trigger( boost::bind( &ProbeArray::trigger_reset, this ) )
+    .mark_basic();
+
+  options().add("buffer_size", 100u)
+    .pretty_name("Buffer Size")
+    .description("Number of executions that are kept in memory before writing them to the file")
+    .mark_basic();
+
+  options().add(solver::Tags::time(), m_time)
+    .pretty_name("Time")
+    .description("Time component, used to stamp the records. The number of executions is used if this is not set.")
+    .link_to(&m_time)
+    .mark_basic();
+
+  m_point_interpolator = create_component<PointInterpolator>("point_interpolator");
+
+  Core::instance().event_handler().connect_to_event(mesh::Tags::event_mesh_changed(), this, &ProbeArray::on_mesh_changed_event);
+  Core::instance().event_handler().connect_to_event(mesh::Tags::event_coordinates_changed(), this, &ProbeArray::on_mesh_changed_event);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ProbeArray::~ProbeArray()
+{
+  try
+  {
+    flush();
+  }
+  catch(std::exception& e)
+  {
+    CFerror << "Failed to write probe data for " << uri().string() << ": " << e.what() << CFendl;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Uint ProbeArray::nb_probes() const
+{
+  return m_dimension == 0 ? 0 : m_coordinates.size() / m_dimension;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ProbeArray::trigger_reset()
+{
+  flush();
+  m_located = false;
+  m_file_started = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ProbeArray::on_mesh_changed_event(SignalArgs& args)
+{
+  if(is_null(m_dict) || !m_located)
+    return;
+
+  XML::SignalOptions options(args);
+  const URI mesh_uri = options.value<URI>("mesh_uri");
+  if(mesh_uri != find_parent_component<Mesh>(*m_dict).uri())
+    return;
+
+  // The layout stays the same, so the records keep going to the same file unless the variables change
+  flush();
+  m_located = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ProbeArray::locate()
+{
+  if(is_null(m_dict))
+    throw SetupError(FromHere(), "Option \"dict\" was not configured in "+uri().string());
+
+  PE::Comm& comm = PE::Comm::instance();
+  const int rank = static_cast<int>(comm.rank());
+  const int nb_procs = static_cast<int>(comm.size());
+
+  const Uint dimension = find_parent_component<Mesh>(*m_dict).dimension();
+  const std::vector<Real> coordinates = options().value< std::vector<Real> >("coordinates");
+  if(coordinates.size() % dimension != 0)
+    throw SetupError(FromHere(), "Size of option \"coordinates\" of " + uri().string() + " is not a multiple of the dimension " + to_str(dimension));
+  const Uint nb_probes = coordinates.size() / dimension;
+
+  // Fields and variables
+  m_fields = options().value< std::vector< Handle<mesh::Field> > >("fields");
+  if(m_fields.empty())
+    m_fields = m_dict->fields();
+  std::vector<std::string> variable_names;
+  m_row_size = 0;
+  boost_foreach(const Handle<Field>& field, m_fields)
+  {
+    if(&field->dict() != m_dict.get())
+      throw SetupError(FromHere(), "Field " + field->uri().string() + " does not belong to dictionary " + m_dict->uri().string());
+    for(Uint var_idx = 0; var_idx != field->nb_vars(); ++var_idx)
+    {
+      const std::string var_name = field->descriptor().user_variable_name(var_idx);
+      const Uint var_length = field->descriptor().var_length(var_idx);
+      if(var_length == 1)
+        variable_names.push_back(var_name);
+      else
+        for(Uint i = 0; i != var_length; ++i)
+          variable_names.push_back(var_name + "[" + to_str(i) + "]");
+    }
+    m_row_size += field->row_size();
+  }
+
+  // A change in the record layout requires a new output file
+  const URI file = options().value<URI>("file");
+  if(variable_names != m_variable_names || coordinates != m_coordinates || file != m_file)
+    m_file_started = false;
+  m_variable_names = variable_names;
+  m_coordinates = coordinates;
+  m_file = file;
+  m_dimension = dimension;
+
+  // Find the probes on this process. The lowest rank that finds a probe owns it.
+  m_point_interpolator->options().set("dict", m_dict);
+  std::vector<int> owners(nb_probes, nb_procs);
+  std::vector< std::vector<Uint> > points(nb_probes);
+  std::vector< std::vector<Real> > weights(nb_probes);
+  RealVector coord(dimension);
+  SpaceElem element;
+  std::vector<SpaceElem> stencil;
+  for(Uint probe = 0; probe != nb_probes; ++probe)
+  {
+    for(Uint i = 0; i != dimension; ++i)
+      coord[i] = coordinates[probe*dimension + i];
+    if(m_point_interpolator->compute_storage(coord, element, stencil, points[probe], weights[probe]))
+      owners[probe] = rank;
+  }
+
+  if(comm.is_active() && nb_probes != 0)
+    comm.all_reduce(PE::min(), &owners[0], nb_probes, &owners[0]);
+
+  Uint nb_not_found = 0;
+  for(Uint probe = 0; probe != nb_probes; ++probe)
+  {
+    if(owners[probe] == nb_procs)
+    {
+      if(nb_not_found == 0)
+        CFerror << "Probe " << probe << " of " << uri().string() << " at (" << to_str(std::vector<Real>(coordinates.begin() + probe*dimension, coordinates.begin() + (probe+1)*dimension)) << ") lies outside the domain" << CFendl;
+      ++nb_not_found;
+    }
+  }
+  if(nb_not_found != 0)
+    throw SetupError(FromHere(), "Cannot probe: " + to_str(nb_not_found) + " of the points of " + uri().string() + " lie outside the domain");
+
+  // Cache the interpolation data of the local probes, and the order in which rank 0 receives the values
+  m_local_probes.clear();
+  m_local_points.clear();
+  m_local_weights.clear();
+  m_receive_counts.assign(nb_procs, 0);
+  for(Uint probe = 0; probe != nb_probes; ++probe)
+  {
+    m_receive_counts[owners[probe]] += m_row_size;
+    if(owners[probe] == rank)
+    {
+      m_local_probes.push_back(probe);
+      m_local_points.push_back(points[probe]);
+      m_local_weights.push_back(weights[probe]);
+    }
+  }
+
+  m_receive_order.clear();
+  if(rank == 0)
+  {
+    std::vector< std::vector<Uint> > probes_per_rank(nb_procs);
+    for(Uint probe = 0; probe != nb_probes; ++probe)
+      probes_per_rank[owners[probe]].push_back(probe);
+    m_receive_order.reserve(nb_probes);
+    for(int i = 0; i != nb_procs; ++i)
+      m_receive_order.insert(m_receive_order.end(), probes_per_rank[i].begin(), probes_per_rank[i].end());
+  }
+
+  m_located = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ProbeArray::execute()
+{
+  if(!m_located)
+    locate();
+
+  PE::Comm& comm = PE::Comm::instance();
+  const Uint nb_probes = this->nb_probes();
+
+  // Interpolate the local probes. The buffers have one extra value, so they can be passed to MPI when empty.
+  std::vector<Real> local_values(m_local_probes.size() * m_row_size + 1, 0.);
+  for(Uint i = 0; i != m_local_probes.size(); ++i)
+  {
+    const std::vector<Uint>& points = m_local_points[i];
+    const std::vector<Real>& weights = m_local_weights[i];
+    Real* probe_values = &local_values[i*m_row_size];
+    Uint offset = 0;
+    boost_foreach(const Handle<Field>& field, m_fields)
+    {
+      const Field& f = *field;
+      const Uint field_row_size = f.row_size();
+      for(Uint j = 0; j != points.size(); ++j)
+      {
+        for(Uint v = 0; v != field_row_size; ++v)
+          probe_values[offset + v] += f[points[j]][v] * weights[j];
+      }
+      offset += field_row_size;
+    }
+  }
+
+  // Collect the values on rank 0. The receive counts are known, so this is a single collective operation.
+  std::vector<Real> received(nb_probes * m_row_size + 1);
+  if(comm.is_active())
+    comm.gather(&local_values[0], static_cast<int>(m_local_probes.size() * m_row_size), &received[0], &m_receive_counts[0], 0);
+  else
+    received.swap(local_values);
+
+  ++m_step;
+  if(comm.rank() != 0)
+    return;
+
+  m_values.resize(nb_probes * m_row_size);
+  for(Uint i = 0; i != nb_probes; ++i)
+    std::copy(received.begin() + i*m_row_size, received.begin() + (i+1)*m_row_size, m_values.begin() + m_receive_order[i]*m_row_size);
+
+  m_buffer.push_back(is_null(m_time) ? static_cast<Real>(m_step) : m_time->current_time());
+  m_buffer.insert(m_buffer.end(), m_values.begin(), m_values.end());
+
+  const Uint record_size = 1 + m_values.size();
+  if(m_buffer.size() >= std::max(options().value<Uint>("buffer_size"), 1u) * record_size)
+    flush();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ProbeArray::flush()
+{
+  if(PE::Comm::instance().rank() != 0 || m_buffer.empty())
+    return;
+
+  const URI binfile = m_file.base_path() / (m_file.base_name() + ".cfprobes");
+
+  const std::ios_base::openmode mode = std::ios_base::out | std::ios_base::binary | (m_file_started ? std::ios_base::app : std::ios_base::trunc);
+  boost::filesystem::fstream out_file(binfile.path(), mode);
+  if(!out_file)
+    throw FileSystemError(FromHere(), "Failed to open file " + binfile.path());
+  if(!m_file_started)
+    m_nb_written = 0;
+  out_file.write(reinterpret_cast<const char*>(&m_buffer[0]), m_buffer.size() * sizeof(Real));
+  out_file.close();
+  if(!out_file)
+    throw FileSystemError(FromHere(), "Failed to write probe data to " + binfile.path());
+
+  m_nb_written += m_buffer.size() / (1 + nb_probes() * m_row_size);
+  m_file_started = true;
+  m_buffer.clear();
+
+  write_header();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ProbeArray::write_header()
+{
+  XML::XmlDoc xml_doc("1.0", "ISO-8859-1");
+  XML::XmlNode probes_node = xml_doc.add_node("probes");
+  probes_node.set_attribute("version", "1");
+  probes_node.set_attribute("binary_file", m_file.base_name() + ".cfprobes");
+  probes_node.set_attribute("nb_probes", to_str(nb_probes()));
+  probes_node.set_attribute("dimension", to_str(m_dimension));
+  probes_node.set_attribute("record_size", to_str(1 + nb_probes() * m_row_size));
+  probes_node.set_attribute("nb_records", to_str(m_nb_written));
+
+  for(Uint i = 0; i != m_variable_names.size(); ++i)
+  {
+    XML::XmlNode variable_node = probes_node.add_node("variable");
+    variable_node.set_attribute("name", m_variable_names[i]);
+    variable_node.set_attribute("offset", to_str(i));
+  }
+
+  for(Uint probe = 0; probe != nb_probes(); ++probe)
+  {
+    XML::XmlNode probe_node = probes_node.add_node("probe");
+    probe_node.set_attribute("coordinate", to_str(std::vector<Real>(m_coordinates.begin() + probe*m_dimension, m_coordinates.begin() + (probe+1)*m_dimension)));
+  }
+
+  XML::to_file(xml_doc, m_file);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // actions
+} // solver
+} // cf3
@@ -0,0 +1,133 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#ifndef cf3_solver_actions_ProbeArray_hpp
+#define cf3_solver_actions_ProbeArray_hpp
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include "common/Action.hpp"
+#include "common/URI.hpp"
+#include "solver/actions/LibActions.hpp"
+
+namespace cf3 {
+namespace mesh { class Dictionary; class Field; class PointInterpolator; }
+namespace solver {
+class Time;
+namespace actions {
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief Interpolate fields to a large set of points, and record the values in a binary file
+///
+/// Contrary to Probe, the points are located only once: the owning process, the interpolation points and the weights
+/// are cached until the mesh changes. Each execution interpolates the points owned by each process, and collects all
+/// values on rank 0 with a single gather. Rank 0 buffers the records in memory and appends them to the binary file
+/// every buffer_size executions.
+///
+/// The "file" option names an XML file describing the output:
+/// @verbatim
+/// <probes version="1" binary_file="probes.cfprobes" nb_probes="2" dimension="2" record_size="7" nb_records="100">
+///   <variable name="u[0]" offset="0"/>
+///   ...
+///   <probe coordinate="0.5 0.5"/>
+///   ...
+/// </probes>
+/// @endverbatim
+/// The binary file holds nb_records records of record_size native doubles: the time, followed by the values of all
+/// variables for the first probe, then for the second probe, ...
+class solver_actions_API ProbeArray : public common::Action {
+public: // functions
+
+  /// Contructor
+  /// @param name of the component
+  ProbeArray ( const std::string& name );
+
+  /// Virtual destructor, flushes the buffered records
+  virtual ~ProbeArray();
+
+  /// Get the class name
+  static std::string type_name () { return "ProbeArray"; }
+
+  virtual void execute();
+
+  /// Append the buffered records to the binary file. Only does work on rank 0.
+  void flush();
+
+  /// Number of probe points
+  Uint nb_probes() const;
+
+  /// Names of the variables recorded for each probe
+  const std::vector<std::string>& variable_names() const { return m_variable_names; }
+
+  /// Values interpolated during the last execution, for each probe in turn. Only filled on rank 0.
+  const std::vector<Real>& values() const { return m_values; }
+
+private: // functions
+
+  /// Find the process, interpolation points and weights of each probe
+  void locate();
+
+  /// Forget the location of the probes, and start a new output file since the record layout may change
+  void trigger_reset();
+
+  /// Forget the location of the probes if our mesh changed
+  void on_mesh_changed_event(common::SignalArgs& args);
+
+  /// Write the XML description of the output
+  void write_header();
+
+private: // data
+
+  Handle<mesh::Dictionary>            m_dict;                ///< Dictionary to interpolate
+  Handle<mesh::PointInterpolator>     m_point_interpolator;  ///< Interpolator used to locate the points
+  Handle<solver::Time>                m_time;                ///< Optional time component
+
+  /// True if the cached location data is valid
+  bool m_located;
+  /// Coordinates of the probes, fixed when the probes are located
+  std::vector<Real> m_coordinates;
+  Uint m_dimension;
+  /// Output file, fixed when the probes are located
+  common::URI m_file;
+  /// Fields that are probed, fixed when the probes are located
+  std::vector< Handle<mesh::Field> > m_fields;
+  /// Number of values per probe
+  Uint m_row_size;
+  std::vector<std::string> m_variable_names;
+
+  /// Probes located on this process, in increasing order
+  std::vector<Uint> m_local_probes;
+  /// Interpolation points and weights of the local probes
+  std::vector< std::vector<Uint> > m_local_points;
+  std::vector< std::vector<Real> > m_local_weights;
+
+  /// Number of values sent by each process
+  std::vector<int> m_receive_counts;
+  /// For each probe in the received order, its index (rank 0 only)
+  std::vector<Uint> m_receive_order;
+
+  /// Last interpolated values (rank 0 only)
+  std::vector<Real> m_values;
+  /// Records that were not written yet (rank 0 only)
+  std::vector<Real> m_buffer;
+  /// Number of records written to the file so far
+  Uint m_nb_written;
+  /// True once the binary file was created for the current layout
+  bool m_file_started;
+  /// Number of executions, used as time if no time component is set
+  Uint m_step;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // actions
+} // solver
+} // cf3
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // cf3_solver_actions_ProbeArray_hpp
@@ -8,9 +8,12 @@
 #ifndef cf3_solver_actions_Proto_BlockAccumulator_hpp
 #define cf3_solver_actions_Proto_BlockAccumulator_hpp
 
+#include <typeinfo>
+
 #include <boost/mpl/assert.hpp>
 #include <boost/proto/core.hpp>
 #include <boost/proto/traits.hpp>
+#include <boost/thread/mutex.hpp>
 
 
 #include "math/MatrixTypes.hpp"
@@ -54,6 +57,41 @@ namespace detail {
   {
     throw common::ShouldNotBeHere(FromHere(), "Number of element nodes was found to be zero.");
   }
+
+  /// Locks the given mutex for the lifetime of the object, if it is not null
+  class OptionalLock : boost::noncopyable
+  {
+  public:
+    OptionalLock(boost::mutex* mutex) : m_mutex(mutex)
+    {
+      if(is_not_null(m_mutex))
+        m_mutex->lock();
+    }
+
+    ~OptionalLock()
+    {
+      if(is_not_null(m_mutex))
+        m_mutex->unlock();
+    }
+
+  private:
+    boost::mutex* m_mutex;
+  };
+
+  /// Storage for the matrix offsets of the current element of data, see math::LSS::Matrix::add_values_cached
+  /// The storage is looked up once per data object, and identified by the elements and the type of data, which
+  /// determines the layout of the block accumulator
+  template<typename DataT>
+  inline std::vector<int>& element_offsets(math::LSS::Matrix& lss_matrix, const DataT& data)
+  {
+    if(data.lss_offsets_matrix != &lss_matrix)
+    {
+      data.lss_offsets = &lss_matrix.cached_offsets(data.elements().uri().path() + ":" + typeid(DataT).name(), data.elements().size());
+      data.lss_offsets_matrix = &lss_matrix;
+    }
+    cf3_assert(data.element_idx() < data.lss_offsets->size());
+    return (*data.lss_offsets)[data.element_idx()];
+  }
 }
   
   
@@ -103,6 +141,38 @@ inline void do_assign_op_matrix(boost::proto::tag::plus_assign, math::LSS::Matri
   lss_matrix.add_values(block_accumulator);
 }
 
+/// Translate tag to operator, locking the LSS mutex of the data if it is not null
+template<typename OpTagT, typename DataT>
+inline void do_assign_op_matrix(OpTagT, math::LSS::Matrix& lss_matrix, const math::LSS::BlockAccumulator& block_accumulator, const DataT& data)
+{
+  detail::OptionalLock lock(data.lss_mutex);
+  do_assign_op_matrix(OpTagT(), lss_matrix, block_accumulator);
+}
+
+/// Translate tag to operator, skipping the lock if the matrix supports concurrent additions
+/// and using the offsets cached for the current element if the matrix asks for it
+template<typename DataT>
+inline void do_assign_op_matrix(boost::proto::tag::plus_assign, math::LSS::Matrix& lss_matrix, const math::LSS::BlockAccumulator& block_accumulator, const DataT& data)
+{
+  const bool concurrent = is_not_null(data.lss_mutex) && lss_matrix.supports_concurrent_add();
+  if(lss_matrix.use_cached_offsets())
+  {
+    std::vector<int>& offsets = detail::element_offsets(lss_matrix, data);
+    detail::OptionalLock lock(concurrent ? 0 : data.lss_mutex);
+    lss_matrix.add_values_cached(block_accumulator, offsets, concurrent);
+    return;
+  }
+
+  if(concurrent)
+  {
+    lss_matrix.add_values_concurrent(block_accumulator);
+    return;
+  }
+
+  detail::OptionalLock lock(data.lss_mutex);
+  lss_matrix.add_values(block_accumulator);
+}
+
 /// Translate tag to operator
 inline void do_assign_op_rhs(boost::proto::tag::assign, math::LSS::Vector& lss_rhs, const math::LSS::BlockAccumulator& block_accumulator)
 {
@@ -154,7 +224,7 @@ struct BlockAssignmentOp<SystemMatrixTag, OpTagT>
         block_accumulator.mat(block_row, block_col) = rhs(row, col);
       }
     }
-    do_assign_op_matrix(OpTagT(), lss.matrix(), block_accumulator);
+    do_assign_op_matrix(OpTagT(), lss.matrix(), block_accumulator, data);
   }
 };
 
@@ -179,6 +249,7 @@ struct BlockAssignmentOp<SystemRHSTag, OpTagT>
       block_accumulator.rhs[block_idx] = rhs[i];
     }
 
+    detail::OptionalLock lock(data.lss_mutex);
     do_assign_op_rhs(OpTagT(), lss.rhs(), block_accumulator);
   }
 };
@@ -255,6 +326,7 @@ boost::proto::transform< RHSAccumulator >
         const Uint block_idx = (i % nb_nodes)*nb_dofs + i / nb_nodes;
         block_accumulator.rhs[block_idx] = 0.;
       }
+      detail::OptionalLock lock(data.lss_mutex);
       do_assign_op_rhs(boost::proto::tag::plus_assign(), *lss.rhs(), block_accumulator);
     }
 
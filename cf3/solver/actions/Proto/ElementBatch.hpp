@@ -0,0 +1,263 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#ifndef cf3_solver_actions_Proto_ElementBatch_hpp
+#define cf3_solver_actions_Proto_ElementBatch_hpp
+
+// Number of elements that are processed together by the element loops
+#ifndef CF3_PROTO_ELEMENT_BATCH_SIZE
+  #define CF3_PROTO_ELEMENT_BATCH_SIZE 8
+#endif
+
+// Maximum number of different mapped coordinates for which the jacobians of a batch are kept
+#ifndef CF3_PROTO_MAX_BATCH_POINTS
+  #define CF3_PROTO_MAX_BATCH_POINTS 27
+#endif
+
+#include <algorithm>
+
+#include "common/Assertions.hpp"
+#include "common/Table.hpp"
+
+#include "math/MatrixTypes.hpp"
+
+#include "mesh/Connectivity.hpp"
+
+namespace cf3 {
+namespace solver {
+namespace actions {
+namespace Proto {
+
+namespace detail
+{
+  /// Lane-wise inverse and determinant of Dim x Dim matrices stored as structure of arrays: entry (i,j) of lane l is at
+  /// index (i*Dim + j)*BatchSize + l. The loops over the lanes have a fixed trip count, so the compiler can vectorize them.
+  template<Uint Dim, Uint BatchSize>
+  struct BatchInverse;
+
+  template<Uint BatchSize>
+  struct BatchInverse<1, BatchSize>
+  {
+    static void apply(const Real* j, Real* inv, Real* det)
+    {
+      for(Uint l = 0; l != BatchSize; ++l)
+      {
+        det[l] = j[l];
+        inv[l] = 1. / j[l];
+      }
+    }
+  };
+
+  template<Uint BatchSize>
+  struct BatchInverse<2, BatchSize>
+  {
+    static void apply(const Real* j, Real* inv, Real* det)
+    {
+      const Real* j00 = j;
+      const Real* j01 = j + BatchSize;
+      const Real* j10 = j + 2*BatchSize;
+      const Real* j11 = j + 3*BatchSize;
+      for(Uint l = 0; l != BatchSize; ++l)
+      {
+        det[l] = j00[l]*j11[l] - j01[l]*j10[l];
+        const Real inv_det = 1. / det[l];
+        inv[l]               =  j11[l] * inv_det;
+        inv[l + BatchSize]   = -j01[l] * inv_det;
+        inv[l + 2*BatchSize] = -j10[l] * inv_det;
+        inv[l + 3*BatchSize] =  j00[l] * inv_det;
+      }
+    }
+  };
+
+  template<Uint BatchSize>
+  struct BatchInverse<3, BatchSize>
+  {
+    static void apply(const Real* j, Real* inv, Real* det)
+    {
+      for(Uint l = 0; l != BatchSize; ++l)
+      {
+        const Real a = j[l];
+        const Real b = j[l +   BatchSize];
+        const Real c = j[l + 2*BatchSize];
+        const Real d = j[l + 3*BatchSize];
+        const Real e = j[l + 4*BatchSize];
+        const Real f = j[l + 5*BatchSize];
+        const Real g = j[l + 6*BatchSize];
+        const Real h = j[l + 7*BatchSize];
+        const Real i = j[l + 8*BatchSize];
+
+        const Real c00 = e*i - f*h;
+        const Real c01 = f*g - d*i;
+        const Real c02 = d*h - e*g;
+
+        det[l] = a*c00 + b*c01 + c*c02;
+        const Real inv_det = 1. / det[l];
+
+        inv[l]               = c00 * inv_det;
+        inv[l +   BatchSize] = (c*h - b*i) * inv_det;
+        inv[l + 2*BatchSize] = (b*f - c*e) * inv_det;
+        inv[l + 3*BatchSize] = c01 * inv_det;
+        inv[l + 4*BatchSize] = (a*i - c*g) * inv_det;
+        inv[l + 5*BatchSize] = (c*d - a*f) * inv_det;
+        inv[l + 6*BatchSize] = c02 * inv_det;
+        inv[l + 7*BatchSize] = (b*g - a*h) * inv_det;
+        inv[l + 8*BatchSize] = (a*e - b*d) * inv_det;
+      }
+    }
+  };
+
+  /// Jacobians, their inverses and determinants for a batch of elements of the same type. The node coordinates of the
+  /// batch are gathered in structure of arrays form, and the first time a mapped coordinate is requested the jacobians
+  /// are computed for all elements of the batch at once. Later requests for the same point, typically the same Gauss
+  /// point for the next elements of the batch, only copy the result.
+  template<typename ETYPE, bool IsVolume = ETYPE::dimension == ETYPE::dimensionality>
+  class BatchedJacobians
+  {
+  public:
+    static const Uint batch_size = CF3_PROTO_ELEMENT_BATCH_SIZE;
+    static const Uint max_points = CF3_PROTO_MAX_BATCH_POINTS;
+
+    BatchedJacobians() : m_nb_elements(0), m_nb_points(0)
+    {
+    }
+
+    /// Gather the node coordinates for the given elements, discarding the jacobians computed for the previous batch
+    void set_elements(const common::Table<Real>& coordinates, const mesh::Connectivity::ArrayT& connectivity, const Uint* elements, const Uint nb_elements)
+    {
+      cf3_assert(nb_elements <= batch_size);
+      m_nb_elements = nb_elements;
+      m_nb_points = 0;
+      if(nb_elements == 0)
+        return;
+      for(Uint l = 0; l != batch_size; ++l)
+      {
+        // Unused lanes repeat the first element, so they hold a valid geometry
+        const mesh::Connectivity::ConstRow row = connectivity[elements[l < nb_elements ? l : 0]];
+        for(Uint n = 0; n != nb_nodes; ++n)
+        {
+          const common::Table<Real>::ConstRow node = coordinates[row[n]];
+          for(Uint d = 0; d != dim; ++d)
+            m_nodes[(n*dim + d)*batch_size + l] = node[d];
+        }
+      }
+    }
+
+    /// Number of elements in the current batch
+    Uint nb_elements() const
+    {
+      return m_nb_elements;
+    }
+
+    /// Index of the jacobians for the given mapped coordinates, computing them for the whole batch if this point was not
+    /// requested before. Returns max_points if the point is new and there is no more room.
+    Uint point_index(const typename ETYPE::MappedCoordsT& mapped_coords)
+    {
+      for(Uint p = 0; p != m_nb_points; ++p)
+      {
+        if(std::equal(mapped_coords.data(), mapped_coords.data() + dim, m_points + p*dim))
+          return p;
+      }
+
+      if(m_nb_points == max_points)
+        return max_points;
+
+      const Uint p = m_nb_points++;
+      std::copy(mapped_coords.data(), mapped_coords.data() + dim, m_points + p*dim);
+
+      typename ETYPE::SF::GradientT mapped_gradient;
+      ETYPE::SF::compute_gradient(mapped_coords, mapped_gradient);
+
+      Real* jacobian = m_jacobians + p*dim*dim*batch_size;
+      std::fill(jacobian, jacobian + dim*dim*batch_size, 0.);
+      for(Uint i = 0; i != dim; ++i)
+      {
+        for(Uint n = 0; n != nb_nodes; ++n)
+        {
+          const Real dn = mapped_gradient(i, n);
+          for(Uint j = 0; j != dim; ++j)
+          {
+            Real* jac_ij = jacobian + (i*dim + j)*batch_size;
+            const Real* node_nj = m_nodes + (n*dim + j)*batch_size;
+            for(Uint l = 0; l != batch_size; ++l)
+              jac_ij[l] += dn * node_nj[l];
+          }
+        }
+      }
+
+      BatchInverse<dim, batch_size>::apply(jacobian, m_inverses + p*dim*dim*batch_size, m_determinants + p*batch_size);
+
+      return p;
+    }
+
+    /// Copy the results at point index p (as returned by point_index) for the element at position lane in the batch
+    void get(const Uint p, const Uint lane, typename ETYPE::JacobianT& jacobian, typename ETYPE::JacobianT& jacobian_inverse, Real& determinant) const
+    {
+      cf3_assert(p < m_nb_points);
+      cf3_assert(lane < m_nb_elements);
+      const Real* jac = m_jacobians + p*dim*dim*batch_size + lane;
+      const Real* inv = m_inverses + p*dim*dim*batch_size + lane;
+      for(Uint i = 0; i != dim; ++i)
+      {
+        for(Uint j = 0; j != dim; ++j)
+        {
+          jacobian(i, j) = jac[(i*dim + j)*batch_size];
+          jacobian_inverse(i, j) = inv[(i*dim + j)*batch_size];
+        }
+      }
+      determinant = m_determinants[p*batch_size + lane];
+      cf3_assert(determinant != 0.);
+    }
+
+  private:
+    static const Uint dim = ETYPE::dimension;
+    static const Uint nb_nodes = ETYPE::nb_nodes;
+
+    Uint m_nb_elements;
+    Uint m_nb_points;
+
+    /// Node coordinates, entry for node n, coordinate d and lane l at (n*dim + d)*batch_size + l
+    Real m_nodes[nb_nodes*dim*batch_size];
+    /// Mapped coordinates for which the jacobians were computed
+    Real m_points[max_points*dim];
+    Real m_jacobians[max_points*dim*dim*batch_size];
+    Real m_inverses[max_points*dim*dim*batch_size];
+    Real m_determinants[max_points*batch_size];
+  };
+
+  /// Jacobians of faces and edges are not square, so they are not batched
+  template<typename ETYPE>
+  class BatchedJacobians<ETYPE, false>
+  {
+  public:
+    static const Uint batch_size = CF3_PROTO_ELEMENT_BATCH_SIZE;
+    static const Uint max_points = CF3_PROTO_MAX_BATCH_POINTS;
+
+    void set_elements(const common::Table<Real>&, const mesh::Connectivity::ArrayT&, const Uint*, const Uint)
+    {
+    }
+
+    Uint nb_elements() const
+    {
+      return 0;
+    }
+
+    Uint point_index(const typename ETYPE::MappedCoordsT&)
+    {
+      return max_points;
+    }
+
+    void get(const Uint, const Uint, typename ETYPE::JacobianT&, typename ETYPE::JacobianT&, Real&) const
+    {
+    }
+  };
+}
+
+} // namespace Proto
+} // namespace actions
+} // namespace solver
+} // namespace cf3
+
+#endif // cf3_solver_actions_Proto_ElementBatch_hpp
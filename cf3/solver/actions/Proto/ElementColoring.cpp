@@ -0,0 +1,178 @@
+// Copyright (C) 2010-2011 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#include <algorithm>
+
+#include "common/Core.hpp"
+#include "common/List.hpp"
+#include "common/Environment.hpp"
+#include "common/EventHandler.hpp"
+#include "common/OptionList.hpp"
+
+#include "mesh/Connectivity.hpp"
+#include "mesh/Dictionary.hpp"
+#include "mesh/Space.hpp"
+#include "mesh/Tags.hpp"
+
+#include "ElementColoring.hpp"
+
+namespace cf3 {
+namespace solver {
+namespace actions {
+namespace Proto {
+
+namespace detail
+{
+  /// Node used for the coloring, following the periodic links if there are any
+  inline Uint colored_node(const std::vector<Uint>& periodic_nodes, const Uint node)
+  {
+    return periodic_nodes.empty() ? node : periodic_nodes[node];
+  }
+}
+
+ElementColoring::ElementColoring()
+{
+  common::Core::instance().event_handler().connect_to_event(mesh::Tags::event_mesh_changed(), this, &ElementColoring::on_mesh_changed_event);
+  common::Core::instance().event_handler().connect_to_event(mesh::Tags::event_periodic_links_changed(), this, &ElementColoring::on_mesh_changed_event);
+}
+
+ElementColoring::~ElementColoring()
+{
+}
+
+ElementColoring& ElementColoring::instance()
+{
+  static ElementColoring instance;
+  return instance;
+}
+
+const ElementColoring::ColorsT& ElementColoring::colors(const mesh::Elements& elements)
+{
+  CachedColoring& cached = m_colorings[elements.uri().path()];
+  if(cached.colors.empty() || cached.nb_elements != elements.size())
+  {
+    cached.nb_elements = elements.size();
+    compute(elements.geometry_space().connectivity(), cached.colors, periodic_nodes(elements.geometry_fields()));
+  }
+
+  return cached.colors;
+}
+
+const std::vector<Uint>& ElementColoring::periodic_nodes(const mesh::Dictionary& geometry)
+{
+  const std::string path = geometry.uri().path();
+  PeriodicNodesT::iterator found = m_periodic_nodes.find(path);
+  if(found != m_periodic_nodes.end())
+    return found->second;
+
+  // Resolve the periodic links of the geometry nodes, as done when creating a linear system
+  std::vector<Uint>& result = m_periodic_nodes[path];
+  Handle< common::List<Uint> const > periodic_links_nodes(geometry.get_child("periodic_links_nodes"));
+  Handle< common::List<bool> const > periodic_links_active(geometry.get_child("periodic_links_active"));
+  if(is_not_null(periodic_links_nodes) && is_not_null(periodic_links_active))
+  {
+    const Uint nb_nodes = periodic_links_active->size();
+    result.resize(nb_nodes);
+    for(Uint node = 0; node != nb_nodes; ++node)
+    {
+      Uint target_node = node;
+      while((*periodic_links_active)[target_node])
+        target_node = (*periodic_links_nodes)[target_node];
+      result[node] = target_node;
+    }
+  }
+
+  return result;
+}
+
+void ElementColoring::clear()
+{
+  m_colorings.clear();
+  m_periodic_nodes.clear();
+}
+
+void ElementColoring::compute(const mesh::Connectivity& connectivity, ColorsT& colors, const std::vector<Uint>& periodic_nodes)
+{
+  colors.clear();
+
+  const Uint nb_elems = connectivity.size();
+  if(nb_elems == 0)
+    return;
+
+  const Uint nb_elem_nodes = connectivity.row_size();
+
+  // Build the node to element connectivity for this block only, in compressed row format
+  Uint nb_nodes = 0;
+  for(Uint elem = 0; elem != nb_elems; ++elem)
+  {
+    for(Uint i = 0; i != nb_elem_nodes; ++i)
+      nb_nodes = std::max(nb_nodes, detail::colored_node(periodic_nodes, connectivity[elem][i]) + 1);
+  }
+
+  std::vector<Uint> node_start(nb_nodes + 1, 0);
+  for(Uint elem = 0; elem != nb_elems; ++elem)
+  {
+    for(Uint i = 0; i != nb_elem_nodes; ++i)
+      ++node_start[detail::colored_node(periodic_nodes, connectivity[elem][i]) + 1];
+  }
+  for(Uint node = 0; node != nb_nodes; ++node)
+    node_start[node+1] += node_start[node];
+
+  std::vector<Uint> node_elements(node_start.back());
+  std::vector<Uint> fill_position(node_start.begin(), node_start.end() - 1);
+  for(Uint elem = 0; elem != nb_elems; ++elem)
+  {
+    for(Uint i = 0; i != nb_elem_nodes; ++i)
+      node_elements[fill_position[detail::colored_node(periodic_nodes, connectivity[elem][i])]++] = elem;
+  }
+
+  // Greedy coloring: each element gets the lowest color not used by any element sharing one of its nodes
+  // forbidden[c] == elem+1 marks color c as unavailable for element elem
+  const Uint no_color = nb_elems;
+  std::vector<Uint> element_color(nb_elems, no_color);
+  std::vector<Uint> forbidden;
+  for(Uint elem = 0; elem != nb_elems; ++elem)
+  {
+    for(Uint i = 0; i != nb_elem_nodes; ++i)
+    {
+      const Uint node = detail::colored_node(periodic_nodes, connectivity[elem][i]);
+      for(Uint j = node_start[node]; j != node_start[node+1]; ++j)
+      {
+        const Uint neighbour_color = element_color[node_elements[j]];
+        if(neighbour_color != no_color)
+          forbidden[neighbour_color] = elem + 1;
+      }
+    }
+
+    Uint color = 0;
+    while(color != forbidden.size() && forbidden[color] == elem + 1)
+      ++color;
+
+    if(color == forbidden.size())
+    {
+      forbidden.push_back(0);
+      colors.push_back(std::vector<Uint>());
+    }
+
+    element_color[elem] = color;
+    colors[color].push_back(elem);
+  }
+}
+
+void ElementColoring::on_mesh_changed_event(common::SignalArgs& args)
+{
+  clear();
+}
+
+Uint nb_assembly_threads()
+{
+  return std::max(common::Core::instance().environment().options().value<Uint>("assembly_threads"), 1u);
+}
+
+} // namespace Proto
+} // namespace actions
+} // namespace solver
+} // namespace cf3
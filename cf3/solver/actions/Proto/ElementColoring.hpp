@@ -0,0 +1,90 @@
+// Copyright (C) 2010-2011 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#ifndef cf3_solver_actions_Proto_ElementColoring_hpp
+#define cf3_solver_actions_Proto_ElementColoring_hpp
+
+#include <map>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include "common/ConnectionManager.hpp"
+#include "common/SignalHandler.hpp"
+
+#include "mesh/Elements.hpp"
+
+#include "solver/actions/LibActions.hpp"
+
+/// @file
+/// Graph coloring of element blocks, used to run element loops in parallel without write conflicts
+
+namespace cf3 {
+namespace solver {
+namespace actions {
+namespace Proto {
+
+/// Partitions the elements of each Elements component into colors, so that no two elements of the same color
+/// share a node. Elements of a single color can then be processed concurrently, since their writes to nodal fields
+/// and to the rows of a linear system never overlap. Periodically linked nodes count as the same node, since the
+/// rows of a linear system are shared between them.
+/// Colorings are cached per Elements component and invalidated when a mesh_changed or periodic_links_changed event
+/// is raised.
+class solver_actions_API ElementColoring : public common::ConnectionManager, public boost::noncopyable
+{
+public:
+  /// Element indices, grouped per color
+  typedef std::vector< std::vector<Uint> > ColorsT;
+
+  /// Singleton implementation
+  static ElementColoring& instance();
+
+  /// Get the coloring for the given elements, computing it if needed
+  const ColorsT& colors(const mesh::Elements& elements);
+
+  /// Drop all cached colorings
+  void clear();
+
+  /// Compute a greedy coloring based on the supplied element-to-node connectivity
+  /// @param periodic_nodes If not empty, maps each node to the node it is periodically linked with (or to itself), so
+  /// that elements sharing a node only through a periodic link also get different colors
+  static void compute(const mesh::Connectivity& connectivity, ColorsT& colors, const std::vector<Uint>& periodic_nodes = std::vector<Uint>());
+
+  ~ElementColoring();
+
+private:
+  ElementColoring();
+
+  void on_mesh_changed_event(common::SignalArgs& args);
+
+  /// Node each geometry node is periodically linked with, or an empty vector if the dictionary has no periodic links
+  const std::vector<Uint>& periodic_nodes(const mesh::Dictionary& geometry);
+
+  struct CachedColoring
+  {
+    /// Number of elements at the time the coloring was computed, used as sanity check
+    Uint nb_elements;
+    ColorsT colors;
+  };
+
+  // Colorings, keyed by the path of the Elements component
+  typedef std::map<std::string, CachedColoring> ColoringsT;
+  ColoringsT m_colorings;
+
+  // Resolved periodic links, keyed by the path of the geometry dictionary
+  typedef std::map< std::string, std::vector<Uint> > PeriodicNodesT;
+  PeriodicNodesT m_periodic_nodes;
+};
+
+/// Number of threads to use in element loops, as set by the assembly_threads option of the environment
+solver_actions_API Uint nb_assembly_threads();
+
+} // namespace Proto
+} // namespace actions
+} // namespace solver
+} // namespace cf3
+
+#endif // cf3_solver_actions_Proto_ElementColoring_hpp
@@ -7,6 +7,8 @@
 #ifndef cf3_solver_actions_Proto_ElementData_hpp
 #define cf3_solver_actions_Proto_ElementData_hpp
 
+#include <typeinfo>
+
 #include <boost/array.hpp>
 
 #include <boost/fusion/algorithm/iteration/for_each.hpp>
@@ -22,11 +24,14 @@
 #include <boost/mpl/transform.hpp>
 #include <boost/mpl/vector_c.hpp>
 
+#include <boost/thread/mutex.hpp>
+
 #include "common/Component.hpp"
 #include "common/FindComponents.hpp"
 
 #include "math/VariablesDescriptor.hpp"
 #include "math/LSS/BlockAccumulator.hpp"
+#include "math/LSS/Matrix.hpp"
 
 #include "mesh/Elements.hpp"
 #include "mesh/Field.hpp"
@@ -37,10 +42,12 @@
 #include "mesh/ElementData.hpp"
 #include "mesh/Connectivity.hpp"
 
+#include "ElementBatch.hpp"
 #include "ElementMatrix.hpp"
 #include "ElementOperations.hpp"
 #include "ElementTransforms.hpp"
 #include "FieldSync.hpp"
+#include "GeometricFactors.hpp"
 #include "Terminals.hpp"
 
 namespace cf3 {
@@ -182,15 +189,33 @@ public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
   GeometricSupport(const mesh::Elements& elements) :
+    m_elements(elements),
     m_coordinates(elements.geometry_fields().coordinates()),
-    m_connectivity_array(elements.geometry_space().connectivity().array())
+    m_connectivity_array(elements.geometry_space().connectivity().array()),
+    m_batch_lane(CF3_PROTO_ELEMENT_BATCH_SIZE),
+    m_use_cache(cache_geometric_factors())
+  {
+    // Coordinates may have been modified in place without raising coordinates_changed
+    if(m_use_cache)
+      GeometricFactorsCache::instance().check_coordinates(elements);
+  }
+
+  /// Gather the nodes of a batch of at most CF3_PROTO_ELEMENT_BATCH_SIZE elements, so the precomputed jacobians are
+  /// computed for the whole batch at once. Each element must then be visited with set_element, passing its position in the batch.
+  void set_batch(const Uint* elements, const Uint nb_elements)
   {
+    // Cached factors make the batch computation unnecessary
+    if(!m_use_cache)
+      m_batch.set_elements(m_coordinates, m_connectivity_array, elements, nb_elements);
   }
 
   /// Update nodes for the current element and set the connectivity for the passed block accumulator
-  void set_element(const Uint element_idx)
+  /// batch_lane is the position of the element in the last batch passed to set_batch, or CF3_PROTO_ELEMENT_BATCH_SIZE if it is not part of a batch
+  void set_element(const Uint element_idx, const Uint batch_lane = CF3_PROTO_ELEMENT_BATCH_SIZE)
   {
+    cf3_assert(m_use_cache || batch_lane == CF3_PROTO_ELEMENT_BATCH_SIZE || batch_lane < m_batch.nb_elements());
     m_element_idx = element_idx;
+    m_batch_lane = batch_lane;
     const mesh::Connectivity::ConstRow row = m_connectivity_array[element_idx];
     std::copy(row.begin(), row.end(), m_connectivity.begin());
     mesh::fill(m_nodes, m_coordinates, m_connectivity);
@@ -307,15 +332,82 @@ private:
 
   void compute_jacobian_dispatch(boost::mpl::true_, const typename EtypeT::MappedCoordsT& mapped_coords) const
   {
+    if(m_use_cache)
+    {
+      const GeometricFactors& factors = cached_factors(mapped_coords);
+      const Uint offset = m_element_idx*EtypeT::dimension*EtypeT::dimension;
+      m_jacobian_matrix = Eigen::Map<const typename EtypeT::JacobianT>(&factors.jacobians[offset]);
+      m_jacobian_inverse = Eigen::Map<const typename EtypeT::JacobianT>(&factors.jacobian_inverses[offset]);
+      m_jacobian_determinant = factors.determinants[m_element_idx];
+      return;
+    }
+    if(m_batch_lane != CF3_PROTO_ELEMENT_BATCH_SIZE)
+    {
+      const Uint point = m_batch.point_index(mapped_coords);
+      if(point != CF3_PROTO_MAX_BATCH_POINTS)
+      {
+        m_batch.get(point, m_batch_lane, m_jacobian_matrix, m_jacobian_inverse, m_jacobian_determinant);
+        return;
+      }
+    }
     EtypeT::compute_jacobian(mapped_coords, m_nodes, m_jacobian_matrix);
     bool is_invertible;
     m_jacobian_matrix.computeInverseAndDetWithCheck(m_jacobian_inverse, m_jacobian_determinant, is_invertible);
     cf3_assert(is_invertible);
   }
 
+  /// Factors at the given mapped coordinates, from the GeometricFactorsCache. If they are not there, they are computed for all elements
+  const GeometricFactors& cached_factors(const typename EtypeT::MappedCoordsT& mapped_coords) const
+  {
+    const Uint nb_points = m_cached_factors.size();
+    for(Uint i = 0; i != nb_points; ++i)
+    {
+      if(std::equal(mapped_coords.data(), mapped_coords.data() + EtypeT::dimensionality, m_cached_factors[i]->mapped_coords.begin()))
+        return *m_cached_factors[i];
+    }
+
+    const std::string etype_key = typeid(EtypeT).name();
+    GeometricFactorsCache::ConstFactorsPtrT factors = GeometricFactorsCache::instance().find(m_elements, etype_key, mapped_coords.data(), EtypeT::dimensionality);
+    if(!factors)
+    {
+      static const Uint jacobian_size = EtypeT::dimension*EtypeT::dimension;
+      const Uint nb_elems = m_connectivity_array.size();
+      boost::shared_ptr<GeometricFactors> new_factors(new GeometricFactors());
+      new_factors->mapped_coords.assign(mapped_coords.data(), mapped_coords.data() + EtypeT::dimensionality);
+      new_factors->jacobians.resize(nb_elems*jacobian_size);
+      new_factors->jacobian_inverses.resize(nb_elems*jacobian_size);
+      new_factors->determinants.resize(nb_elems);
+      ValueT nodes;
+      typename EtypeT::JacobianT jacobian;
+      for(Uint elem = 0; elem != nb_elems; ++elem)
+      {
+        const mesh::Connectivity::ConstRow row = m_connectivity_array[elem];
+        for(Uint i = 0; i != EtypeT::nb_nodes; ++i)
+        {
+          const common::Table<Real>::ConstRow node = m_coordinates[row[i]];
+          for(Uint j = 0; j != EtypeT::dimension; ++j)
+            nodes(i, j) = node[j];
+        }
+        EtypeT::compute_jacobian(mapped_coords, nodes, jacobian);
+        Eigen::Map<typename EtypeT::JacobianT>(&new_factors->jacobians[elem*jacobian_size]) = jacobian;
+        Eigen::Map<typename EtypeT::JacobianT> inverse(&new_factors->jacobian_inverses[elem*jacobian_size]);
+        bool is_invertible;
+        jacobian.computeInverseAndDetWithCheck(inverse, new_factors->determinants[elem], is_invertible);
+        cf3_assert(is_invertible);
+      }
+      factors = GeometricFactorsCache::instance().insert(m_elements, etype_key, new_factors);
+    }
+
+    m_cached_factors.push_back(factors);
+    return *factors;
+  }
+
   /// Stored node data
   ValueT m_nodes;
 
+  /// Elements that are looped over
+  const mesh::Elements& m_elements;
+
   /// Coordinates table
   const common::Table<Real>& m_coordinates;
 
@@ -328,6 +420,18 @@ private:
   /// Index for the current element
   Uint m_element_idx;
 
+  /// Position of the current element in the batch
+  Uint m_batch_lane;
+
+  /// Lane-wise computed jacobians for the current batch
+  mutable detail::BatchedJacobians<EtypeT> m_batch;
+
+  /// True if the factors are taken from the GeometricFactorsCache
+  const bool m_use_cache;
+
+  /// Factors obtained from the cache so far
+  mutable std::vector<GeometricFactorsCache::ConstFactorsPtrT> m_cached_factors;
+
   /// Temp storage for non-scalar results
 private:
   mutable typename EtypeT::SF::ValueT m_sf;
@@ -917,6 +1021,9 @@ public:
   static const Uint nb_lss_nodes = detail::GetNbNodes<EquationDataT>::value;
 
   ElementData(VariablesT& variables, mesh::Elements& elements) :
+    lss_mutex(nullptr),
+    lss_offsets(nullptr),
+    lss_offsets_matrix(nullptr),
     m_variables(variables),
     m_elements(elements),
     m_support(elements),
@@ -954,11 +1061,17 @@ public:
     boost::mpl::for_each< boost::mpl::range_c<int, 0, NbVarsT::value> >(DeleteVariablesData(m_variables_data));
   }
 
-  /// Update element index
-  void set_element(const Uint element_idx)
+  /// Start a batch of elements, see GeometricSupport::set_batch
+  void set_batch(const Uint* elements, const Uint nb_elements)
+  {
+    m_support.set_batch(elements, nb_elements);
+  }
+
+  /// Update element index. batch_lane is the position of the element in the current batch, if any
+  void set_element(const Uint element_idx, const Uint batch_lane = CF3_PROTO_ELEMENT_BATCH_SIZE)
   {
     m_element_idx = element_idx;
-    m_support.set_element(element_idx);
+    m_support.set_element(element_idx, batch_lane);
     boost::mpl::for_each< boost::mpl::range_c<int, 0, NbVarsT::value> >(SetElement(m_variables_data, element_idx));
     boost::fusion::for_each(m_equation_data, FillRhs(m_element_rhs));
     update_blocks(typename boost::fusion::result_of::empty<EquationDataT>::type());
@@ -1068,6 +1181,26 @@ public:
   mutable math::LSS::BlockAccumulator block_accumulator;
   mutable bool indices_converted; // Indicate if the indices in the block accumulator have been converted to LSS indices
 
+  /// If not null, this mutex must be locked when writing to a linear system (used in threaded element loops),
+  /// except for additions to a matrix that supports concurrent additions
+  boost::mutex* lss_mutex;
+
+  /// Cached matrix offsets for each element, used when the matrix lss_offsets_matrix assembles using cached offsets
+  mutable std::vector< std::vector<int> >* lss_offsets;
+  mutable const math::LSS::Matrix* lss_offsets_matrix;
+
+  /// Index of the current element
+  Uint element_idx() const
+  {
+    return m_element_idx;
+  }
+
+  /// Elements that are looped over
+  const mesh::Elements& elements() const
+  {
+    return m_elements;
+  }
+
 private:
   /// Variables used in the expression
   VariablesT& m_variables;
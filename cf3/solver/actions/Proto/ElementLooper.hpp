@@ -7,6 +7,13 @@
 #ifndef cf3_solver_actions_Proto_ElementLooper_hpp
 #define cf3_solver_actions_Proto_ElementLooper_hpp
 
+#include <boost/array.hpp>
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
 #include <boost/fusion/algorithm/iteration/for_each.hpp>
 #include <boost/fusion/adapted/mpl.hpp>
 #include <boost/fusion/mpl.hpp>
@@ -16,6 +23,7 @@
 #include <boost/mpl/for_each.hpp>
 #include <boost/mpl/filter_view.hpp>
 
+#include "ElementColoring.hpp"
 #include "ElementData.hpp"
 #include "ElementExpressionWrapper.hpp"
 #include "ElementGrammar.hpp"
@@ -60,7 +68,7 @@ struct CheckSameEtype
 template<typename ElementTypesT, typename ExprT, typename SupportETYPE, typename VariablesT, typename VariablesEtypesT, typename NbVarsT, typename VarIdxT>
 struct ExpressionRunner
 {
-  ExpressionRunner(VariablesT& vars, const ExprT& expr, mesh::Elements& elems) : variables(vars), expression(expr), elements(elems), m_nb_tests(0), m_found(false) {}
+  ExpressionRunner(VariablesT& vars, const ExprT& expr, mesh::Elements& elems, const Uint nb_thr) : variables(vars), expression(expr), elements(elems), nb_threads(nb_thr), m_nb_tests(0), m_found(false) {}
 
   typedef typename boost::remove_reference<typename boost::fusion::result_of::at<VariablesT, VarIdxT>::type>::type VarT;
 
@@ -89,7 +97,7 @@ struct ExpressionRunner
       NewVariablesEtypesT,
       NbVarsT,
       NextIdxT
-    >(variables, expression, elements).run();
+    >(variables, expression, elements, nb_threads).run();
   }
 
   // Chosen otherwise
@@ -141,12 +149,13 @@ struct ExpressionRunner
       NewVariablesEtypesT,
       NbVarsT,
       NextIdxT
-    >(variables, expression, elements).run();
+    >(variables, expression, elements, nb_threads).run();
   }
 
   VariablesT& variables;
   const ExprT& expression;
   mesh::Elements& elements;
+  const Uint nb_threads;
   // Number of times we tried a shape function
   mutable Uint m_nb_tests;
   mutable bool m_found;
@@ -154,28 +163,168 @@ struct ExpressionRunner
 
 
 
+namespace detail
+{
+  /// Collects the first error raised by one of the threads of a threaded element loop
+  class ThreadedLoopErrors
+  {
+  public:
+    ThreadedLoopErrors() : m_failed(false)
+    {
+    }
+
+    void set(const std::string& message)
+    {
+      boost::mutex::scoped_lock lock(m_mutex);
+      if(!m_failed)
+        m_message = message;
+      m_failed = true;
+    }
+
+    bool failed()
+    {
+      boost::mutex::scoped_lock lock(m_mutex);
+      return m_failed;
+    }
+
+    const std::string& message() const
+    {
+      return m_message;
+    }
+
+  private:
+    boost::mutex m_mutex;
+    bool m_failed;
+    std::string m_message;
+  };
+}
+
 /// Helper struct to launch execution once all shape functions have been determined
 template<typename DataT>
 struct ElementLooperImpl
 {
-  template<typename ExprT>
-  void operator()(const ExprT& expr, DataT& data, const Uint nb_elems) const
+  /// @param nb_threads Number of threads to use. This must be the same on every rank, since ElementData destructors
+  /// may do collective communication
+  ElementLooperImpl(const Uint nb_threads = 1u) : m_nb_threads(nb_threads)
   {
-    const typename DataT::SupportShapeFunction::MappedCoordsT mapped_coords; // needed to deduce proper return type when wrapping
-    run(WrapExpression()(expr, mapped_coords, data), data, nb_elems);
+  }
+
+  template<typename ExprT, typename VariablesT>
+  void operator()(const ExprT& expr, VariablesT& variables, mesh::Elements& elements) const
+  {
+    if(m_nb_threads < 2)
+    {
+      DataT data(variables, elements);
+      const typename DataT::SupportShapeFunction::MappedCoordsT mapped_coords; // needed to deduce proper return type when wrapping
+      run(WrapExpression()(expr, mapped_coords, data), data, elements.size());
+    }
+    else
+    {
+      run_threaded(expr, variables, elements, m_nb_threads);
+    }
   }
 
 private:
+  const Uint m_nb_threads;
+
   template<typename FilteredExprT>
   void run(const FilteredExprT& expr, DataT& data, const Uint nb_elems) const
   {
     ElementGrammar grammar;
-    for(Uint elem = 0; elem != nb_elems; ++elem)
+    boost::array<Uint, CF3_PROTO_ELEMENT_BATCH_SIZE> batch;
+    for(Uint batch_begin = 0; batch_begin < nb_elems; batch_begin += CF3_PROTO_ELEMENT_BATCH_SIZE)
     {
-      // Update the data for the element
-      data.set_element(elem);
-      // Run the expression using a proto transform, passing as arguments in the standard proto sense: the expression, a state and the data
-      grammar(expr, elem, data);
+      const Uint batch_end = std::min(nb_elems, batch_begin + CF3_PROTO_ELEMENT_BATCH_SIZE);
+      for(Uint elem = batch_begin; elem != batch_end; ++elem)
+        batch[elem - batch_begin] = elem;
+      // Geometric data is computed for all elements of the batch at once
+      data.set_batch(batch.data(), batch_end - batch_begin);
+      for(Uint elem = batch_begin; elem != batch_end; ++elem)
+      {
+        // Update the data for the element
+        data.set_element(elem, elem - batch_begin);
+        // Run the expression using a proto transform, passing as arguments in the standard proto sense: the expression, a state and the data
+        grammar(expr, elem, data);
+      }
+    }
+  }
+
+  /// Each thread gets its own data, and processes its share of the elements of each color. Threads wait for each other between colors.
+  /// The terminals of the expression are shared by all threads, so the expression may not hold any state that is modified
+  /// during evaluation.
+  template<typename ExprT, typename VariablesT>
+  void run_threaded(const ExprT& expr, VariablesT& variables, mesh::Elements& elements, const Uint nb_threads) const
+  {
+    const ElementColoring::ColorsT& colors = ElementColoring::instance().colors(elements);
+
+    // Serializes the scatter into the linear system, for matrices that don't support concurrent insertion
+    boost::mutex lss_mutex;
+
+    boost::ptr_vector<DataT> thread_data;
+    for(Uint i = 0; i != nb_threads; ++i)
+    {
+      thread_data.push_back(new DataT(variables, elements));
+      thread_data.back().lss_mutex = &lss_mutex;
+    }
+
+    boost::barrier barrier(nb_threads);
+    detail::ThreadedLoopErrors errors;
+
+    boost::thread_group threads;
+    for(Uint i = 1; i != nb_threads; ++i)
+    {
+      threads.create_thread(boost::bind(&ElementLooperImpl<DataT>::template run_colors<ExprT>, this, boost::cref(expr), boost::ref(thread_data[i]), boost::cref(colors), i, nb_threads, boost::ref(barrier), boost::ref(errors)));
+    }
+    run_colors(expr, thread_data[0], colors, 0, nb_threads, barrier, errors);
+    threads.join_all();
+
+    if(errors.failed())
+      throw common::ParallelError(FromHere(), "Error in threaded loop over " + elements.uri().path() + ": " + errors.message());
+  }
+
+  template<typename ExprT>
+  void run_colors(const ExprT& expr, DataT& data, const ElementColoring::ColorsT& colors, const Uint thread_idx, const Uint nb_threads, boost::barrier& barrier, detail::ThreadedLoopErrors& errors) const
+  {
+    // Wrapped expressions hold storage for intermediate results, so each thread needs its own copy
+    const typename DataT::SupportShapeFunction::MappedCoordsT mapped_coords;
+    run_colors_wrapped(WrapExpression()(expr, mapped_coords, data), data, colors, thread_idx, nb_threads, barrier, errors);
+  }
+
+  template<typename FilteredExprT>
+  void run_colors_wrapped(const FilteredExprT& expr, DataT& data, const ElementColoring::ColorsT& colors, const Uint thread_idx, const Uint nb_threads, boost::barrier& barrier, detail::ThreadedLoopErrors& errors) const
+  {
+    ElementGrammar grammar;
+    const Uint nb_colors = colors.size();
+    for(Uint color = 0; color != nb_colors; ++color)
+    {
+      const std::vector<Uint>& color_elements = colors[color];
+      const Uint nb_color_elems = color_elements.size();
+      // Contiguous range for this thread, to keep the element order within the range
+      const Uint begin = (nb_color_elems / nb_threads) * thread_idx + std::min(thread_idx, nb_color_elems % nb_threads);
+      const Uint end = begin + nb_color_elems / nb_threads + (thread_idx < nb_color_elems % nb_threads ? 1 : 0);
+      if(!errors.failed())
+      {
+        try
+        {
+          for(Uint batch_begin = begin; batch_begin < end; batch_begin += CF3_PROTO_ELEMENT_BATCH_SIZE)
+          {
+            const Uint batch_end = std::min(end, batch_begin + CF3_PROTO_ELEMENT_BATCH_SIZE);
+            data.set_batch(&color_elements[batch_begin], batch_end - batch_begin);
+            for(Uint i = batch_begin; i != batch_end; ++i)
+            {
+              const Uint elem = color_elements[i];
+              data.set_element(elem, i - batch_begin);
+              grammar(expr, elem, data);
+            }
+          }
+        }
+        catch(std::exception& e)
+        {
+          errors.set(e.what());
+        }
+      }
+      // All threads must reach the barrier, also after an error, or the others would block forever
+      barrier.wait();
     }
   }
 };
@@ -184,7 +333,7 @@ private:
 template<typename ElementTypesT, typename ExprT, typename SupportETYPE, typename VariablesT, typename VariablesEtypesT, typename NbVarsT>
 struct ExpressionRunner<ElementTypesT, ExprT, SupportETYPE, VariablesT, VariablesEtypesT, NbVarsT, NbVarsT>
 {
-  ExpressionRunner(VariablesT& vars, const ExprT& expr, mesh::Elements& elems) : variables(vars), expression(expr), elements(elems) {}
+  ExpressionRunner(VariablesT& vars, const ExprT& expr, mesh::Elements& elems, const Uint nb_thr) : variables(vars), expression(expr), elements(elems), nb_threads(nb_thr) {}
 
   typedef ElementData<VariablesT, VariablesEtypesT, SupportETYPE, typename EquationVariables<ExprT, NbVarsT>::type> DataT;
 
@@ -196,15 +345,14 @@ struct ExpressionRunner<ElementTypesT, ExprT, SupportETYPE, VariablesT, Variable
       INVALID_ELEMENT_EXPRESSION,
       (ElementGrammar));
 
-    DataT data(variables, elements);
-
-    ElementLooperImpl<DataT>()(expression, data, elements.size());
+    ElementLooperImpl<DataT>(nb_threads)(expression, variables, elements);
   }
 
 private:
   VariablesT& variables;
   const ExprT& expression;
   mesh::Elements& elements;
+  const Uint nb_threads;
 };
 
 /// mpl::for_each compatible functor to loop over elements, using the correct shape function for the geometry
@@ -215,10 +363,13 @@ struct ElementLooper
   // Type of a fusion vector that can contain a copy of each variable that is used in the expression
   typedef typename ExpressionProperties<ExprT>::VariablesT VariablesT;
 
-  ElementLooper(mesh::Elements& elements, const ExprT& expr, VariablesT& variables) :
+  /// @param nb_threads Number of threads used to loop over the elements. Only expressions that modify no state shared
+  /// between elements may use more than one thread, see for_each_element_threaded
+  ElementLooper(mesh::Elements& elements, const ExprT& expr, VariablesT& variables, const Uint nb_threads = 1u) :
     m_elements(elements),
     m_expr(expr),
-    m_variables(variables)
+    m_variables(variables),
+    m_nb_threads(nb_threads)
   {
   }
 
@@ -252,9 +403,7 @@ struct ElementLooper
     // Verify the types match, and throw an error if non-matching fields are found
     boost::fusion::for_each(m_variables, CheckSameEtype<ETYPE>(m_elements));
 
-    DataT data(m_variables, m_elements);
-
-    ElementLooperImpl<DataT>()(m_expr, data, m_elements.size());
+    ElementLooperImpl<DataT>(m_nb_threads)(m_expr, m_variables, m_elements);
   }
 
   /// Static dispatch in case different ETYPE are possible
@@ -275,32 +424,52 @@ struct ElementLooper
       boost::mpl::vector0<>, // Start with an empty vector for the per-variable element types
       NbVarsT, // number of variables
       boost::mpl::int_<0> // Start index, as MPL integral constant
-    >(m_variables, m_expr, m_elements).run();
+    >(m_variables, m_expr, m_elements, m_nb_threads).run();
   }
 
 private:
   mesh::Elements& m_elements;
   const ExprT& m_expr;
   VariablesT& m_variables;
+  const Uint m_nb_threads;
 };
 
-template<typename ElementTypesT, typename ExprT>
-void for_each_element(mesh::Region& root_region, const ExprT& expr)
+namespace detail
 {
-  // Store the variables
-  typedef typename ExpressionProperties<ExprT>::VariablesT VariablesT;
-  VariablesT vars;
-  CopyNumberedVars<VariablesT> ctx(vars); // This is a proto context
-  boost::proto::eval(expr, ctx); // calling eval using the above context stores all variables in vars
-
-  // Traverse all Elements under the root and evaluate the expression
-  BOOST_FOREACH(mesh::Elements& elements, common::find_components_recursively<mesh::Elements>(root_region))
+  template<typename ElementTypesT, typename ExprT>
+  void for_each_element_impl(mesh::Region& root_region, const ExprT& expr, const Uint nb_threads)
   {
-    // We skip order 0 functions in the top-call, because first the support shape function is determined, and order 0 is not allowed there
-    boost::mpl::for_each< boost::mpl::filter_view< ElementTypesT, mesh::IsMinimalOrder<1> > >( ElementLooper<ElementTypesT, ExprT>(elements, expr, vars) );
+    // Store the variables
+    typedef typename ExpressionProperties<ExprT>::VariablesT VariablesT;
+    VariablesT vars;
+    CopyNumberedVars<VariablesT> ctx(vars); // This is a proto context
+    boost::proto::eval(expr, ctx); // calling eval using the above context stores all variables in vars
+
+    // Traverse all Elements under the root and evaluate the expression
+    BOOST_FOREACH(mesh::Elements& elements, common::find_components_recursively<mesh::Elements>(root_region))
+    {
+      // We skip order 0 functions in the top-call, because first the support shape function is determined, and order 0 is not allowed there
+      boost::mpl::for_each< boost::mpl::filter_view< ElementTypesT, mesh::IsMinimalOrder<1> > >( ElementLooper<ElementTypesT, ExprT>(elements, expr, vars, nb_threads) );
+    }
   }
+}
+
+template<typename ElementTypesT, typename ExprT>
+void for_each_element(mesh::Region& root_region, const ExprT& expr)
+{
+  detail::for_each_element_impl<ElementTypesT>(root_region, expr, 1u);
 };
 
+/// Loop over the elements using the number of threads set by the assembly_threads option of the environment.
+/// All threads evaluate the same terminals, so this is only allowed for expressions that modify no state shared between
+/// elements: no assignments to lit() terminals and no parsed functions, whose evaluation writes to the function object.
+/// Fields, element matrices and the linear system are safe, since elements of the same color share no nodes.
+template<typename ElementTypesT, typename ExprT>
+void for_each_element_threaded(mesh::Region& root_region, const ExprT& expr)
+{
+  detail::for_each_element_impl<ElementTypesT>(root_region, expr, nb_assembly_threads());
+}
+
 } // namespace Proto
 } // namespace actions
 } // namespace solver
@@ -0,0 +1,98 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#ifndef cf3_solver_actions_Proto_ElementSumFactorization_hpp
+#define cf3_solver_actions_Proto_ElementSumFactorization_hpp
+
+#include "mesh/Integrators/SumFactorization.hpp"
+
+#include "ElementIntegration.hpp"
+#include "ElementOperations.hpp"
+
+namespace cf3 {
+namespace solver {
+namespace actions {
+namespace Proto {
+
+/// Add k times the Laplacian element matrix of a scalar variable to A, for tensor-product Lagrange elements (lines, quads
+/// and hexahedra) with a tensor-product geometric support. The gradients of the shape functions at the quadrature points
+/// and their integration are done with the sum-factorized kernels of mesh::Integrators::SumFactorization. The Gauss rule
+/// is the one element_quadrature uses for the same elements, so sumfact_laplacian(T, k, _A(T)) adds the same matrix as
+/// element_quadrature(_A(T) += k * transpose(nabla(T)) * nabla(T)).
+struct SumFactorizedLaplacianOp
+{
+  typedef void result_type;
+
+  template<typename VarT, typename MatrixT>
+  void operator()(const VarT& var, const Real k, MatrixT& A) const
+  {
+    typedef typename VarT::EtypeT::SF SF;
+    typedef typename VarT::SupportT::EtypeT SupportEtypeT;
+    typedef typename SupportEtypeT::SF SupportSF;
+    static const Uint dim = SF::dimensionality;
+    BOOST_MPL_ASSERT_RELATION(SupportEtypeT::dimension, ==, dim);
+    BOOST_MPL_ASSERT_RELATION(SupportSF::dimensionality, ==, dim);
+
+    static const Uint max_order = SF::order > SupportSF::order ? SF::order : SupportSF::order;
+    static const Uint nb_points_1d = IntegrationOrder<max_order>::value;
+    typedef mesh::Integrators::SumFactorization<SF, nb_points_1d> SumFactT;
+    typedef mesh::Integrators::SumFactorization<SupportSF, nb_points_1d> SupportSumFactT;
+    static const Uint nb_points = SumFactT::nb_points;
+    typedef Eigen::Matrix<Real, dim, dim> JacobianT;
+
+    const SumFactT& sumfact = SumFactT::instance();
+    const SupportSumFactT& support_sumfact = SupportSumFactT::instance();
+
+    // Gradients of each coordinate at the quadrature points, giving the columns of the jacobian
+    const typename SupportEtypeT::NodesT& nodes = var.support().nodes();
+    typename SupportSumFactT::NodalT coordinate;
+    typename SupportSumFactT::PointVectorsT coordinate_gradients[dim];
+    for(Uint e = 0; e != dim; ++e)
+    {
+      coordinate = nodes.col(e);
+      support_sumfact.interpolate_gradient(coordinate, coordinate_gradients[e]);
+    }
+
+    // Weighted metric k w J^-T J^-1 |J| at each point, mapping mapped gradients to the integrand of the Laplacian
+    JacobianT metric[nb_points];
+    JacobianT jacobian;
+    for(Uint q = 0; q != nb_points; ++q)
+    {
+      for(Uint e = 0; e != dim; ++e)
+        jacobian.col(e) = coordinate_gradients[e].col(q);
+      const JacobianT jacobian_inverse = jacobian.inverse();
+      metric[q] = (k * sumfact.weights()[q] * jacobian.determinant()) * jacobian_inverse.transpose() * jacobian_inverse;
+    }
+
+    // One column of the matrix for each shape function
+    typename SumFactT::NodalT unit = SumFactT::NodalT::Zero();
+    typename SumFactT::PointVectorsT gradients;
+    typename SumFactT::NodalT column;
+    for(Uint j = 0; j != SF::nb_nodes; ++j)
+    {
+      unit[j] = 1.;
+      sumfact.interpolate_gradient(unit, gradients);
+      unit[j] = 0.;
+      for(Uint q = 0; q != nb_points; ++q)
+        gradients.col(q) = metric[q] * gradients.col(q);
+      sumfact.integrate_gradient(gradients, column);
+      for(Uint i = 0; i != SF::nb_nodes; ++i)
+        A(i, j) += column[i];
+    }
+  }
+};
+
+/// Add the Laplacian element matrix of a scalar variable, computed with sum factorization:
+/// sumfact_laplacian(T, k, _A(T)) is equivalent to element_quadrature(_A(T) += k * transpose(nabla(T)) * nabla(T))
+/// for tensor-product elements
+static MakeSFOp<SumFactorizedLaplacianOp>::type const sumfact_laplacian = {};
+
+} // namespace Proto
+} // namespace actions
+} // namespace solver
+} // namespace cf3
+
+#endif // cf3_solver_actions_Proto_ElementSumFactorization_hpp
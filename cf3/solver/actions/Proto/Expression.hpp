@@ -65,6 +65,11 @@ public:
   /// value: space library name, to indicate what kind of field is expected
   virtual void insert_field_info(std::map<std::string, std::string>& tags) const = 0;
 
+  /// Allow loops over elements to use the number of threads set by the assembly_threads option of the environment.
+  /// Only valid if the expression modifies no state shared between elements, see for_each_element_threaded.
+  /// Loops over nodes always use a single thread.
+  virtual void set_threaded(const bool threaded) = 0;
+
   virtual ~Expression() {}
 };
 
@@ -76,7 +81,8 @@ public:
 
   ExpressionBase(const ExprT& expr) :
     m_constant_values(),
-    m_expr( DeepCopy()( ReplaceConfigurableConstants()(ReplacePhysicsConstants()(expr, m_physics_values), m_constant_values) ) )
+    m_expr( DeepCopy()( ReplaceConfigurableConstants()(ReplacePhysicsConstants()(expr, m_physics_values), m_constant_values) ) ),
+    m_threaded(false)
   {
     // Store the variables
     CopyNumberedVars<VariablesT> ctx(m_variables);
@@ -144,6 +150,11 @@ public:
     boost::fusion::for_each(m_variables, AppendTags(tags));
   }
 
+  void set_threaded(const bool threaded)
+  {
+    m_threaded = threaded;
+  }
+
 private:
   /// Values for configurable constants
   ConstantStorage m_constant_values;
@@ -165,6 +176,9 @@ protected:
   // True for the variables that are stored
   typedef typename EquationVariables<ExprT, NbVarsT>::type EquationVariablesT;
 
+  /// True if element loops may use multiple threads
+  bool m_threaded;
+
 private:
 
   /// Functor to register variables in a physical model
@@ -255,7 +269,7 @@ public:
     // Traverse all Elements under the region and evaluate the expression
     BOOST_FOREACH(mesh::Elements& elements, common::find_components_recursively<mesh::Elements>(region) )
     {
-      boost::mpl::for_each<boost::mpl::filter_view< ElementTypes, mesh::IsMinimalOrder<1> > >( ElementLooper<ElementTypes, typename BaseT::CopiedExprT>(elements, BaseT::m_expr, BaseT::m_variables) );
+      boost::mpl::for_each<boost::mpl::filter_view< ElementTypes, mesh::IsMinimalOrder<1> > >( ElementLooper<ElementTypes, typename BaseT::CopiedExprT>(elements, BaseT::m_expr, BaseT::m_variables, BaseT::m_threaded ? nb_assembly_threads() : 1u) );
     }
   }
 };
@@ -5,6 +5,7 @@
 // See doc/lgpl.txt and doc/gpl.txt for the license text.
 
 #include "common/PE/Comm.hpp"
+#include "common/PE/CommPattern.hpp"
 #include "common/List.hpp"
 
 #include "FieldSync.hpp"
@@ -86,9 +87,27 @@ void FieldSynchronizer::synchronize()
   
   if(common::PE::Comm::instance().is_active())
   {
+    // Group the fields per pattern, keyed by the pattern path so the order is the same on each cpu
+    typedef std::map< std::string, std::pair< common::PE::CommPattern*, std::vector<std::string> > > PatternFieldsT;
+    PatternFieldsT pattern_fields;
     for(FieldsT::iterator field_it = m_fields.begin(); field_it != m_fields.end(); ++field_it)
     {
-      field_it->second.first->synchronize();
+      common::PE::CommPattern& pattern = field_it->second.first->comm_pattern();
+      std::pair< common::PE::CommPattern*, std::vector<std::string> >& entry = pattern_fields[pattern.uri().path()];
+      entry.first = &pattern;
+      entry.second.push_back(field_it->second.first->name());
+    }
+
+    // All fields of a pattern go in a single message per neighbour, using a persistent plan that is cached by the pattern
+    std::vector< Handle<common::PE::ExchangePlan> > plans;
+    for(PatternFieldsT::iterator pattern_it = pattern_fields.begin(); pattern_it != pattern_fields.end(); ++pattern_it)
+    {
+      plans.push_back(pattern_it->second.first->exchange_plan(pattern_it->second.second));
+      plans.back()->begin_synchronize();
+    }
+    for(Uint i = 0; i != plans.size(); ++i)
+    {
+      plans[i]->end_synchronize();
     }
   }
 
@@ -8,8 +8,13 @@
 #define cf3_solver_actions_Proto_Functions_hpp
 
 #include <boost/proto/core.hpp>
+#include <boost/proto/context.hpp>
+
+#include <algorithm>
 
 #include "common/CF.hpp"
+#include "common/List.hpp"
+#include "common/Table.hpp"
 #include "math/VectorialFunction.hpp"
 
 namespace cf3 {
@@ -54,6 +59,54 @@ pow(Arg const &arg)
 struct ProtoEvaluatedFunction : math::VectorialFunction
 {
   mutable std::vector<Real> predefined_values;
+
+  /// Evaluate the function for a set of nodes at once, using evaluate_batch. Node expressions look up the values
+  /// of these nodes instead of evaluating the function at each node, until clear_node_values is called.
+  /// @param nodes Indices of the nodes, in increasing order
+  /// @param coordinates Coordinates of the dictionary the nodes belong to
+  void evaluate_nodes(const common::List<Uint>& nodes, const common::Table<Real>& coordinates) const
+  {
+    const Uint nb_nodes = nodes.size();
+    const Uint nb_vars = nbvars();
+    const Uint dim = std::min(coordinates.row_size(), nb_vars);
+    cf3_assert(predefined_values.size() >= nb_vars);
+
+    RealMatrix var_values(nb_nodes, nb_vars);
+    value_nodes.resize(nb_nodes);
+    for(Uint i = 0; i != nb_nodes; ++i)
+    {
+      value_nodes[i] = nodes[i];
+      const common::Table<Real>::ConstRow row = coordinates[nodes[i]];
+      for(Uint j = 0; j != dim; ++j)
+        var_values(i, j) = row[j];
+      for(Uint j = dim; j != nb_vars; ++j)
+        var_values(i, j) = predefined_values[j];
+    }
+
+    evaluate_batch(var_values, node_values);
+  }
+
+  /// Return to evaluating the function at each node
+  void clear_node_values() const
+  {
+    value_nodes.clear();
+    node_values.resize(0, 0);
+  }
+
+  /// Row of node_values holding the values at the given node, or -1 if it was not part of evaluate_nodes
+  int node_row(const Uint node_idx) const
+  {
+    const std::vector<Uint>::const_iterator found = std::lower_bound(value_nodes.begin(), value_nodes.end(), node_idx);
+    if(found == value_nodes.end() || *found != node_idx)
+      return -1;
+    return static_cast<int>(found - value_nodes.begin());
+  }
+
+  /// Nodes evaluated by evaluate_nodes, in increasing order
+  mutable std::vector<Uint> value_nodes;
+
+  /// Function values for each node in value_nodes, one row per node
+  mutable RealMatrix node_values;
 };
 
 
@@ -111,6 +164,59 @@ boost::proto::transform< ParsedScalarFunctionTransform >
   };
 };
 
+/// Use the value computed by evaluate_nodes for the current node, if any, or evaluate the function otherwise
+template<typename ResultT, typename DataT>
+void evaluate_function_at_node(const ProtoEvaluatedFunction& func, const DataT& data, ResultT& result)
+{
+  const int row = func.node_row(data.node_idx());
+  if(row < 0)
+  {
+    evaluate_function(func, data.coordinates(), result);
+    return;
+  }
+
+  cf3_assert(static_cast<Uint>(result.size()) == static_cast<Uint>(func.node_values.cols()));
+  for(Uint i = 0; i != static_cast<Uint>(result.size()); ++i)
+  {
+    result[i] = func.node_values(row, i);
+  }
+}
+
+/// Vector function transform for node expressions, using the values of evaluate_nodes
+struct NodeParsedVectorFunctionTransform :
+  boost::proto::transform< NodeParsedVectorFunctionTransform >
+{
+  template<typename ExprT, typename StateT, typename DataT>
+  struct impl : boost::proto::transform_impl<ExprT, StateT, DataT>
+  {
+    typedef const typename boost::remove_reference<DataT>::type::CoordsT& result_type;
+
+    result_type operator()(typename impl::expr_param expr, typename impl::state_param state, typename impl::data_param data) const
+    {
+      evaluate_function_at_node(boost::proto::value(expr), data, expr.value);
+      return expr.value;
+    }
+  };
+};
+
+/// Scalar function transform for node expressions, using the values of evaluate_nodes
+struct NodeParsedScalarFunctionTransform :
+boost::proto::transform< NodeParsedScalarFunctionTransform >
+{
+  template<typename ExprT, typename StateT, typename DataT>
+  struct impl : boost::proto::transform_impl<ExprT, StateT, DataT>
+  {
+    typedef Real result_type;
+
+    Real operator()(typename impl::expr_param expr, typename impl::state_param state, typename impl::data_param data) const
+    {
+      std::vector<Real> result(1);
+      evaluate_function_at_node(boost::proto::value(expr), data, result);
+      return result.back();
+    }
+  };
+};
+
 struct ParsedFunctionGrammar :
   boost::proto::or_
   <
@@ -128,6 +234,49 @@ struct ParsedFunctionGrammar :
 {
 };
 
+/// Parsed functions in node expressions
+struct NodeParsedFunctionGrammar :
+  boost::proto::or_
+  <
+    boost::proto::when
+    <
+      boost::proto::terminal<VectorFunction>,
+      NodeParsedVectorFunctionTransform
+    >,
+    boost::proto::when
+    <
+      boost::proto::terminal<ScalarFunction>,
+      NodeParsedScalarFunctionTransform
+    >
+  >
+{
+};
+
+/// Calls evaluate_nodes on all parsed functions in an expression, or clear_node_values if no nodes are given
+struct EvaluateFunctionsForNodes
+  : boost::proto::callable_context< EvaluateFunctionsForNodes, boost::proto::null_context >
+{
+  typedef void result_type;
+
+  EvaluateFunctionsForNodes(const common::List<Uint>* nodes, const common::Table<Real>* coordinates) :
+    m_nodes(nodes),
+    m_coordinates(coordinates)
+  {
+  }
+
+  void operator()(boost::proto::tag::terminal, const ProtoEvaluatedFunction& func)
+  {
+    if(m_nodes)
+      func.evaluate_nodes(*m_nodes, *m_coordinates);
+    else
+      func.clear_node_values();
+  }
+
+private:
+  const common::List<Uint>* m_nodes;
+  const common::Table<Real>* m_coordinates;
+};
+
 } // namespace Proto
 } // namespace actions
 } // namespace solver
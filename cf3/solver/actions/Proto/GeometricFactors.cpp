@@ -0,0 +1,159 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#include <algorithm>
+#include <cstring>
+
+#include <boost/cstdint.hpp>
+
+#include "common/Core.hpp"
+#include "common/Environment.hpp"
+#include "common/EventHandler.hpp"
+#include "common/OptionList.hpp"
+
+#include "mesh/Connectivity.hpp"
+#include "mesh/Dictionary.hpp"
+#include "mesh/Field.hpp"
+#include "mesh/Space.hpp"
+#include "mesh/Tags.hpp"
+
+#include "GeometricFactors.hpp"
+
+namespace cf3 {
+namespace solver {
+namespace actions {
+namespace Proto {
+
+GeometricFactorsCache::GeometricFactorsCache()
+{
+  common::Core::instance().event_handler().connect_to_event(mesh::Tags::event_mesh_changed(), this, &GeometricFactorsCache::on_mesh_changed_event);
+  common::Core::instance().event_handler().connect_to_event(mesh::Tags::event_coordinates_changed(), this, &GeometricFactorsCache::on_mesh_changed_event);
+}
+
+GeometricFactorsCache::~GeometricFactorsCache()
+{
+}
+
+GeometricFactorsCache& GeometricFactorsCache::instance()
+{
+  static GeometricFactorsCache instance;
+  return instance;
+}
+
+GeometricFactorsCache::ConstFactorsPtrT GeometricFactorsCache::find(const mesh::Elements& elements, const std::string& etype_key, const Real* mapped_coords, const Uint dimensionality)
+{
+  boost::mutex::scoped_lock lock(m_mutex);
+  return find_point(entry(elements, etype_key).points, mapped_coords, dimensionality);
+}
+
+GeometricFactorsCache::ConstFactorsPtrT GeometricFactorsCache::insert(const mesh::Elements& elements, const std::string& etype_key, const ConstFactorsPtrT& factors)
+{
+  cf3_assert(factors->determinants.size() == elements.size());
+
+  boost::mutex::scoped_lock lock(m_mutex);
+  Entry& cached = entry(elements, etype_key);
+  const ConstFactorsPtrT existing = find_point(cached.points, &factors->mapped_coords[0], factors->mapped_coords.size());
+  if(existing)
+    return existing;
+
+  cached.points.push_back(factors);
+  return factors;
+}
+
+void GeometricFactorsCache::check_coordinates(const mesh::Elements& elements)
+{
+  const std::size_t checksum = coordinates_checksum(elements);
+  const std::string path = elements.uri().path();
+
+  boost::mutex::scoped_lock lock(m_mutex);
+  ChecksumsT::iterator found = m_checksums.find(path);
+  if(found != m_checksums.end() && found->second == checksum)
+    return;
+
+  // Drop the entries for all element types of these elements
+  const std::string prefix = path + ":";
+  EntriesT::iterator it = m_entries.lower_bound(prefix);
+  while(it != m_entries.end() && it->first.compare(0, prefix.size(), prefix) == 0)
+    m_entries.erase(it++);
+
+  m_checksums[path] = checksum;
+}
+
+std::size_t GeometricFactorsCache::coordinates_checksum(const mesh::Elements& elements)
+{
+  const common::Table<Real>& coordinates = elements.geometry_fields().coordinates();
+  const mesh::Connectivity& connectivity = elements.geometry_space().connectivity();
+  const Uint nb_elems = connectivity.size();
+  const Uint nb_elem_nodes = connectivity.row_size();
+  const Uint dim = coordinates.row_size();
+
+  // FNV-1a over the bits of the coordinates, one 64 bit value at a time
+  boost::uint64_t result = UINT64_C(14695981039346656037);
+  for(Uint elem = 0; elem != nb_elems; ++elem)
+  {
+    const mesh::Connectivity::ConstRow row = connectivity[elem];
+    for(Uint i = 0; i != nb_elem_nodes; ++i)
+    {
+      const common::Table<Real>::ConstRow node = coordinates[row[i]];
+      for(Uint j = 0; j != dim; ++j)
+      {
+        boost::uint64_t bits = 0;
+        const Real x = node[j];
+        std::memcpy(&bits, &x, std::min(sizeof(bits), sizeof(x)));
+        result = (result ^ bits) * UINT64_C(1099511628211);
+      }
+    }
+  }
+
+  return static_cast<std::size_t>(result);
+}
+
+void GeometricFactorsCache::clear()
+{
+  boost::mutex::scoped_lock lock(m_mutex);
+  m_entries.clear();
+  m_checksums.clear();
+}
+
+void GeometricFactorsCache::on_mesh_changed_event(common::SignalArgs& args)
+{
+  clear();
+}
+
+GeometricFactorsCache::ConstFactorsPtrT GeometricFactorsCache::find_point(const std::vector<ConstFactorsPtrT>& points, const Real* mapped_coords, const Uint dimensionality)
+{
+  const Uint nb_points = points.size();
+  for(Uint i = 0; i != nb_points; ++i)
+  {
+    const std::vector<Real>& point_coords = points[i]->mapped_coords;
+    if(point_coords.size() == dimensionality && std::equal(point_coords.begin(), point_coords.end(), mapped_coords))
+      return points[i];
+  }
+
+  return ConstFactorsPtrT();
+}
+
+GeometricFactorsCache::Entry& GeometricFactorsCache::entry(const mesh::Elements& elements, const std::string& etype_key)
+{
+  Entry& cached = m_entries[elements.uri().path() + ":" + etype_key];
+  if(cached.nb_elements != elements.size())
+  {
+    cached.nb_elements = elements.size();
+    cached.points.clear();
+  }
+
+  return cached;
+}
+
+bool cache_geometric_factors()
+{
+  return common::Core::instance().environment().options().value<bool>("cache_geometric_factors");
+}
+
+} // namespace Proto
+} // namespace actions
+} // namespace solver
+} // namespace cf3
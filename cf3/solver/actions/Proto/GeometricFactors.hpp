@@ -0,0 +1,119 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#ifndef cf3_solver_actions_Proto_GeometricFactors_hpp
+#define cf3_solver_actions_Proto_GeometricFactors_hpp
+
+#include <map>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "common/ConnectionManager.hpp"
+#include "common/SignalHandler.hpp"
+
+#include "mesh/Elements.hpp"
+
+#include "solver/actions/LibActions.hpp"
+
+/// @file
+/// Cache for the jacobians of the elements at the quadrature points, used on static meshes
+
+namespace cf3 {
+namespace solver {
+namespace actions {
+namespace Proto {
+
+/// Jacobians, their inverses and determinants for all elements of an Elements component, at one point in mapped coordinates
+struct GeometricFactors
+{
+  /// The mapped coordinates of the point
+  std::vector<Real> mapped_coords;
+  /// For each element, the entries of the jacobian matrix in column-major order
+  std::vector<Real> jacobians;
+  /// For each element, the entries of the inverse jacobian matrix in column-major order
+  std::vector<Real> jacobian_inverses;
+  /// For each element, the jacobian determinant
+  std::vector<Real> determinants;
+};
+
+/// Stores the geometric factors of the elements at each point where Proto expressions requested them, so they are
+/// computed only once on static meshes. Entries are kept per Elements component and per element type, and the
+/// points are identified by their mapped coordinates, so each quadrature rule gets its own points.
+/// The cache is cleared when a mesh_changed or coordinates_changed event is raised. Since coordinates can also be
+/// modified in place without an event (e.g. from a script), each loop over the elements compares a checksum of their
+/// node coordinates with the one of the cached factors, see check_coordinates.
+/// It is used only if the cache_geometric_factors option of the environment is true.
+class solver_actions_API GeometricFactorsCache : public common::ConnectionManager, public boost::noncopyable
+{
+public:
+  typedef boost::shared_ptr<const GeometricFactors> ConstFactorsPtrT;
+
+  /// Singleton implementation
+  static GeometricFactorsCache& instance();
+
+  /// Get the factors at the given mapped coordinates, or null if they were not computed yet
+  /// @param elements The elements for which the factors are stored
+  /// @param etype_key Key identifying the element type used to compute the factors
+  ConstFactorsPtrT find(const mesh::Elements& elements, const std::string& etype_key, const Real* mapped_coords, const Uint dimensionality);
+
+  /// Store newly computed factors. If another thread stored factors for the same point first, those are returned
+  ConstFactorsPtrT insert(const mesh::Elements& elements, const std::string& etype_key, const ConstFactorsPtrT& factors);
+
+  /// Drop the factors of the elements if the coordinates of their nodes changed since the factors were computed.
+  /// This computes a checksum over the connectivity, so it is called once per loop and not per element.
+  void check_coordinates(const mesh::Elements& elements);
+
+  /// Checksum of the coordinates of the nodes used by the elements, in connectivity order
+  static std::size_t coordinates_checksum(const mesh::Elements& elements);
+
+  /// Drop all cached factors
+  void clear();
+
+  ~GeometricFactorsCache();
+
+private:
+  GeometricFactorsCache();
+
+  void on_mesh_changed_event(common::SignalArgs& args);
+
+  /// Search the points of an entry
+  static ConstFactorsPtrT find_point(const std::vector<ConstFactorsPtrT>& points, const Real* mapped_coords, const Uint dimensionality);
+
+  struct Entry
+  {
+    Entry() : nb_elements(0) {}
+
+    /// Number of elements at the time the factors were computed, used as sanity check
+    Uint nb_elements;
+    std::vector<ConstFactorsPtrT> points;
+  };
+
+  /// Entry for the elements, dropping any data if the number of elements changed. Must be called with the mutex locked
+  Entry& entry(const mesh::Elements& elements, const std::string& etype_key);
+
+  // Entries, keyed by the path of the Elements component and the element type key
+  typedef std::map<std::string, Entry> EntriesT;
+  EntriesT m_entries;
+
+  // Checksum of the coordinates used for the entries of each Elements component, keyed by its path
+  typedef std::map<std::string, std::size_t> ChecksumsT;
+  ChecksumsT m_checksums;
+
+  boost::mutex m_mutex;
+};
+
+/// True if the geometric factors must be cached, as set by the cache_geometric_factors option of the environment
+solver_actions_API bool cache_geometric_factors();
+
+} // namespace Proto
+} // namespace actions
+} // namespace solver
+} // namespace cf3
+
+#endif // cf3_solver_actions_Proto_GeometricFactors_hpp
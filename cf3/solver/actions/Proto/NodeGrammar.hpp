@@ -176,7 +176,7 @@ struct NodeMath;
 struct NodeMathBase :
   boost::proto::or_
   <
-    boost::proto::or_<MathTerminals, ParsedFunctionGrammar, boost::proto::terminal< IndexTag<boost::proto::_> > >, // Scalars and matrices
+    boost::proto::or_<MathTerminals, NodeParsedFunctionGrammar, boost::proto::terminal< IndexTag<boost::proto::_> > >, // Scalars and matrices
     // Value of numbered variables
     boost::proto::when
     <
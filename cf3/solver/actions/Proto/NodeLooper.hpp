@@ -159,12 +159,20 @@ private:
     boost::shared_ptr< common::List<Uint> > used_nodes_ptr = mesh::build_used_nodes_list(used_entities, dict, true);
 
     const common::List<Uint>& nodes = *used_nodes_ptr;
+
+    // Parsed functions are evaluated for all nodes at once, which is much faster than evaluating them per node
+    EvaluateFunctionsForNodes evaluate_functions(&nodes, &dict.coordinates());
+    boost::proto::eval(expr, evaluate_functions);
+
     const Uint nb_nodes = nodes.size();
     for(Uint i = 0; i != nb_nodes; ++i)
     {
       data.set_node(nodes[i]);
       grammar(expr, 0, data); // The "0" is the proto state, which is unused at the top-level expression
     }
+
+    EvaluateFunctionsForNodes clear_functions(0, 0);
+    boost::proto::eval(expr, clear_functions);
   }
 
   struct FindDict
@@ -11,6 +11,7 @@
 #include "common/Builder.hpp"
 #include "common/Log.hpp"
 #include "common/OptionComponent.hpp"
+#include "common/OptionList.hpp"
 #include "common/URI.hpp"
 
 #include "mesh/Region.hpp"
@@ -107,6 +108,10 @@ ProtoAction::ProtoAction(const std::string& name) :
   Action(name),
   m_implementation(new Implementation(*this, m_physical_model))
 {
+  options().add("threaded", false)
+    .pretty_name("Threaded")
+    .description("Loop over the elements using the number of threads set by the assembly_threads option of the environment. Only valid for expressions that modify no state shared between elements, i.e. without assignments to lit() terminals or parsed functions.")
+    .attach_trigger(boost::bind(&ProtoAction::trigger_threaded, this));
 }
 
 ProtoAction::~ProtoAction()
@@ -130,10 +135,17 @@ void ProtoAction::execute()
 void ProtoAction::set_expression(const boost::shared_ptr< Expression >& expression)
 {
   m_implementation->m_expression = expression;
+  expression->set_threaded(options().value<bool>("threaded"));
   expression->add_options(options());
   m_implementation->trigger_physical_model();
 }
 
+void ProtoAction::trigger_threaded()
+{
+  if(is_not_null(m_implementation->m_expression))
+    m_implementation->m_expression->set_threaded(options().value<bool>("threaded"));
+}
+
 bool ProtoAction::expression_is_set() const
 {
   return is_not_null(m_implementation->m_expression);
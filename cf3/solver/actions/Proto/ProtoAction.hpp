@@ -48,6 +48,8 @@ public:
   void insert_field_info(std::map<std::string, std::string>& tags) const;
 
 private:
+  void trigger_threaded();
+
   class Implementation;
   boost::scoped_ptr<Implementation> m_implementation;
 };
@@ -11,6 +11,7 @@
 #include "common/OptionList.hpp"
 #include "common/List.hpp"
 #include "common/BinaryDataReader.hpp"
+#include "common/PE/SharedFile.hpp"
 
 #include "common/XML/FileOperations.hpp"
 
@@ -25,6 +26,7 @@
 #include "solver/Time.hpp"
 
 #include "solver/actions/ReadRestartFile.hpp"
+#include "solver/actions/SharedRestartFile.hpp"
 
 /////////////////////////////////////////////////////////////////////////////////////
 
@@ -88,7 +90,21 @@ void ReadRestartFile::execute()
     time->options().set("iteration", common::from_str<Uint>(restart_node.attribute_value("iteration")));
   }
 
-  if(common::from_str<Uint>(restart_node.attribute_value("version")) != 1)
+  const Uint version = common::from_str<Uint>(restart_node.attribute_value("version"));
+  if(version == 2)
+  {
+    // Shared file format, independent of the number of processes
+    common::PE::SharedFile file(common::URI(restart_node.attribute_value("binary_file")), common::PE::SharedFile::READ);
+    common::XML::XmlNode dict_node(restart_node.content->first_node("dictionary"));
+    for(; dict_node.is_valid(); dict_node.content = dict_node.content->next_sibling("dictionary"))
+    {
+      detail::read_shared_restart_dictionary(file, dict_node, *mesh);
+    }
+    file.close();
+    return;
+  }
+
+  if(version != 1)
     throw common::FileFormatError(FromHere(), "File  " + filepath.path() + " has unsupported version");
 
   common::PE::Comm& comm = common::PE::Comm::instance();
@@ -0,0 +1,345 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#include <algorithm>
+#include <limits>
+
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "rapidxml/rapidxml.hpp"
+
+#include "common/BasicExceptions.hpp"
+#include "common/List.hpp"
+#include "common/PE/Comm.hpp"
+
+#include "mesh/Dictionary.hpp"
+#include "mesh/Field.hpp"
+#include "mesh/Mesh.hpp"
+
+#include "solver/actions/SharedRestartFile.hpp"
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+namespace cf3 {
+namespace solver {
+namespace actions {
+namespace detail {
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+  typedef boost::uint64_t IdT;
+
+  /// all_to_all that also works without MPI
+  template<typename T>
+  void exchange(const std::vector< std::vector<T> >& send, std::vector< std::vector<T> >& recv)
+  {
+    common::PE::Comm& comm = common::PE::Comm::instance();
+    if(comm.is_active())
+      comm.all_to_all(send, recv);
+    else
+      recv = send;
+  }
+
+  /// all_gather of a single value that also works without MPI
+  template<typename T>
+  void gather_all(const T& value, std::vector<T>& result)
+  {
+    common::PE::Comm& comm = common::PE::Comm::instance();
+    if(comm.is_active())
+    {
+      comm.all_gather(value, result);
+    }
+    else
+    {
+      result.assign(1, value);
+    }
+  }
+
+  /// Maximum over all processes, also without MPI
+  template<typename T>
+  T global_max(const T& value)
+  {
+    common::PE::Comm& comm = common::PE::Comm::instance();
+    if(!comm.is_active())
+      return value;
+
+    T result;
+    comm.all_reduce(common::PE::max(), &value, 1, &result);
+    return result;
+  }
+
+  /// Sum over all processes, also without MPI
+  template<typename T>
+  T global_sum(const T& value)
+  {
+    common::PE::Comm& comm = common::PE::Comm::instance();
+    if(!comm.is_active())
+      return value;
+
+    T result;
+    comm.all_reduce(common::PE::plus(), &value, 1, &result);
+    return result;
+  }
+
+  /// Path of a component relative to the mesh
+  std::string relative_path(const common::Component& component, const std::string& base_path)
+  {
+    std::string result = component.uri().path();
+    boost::replace_first(result, base_path, "");
+    cf3_assert(result.size() == component.uri().path().size() - base_path.size());
+    return result;
+  }
+
+  template<typename T>
+  T* data_ptr(std::vector<T>& v)
+  {
+    return v.empty() ? 0 : &v[0];
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+boost::uint64_t write_shared_restart_dictionary(common::PE::SharedFile& file,
+                                                const boost::uint64_t offset,
+                                                const mesh::Dictionary& dict,
+                                                const std::vector< Handle<mesh::Field> >& fields,
+                                                const std::string& base_path,
+                                                common::XML::XmlNode& dict_node)
+{
+  common::PE::Comm& comm = common::PE::Comm::instance();
+  const Uint nb_procs = comm.size();
+  const Uint my_rank = comm.rank();
+
+  const common::List<Uint>& glb_idx = dict.glb_idx();
+  const Uint nb_local_rows = dict.size();
+
+  // Owned rows
+  std::vector<Uint> owned_rows;
+  owned_rows.reserve(nb_local_rows);
+  IdT local_id_space = 0;
+  for(Uint i = 0; i != nb_local_rows; ++i)
+  {
+    if(dict.is_ghost(i))
+      continue;
+    owned_rows.push_back(i);
+    local_id_space = std::max(local_id_space, static_cast<IdT>(glb_idx[i]) + 1);
+  }
+
+  // Each process collects a contiguous range of global indices
+  const IdT id_space = global_max(local_id_space);
+  const IdT slab_size = id_space / nb_procs + 1;
+
+  std::vector< std::vector<IdT> > send_ids(nb_procs);
+  BOOST_FOREACH(const Uint row, owned_rows)
+  {
+    send_ids[glb_idx[row] / slab_size].push_back(glb_idx[row]);
+  }
+  std::vector< std::vector<IdT> > recv_ids;
+  exchange(send_ids, recv_ids);
+
+  // Sort the received ids, keeping track of where they came from
+  std::vector< std::pair<IdT, std::pair<Uint, Uint> > > sorted_ids;
+  for(Uint proc = 0; proc != nb_procs; ++proc)
+  {
+    const Uint nb_received = recv_ids[proc].size();
+    for(Uint i = 0; i != nb_received; ++i)
+      sorted_ids.push_back(std::make_pair(recv_ids[proc][i], std::make_pair(proc, i)));
+  }
+  std::sort(sorted_ids.begin(), sorted_ids.end());
+
+  const Uint nb_slab_rows = sorted_ids.size();
+  Uint nb_duplicates = 0;
+  for(Uint i = 1; i < nb_slab_rows; ++i)
+  {
+    if(sorted_ids[i].first == sorted_ids[i-1].first)
+      ++nb_duplicates;
+  }
+  if(global_sum(nb_duplicates) != 0)
+    throw common::ParallelError(FromHere(), "Dictionary " + dict.uri().path() + " has rows with the same global index on different processes");
+
+  std::vector<IdT> slab_ids(nb_slab_rows);
+  for(Uint i = 0; i != nb_slab_rows; ++i)
+    slab_ids[i] = sorted_ids[i].first;
+
+  std::vector<Uint> all_nb_slab_rows;
+  gather_all(nb_slab_rows, all_nb_slab_rows);
+  IdT first_row = 0;
+  IdT nb_rows = 0;
+  for(Uint proc = 0; proc != nb_procs; ++proc)
+  {
+    if(proc == my_rank)
+      first_row = nb_rows;
+    nb_rows += all_nb_slab_rows[proc];
+  }
+
+  dict_node.set_attribute("path", relative_path(dict, base_path));
+  dict_node.set_attribute("nb_rows", boost::lexical_cast<std::string>(nb_rows));
+  dict_node.set_attribute("offset", boost::lexical_cast<std::string>(offset));
+
+  file.write_at_all(offset + first_row*sizeof(IdT), data_ptr(slab_ids), nb_slab_rows*sizeof(IdT));
+  IdT field_offset = offset + nb_rows*sizeof(IdT);
+
+  BOOST_FOREACH(const Handle<mesh::Field>& field, fields)
+  {
+    cf3_assert(&field->dict() == &dict);
+    const Uint row_size = field->row_size();
+
+    // Send the values along the same route as the ids
+    std::vector< std::vector<Real> > send_values(nb_procs);
+    BOOST_FOREACH(const Uint row, owned_rows)
+    {
+      std::vector<Real>& buffer = send_values[glb_idx[row] / slab_size];
+      const mesh::Field::ConstRow field_row = (*field)[row];
+      buffer.insert(buffer.end(), field_row.begin(), field_row.end());
+    }
+    std::vector< std::vector<Real> > recv_values;
+    exchange(send_values, recv_values);
+
+    std::vector<Real> slab_values(nb_slab_rows*row_size);
+    for(Uint i = 0; i != nb_slab_rows; ++i)
+    {
+      const Uint proc = sorted_ids[i].second.first;
+      const Uint recv_idx = sorted_ids[i].second.second;
+      std::copy(recv_values[proc].begin() + recv_idx*row_size, recv_values[proc].begin() + (recv_idx+1)*row_size, slab_values.begin() + i*row_size);
+    }
+
+    common::XML::XmlNode field_node = dict_node.add_node("field");
+    field_node.set_attribute("path", relative_path(*field, base_path));
+    field_node.set_attribute("row_size", common::to_str(row_size));
+    field_node.set_attribute("offset", boost::lexical_cast<std::string>(field_offset));
+
+    file.write_at_all(field_offset + first_row*row_size*sizeof(Real), data_ptr(slab_values), slab_values.size()*sizeof(Real));
+    field_offset += nb_rows*row_size*sizeof(Real);
+  }
+
+  return field_offset;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+void read_shared_restart_dictionary(common::PE::SharedFile& file, const common::XML::XmlNode& dict_node, mesh::Mesh& mesh)
+{
+  common::PE::Comm& comm = common::PE::Comm::instance();
+  const Uint nb_procs = comm.size();
+  const Uint my_rank = comm.rank();
+
+  Handle<mesh::Dictionary> dict(mesh.access_component(common::URI(dict_node.attribute_value("path"), common::URI::Scheme::CPATH)));
+  if(is_null(dict))
+    throw common::SetupError(FromHere(), "Dictionary " + dict_node.attribute_value("path") + " was not found in mesh " + mesh.uri().path());
+
+  const IdT nb_rows = boost::lexical_cast<IdT>(dict_node.attribute_value("nb_rows"));
+  const IdT offset = boost::lexical_cast<IdT>(dict_node.attribute_value("offset"));
+
+  // Read an equal part of the sorted ids
+  const IdT first_row = nb_rows * my_rank / nb_procs;
+  const Uint nb_slab_rows = static_cast<Uint>(nb_rows * (my_rank+1) / nb_procs - first_row);
+  std::vector<IdT> slab_ids(nb_slab_rows);
+  file.read_at_all(offset + first_row*sizeof(IdT), data_ptr(slab_ids), nb_slab_rows*sizeof(IdT));
+
+  // First id held by each process, to find the process holding a given id. An empty slab gets the first id of the
+  // next non-empty slab, so first_ids stays sorted and upper_bound selects the non-empty one. Empty slabs at the end
+  // get the maximum id.
+  const IdT my_first_id = nb_slab_rows == 0 ? std::numeric_limits<IdT>::max() : slab_ids.front();
+  std::vector<IdT> first_ids;
+  gather_all(my_first_id, first_ids);
+  for(Uint proc = nb_procs - 1; proc != 0; --proc)
+  {
+    if(nb_rows * proc / nb_procs == nb_rows * (proc-1) / nb_procs)
+      first_ids[proc-1] = first_ids[proc];
+  }
+
+  // Request the rows of all local entries, including ghosts
+  const common::List<Uint>& glb_idx = dict->glb_idx();
+  const Uint nb_local_rows = dict->size();
+  std::vector< std::vector<IdT> > request_ids(nb_procs);
+  std::vector< std::vector<Uint> > request_rows(nb_procs);
+  for(Uint i = 0; i != nb_local_rows; ++i)
+  {
+    const IdT gid = glb_idx[i];
+    const std::vector<IdT>::const_iterator holder = std::upper_bound(first_ids.begin(), first_ids.end(), gid);
+    const Uint proc = holder == first_ids.begin() ? 0 : static_cast<Uint>(holder - first_ids.begin()) - 1;
+    request_ids[proc].push_back(gid);
+    request_rows[proc].push_back(i);
+  }
+  std::vector< std::vector<IdT> > received_requests;
+  exchange(request_ids, received_requests);
+
+  // Locate the requested rows in the slab
+  static const Uint missing = std::numeric_limits<Uint>::max();
+  Uint nb_missing = 0;
+  std::vector< std::vector<Uint> > slab_rows(nb_procs);
+  for(Uint proc = 0; proc != nb_procs; ++proc)
+  {
+    BOOST_FOREACH(const IdT gid, received_requests[proc])
+    {
+      const std::vector<IdT>::const_iterator found = std::lower_bound(slab_ids.begin(), slab_ids.end(), gid);
+      if(found == slab_ids.end() || *found != gid)
+      {
+        slab_rows[proc].push_back(missing);
+        ++nb_missing;
+      }
+      else
+      {
+        slab_rows[proc].push_back(static_cast<Uint>(found - slab_ids.begin()));
+      }
+    }
+  }
+  if(global_sum(nb_missing) != 0)
+    throw common::FileFormatError(FromHere(), "Restart data for dictionary " + dict->uri().path() + " does not match the global numbering of the mesh");
+
+  common::XML::XmlNode field_node(dict_node.content->first_node("field"));
+  for(; field_node.is_valid(); field_node.content = field_node.content->next_sibling("field"))
+  {
+    Handle<mesh::Field> field(mesh.access_component(common::URI(field_node.attribute_value("path"), common::URI::Scheme::CPATH)));
+    if(is_null(field))
+      throw common::SetupError(FromHere(), "Field " + field_node.attribute_value("path") + " was not found in mesh " + mesh.uri().path());
+
+    const Uint row_size = common::from_str<Uint>(field_node.attribute_value("row_size"));
+    if(field->row_size() != row_size)
+      throw common::SetupError(FromHere(), "Field " + field->uri().path() + " has row size " + common::to_str(field->row_size()) + " but the restart data has row size " + common::to_str(row_size));
+    if(&field->dict() != dict.get())
+      throw common::SetupError(FromHere(), "Field " + field->uri().path() + " does not belong to dictionary " + dict->uri().path());
+
+    const IdT field_offset = boost::lexical_cast<IdT>(field_node.attribute_value("offset"));
+    std::vector<Real> slab_values(nb_slab_rows*row_size);
+    file.read_at_all(field_offset + first_row*row_size*sizeof(Real), data_ptr(slab_values), slab_values.size()*sizeof(Real));
+
+    std::vector< std::vector<Real> > reply_values(nb_procs);
+    for(Uint proc = 0; proc != nb_procs; ++proc)
+    {
+      BOOST_FOREACH(const Uint slab_row, slab_rows[proc])
+      {
+        reply_values[proc].insert(reply_values[proc].end(), slab_values.begin() + slab_row*row_size, slab_values.begin() + (slab_row+1)*row_size);
+      }
+    }
+    std::vector< std::vector<Real> > received_values;
+    exchange(reply_values, received_values);
+
+    for(Uint proc = 0; proc != nb_procs; ++proc)
+    {
+      const Uint nb_requested = request_rows[proc].size();
+      cf3_assert(received_values[proc].size() == nb_requested*row_size);
+      for(Uint i = 0; i != nb_requested; ++i)
+      {
+        mesh::Field::Row field_row = (*field)[request_rows[proc][i]];
+        std::copy(received_values[proc].begin() + i*row_size, received_values[proc].begin() + (i+1)*row_size, field_row.begin());
+      }
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+} // detail
+} // actions
+} // solver
+} // cf3
+
+/////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,64 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#ifndef cf3_solver_actions_SharedRestartFile_hpp
+#define cf3_solver_actions_SharedRestartFile_hpp
+
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include "common/Handle.hpp"
+#include "common/PE/SharedFile.hpp"
+#include "common/XML/XmlNode.hpp"
+
+#include "solver/actions/LibActions.hpp"
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+namespace cf3 {
+namespace mesh { class Dictionary; class Field; class Mesh; }
+namespace solver {
+namespace actions {
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+/// @file
+/// Restart data in a single binary file shared by all processes. For each dictionary the file holds the sorted global
+/// indices of its rows, followed by the rows of each field in the same order. Since the data is ordered by global
+/// index, it can be read back on any number of processes, as long as the mesh has the same global numbering.
+/// Data is stored in the native byte order.
+
+namespace detail
+{
+  /// Write the fields, which must all belong to dict, as one dictionary section of a shared restart file, starting at
+  /// offset. The rows owned by each process are sent to the process responsible for their range of global indices,
+  /// which writes them as a contiguous slab. The layout is stored as attributes and child nodes of dict_node.
+  /// @param base_path Path of the mesh, removed from the field paths stored in the XML
+  /// @return The offset of the end of the section
+  solver_actions_API boost::uint64_t write_shared_restart_dictionary(common::PE::SharedFile& file,
+                                                                    const boost::uint64_t offset,
+                                                                    const mesh::Dictionary& dict,
+                                                                    const std::vector< Handle<mesh::Field> >& fields,
+                                                                    const std::string& base_path,
+                                                                    common::XML::XmlNode& dict_node);
+
+  /// Read a section written by write_shared_restart_dictionary into the fields of the mesh. Each process reads an
+  /// equal slab of the file and sends the rows to the processes that hold them, including the ghosts.
+  solver_actions_API void read_shared_restart_dictionary(common::PE::SharedFile& file,
+                                                         const common::XML::XmlNode& dict_node,
+                                                         mesh::Mesh& mesh);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+} // actions
+} // solver
+} // cf3
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+#endif // cf3_solver_actions_SharedRestartFile_hpp
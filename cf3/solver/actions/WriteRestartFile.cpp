@@ -4,6 +4,8 @@
 // GNU Lesser General Public License version 3 (LGPLv3).
 // See doc/lgpl.txt and doc/gpl.txt for the license text.
 
+#include <map>
+
 #include <boost/bind.hpp>
 #include <boost/function.hpp>
 
@@ -12,6 +14,7 @@
 #include "common/OptionList.hpp"
 #include "common/List.hpp"
 #include "common/BinaryDataWriter.hpp"
+#include "common/PE/SharedFile.hpp"
 #include "common/XML/FileOperations.hpp"
 
 #include "mesh/Dictionary.hpp"
@@ -24,6 +27,7 @@
 #include "solver/Tags.hpp"
 #include "solver/Time.hpp"
 
+#include "solver/actions/SharedRestartFile.hpp"
 #include "solver/actions/WriteRestartFile.hpp"
 
 /////////////////////////////////////////////////////////////////////////////////////
@@ -38,6 +42,17 @@ common::ComponentBuilder < WriteRestartFile, common::Action, LibActions > WriteR
 
 ///////////////////////////////////////////////////////////////////////////////////////
 
+namespace
+{
+  void write_restart_xml(const boost::shared_ptr<common::XML::XmlDoc>& xml_doc, const common::URI& out_file_path)
+  {
+    if(common::PE::Comm::instance().rank() == 0)
+      common::XML::to_file(*xml_doc, out_file_path);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+
 WriteRestartFile::WriteRestartFile ( const std::string& name ) :
   common::Action(name)
 {
@@ -55,6 +70,17 @@ WriteRestartFile::WriteRestartFile ( const std::string& name ) :
     .pretty_name("Time")
     .description("Time component, used to extract timing and iteration information")
     .mark_basic();
+
+  options().add("shared_file", false)
+    .pretty_name("Shared File")
+    .description("Write the data to a single file shared by all processes, ordered by global index, so it can be read back on a different number of processes")
+    .mark_basic();
+
+  options().add("asynchronous", false)
+    .pretty_name("Asynchronous")
+    .description("Copy the fields and compress and write them on a background thread, so the solver can continue. "
+                 "The restart file itself is written once the data is complete. Not used for shared files.")
+    .mark_basic();
 }
 
 /////////////////////////////////////////////////////////////////////////////////////
@@ -83,12 +109,19 @@ void WriteRestartFile::execute()
   cf3_assert(is_not_null(mesh));
   
   const common::URI out_file_path = options().value<common::URI>("file");
+  if(options().value<bool>("shared_file"))
+  {
+    write_shared(fields, *mesh, *time, out_file_path);
+    return;
+  }
+
   const common::URI binfile = out_file_path.base_path() / (out_file_path.base_name() + ".cfbinxml");
   boost::shared_ptr<common::BinaryDataWriter> data_writer = common::allocate_component<common::BinaryDataWriter>("DataWriter");
   data_writer->options().set("file", binfile);
+  data_writer->options().set("asynchronous", options().value<bool>("asynchronous"));
   
-  common::XML::XmlDoc xml_doc("1.0", "ISO-8859-1");
-  common::XML::XmlNode restart_node = xml_doc.add_node("restart");
+  boost::shared_ptr<common::XML::XmlDoc> xml_doc(new common::XML::XmlDoc("1.0", "ISO-8859-1"));
+  common::XML::XmlNode restart_node = xml_doc->add_node("restart");
   restart_node.set_attribute("version", "1");
   restart_node.set_attribute("binary_file", binfile.path());
   restart_node.set_attribute("nb_procs", common::to_str(comm.size()));
@@ -108,6 +141,50 @@ void WriteRestartFile::execute()
     field_node.set_attribute("index", common::to_str(data_writer->append_data(*field)));
   }
 
+  // The restart file is only written once the binary data is complete, so an interrupted write never leaves a
+  // restart file pointing to incomplete data
+  data_writer->close(boost::bind(&write_restart_xml, xml_doc, out_file_path));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+void WriteRestartFile::write_shared(const std::vector< Handle<mesh::Field> >& fields, const mesh::Mesh& mesh, const Time& time, const common::URI& out_file_path)
+{
+  common::PE::Comm& comm = common::PE::Comm::instance();
+
+  const common::URI binfile = out_file_path.base_path() / (out_file_path.base_name() + ".cfshared");
+
+  common::XML::XmlDoc xml_doc("1.0", "ISO-8859-1");
+  common::XML::XmlNode restart_node = xml_doc.add_node("restart");
+  restart_node.set_attribute("version", "2");
+  restart_node.set_attribute("binary_file", binfile.path());
+  restart_node.set_attribute("nb_procs", common::to_str(comm.size()));
+  restart_node.set_attribute("current_time", common::to_str(time.current_time()));
+  restart_node.set_attribute("time_step", common::to_str(time.dt()));
+  restart_node.set_attribute("iteration", common::to_str(time.iter()));
+
+  // Group the fields per dictionary, keeping the order in which the dictionaries first appear
+  std::vector< Handle<mesh::Dictionary> > dictionaries;
+  std::map< mesh::Dictionary*, std::vector< Handle<mesh::Field> > > dict_fields;
+  BOOST_FOREACH(const Handle<mesh::Field>& field, fields)
+  {
+    std::vector< Handle<mesh::Field> >& group = dict_fields[&field->dict()];
+    if(group.empty())
+      dictionaries.push_back(field->dict().handle<mesh::Dictionary>());
+    group.push_back(field);
+  }
+
+  const std::string base_path = mesh.uri().path() + "/";
+
+  common::PE::SharedFile file(binfile, common::PE::SharedFile::WRITE);
+  boost::uint64_t offset = 0;
+  BOOST_FOREACH(const Handle<mesh::Dictionary>& dict, dictionaries)
+  {
+    common::XML::XmlNode dict_node = restart_node.add_node("dictionary");
+    offset = detail::write_shared_restart_dictionary(file, offset, *dict, dict_fields[dict.get()], base_path, dict_node);
+  }
+  file.close();
+
   if(comm.rank() == 0)
     common::XML::to_file(xml_doc, out_file_path);
 }
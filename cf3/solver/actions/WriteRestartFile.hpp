@@ -8,17 +8,22 @@
 #define cf3_solver_actions_WriteRestartFile_hpp
 
 #include "common/Action.hpp"
+#include "common/URI.hpp"
 #include "solver/actions/LibActions.hpp"
 
 /////////////////////////////////////////////////////////////////////////////////////
 
 namespace cf3 {
+namespace mesh { class Field; class Mesh; }
 namespace solver {
+class Time;
 namespace actions {
 
 ///////////////////////////////////////////////////////////////////////////////////////
 
-/// Write out a restartfile, designed to be loaded into an already-created mesh
+/// Write out a restartfile, designed to be loaded into an already-created mesh.
+/// If the shared_file option is set, all processes write to a single binary file ordered by global index, which can
+/// be read back on any number of processes.
 class solver_actions_API WriteRestartFile : public common::Action
 {
 public: // functions
@@ -34,6 +39,10 @@ public: // functions
 
   /// execute the action
   virtual void execute ();
+
+private:
+  /// Write the fields to a single binary file shared by all processes
+  void write_shared(const std::vector< Handle<mesh::Field> >& fields, const mesh::Mesh& mesh, const Time& time, const common::URI& out_file_path);
 };
 
 /////////////////////////////////////////////////////////////////////////////////////
@@ -8,6 +8,8 @@
 #include "common/Log.hpp"
 #include "common/Signal.hpp"
 #include "common/Builder.hpp"
+#include "common/Core.hpp"
+#include "common/EventHandler.hpp"
 #include <common/List.hpp>
 #include <common/PropertyList.hpp>
 
@@ -21,6 +23,8 @@
 #include "mesh/FieldManager.hpp"
 #include "mesh/Dictionary.hpp"
 #include "mesh/Field.hpp"
+#include "mesh/Region.hpp"
+#include "mesh/Tags.hpp"
 
 #include "solver/Tags.hpp"
 #include "solver/actions/Proto/ProtoAction.hpp"
@@ -113,6 +117,8 @@ LSSAction::LSSAction(const std::string& name) :
     .description("Builder to use when creating the initial LSS solution strategy")
     .attach_trigger(boost::bind(&LSSAction::create_lss, this))
     .mark_basic();
+
+  Core::instance().event_handler().connect_to_event(mesh::Tags::event_mesh_changed(), this, &LSSAction::on_mesh_changed_event);
 }
 
 LSSAction::~LSSAction()
@@ -152,6 +158,22 @@ LSS::System& LSSAction::create_lss()
   return *lss;
 }
 
+void LSSAction::on_mesh_changed_event(SignalArgs& args)
+{
+  if(is_null(m_implementation->m_lss) || !m_implementation->m_lss->is_created() || m_loop_regions.empty() || is_null(m_loop_regions.front()))
+    return;
+
+  SignalOptions options(args);
+  const URI mesh_uri = options.value<URI>("mesh_uri");
+  if(mesh_uri != find_parent_component<mesh::Mesh>(*m_loop_regions.front()).uri())
+    return;
+
+  // The sparsity and numbering of the system follow the old mesh. The comm patterns may still be rebuilt after this
+  // event (e.g. by DynamicLoadBalance), so the system is created again on the next execution rather than here.
+  CFdebug << "Destroying LSS for " << uri().path() << " because mesh " << mesh_uri.path() << " changed" << CFendl;
+  m_implementation->m_lss->destroy();
+}
+
 void LSSAction::signal_create_lss(SignalArgs& node)
 {
   LSS::System& lss = create_lss();
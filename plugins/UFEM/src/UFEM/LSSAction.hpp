@@ -78,6 +78,9 @@ private:
   /// Trigger for the initial conditions
   void trigger_initial_conditions();
 
+  /// Destroy the LSS when the mesh it was built for changes, so it is created again on the next execution
+  void on_mesh_changed_event(common::SignalArgs& args);
+
   /// The dictionary to use for field lookups
   Handle<mesh::Dictionary> m_dictionary;
 
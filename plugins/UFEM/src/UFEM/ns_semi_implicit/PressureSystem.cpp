@@ -240,7 +240,10 @@ void PressureSystem::do_create_lss(common::PE::CommPattern &cp, const math::Vari
 
   Handle<math::LSS::System> lss(get_child("LSS"));
 
-  // We also create a matrix that contains the original sparsity to do the assembly
+  // We also create a matrix that contains the original sparsity to do the assembly, replacing the one of an
+  // earlier mesh when the LSS is created again after a mesh change
+  if(is_not_null(get_child("AssemblySystem")))
+    remove_component("AssemblySystem");
   Handle<math::LSS::System> assembly_system = create_component<math::LSS::System>("AssemblySystem");
   assembly_system->options().set("matrix_builder", std::string("cf3.math.LSS.TrilinosCrsMatrix"));
   assembly_system->create(cp, 1, node_connectivity, starting_indices, periodic_links_nodes, periodic_links_active);
@@ -0,0 +1,78 @@
+import sys
+import coolfluid as cf
+
+# Global configuration
+cf.env.assertion_backtrace = False
+cf.env.exception_backtrace = True
+cf.env.regist_signal_handlers = False
+cf.env.exception_log_level = 0
+cf.env.log_level = 4
+cf.env.exception_outputs = False
+cf.env.only_cpu0_writes = True
+
+# Steady heat conduction, with the assembly and solve done inside a DynamicLoadBalance that repartitions the mesh
+# after every execution
+model = cf.Core.root().create_component('HotModel', 'cf3.solver.Model')
+domain = model.create_domain()
+physics = model.create_physics('cf3.UFEM.NavierStokesPhysics')
+solver = model.create_solver('cf3.UFEM.Solver')
+hc = solver.add_direct_solver('cf3.UFEM.HeatConductionSteady')
+
+balancer = solver.create_component('Balancer', 'cf3.solver.actions.DynamicLoadBalance')
+balancer.check_interval = 1
+# Any measured time exceeds half the mean, so every execution rebalances
+balancer.imbalance_threshold = 0.5
+hc.move_component(balancer.uri())
+
+mesh = domain.create_component('mesh','cf3.mesh.Mesh')
+
+blocks = domain.create_component('model', 'cf3.mesh.BlockMesh.BlockArrays')
+points = blocks.create_points(dimensions = 2, nb_points = 4)
+points[0]  = [0., 0.]
+points[1]  = [1., 0.]
+points[2]  = [1., 1.]
+points[3]  = [0., 1.]
+block_nodes = blocks.create_blocks(1)
+block_nodes[0] = [0, 1, 2, 3]
+block_subdivs = blocks.create_block_subdivisions()
+block_subdivs[0] = [20,20]
+gradings = blocks.create_block_gradings()
+gradings[0] = [1., 1., 1., 1.]
+blocks.create_patch_nb_faces(name = 'bottom', nb_faces = 1)[0] = [0, 1]
+blocks.create_patch_nb_faces(name = 'right', nb_faces = 1)[0] = [1, 2]
+blocks.create_patch_nb_faces(name = 'top', nb_faces = 1)[0] = [2, 3]
+blocks.create_patch_nb_faces(name = 'left', nb_faces = 1)[0] = [3, 0]
+blocks.partition_blocks(nb_partitions = cf.Core.nb_procs(), direction = 1)
+blocks.create_mesh(mesh.uri())
+
+balancer.mesh = mesh
+hc.regions = [mesh.topology.interior.uri()]
+hc.children.Update.options.relaxation_factor_hc = 1.
+
+bc = hc.BoundaryConditions
+bc.regions = [mesh.topology.uri()]
+bc.add_constant_bc(region_name = 'bottom', variable_name = 'Temperature').value = 10
+bc.add_constant_bc(region_name = 'top', variable_name = 'Temperature').value = 30
+
+def check_temperature(nb_rebalances):
+  if balancer.properties()['nb_rebalances'] != nb_rebalances:
+    raise Exception('Expected ' + str(nb_rebalances) + ' rebalances, got ' + str(balancer.properties()['nb_rebalances']))
+  coords = mesh.geometry.coordinates
+  temperature = mesh.geometry.heat_conduction_solution
+  if len(temperature) != len(coords):
+    raise Exception('Temperature has ' + str(len(temperature)) + ' rows for ' + str(len(coords)) + ' nodes')
+  for i in range(len(coords)):
+    expected = 10. + 20.*coords[i][1]
+    if abs(temperature[i][0] - expected) > 1e-8:
+      raise Exception('Incorrect temperature ' + str(temperature[i][0]) + ' at ' + str(coords[i]) + ', expected ' + str(expected))
+
+# Solve on the initial partitioning. The solution is migrated with the mesh.
+model.simulate()
+check_temperature(1)
+
+# Solve again from zero on the new partitioning, which needs the LSS to be rebuilt by the HeatConductionSteady action
+temperature = mesh.geometry.heat_conduction_solution
+for i in range(len(temperature)):
+  temperature[i][0] = 0.
+model.simulate()
+check_temperature(2)
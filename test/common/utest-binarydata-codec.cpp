@@ -0,0 +1,124 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Test module for the compression of binary data blocks"
+
+#include <cmath>
+#include <cstring>
+
+#include <boost/test/unit_test.hpp>
+
+#include "common/BinaryDataCodec.hpp"
+
+using namespace cf3;
+using namespace cf3::common;
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct BinaryDataCodecFixture
+{
+  BinaryDataCodecFixture() :
+    nb_rows(1001),
+    nb_cols(3)
+  {
+    // A smooth vector field, with columns of very different magnitude
+    values.resize(nb_rows*nb_cols);
+    for(Uint i = 0; i != nb_rows; ++i)
+    {
+      const Real x = static_cast<Real>(i) / static_cast<Real>(nb_rows);
+      values[i*nb_cols] = 1e-3*std::sin(x);
+      values[i*nb_cols+1] = 1e5 + std::cos(x);
+      values[i*nb_cols+2] = -x*x;
+    }
+
+    // The stored bytes, with a few trailing bytes so the count is not a multiple of the value size
+    bytes.resize(values.size()*sizeof(Real) + 5);
+    std::memcpy(&bytes[0], &values[0], values.size()*sizeof(Real));
+    for(Uint i = 0; i != 5; ++i)
+      bytes[values.size()*sizeof(Real) + i] = static_cast<char>(i+1);
+  }
+
+  /// Compress in chunks and decompress again, checking that the data is unchanged. Returns the compressed size.
+  std::size_t round_trip(const BinaryDataCodec& codec, const std::size_t chunk_size)
+  {
+    std::vector< std::vector<char> > chunks;
+    codec.compress_chunks(&bytes[0], bytes.size(), chunk_size, 3, chunks);
+    BOOST_CHECK_EQUAL(chunks.size(), (bytes.size() + chunk_size - 1) / chunk_size);
+
+    std::size_t compressed_size = 0;
+    std::vector<const char*> chunk_data;
+    std::vector<std::size_t> chunk_sizes;
+    for(Uint i = 0; i != chunks.size(); ++i)
+    {
+      chunk_data.push_back(chunks[i].empty() ? 0 : &chunks[i][0]);
+      chunk_sizes.push_back(chunks[i].size());
+      compressed_size += chunks[i].size();
+    }
+
+    std::vector<char> result(bytes.size());
+    codec.decompress_chunks(chunk_data, chunk_sizes, &result[0], result.size(), chunk_size, 2);
+    BOOST_CHECK(result == bytes);
+
+    return compressed_size;
+  }
+
+  const Uint nb_rows;
+  const Uint nb_cols;
+  std::vector<Real> values;
+  std::vector<char> bytes;
+};
+
+BOOST_FIXTURE_TEST_SUITE( BinaryDataCodecSuite, BinaryDataCodecFixture )
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_CASE( Filters )
+{
+  const std::string codecs[] = {"none", "zlib", "fast"};
+  const std::string filters[] = {"none", "shuffle", "xor_shuffle"};
+  const Uint row_size = nb_cols*sizeof(Real);
+
+  // Chunk sizes that are not a multiple of the row size or of the value size, and a single chunk
+  const std::size_t chunk_sizes[] = {1000, 4097, bytes.size()};
+
+  for(Uint c = 0; c != 3; ++c)
+  {
+    for(Uint f = 0; f != 3; ++f)
+    {
+      const BinaryDataCodec codec(codecs[c], 1, filters[f], sizeof(Real), row_size);
+      BOOST_CHECK_EQUAL(codec.row_size(), row_size);
+      for(Uint s = 0; s != 3; ++s)
+        round_trip(codec, chunk_sizes[s]);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE( DefaultRowSize )
+{
+  // Without a row size, values are XORed with the previous one, as for lists
+  const BinaryDataCodec codec("zlib", 1, "xor_shuffle", sizeof(Real));
+  BOOST_CHECK_EQUAL(codec.row_size(), sizeof(Real));
+  round_trip(codec, 1000);
+
+  // Single bytes with a row size are still XORed by row
+  const BinaryDataCodec byte_codec("fast", 1, "xor_shuffle", 1, 3);
+  round_trip(byte_codec, 1000);
+}
+
+BOOST_AUTO_TEST_CASE( XorByRow )
+{
+  // XOR with the same column of the previous row must compress the vector field better than XOR with the next column
+  const std::size_t by_value = round_trip(BinaryDataCodec("zlib", 6, "xor_shuffle", sizeof(Real)), bytes.size());
+  const std::size_t by_row = round_trip(BinaryDataCodec("zlib", 6, "xor_shuffle", sizeof(Real), nb_cols*sizeof(Real)), bytes.size());
+  BOOST_CHECK_LT(by_row, by_value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_SUITE_END()
+
+////////////////////////////////////////////////////////////////////////////////
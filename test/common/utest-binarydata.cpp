@@ -9,12 +9,15 @@
 
 #include <iostream>
 
+#include <boost/bind.hpp>
 #include <boost/mpl/if.hpp>
 #include <boost/test/unit_test.hpp>
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/random/uniform_int_distribution.hpp>
 #include <boost/random/uniform_real_distribution.hpp>
+#include <boost/thread/thread.hpp>
 
+#include "common/BackgroundWriter.hpp"
 #include "common/BinaryDataReader.hpp"
 #include "common/BinaryDataWriter.hpp"
 #include "common/Core.hpp"
@@ -173,6 +176,82 @@ BOOST_AUTO_TEST_CASE( ReadBinaryData )
   BOOST_CHECK_EQUAL(empty_real_table.row_size(), 8);
 }
 
+BOOST_AUTO_TEST_CASE( ChunkedCodecs )
+{
+  Handle<common::Component> write_group = common::Core::instance().root().get_child("WriteGroup");
+  const common::Table<Real>& real_table = *Handle< common::Table<Real> >(write_group->get_child("RealTable"));
+  const common::List<Uint>& int_list = *Handle< common::List<Uint> >(write_group->get_child("IntList"));
+
+  const std::string codecs[] = {"none", "zlib", "fast"};
+  for(Uint i = 0; i != 3; ++i)
+  {
+    const std::string filename = "binary_data_" + codecs[i] + ".cfbinxml";
+    common::BinaryDataWriter& writer = *write_group->create_component<common::BinaryDataWriter>("Writer_" + codecs[i]);
+    writer.options().set("file", common::URI(filename));
+    writer.options().set("codec", codecs[i]);
+    writer.options().set("filter", std::string(i == 1 ? "shuffle" : "xor_shuffle"));
+    writer.options().set("compression_level", 1u);
+    writer.options().set("chunk_size", 10000u);
+    writer.options().set("threads", 3u);
+    writer.append_data(real_table);
+    writer.append_data(int_list);
+    writer.close();
+
+    common::Component& read_group = *common::Core::instance().root().create_component("ReadGroup_" + codecs[i], "cf3.common.Group");
+    common::BinaryDataReader& reader = *read_group.create_component<common::BinaryDataReader>("Reader");
+    reader.options().set("threads", 2u);
+    reader.options().set("file", common::URI(filename));
+    common::Table<Real>& read_real_table = *read_group.create_component< common::Table<Real> >("RealTable");
+    common::List<Uint>& read_int_list = *read_group.create_component< common::List<Uint> >("IntList");
+    reader.read_table(read_real_table, 0);
+    reader.read_list(read_int_list, 1);
+
+    BOOST_CHECK(read_real_table.array() == real_table.array());
+    BOOST_CHECK(read_int_list.array() == int_list.array());
+  }
+}
+
+void set_flag(bool& flag)
+{
+  flag = true;
+}
+
+BOOST_AUTO_TEST_CASE( AsynchronousWrite )
+{
+  Handle<common::Component> write_group = common::Core::instance().root().get_child("WriteGroup");
+  common::Table<Real>& real_table = *Handle< common::Table<Real> >(write_group->get_child("RealTable"));
+  const common::Table<Real>::ArrayT reference = real_table.array();
+
+  common::BinaryDataWriter& writer = *write_group->create_component<common::BinaryDataWriter>("AsyncWriter");
+  writer.options().set("file", common::URI("binary_data_async.cfbinxml"));
+  writer.options().set("asynchronous", true);
+  writer.append_data(real_table);
+
+  bool completed = false;
+  writer.close(boost::bind(&set_flag, boost::ref(completed)));
+
+  // Modifying the data after appending must not affect the file
+  real_table[0][0] += 1.;
+
+  // Polling completes the file once the background thread wrote it, without waiting for the next submit
+  for(Uint i = 0; i != 1000 && common::BackgroundWriter::instance().nb_pending() != 0; ++i)
+  {
+    common::BackgroundWriter::instance().poll();
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+  }
+  BOOST_CHECK(completed);
+  BOOST_CHECK_EQUAL(common::BackgroundWriter::instance().nb_pending(), 0);
+  common::BackgroundWriter::instance().wait_all();
+
+  common::Component& read_group = *common::Core::instance().root().create_component("AsyncReadGroup", "cf3.common.Group");
+  common::BinaryDataReader& reader = *read_group.create_component<common::BinaryDataReader>("Reader");
+  reader.options().set("file", common::URI("binary_data_async.cfbinxml"));
+  common::Table<Real>& read_real_table = *read_group.create_component< common::Table<Real> >("RealTable");
+  reader.read_table(read_real_table, 0);
+
+  BOOST_CHECK(read_real_table.array() == reference);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,205 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Test module for CompressedTable component"
+
+#include <boost/assign/list_of.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "common/CF.hpp"
+#include "common/CompressedTable.hpp"
+
+//////////////////////////////////////////////////////////////////////////////
+
+using namespace cf3;
+using namespace cf3::common;
+
+/// Check that the given row holds the expected values
+void check_row(const CompressedTable<Uint>& table, const Uint row, const std::vector<Uint>& expected)
+{
+  BOOST_CHECK_EQUAL(table.row_size(row), expected.size());
+  BOOST_CHECK_EQUAL(table[row].size(), expected.size());
+  BOOST_CHECK_EQUAL_COLLECTIONS(table[row].begin(), table[row].end(), expected.begin(), expected.end());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_SUITE( CompressedTableTests )
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_CASE ( Empty )
+{
+  boost::shared_ptr< CompressedTable<Uint> > table_ptr = allocate_component< CompressedTable<Uint> >("table");
+  CompressedTable<Uint>& table = *table_ptr;
+
+  BOOST_CHECK_EQUAL(table.size(), 0u);
+  BOOST_CHECK_EQUAL(table.nb_values(), 0u);
+  BOOST_CHECK_EQUAL(table.offsets().size(), 1u);
+
+  // Building a table without values gives empty rows
+  CompressedTableBuilder<Uint> builder(table, 3);
+  builder.allocate();
+  BOOST_CHECK_EQUAL(table.size(), 3u);
+  BOOST_CHECK_EQUAL(table.nb_values(), 0u);
+  for(Uint i = 0; i != 3; ++i)
+  {
+    BOOST_CHECK_EQUAL(table.row_size(i), 0u);
+    BOOST_CHECK(table[i].empty());
+  }
+
+  table.clear();
+  BOOST_CHECK_EQUAL(table.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE ( TwoPassBuild )
+{
+  boost::shared_ptr< CompressedTable<Uint> > table_ptr = allocate_component< CompressedTable<Uint> >("table");
+  CompressedTable<Uint>& table = *table_ptr;
+
+  // Rows 1 and 4 stay empty, and the values are counted and added in an arbitrary row order
+  CompressedTableBuilder<Uint> builder(table, 5);
+  builder.count(3);
+  builder.count(0);
+  builder.count(3, 2);
+  builder.count(2);
+  builder.count(0);
+  builder.allocate();
+
+  BOOST_CHECK_EQUAL(table.size(), 5u);
+  BOOST_CHECK_EQUAL(table.nb_values(), 6u);
+  const std::vector<Uint> expected_offsets = boost::assign::list_of(0)(2)(2)(3)(6)(6);
+  BOOST_CHECK_EQUAL_COLLECTIONS(table.offsets().begin(), table.offsets().end(), expected_offsets.begin(), expected_offsets.end());
+
+  builder.add(3, 30);
+  builder.add(2, 20);
+  builder.add(0, 0);
+  builder.add(3, 31);
+  builder.add(0, 1);
+  builder.add(3, 32);
+
+  // Values keep the order in which they were added to their row
+  check_row(table, 0, boost::assign::list_of(0)(1));
+  check_row(table, 1, std::vector<Uint>());
+  check_row(table, 2, boost::assign::list_of(20));
+  check_row(table, 3, boost::assign::list_of(30)(31)(32));
+  check_row(table, 4, std::vector<Uint>());
+
+  // Rows can be modified in place
+  table[2][0] = 21;
+  check_row(table, 2, boost::assign::list_of(21));
+
+  // Building again discards the previous contents
+  CompressedTableBuilder<Uint> rebuilder(table, 2);
+  rebuilder.count(1);
+  rebuilder.allocate();
+  rebuilder.add(1, 7);
+  BOOST_CHECK_EQUAL(table.size(), 2u);
+  check_row(table, 0, std::vector<Uint>());
+  check_row(table, 1, boost::assign::list_of(7));
+}
+
+BOOST_AUTO_TEST_CASE ( Assign )
+{
+  boost::shared_ptr< CompressedTable<Uint> > table_ptr = allocate_component< CompressedTable<Uint> >("table");
+  CompressedTable<Uint>& table = *table_ptr;
+
+  std::vector< std::vector<Uint> > rows(4);
+  rows[0] = boost::assign::list_of(1)(2)(3);
+  rows[2] = boost::assign::list_of(4);
+  table.assign(rows);
+
+  BOOST_CHECK_EQUAL(table.size(), 4u);
+  BOOST_CHECK_EQUAL(table.nb_values(), 4u);
+  for(Uint i = 0; i != rows.size(); ++i)
+    check_row(table, i, rows[i]);
+
+  // Row sizes can be set before filling the values
+  table.set_row_sizes(boost::assign::list_of(0)(2));
+  BOOST_CHECK_EQUAL(table.size(), 2u);
+  check_row(table, 0, std::vector<Uint>());
+  check_row(table, 1, boost::assign::list_of(0)(0));
+}
+
+BOOST_AUTO_TEST_CASE ( Buffer )
+{
+  boost::shared_ptr< CompressedTable<Uint> > table_ptr = allocate_component< CompressedTable<Uint> >("table");
+  CompressedTable<Uint>& table = *table_ptr;
+
+  {
+    boost::shared_ptr< CompressedTable<Uint>::Buffer > buffer = table.create_buffer_ptr();
+
+    buffer->add_row(std::vector<Uint>(3, 0));
+    buffer->add_row(std::vector<Uint>(4, 1));
+    buffer->add_row(std::vector<Uint>());
+    buffer->add_row(std::vector<Uint>(2, 3));
+
+    // Nothing changes before the flush
+    BOOST_CHECK_EQUAL(table.size(), 0u);
+
+    buffer->flush();
+    BOOST_CHECK_EQUAL(table.size(), 4u);
+    check_row(table, 0, std::vector<Uint>(3, 0));
+    check_row(table, 1, std::vector<Uint>(4, 1));
+    check_row(table, 2, std::vector<Uint>());
+    check_row(table, 3, std::vector<Uint>(2, 3));
+
+    // Add a row and remove it again before flushing, then add another one
+    buffer->add_row(std::vector<Uint>(4, 4));
+    buffer->rm_row(4);
+    buffer->add_row(std::vector<Uint>(7, 5));
+    buffer->flush();
+    BOOST_CHECK_EQUAL(table.size(), 5u);
+    check_row(table, 4, std::vector<Uint>(7, 5));
+
+    // Removed rows are filled with the last rows on flush
+    buffer->rm_row(0);
+    buffer->rm_row(1);
+    buffer->rm_row(2);
+    BOOST_CHECK_EQUAL(table.size(), 5u);
+    buffer->flush();
+    BOOST_CHECK_EQUAL(table.size(), 2u);
+    check_row(table, 0, std::vector<Uint>(2, 3));
+    check_row(table, 1, std::vector<Uint>(7, 5));
+    BOOST_CHECK_EQUAL(table.nb_values(), 9u);
+
+    // Reassign the first row, with a different size
+    buffer->rm_row(0);
+    buffer->add_row(std::vector<Uint>(5, 6));
+    buffer->flush();
+    BOOST_CHECK_EQUAL(table.size(), 2u);
+    check_row(table, 0, std::vector<Uint>(5, 6));
+    check_row(table, 1, std::vector<Uint>(7, 5));
+
+    // Rows that are not flushed yet can be set to a different size
+    const Uint new_row = buffer->add_row(std::vector<Uint>(3, 7));
+    buffer->set_row(new_row, std::vector<Uint>(1, 8));
+
+    // The buffer is flushed when it is destroyed
+  }
+
+  BOOST_CHECK_EQUAL(table.size(), 3u);
+  check_row(table, 0, std::vector<Uint>(5, 6));
+  check_row(table, 1, std::vector<Uint>(7, 5));
+  check_row(table, 2, std::vector<Uint>(1, 8));
+  BOOST_CHECK_EQUAL(table.nb_values(), 13u);
+
+  // A new buffer starts from the current contents of the table
+  {
+    boost::shared_ptr< CompressedTable<Uint>::Buffer > buffer = table.create_buffer_ptr();
+    buffer->rm_row(1);
+  }
+  BOOST_CHECK_EQUAL(table.size(), 2u);
+  check_row(table, 0, std::vector<Uint>(5, 6));
+  check_row(table, 1, std::vector<Uint>(1, 8));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_SUITE_END()
+
+////////////////////////////////////////////////////////////////////////////////
@@ -452,6 +452,43 @@ BOOST_AUTO_TEST_CASE( all_to_all_vector_variable )
 
 ////////////////////////////////////////////////////////////////////////////////
 
+BOOST_AUTO_TEST_CASE( sparse_all_to_all_vector_variable )
+{
+  int i,j,k;
+
+  setup_data_variable();
+
+  // receive counts are discovered by the sparse exchange
+  vec_tmprcv.resize(0);
+  vec_tmpcnt.assign(nproc,-1);
+  PE::Comm::instance().sparse_all_to_all(vec_snddat, vec_sndcnt, vec_tmprcv, vec_tmpcnt);
+  for (i=0; i<nproc; i++) BOOST_CHECK_EQUAL( vec_tmpcnt[i] , vec_rcvcnt[i] );
+  BOOST_CHECK_EQUAL( (int)vec_tmprcv.size() , rcvcnt );
+  for (i=0, k=0; i<nproc; i++) for (j=0; j<vec_rcvcnt[i]; j++, k++) BOOST_CHECK_EQUAL( vec_tmprcv[k] , vec_rcvdat[k] );
+
+  // in place, with a stride
+  vec_tmprcvchr.assign(vec_snddatchr.begin(),vec_snddatchr.end());
+  PE::Comm::instance().sparse_all_to_all(vec_tmprcvchr, vec_sndcnt, vec_tmprcvchr, vec_tmpcnt, sizeof(double));
+  for (i=0; i<nproc; i++) BOOST_CHECK_EQUAL( vec_tmpcnt[i] , vec_rcvcnt[i] );
+  for (i=0, k=0; i<nproc; i++) for (j=0; j<vec_rcvcnt[i]; j++, k++) BOOST_CHECK_EQUAL( ((double*)(&vec_tmprcvchr[0]))[k] , vec_rcvdat[k] );
+
+  // nested vectors, compared to the dense version
+  std::vector< std::vector<int> > send(nproc);
+  for (i=0; i<nproc; i++) for (j=0; j<vec_sndcnt[i]; j++) send[i].push_back(irank*nproc+i);
+  std::vector< std::vector<int> > recv_dense;
+  std::vector< std::vector<int> > recv_sparse;
+  PE::Comm::instance().all_to_all(send, recv_dense);
+  PE::Comm::instance().sparse_all_to_all(send, recv_sparse);
+  BOOST_CHECK_EQUAL( recv_sparse.size() , recv_dense.size() );
+  for (i=0; i<nproc; i++)
+  {
+    BOOST_CHECK_EQUAL( recv_sparse[i].size() , recv_dense[i].size() );
+    for (j=0; j<(int)recv_dense[i].size(); j++) BOOST_CHECK_EQUAL( recv_sparse[i][j] , recv_dense[i][j] );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 BOOST_AUTO_TEST_SUITE_END()
 
 ////////////////////////////////////////////////////////////////////////////////
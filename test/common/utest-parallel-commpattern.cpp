@@ -16,6 +16,7 @@
 #include <boost/test/unit_test.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
+#include <boost/foreach.hpp>
 
 #include "common/Log.hpp"
 #include "common/FindComponents.hpp"
@@ -25,6 +26,7 @@
 #include "common/PE/CommWrapperMArray.hpp"
 #include "common/PE/CommPattern.hpp"
 #include "common/PE/debug.hpp"
+#include "common/OptionList.hpp"
 #include "common/Group.hpp"
 
 
@@ -212,6 +214,102 @@ BOOST_AUTO_TEST_CASE( commpattern_mainstream )
 
 ////////////////////////////////////////////////////////////////////////////////
 
+BOOST_AUTO_TEST_CASE( commpattern_nonblocking )
+{
+  // general constants in this routine
+  const int nproc=PE::Comm::instance().size();
+  const int irank=PE::Comm::instance().rank();
+
+  // commpattern
+  boost::shared_ptr<CommPattern> pecp_ptr = allocate_component<CommPattern>("CommPattern");
+  CommPattern& pecp = *pecp_ptr;
+
+  // setup gid & rank
+  std::vector<Uint> gid;
+  std::vector<Uint> rank;
+  setupGidAndRank(gid,rank);
+  pecp.insert("gid",gid,1,false);
+
+  // the same data twice, once synchronized collectively and once point-to-point
+  std::vector<double> collective;
+  for(int i=0;i<12*nproc;i++) collective.push_back((double)((irank+1)*1000+i+1));
+  std::vector<double> nonblocking(collective);
+  pecp.insert("collective",collective,2,true);
+  pecp.insert("nonblocking",nonblocking,2,true);
+
+  pecp.setup(Handle<CommWrapper>(pecp.get_child("gid")),rank);
+
+  // only ranks we actually exchange with are neighbours
+  BOOST_FOREACH(const int neighbour, pecp.recv_neighbours()) BOOST_CHECK( neighbour != irank );
+
+  pecp.options().set("point_to_point",false);
+  pecp.synchronize("collective");
+
+  pecp.begin_synchronize("nonblocking");
+  BOOST_CHECK_THROW( pecp.begin_synchronize("nonblocking"), IllegalCall );
+  pecp.end_synchronize("nonblocking");
+  BOOST_CHECK_THROW( pecp.end_synchronize("nonblocking"), IllegalCall );
+
+  BOOST_CHECK_EQUAL( collective.size(), nonblocking.size() );
+  for (Uint i=0; i<collective.size(); i++) BOOST_CHECK_EQUAL( collective[i], nonblocking[i] );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_CASE( commpattern_exchange_plan )
+{
+  // general constants in this routine
+  const int nproc=PE::Comm::instance().size();
+  const int irank=PE::Comm::instance().rank();
+
+  // commpattern
+  boost::shared_ptr<CommPattern> pecp_ptr = allocate_component<CommPattern>("CommPattern");
+  CommPattern& pecp = *pecp_ptr;
+
+  // setup gid & rank
+  std::vector<Uint> gid;
+  std::vector<Uint> rank;
+  setupGidAndRank(gid,rank);
+  pecp.insert("gid",gid,1,false);
+
+  // reference data synchronized one by one, and two arrays of different type and stride synchronized by the plan
+  std::vector<double> ref_d;
+  for(int i=0;i<12*nproc;i++) ref_d.push_back((double)((irank+1)*1000+i+1));
+  std::vector<int> ref_i;
+  for(int i=0;i<6*nproc;i++) ref_i.push_back(-((irank+1)*1000+i+1));
+  std::vector<double> plan_d(ref_d);
+  std::vector<int> plan_i(ref_i);
+  pecp.insert("ref_d",ref_d,2,true);
+  pecp.insert("ref_i",ref_i,1,true);
+  pecp.insert("plan_d",plan_d,2,true);
+  pecp.insert("plan_i",plan_i,1,true);
+
+  pecp.setup(Handle<CommWrapper>(pecp.get_child("gid")),rank);
+
+  pecp.synchronize("ref_d");
+  pecp.synchronize("ref_i");
+
+  std::vector<std::string> names;
+  names.push_back("plan_d");
+  names.push_back("plan_i");
+  Handle<ExchangePlan> plan = pecp.exchange_plan(names);
+  BOOST_CHECK( plan == pecp.exchange_plan(names) );
+
+  // run twice, to check the persistent requests can be restarted
+  for (int pass=0; pass<2; pass++)
+  {
+    plan->begin_synchronize();
+    BOOST_CHECK_THROW( plan->begin_synchronize(), IllegalCall );
+    plan->end_synchronize();
+    BOOST_CHECK_THROW( plan->end_synchronize(), IllegalCall );
+
+    for (Uint i=0; i<ref_d.size(); i++) BOOST_CHECK_EQUAL( ref_d[i], plan_d[i] );
+    for (Uint i=0; i<ref_i.size(); i++) BOOST_CHECK_EQUAL( ref_i[i], plan_i[i] );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 BOOST_AUTO_TEST_CASE( commpattern_external_synchronization )
 {
 /*
@@ -81,6 +81,41 @@ BOOST_AUTO_TEST_CASE( function_2 )
 
 }
 
+BOOST_AUTO_TEST_CASE( batch_matches_pointwise )
+{
+  // 1/x divides by zero for the first point, and if() is evaluated point by point.
+  // The powers with a non-integer or variable exponent compile to cPow, with a negative base for (y-x)^2.3 and
+  // zero to a negative power for x^(y-8) at the first point
+  cf3::math::VectorialFunction f ("[sin(x)*y+x^2][1/x][if(x<y,x,y)][sqrt(x)*pi][x^1.7][x^y][(y-x)^2.3][x^(y-8)]","x,y");
+
+  // more points than a block, with the last block partially filled
+  const Uint nb_points = 150;
+  RealMatrix variables(nb_points, 2);
+  for (Uint p=0; p<nb_points; ++p)
+  {
+    variables(p,0) = static_cast<Real>(p) / 10.;
+    variables(p,1) = 7. - static_cast<Real>(p) / 20.;
+  }
+
+  RealMatrix values;
+  f.evaluate_batch(variables, values);
+  BOOST_CHECK_EQUAL( static_cast<Uint>(values.rows()), nb_points );
+  BOOST_CHECK_EQUAL( static_cast<Uint>(values.cols()), 8u );
+
+  RealVector point(2);
+  RealVector r(8);
+  for (Uint p=0; p<nb_points; ++p)
+  {
+    point = variables.row(p);
+    f.evaluate(point, r);
+    for (Uint i=0; i<8; ++i)
+      BOOST_CHECK_EQUAL( values(p,i), r[i] );
+  }
+
+  BOOST_CHECK_EQUAL( values(0,1), 0. );
+  BOOST_CHECK_EQUAL( values(0,7), 0. );
+}
+
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -15,6 +15,8 @@
 #include <boost/test/unit_test.hpp>
 #include <boost/assign/std/vector.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
 
 #include "common/Log.hpp"
 #include "math/LSS/System.hpp"
@@ -34,6 +36,15 @@ using namespace cf3::math::LSS;
 
 ////////////////////////////////////////////////////////////////////////////////
 
+/// Add the same block a number of times, using the thread-safe interface
+void add_block_concurrent(LSS::Matrix& mat, const LSS::BlockAccumulator& ba, const int nb_adds)
+{
+  for (int i=0; i<nb_adds; i++)
+    mat.add_values_concurrent(ba);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 struct LSSAtomicFixture
 {
   /// common setup for each test case
@@ -474,6 +485,130 @@ BOOST_AUTO_TEST_CASE( test_matrix_only )
 
 ////////////////////////////////////////////////////////////////////////////////
 
+BOOST_AUTO_TEST_CASE( test_matrix_concurrent_add )
+{
+  boost::shared_ptr<common::PE::CommPattern> cp_ptr = common::allocate_component<common::PE::CommPattern>("commpattern");
+  common::PE::CommPattern& cp = *cp_ptr;
+  build_commpattern(cp);
+  boost::shared_ptr<LSS::System> sys(common::allocate_component<LSS::System>("sys"));
+  sys->options().option("matrix_builder").change_value(matrix_builder);
+  build_system(*sys,cp);
+  Handle<LSS::Matrix> mat=sys->matrix();
+
+  if (!mat->supports_concurrent_add())
+  {
+    LSS::BlockAccumulator ba;
+    ba.resize(1,neq);
+    BOOST_CHECK_THROW(mat->add_values_concurrent(ba), common::NotImplemented);
+    return;
+  }
+
+  if (irank==1)
+  {
+    const int nb_threads=4;
+    const int nb_adds=25;
+
+    LSS::BlockAccumulator ba;
+    ba.resize(3,neq);
+    ba.mat << 53., 54., 51., 52., 55., 56.,
+              59., 60., 57., 58., 61., 62.,
+              23., 24., 21., 22., 25., 26.,
+              29., 30., 27., 28., 31., 32.,
+              83., 84., 81., 82., 85., 86.,
+              89., 90., 87., 88., 91., 92.;
+    ba.indices[0]=5;
+    ba.indices[1]=2;
+    ba.indices[2]=8;
+
+    // reference, serial
+    std::vector<Uint> ref_rows, ref_cols;
+    std::vector<Real> ref_vals;
+    mat->reset();
+    for (int i=0; i<nb_threads*nb_adds; i++)
+      mat->add_values(ba);
+    mat->debug_data(ref_rows,ref_cols,ref_vals);
+
+    // all threads hit the same entries, so the additions must be atomic
+    std::vector<Uint> rows, cols;
+    std::vector<Real> vals;
+    mat->reset();
+    boost::thread_group threads;
+    for (int i=0; i<nb_threads; i++)
+      threads.create_thread(boost::bind(&add_block_concurrent, boost::ref(*mat), boost::cref(ba), nb_adds));
+    threads.join_all();
+    mat->debug_data(rows,cols,vals);
+
+    BOOST_CHECK_EQUAL(vals.size(),ref_vals.size());
+    for (int i=0; i<(const int)vals.size(); i++)
+    {
+      BOOST_CHECK_EQUAL(rows[i],ref_rows[i]);
+      BOOST_CHECK_EQUAL(cols[i],ref_cols[i]);
+      BOOST_CHECK_EQUAL(vals[i],ref_vals[i]);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_CASE( test_matrix_cached_add )
+{
+  boost::shared_ptr<common::PE::CommPattern> cp_ptr = common::allocate_component<common::PE::CommPattern>("commpattern");
+  common::PE::CommPattern& cp = *cp_ptr;
+  build_commpattern(cp);
+  boost::shared_ptr<LSS::System> sys(common::allocate_component<LSS::System>("sys"));
+  sys->options().option("matrix_builder").change_value(matrix_builder);
+  build_system(*sys,cp);
+  Handle<LSS::Matrix> mat=sys->matrix();
+
+  if (irank==1)
+  {
+    LSS::BlockAccumulator ba;
+    ba.resize(3,neq);
+    ba.mat << 53., 54., 51., 52., 55., 56.,
+              59., 60., 57., 58., 61., 62.,
+              23., 24., 21., 22., 25., 26.,
+              29., 30., 27., 28., 31., 32.,
+              83., 84., 81., 82., 85., 86.,
+              89., 90., 87., 88., 91., 92.;
+    ba.indices[0]=5;
+    ba.indices[1]=2;
+    ba.indices[2]=8;
+
+    // reference
+    std::vector<Uint> ref_rows, ref_cols;
+    std::vector<Real> ref_vals;
+    mat->reset();
+    mat->add_values(ba);
+    mat->add_values(ba);
+    mat->debug_data(ref_rows,ref_cols,ref_vals);
+
+    // first call computes the offsets, second call uses them
+    std::vector<int>& offsets = mat->cached_offsets("test", 1)[0];
+    BOOST_CHECK(offsets.empty());
+    mat->reset();
+    mat->add_values_cached(ba, offsets);
+    mat->add_values_cached(ba, offsets);
+
+    std::vector<Uint> rows, cols;
+    std::vector<Real> vals;
+    mat->debug_data(rows,cols,vals);
+
+    BOOST_CHECK_EQUAL(vals.size(),ref_vals.size());
+    for (int i=0; i<(const int)vals.size(); i++)
+    {
+      BOOST_CHECK_EQUAL(rows[i],ref_rows[i]);
+      BOOST_CHECK_EQUAL(cols[i],ref_cols[i]);
+      BOOST_CHECK_EQUAL(vals[i],ref_vals[i]);
+    }
+  }
+
+  // recreating the matrix invalidates the cache
+  build_system(*sys,cp);
+  BOOST_CHECK(sys->matrix()->cached_offsets("test", 1)[0].empty());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 BOOST_AUTO_TEST_CASE( test_vector_only )
 {
   // build a commpattern and the two vectors
@@ -0,0 +1,225 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+//
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Test module for cf3::math::LSS::TrilinosMatrixFree"
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <boost/test/unit_test.hpp>
+#include <boost/assign/std/vector.hpp>
+
+#include "common/Action.hpp"
+#include "common/Core.hpp"
+#include "common/Environment.hpp"
+#include "common/Log.hpp"
+#include "common/PE/Comm.hpp"
+#include "common/PE/CommPattern.hpp"
+#include "common/PE/CommWrapper.hpp"
+
+#include "math/LSS/System.hpp"
+#include "math/LSS/Trilinos/TrilinosMatrixFree.hpp"
+#include "math/LSS/Trilinos/TrilinosVector.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+using namespace boost::assign;
+
+using namespace cf3;
+using namespace cf3::math;
+using namespace cf3::math::LSS;
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Assembles a 1D chain of line elements, with an element matrix that depends on the global element index
+class ChainAssembly : public common::Action
+{
+public:
+  ChainAssembly(const std::string& name) : common::Action(name)
+  {
+  }
+
+  static std::string type_name() { return "ChainAssembly"; }
+
+  void execute()
+  {
+    LSS::BlockAccumulator ba;
+    ba.resize(2,1);
+    for (Uint e=0; e<2; e++)
+    {
+      const Real k = 1.+gid[e];
+      ba.indices[0]=e;
+      ba.indices[1]=e+1;
+      ba.mat << 2.*k, -k,
+                -k, 3.*k;
+      ba.rhs << 1., 1.;
+      system->matrix()->add_values(ba);
+      system->rhs()->add_rhs_values(ba);
+    }
+  }
+
+  Handle<LSS::System> system;
+  std::vector<Uint> gid;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct LSSMatrixFreeFixture
+{
+  /// common setup for each test case
+  LSSMatrixFreeFixture() :
+    irank(0),
+    nproc(1),
+    neq(1)
+  {
+    m_argc = boost::unit_test::framework::master_test_suite().argc;
+    m_argv = boost::unit_test::framework::master_test_suite().argv;
+    if (common::PE::Comm::instance().is_initialized())
+    {
+      nproc=common::PE::Comm::instance().size();
+      irank=common::PE::Comm::instance().rank();
+      BOOST_CHECK_EQUAL(nproc,2);
+    }
+  }
+
+  /// create a test commpattern
+  void build_commpattern(common::PE::CommPattern& cp)
+  {
+    gid.clear();
+    rank_updatable.clear();
+    if (irank==0)
+    {
+      gid += 0,1,2;
+      rank_updatable += 0,0,1;
+    } else {
+      gid += 1,2,3;
+      rank_updatable += 0,1,1;
+    }
+    cp.insert("gid",gid,1,false);
+    cp.setup(Handle<common::PE::CommWrapper>(cp.get_child("gid")),rank_updatable);
+  }
+
+  /// build a test system
+  boost::shared_ptr<LSS::System> build_system(const std::string& matrix_builder, common::PE::CommPattern& cp)
+  {
+    std::vector<Uint> node_connectivity, starting_indices;
+    node_connectivity += 0,1,0,1,2,1,2;
+    starting_indices += 0,2,5,7;
+    boost::shared_ptr<LSS::System> sys(common::allocate_component<LSS::System>("sys"));
+    sys->options().option("matrix_builder").change_value(matrix_builder);
+    sys->create(cp,neq,node_connectivity,starting_indices);
+    return sys;
+  }
+
+  /// constructor builds
+  int irank;
+  int nproc;
+  int neq;
+  int m_argc;
+  char** m_argv;
+
+  /// commpattern builds
+  std::vector<Uint> gid;
+  std::vector<Uint> rank_updatable;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_FIXTURE_TEST_SUITE( LSSMatrixFreeSuite, LSSMatrixFreeFixture )
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_CASE( init_mpi )
+{
+  common::PE::Comm::instance().init(m_argc,m_argv);
+  BOOST_CHECK_EQUAL(common::PE::Comm::instance().is_active(),true);
+  common::Core::instance().environment().options().set("log_level", 4u);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_CASE( compare_to_assembled )
+{
+  boost::shared_ptr<common::PE::CommPattern> cp_ptr = common::allocate_component<common::PE::CommPattern>("commpattern");
+  common::PE::CommPattern& cp = *cp_ptr;
+  build_commpattern(cp);
+
+  boost::shared_ptr<ChainAssembly> assembly = common::allocate_component<ChainAssembly>("assembly");
+  assembly->gid = gid;
+
+  // assembled reference
+  boost::shared_ptr<LSS::System> crs_sys = build_system("cf3.math.LSS.TrilinosCrsMatrix", cp);
+  crs_sys->reset();
+  assembly->system = crs_sys->handle<LSS::System>();
+  assembly->execute();
+
+  // matrix-free, executing the same assembly
+  boost::shared_ptr<LSS::System> free_sys = build_system("cf3.math.LSS.TrilinosMatrixFree", cp);
+  free_sys->reset();
+  assembly->system = free_sys->handle<LSS::System>();
+  assembly->execute();
+  free_sys->matrix()->options().set("action", assembly->handle<common::Action>());
+
+  // a dirichlet row on each rank
+  crs_sys->matrix()->set_row(irank == 0 ? 0 : 2, 0, 1., 0.);
+  free_sys->matrix()->set_row(irank == 0 ? 0 : 2, 0, 1., 0.);
+
+  boost::shared_ptr<TrilinosVector> x = common::allocate_component<TrilinosVector>("x");
+  boost::shared_ptr<TrilinosVector> y_crs = common::allocate_component<TrilinosVector>("y_crs");
+  boost::shared_ptr<TrilinosVector> y_free = common::allocate_component<TrilinosVector>("y_free");
+  x->create(cp, neq);
+  y_crs->create(cp, neq);
+  y_free->create(cp, neq);
+  for (Uint i=0; i<3; i++)
+    x->set_value(i, 1.+gid[i]*gid[i]);
+
+  crs_sys->matrix()->apply(y_crs->handle<LSS::Vector>(), x->handle<LSS::Vector const>());
+  free_sys->matrix()->apply(y_free->handle<LSS::Vector>(), x->handle<LSS::Vector const>());
+
+  for (Uint i=0; i<3; i++)
+  {
+    if (rank_updatable[i] != irank)
+      continue;
+    Real crs_val, free_val;
+    y_crs->get_value(i, crs_val);
+    y_free->get_value(i, free_val);
+    BOOST_CHECK_CLOSE(crs_val, free_val, 1e-12);
+  }
+
+  // the RHS assembled by the action during the apply was discarded
+  for (Uint i=0; i<3; i++)
+  {
+    if (rank_updatable[i] != irank)
+      continue;
+    Real crs_val, free_val;
+    crs_sys->rhs()->get_value(i, crs_val);
+    free_sys->rhs()->get_value(i, free_val);
+    BOOST_CHECK_EQUAL(crs_val, free_val);
+  }
+
+  // the diagonal is obtained from the assembly as well
+  std::vector<Real> crs_diag, free_diag;
+  crs_sys->matrix()->get_diagonal(crs_diag);
+  free_sys->matrix()->get_diagonal(free_diag);
+  BOOST_CHECK_EQUAL(crs_diag.size(), free_diag.size());
+  for (Uint i=0; i<crs_diag.size(); i++)
+    BOOST_CHECK_EQUAL(crs_diag[i], free_diag[i]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_CASE( finalize_mpi )
+{
+  common::PE::Comm::instance().finalize();
+  BOOST_CHECK_EQUAL(common::PE::Comm::instance().is_active(),false);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_SUITE_END()
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,99 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Tests mesh::actions::HilbertPartitioner"
+
+#include <boost/test/unit_test.hpp>
+
+#include "common/Core.hpp"
+#include "common/Foreach.hpp"
+#include "common/OptionList.hpp"
+#include "common/PE/Comm.hpp"
+
+#include "mesh/actions/HilbertPartitioner.hpp"
+
+#include "mesh/Entities.hpp"
+#include "mesh/Mesh.hpp"
+#include "mesh/SimpleMeshGenerator.hpp"
+
+using namespace cf3;
+using namespace cf3::common;
+using namespace cf3::mesh;
+using namespace cf3::mesh::actions;
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Number the mesh globally and partition it, as LoadBalance does
+void partition(Mesh& mesh, MeshTransformer& partitioner)
+{
+  build_component_abstract_type<MeshTransformer>("cf3.mesh.actions.GlobalNumbering","glb_numbering")->transform(mesh);
+  build_component_abstract_type<MeshTransformer>("cf3.mesh.actions.GlobalConnectivity","glb_connectivity")->transform(mesh);
+  partitioner.transform(mesh);
+}
+
+/// Check that the elements are not lost and that every processor got the same number, up to one element
+void check_balance(const Mesh& mesh, const Uint nb_elements)
+{
+  Uint local_nb_elements = 0;
+  boost_foreach(const Handle<Entities>& entities, mesh.elements())
+    local_nb_elements += entities->size();
+
+  std::vector<Uint> nb_elements_per_rank;
+  PE::Comm::instance().all_gather(local_nb_elements, nb_elements_per_rank);
+  Uint total = 0;
+  boost_foreach(const Uint n, nb_elements_per_rank)
+  {
+    total += n;
+    BOOST_CHECK_LE(n, nb_elements / nb_elements_per_rank.size() + 1);
+    BOOST_CHECK_GE(n, nb_elements / nb_elements_per_rank.size());
+  }
+  BOOST_CHECK_EQUAL(total, nb_elements);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_SUITE( HilbertPartitionerSuite )
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_CASE( Initiate )
+{
+  Core::instance().initiate(boost::unit_test::framework::master_test_suite().argc, boost::unit_test::framework::master_test_suite().argv);
+  PE::Comm::instance().init(boost::unit_test::framework::master_test_suite().argc, boost::unit_test::framework::master_test_suite().argv);
+}
+
+BOOST_AUTO_TEST_CASE( PartitionSquare )
+{
+  // 24x24 quads with 96 boundary lines, generated in strips by the mesh generator
+  Handle<MeshGenerator> mesh_generator = Core::instance().root().create_component<SimpleMeshGenerator>("generate_square");
+  mesh_generator->options().set("mesh",Core::instance().root().uri()/"mesh");
+  mesh_generator->options().set("lengths",std::vector<Real>(2,1.));
+  mesh_generator->options().set("nb_cells",std::vector<Uint>(2,24));
+  Mesh& mesh = mesh_generator->generate();
+  const Uint nb_elements = 24*24 + 4*24;
+
+  Handle<HilbertPartitioner> partitioner = Core::instance().root().create_component<HilbertPartitioner>("partitioner");
+  partitioner->options().set("weighted", false);
+  partition(mesh, *partitioner);
+  check_balance(mesh, nb_elements);
+
+  // Partitioning again with the same component leaves the mesh balanced
+  partition(mesh, *partitioner);
+  check_balance(mesh, nb_elements);
+}
+
+BOOST_AUTO_TEST_CASE( Terminate )
+{
+  PE::Comm::instance().finalize();
+  Core::instance().terminate();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_SUITE_END()
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,231 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Tests mesh::actions::Renumber in parallel"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "common/Core.hpp"
+#include "common/FindComponents.hpp"
+#include "common/List.hpp"
+#include "common/OptionList.hpp"
+#include "common/PE/Comm.hpp"
+
+#include "mesh/actions/LinkPeriodicNodes.hpp"
+#include "mesh/actions/Renumber.hpp"
+
+#include "mesh/Dictionary.hpp"
+#include "mesh/Field.hpp"
+#include "mesh/Mesh.hpp"
+#include "mesh/Region.hpp"
+#include "mesh/SimpleMeshGenerator.hpp"
+
+using namespace cf3;
+using namespace cf3::common;
+using namespace cf3::mesh;
+using namespace cf3::mesh::actions;
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct RenumberMPIFixture
+{
+  RenumberMPIFixture()
+  {
+    m_argc = boost::unit_test::framework::master_test_suite().argc;
+    m_argv = boost::unit_test::framework::master_test_suite().argv;
+  }
+
+  /// Value of the test fields for the given global index
+  static Real value(const Uint gid)
+  {
+    return 0.5 + static_cast<Real>(gid);
+  }
+
+  /// Set the owned rows of the field to the value of their global index, and the ghost rows to -1
+  static void set_owned(Field& field)
+  {
+    const Dictionary& dict = field.dict();
+    for(Uint i = 0; i != dict.size(); ++i)
+      field[i][0] = dict.is_ghost(i) ? -1. : value(dict.glb_idx()[i]);
+  }
+
+  /// Synchronize the field, and check that all rows, including the ghosts, have the value of their global index
+  static void check_synchronized(Field& field)
+  {
+    field.synchronize();
+    const Dictionary& dict = field.dict();
+    for(Uint i = 0; i != dict.size(); ++i)
+      BOOST_CHECK_EQUAL(field[i][0], value(dict.glb_idx()[i]));
+  }
+
+  /// Number of ghost rows of the dictionary
+  static Uint nb_ghosts(const Dictionary& dict)
+  {
+    Uint result = 0;
+    for(Uint i = 0; i != dict.size(); ++i)
+    {
+      if(dict.is_ghost(i))
+        ++result;
+    }
+    return result;
+  }
+
+  /// Check that the owned rows precede the ghost rows, and that the global indices did not change
+  static void check_dictionary(const Dictionary& dict, const std::vector<Uint>& sorted_glb_idx)
+  {
+    Uint nb_owned = 0;
+    while(nb_owned != dict.size() && !dict.is_ghost(nb_owned))
+      ++nb_owned;
+    for(Uint i = nb_owned; i != dict.size(); ++i)
+      BOOST_CHECK(dict.is_ghost(i));
+
+    std::vector<Uint> glb_idx(dict.glb_idx().array().begin(), dict.glb_idx().array().end());
+    std::sort(glb_idx.begin(), glb_idx.end());
+    BOOST_CHECK(glb_idx == sorted_glb_idx);
+  }
+
+  /// Check that every node of the right boundary is linked to the node of the left boundary at the same height
+  static void check_periodic_links(const Mesh& mesh)
+  {
+    const Dictionary& nodes = mesh.geometry_fields();
+    const Field& coords = nodes.coordinates();
+    const List<Uint>& links = *Handle< List<Uint> const >(nodes.get_child("periodic_links_nodes"));
+    const List<bool>& active = *Handle< List<bool> const >(nodes.get_child("periodic_links_active"));
+    BOOST_REQUIRE_EQUAL(links.size(), nodes.size());
+    BOOST_REQUIRE_EQUAL(active.size(), nodes.size());
+
+    Uint nb_links = 0;
+    for(Uint i = 0; i != nodes.size(); ++i)
+    {
+      const bool on_right = std::abs(coords[i][XX] - 1.) < 1e-10;
+      BOOST_CHECK_EQUAL(static_cast<bool>(active[i]), on_right);
+      if(!active[i])
+        continue;
+      ++nb_links;
+      BOOST_CHECK_SMALL(coords[links[i]][XX], 1e-10);
+      BOOST_CHECK_SMALL(coords[links[i]][YY] - coords[i][YY], 1e-10);
+    }
+    BOOST_CHECK(nb_links != 0);
+  }
+
+  int m_argc;
+  char** m_argv;
+
+  static Handle<Mesh> mesh;
+  static std::vector<Uint> sorted_node_glb_idx;
+  static std::vector<Uint> sorted_p2_glb_idx;
+};
+
+Handle<Mesh> RenumberMPIFixture::mesh;
+std::vector<Uint> RenumberMPIFixture::sorted_node_glb_idx;
+std::vector<Uint> RenumberMPIFixture::sorted_p2_glb_idx;
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_FIXTURE_TEST_SUITE( RenumberMPISuite, RenumberMPIFixture )
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_CASE( Init )
+{
+  Core::instance().initiate(m_argc,m_argv);
+  PE::Comm::instance().init(m_argc,m_argv);
+  BOOST_CHECK(PE::Comm::instance().size() > 1);
+}
+
+// Partitioned mesh with ghost nodes, a P2 dictionary with ghost rows of its own and periodic links between left and right
+BOOST_AUTO_TEST_CASE( CreateMesh )
+{
+  Handle<SimpleMeshGenerator> generator = Core::instance().root().create_component<SimpleMeshGenerator>("generator");
+  generator->options().set("mesh", Core::instance().root().uri()/"mesh");
+  std::vector<Uint> nb_cells(2);
+  nb_cells[XX] = 12;
+  nb_cells[YY] = 16;
+  generator->options().set("nb_cells", nb_cells);
+  generator->options().set("lengths", std::vector<Real>(2, 1.));
+  mesh = generator->generate().handle<Mesh>();
+
+  Dictionary& nodes = mesh->geometry_fields();
+  Dictionary& p2 = mesh->create_continuous_space("P2", "cf3.mesh.LagrangeP2");
+
+  Handle<LinkPeriodicNodes> link = Core::instance().root().create_component<LinkPeriodicNodes>("link");
+  link->options().set("mesh", mesh);
+  link->options().set("source_region", Handle<Region>(mesh->topology().get_child("right")));
+  link->options().set("destination_region", Handle<Region>(mesh->topology().get_child("left")));
+  std::vector<Real> translation(2, 0.);
+  translation[XX] = -1.;
+  link->options().set("translation_vector", translation);
+  link->execute();
+  check_periodic_links(*mesh);
+
+  sorted_node_glb_idx.assign(nodes.glb_idx().array().begin(), nodes.glb_idx().array().end());
+  std::sort(sorted_node_glb_idx.begin(), sorted_node_glb_idx.end());
+  sorted_p2_glb_idx.assign(p2.glb_idx().array().begin(), p2.glb_idx().array().end());
+  std::sort(sorted_p2_glb_idx.begin(), sorted_p2_glb_idx.end());
+
+  // Both dictionaries have ghosts, and the fields use the comm patterns before renumbering
+  BOOST_CHECK(nb_ghosts(nodes) != 0);
+  BOOST_CHECK(nb_ghosts(p2) != 0);
+  Field& u = nodes.create_field("u");
+  Field& v = p2.create_field("v");
+  set_owned(u);
+  set_owned(v);
+  check_synchronized(u);
+  check_synchronized(v);
+}
+
+BOOST_AUTO_TEST_CASE( RenumberRCM )
+{
+  Handle<Renumber> renumber = Core::instance().root().create_component<Renumber>("renumber_rcm");
+  renumber->options().set("ordering", std::string("rcm"));
+  renumber->transform(*mesh);
+
+  Field& u = *Handle<Field>(mesh->geometry_fields().get_child("u"));
+  Field& v = *Handle<Field>(mesh->get_child("P2")->get_child("v"));
+  check_dictionary(u.dict(), sorted_node_glb_idx);
+  check_dictionary(v.dict(), sorted_p2_glb_idx);
+  check_periodic_links(*mesh);
+
+  // The comm patterns are rebuilt for the new numbering
+  set_owned(u);
+  set_owned(v);
+  check_synchronized(u);
+  check_synchronized(v);
+}
+
+BOOST_AUTO_TEST_CASE( RenumberHilbert )
+{
+  Handle<Renumber> renumber = Core::instance().root().create_component<Renumber>("renumber_hilbert");
+  renumber->options().set("ordering", std::string("hilbert"));
+  renumber->transform(*mesh);
+
+  Field& u = *Handle<Field>(mesh->geometry_fields().get_child("u"));
+  Field& v = *Handle<Field>(mesh->get_child("P2")->get_child("v"));
+  check_dictionary(u.dict(), sorted_node_glb_idx);
+  check_dictionary(v.dict(), sorted_p2_glb_idx);
+  check_periodic_links(*mesh);
+
+  set_owned(u);
+  set_owned(v);
+  check_synchronized(u);
+  check_synchronized(v);
+}
+
+BOOST_AUTO_TEST_CASE( Terminate )
+{
+  PE::Comm::instance().finalize();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_SUITE_END()
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,257 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Tests mesh::actions::Renumber"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <boost/test/unit_test.hpp>
+
+#include "common/Core.hpp"
+#include "common/CompressedTable.hpp"
+#include "common/FindComponents.hpp"
+#include "common/OptionList.hpp"
+#include "common/Log.hpp"
+
+#include "mesh/actions/Renumber.hpp"
+
+#include "mesh/Cells.hpp"
+#include "mesh/Connectivity.hpp"
+#include "mesh/Dictionary.hpp"
+#include "mesh/Field.hpp"
+#include "mesh/Mesh.hpp"
+#include "mesh/Space.hpp"
+
+#include "Tools/MeshGeneration/MeshGeneration.hpp"
+#include "Tools/Testing/TimedTestFixture.hpp"
+
+using namespace cf3;
+using namespace cf3::common;
+using namespace cf3::mesh;
+using namespace cf3::mesh::actions;
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Element loop scattering a quarter of the area of each quad to its nodes, as in the assembly of a lumped mass matrix
+Real assemble_lumped_area(const Mesh& mesh, Field& lumped_area)
+{
+  const Cells& cells = find_component_recursively<Cells>(mesh.topology());
+  const Connectivity& connectivity = cells.geometry_space().connectivity();
+  const Field& coords = mesh.geometry_fields().coordinates();
+
+  for (Uint n=0; n<lumped_area.size(); ++n)
+    lumped_area[n][0] = 0.;
+
+  Real total_area = 0.;
+  for (Uint e=0; e<connectivity.size(); ++e)
+  {
+    Connectivity::ConstRow row = connectivity[e];
+    Real area = 0.;
+    for (Uint i=0; i<4; ++i)
+    {
+      const Field::ConstRow a = coords[row[i]];
+      const Field::ConstRow b = coords[row[(i+1)%4]];
+      area += 0.5 * (a[XX]*b[YY] - b[XX]*a[YY]);
+    }
+    for (Uint i=0; i<4; ++i)
+      lumped_area[row[i]][0] += 0.25*area;
+    total_area += area;
+  }
+  return total_area;
+}
+
+/// Graph Laplacian product over the quad edges, with the memory access pattern of a sparse matrix-vector product
+Real edge_laplacian(const CompressedTable<Uint>& graph, const Field& x, std::vector<Real>& y)
+{
+  Real sum = 0.;
+  for (Uint n=0; n<graph.size(); ++n)
+  {
+    y[n] = 0.;
+    boost_foreach(const Uint m, graph[n])
+      y[n] += x[n][0] - x[m][0];
+    sum += y[n];
+  }
+  return sum;
+}
+
+/// Node graph along the edges of the quads
+void build_edge_graph(const Mesh& mesh, CompressedTable<Uint>& graph)
+{
+  const Connectivity& connectivity = find_component_recursively<Cells>(mesh.topology()).geometry_space().connectivity();
+  CompressedTableBuilder<Uint> builder(graph, mesh.geometry_fields().size());
+  for (Uint e=0; e<connectivity.size(); ++e)
+  {
+    for (Uint i=0; i<4; ++i)
+    {
+      builder.count(connectivity[e][i]);
+      builder.count(connectivity[e][(i+1)%4]);
+    }
+  }
+  builder.allocate();
+  for (Uint e=0; e<connectivity.size(); ++e)
+  {
+    for (Uint i=0; i<4; ++i)
+    {
+      builder.add(connectivity[e][i], connectivity[e][(i+1)%4]);
+      builder.add(connectivity[e][(i+1)%4], connectivity[e][i]);
+    }
+  }
+}
+
+/// Check that fields, connectivities and global indices were permuted consistently
+void check_mesh(const Mesh& mesh, const std::vector<Uint>& sorted_node_glb_idx)
+{
+  const Dictionary& nodes = mesh.geometry_fields();
+  const Field& coords = nodes.coordinates();
+  const Field& u = *Handle<Field const>(nodes.get_child("u"));
+  for (Uint n=0; n<nodes.size(); ++n)
+    BOOST_CHECK_CLOSE(u[n][0], 1. + coords[n][XX] + 2.*coords[n][YY], 1e-10);
+
+  std::vector<Uint> node_glb_idx(nodes.glb_idx().array().begin(), nodes.glb_idx().array().end());
+  std::sort(node_glb_idx.begin(), node_glb_idx.end());
+  BOOST_CHECK(node_glb_idx == sorted_node_glb_idx);
+
+  // The element field was set to the element centroid
+  const Cells& cells = find_component_recursively<Cells>(mesh.topology());
+  const Dictionary& elems_dict = *Handle<Dictionary const>(mesh.get_child("elems_P0"));
+  const Field& centroid_x = *Handle<Field const>(elems_dict.get_child("centroid_x"));
+  const Connectivity& connectivity = cells.geometry_space().connectivity();
+  const Connectivity& field_connectivity = cells.space(elems_dict).connectivity();
+  for (Uint e=0; e<cells.size(); ++e)
+  {
+    Real x = 0.;
+    for (Uint i=0; i<4; ++i)
+      x += 0.25*coords[connectivity[e][i]][XX];
+    BOOST_CHECK_CLOSE(centroid_x[field_connectivity[e][0]][0], x, 1e-10);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct RenumberFixture : Tools::Testing::TimedTestFixture
+{
+  void run_benchmark()
+  {
+    Field& lumped_area = *Handle<Field>(mesh->geometry_fields().get_child("lumped_area"));
+    Field& u = *Handle<Field>(mesh->geometry_fields().get_child("u"));
+    boost::shared_ptr< CompressedTable<Uint> > graph = allocate_component< CompressedTable<Uint> >("graph");
+    build_edge_graph(*mesh, *graph);
+    std::vector<Real> y(u.size());
+    restart_timer();
+
+    for (Uint i=0; i<10; ++i)
+    {
+      BOOST_CHECK_CLOSE(assemble_lumped_area(*mesh, lumped_area), 1., 1e-8);
+      BOOST_CHECK_SMALL(edge_laplacian(*graph, u, y), 1e-6);
+    }
+  }
+
+  static Handle<Mesh> mesh;
+  static std::vector<Uint> sorted_node_glb_idx;
+};
+
+Handle<Mesh> RenumberFixture::mesh;
+std::vector<Uint> RenumberFixture::sorted_node_glb_idx;
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_SUITE( RenumberSuite )
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_CASE( Init )
+{
+  Core::instance().initiate(boost::unit_test::framework::master_test_suite().argc, boost::unit_test::framework::master_test_suite().argv);
+}
+
+// Creates a mesh in random order, as a reader could produce it
+BOOST_FIXTURE_TEST_CASE( CreateMesh, RenumberFixture )
+{
+  mesh = Core::instance().root().create_component<Mesh>("mesh");
+  Tools::MeshGeneration::create_rectangle(*mesh, 1., 1., 400, 400);
+
+  Dictionary& nodes = mesh->geometry_fields();
+  nodes.create_field("lumped_area");
+  Field& u = nodes.create_field("u");
+  for (Uint n=0; n<nodes.size(); ++n)
+    u[n][0] = 1. + nodes.coordinates()[n][XX] + 2.*nodes.coordinates()[n][YY];
+
+  Dictionary& elems_dict = mesh->create_discontinuous_space("elems_P0","cf3.mesh.LagrangeP0");
+  Field& centroid_x = elems_dict.create_field("centroid_x");
+  Cells& cells = find_component_recursively<Cells>(mesh->topology());
+  const Connectivity& connectivity = cells.geometry_space().connectivity();
+  const Connectivity& field_connectivity = cells.space(elems_dict).connectivity();
+  for (Uint e=0; e<cells.size(); ++e)
+  {
+    Real x = 0.;
+    for (Uint i=0; i<4; ++i)
+      x += 0.25*nodes.coordinates()[connectivity[e][i]][XX];
+    centroid_x[field_connectivity[e][0]][0] = x;
+  }
+
+  sorted_node_glb_idx.assign(nodes.glb_idx().array().begin(), nodes.glb_idx().array().end());
+  std::sort(sorted_node_glb_idx.begin(), sorted_node_glb_idx.end());
+
+  Handle<Renumber> renumber = Core::instance().root().create_component<Renumber>("shuffle");
+  std::srand(42);
+  std::vector<Uint> node_perm(nodes.size());
+  for (Uint i=0; i<node_perm.size(); ++i)
+    node_perm[i] = i;
+  std::random_shuffle(node_perm.begin(), node_perm.end());
+  renumber->permute_nodes(nodes, node_perm);
+  std::vector<Uint> elem_perm(cells.size());
+  for (Uint i=0; i<elem_perm.size(); ++i)
+    elem_perm[i] = i;
+  std::random_shuffle(elem_perm.begin(), elem_perm.end());
+  renumber->permute_elements(cells, elem_perm);
+  mesh->raise_mesh_changed();
+
+  check_mesh(*mesh, sorted_node_glb_idx);
+}
+
+BOOST_FIXTURE_TEST_CASE( BenchmarkShuffled, RenumberFixture )
+{
+  run_benchmark();
+}
+
+BOOST_FIXTURE_TEST_CASE( RenumberRCM, RenumberFixture )
+{
+  Handle<Renumber> renumber = Core::instance().root().create_component<Renumber>("renumber_rcm");
+  renumber->options().set("ordering", std::string("rcm"));
+  renumber->transform(*mesh);
+  check_mesh(*mesh, sorted_node_glb_idx);
+}
+
+BOOST_FIXTURE_TEST_CASE( BenchmarkRCM, RenumberFixture )
+{
+  run_benchmark();
+}
+
+BOOST_FIXTURE_TEST_CASE( RenumberHilbert, RenumberFixture )
+{
+  Handle<Renumber> renumber = Core::instance().root().create_component<Renumber>("renumber_hilbert");
+  renumber->options().set("ordering", std::string("hilbert"));
+  renumber->transform(*mesh);
+  check_mesh(*mesh, sorted_node_glb_idx);
+}
+
+BOOST_FIXTURE_TEST_CASE( BenchmarkHilbert, RenumberFixture )
+{
+  run_benchmark();
+}
+
+BOOST_AUTO_TEST_CASE( Terminate )
+{
+  Core::instance().terminate();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_SUITE_END()
+
+////////////////////////////////////////////////////////////////////////////////
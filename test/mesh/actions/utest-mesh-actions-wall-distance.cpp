@@ -0,0 +1,292 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Tests mesh::actions::WallDistance"
+
+#include <cmath>
+#include <limits>
+
+#include <boost/test/unit_test.hpp>
+
+#include "common/Core.hpp"
+#include "common/FindComponents.hpp"
+#include "common/Foreach.hpp"
+#include "common/OptionList.hpp"
+#include "common/PE/Comm.hpp"
+
+#include "math/Consts.hpp"
+#include "math/MatrixTypes.hpp"
+
+#include "mesh/actions/WallDistance.hpp"
+
+#include "mesh/Connectivity.hpp"
+#include "mesh/Dictionary.hpp"
+#include "mesh/Faces.hpp"
+#include "mesh/Field.hpp"
+#include "mesh/Mesh.hpp"
+#include "mesh/Region.hpp"
+#include "mesh/SimpleMeshGenerator.hpp"
+#include "mesh/Space.hpp"
+
+using namespace cf3;
+using namespace cf3::common;
+using namespace cf3::mesh;
+using namespace cf3::mesh::actions;
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+/// Distance from p to the segment ab, by projection on the line through a and b
+Real segment_distance(const RealVector3& p, const RealVector3& a, const RealVector3& b)
+{
+  const RealVector3 ab = b - a;
+  const Real t = ab.squaredNorm() > 0. ? std::max(0., std::min(1., (p - a).dot(ab) / ab.squaredNorm())) : 0.;
+  return (p - a - t*ab).norm();
+}
+
+/// Distance from p to the triangle abc: the distance to the plane if the projection falls inside the triangle,
+/// the distance to the closest edge otherwise
+Real triangle_distance(const RealVector3& p, const RealVector3& a, const RealVector3& b, const RealVector3& c)
+{
+  const RealVector3 ab = b - a;
+  const RealVector3 ac = c - a;
+  const RealVector3 normal = ab.cross(ac).normalized();
+  const RealVector3 projected = p - (p - a).dot(normal) * normal;
+
+  // Barycentric coordinates of the projection
+  RealMatrix2 gram;
+  gram << ab.dot(ab), ab.dot(ac),
+          ab.dot(ac), ac.dot(ac);
+  const RealVector2 rhs((projected - a).dot(ab), (projected - a).dot(ac));
+  const RealVector2 uv = gram.inverse() * rhs;
+  if(uv[0] >= 0. && uv[1] >= 0. && uv[0] + uv[1] <= 1.)
+    return std::abs((p - a).dot(normal));
+
+  return std::min(segment_distance(p, a, b), std::min(segment_distance(p, b, c), segment_distance(p, a, c)));
+}
+
+/// Coordinates of a node, padded to 3D
+RealVector3 node_coordinates(const Field& coords, const Uint node)
+{
+  RealVector3 result(0., 0., 0.);
+  for(Uint d = 0; d != coords.row_size(); ++d)
+    result[d] = coords[node][d];
+  return result;
+}
+
+}
+
+struct WallDistanceFixture
+{
+  WallDistanceFixture()
+  {
+    m_argc = boost::unit_test::framework::master_test_suite().argc;
+    m_argv = boost::unit_test::framework::master_test_suite().argv;
+  }
+
+  /// Generate a mesh, with the coordinates deformed by a smooth function so the wall faces are not aligned with the axes
+  Mesh& generate(const std::string& name, const std::vector<Uint>& nb_cells)
+  {
+    Handle<SimpleMeshGenerator> generator = Core::instance().root().create_component<SimpleMeshGenerator>(name + "Generator");
+    generator->options().set("mesh", Core::instance().root().uri()/name);
+    generator->options().set("nb_cells", nb_cells);
+    generator->options().set("lengths", std::vector<Real>(nb_cells.size(), 1.));
+    Mesh& mesh = generator->generate();
+
+    Field& coords = mesh.geometry_fields().coordinates();
+    const Real pi = math::Consts::pi();
+    for(Uint i = 0; i != coords.size(); ++i)
+    {
+      Field::Row x = coords[i];
+      if(coords.row_size() == 2)
+      {
+        const Real x0 = x[XX];
+        x[XX] += 0.05*std::sin(3.*x[YY]);
+        x[YY] += 0.1*std::sin(2.*pi*x0)*(1. - x[YY]);
+      }
+      else
+      {
+        x[XX] += 0.1*std::sin(2.*pi*x[YY])*std::cos(pi*x[ZZ])*(1. - x[XX]);
+      }
+    }
+
+    return mesh;
+  }
+
+  /// Run WallDistance on the given regions and return the distance field
+  const Field& compute(Mesh& mesh, const std::vector< Handle<Region> >& regions, const Uint nb_threads)
+  {
+    Handle<WallDistance> wall_distance = Core::instance().root().create_component<WallDistance>(mesh.name() + "WallDistance");
+    wall_distance->options().set("mesh", mesh.handle<Mesh>());
+    wall_distance->options().set("regions", regions);
+    wall_distance->options().set("threads", nb_threads);
+    wall_distance->execute();
+    return mesh.geometry_fields().field("WallDistance");
+  }
+
+  /// Distances from each node to the wall faces of all processes, by checking every face. Quads are split in the
+  /// same two triangles as in WallDistance, since the faces are not planar.
+  std::vector<Real> brute_force(const Mesh& mesh, const std::vector< Handle<Region> >& regions)
+  {
+    const Field& coords = mesh.geometry_fields().coordinates();
+
+    // Points of the local wall faces, with the number of points per face first
+    std::vector<Real> local_faces;
+    BOOST_FOREACH(const Handle<Region>& region, regions)
+    {
+      BOOST_FOREACH(const Faces& faces, find_components_recursively<Faces>(*region))
+      {
+        const Connectivity& connectivity = faces.geometry_space().connectivity();
+        for(Uint i = 0; i != connectivity.size(); ++i)
+        {
+          local_faces.push_back(connectivity.row_size());
+          BOOST_FOREACH(const Uint node, connectivity[i])
+          {
+            const RealVector3 x = node_coordinates(coords, node);
+            local_faces.insert(local_faces.end(), x.data(), x.data() + 3);
+          }
+        }
+      }
+    }
+
+    std::vector<Real> faces;
+    PE::Comm& comm = PE::Comm::instance();
+    if(comm.is_active())
+    {
+      std::vector< std::vector<Real> > gathered_faces;
+      comm.all_gather(local_faces, gathered_faces);
+      BOOST_FOREACH(const std::vector<Real>& proc_faces, gathered_faces)
+        faces.insert(faces.end(), proc_faces.begin(), proc_faces.end());
+    }
+    else
+    {
+      faces = local_faces;
+    }
+
+    std::vector<Real> result(coords.size(), std::numeric_limits<Real>::max());
+    for(Uint node = 0; node != coords.size(); ++node)
+    {
+      const RealVector3 p = node_coordinates(coords, node);
+      for(Uint i = 0; i != faces.size(); i += 1 + 3*static_cast<Uint>(faces[i]))
+      {
+        const Uint nb_face_nodes = static_cast<Uint>(faces[i]);
+        const RealVector3 a(faces[i+1], faces[i+2], faces[i+3]);
+        const RealVector3 b(faces[i+4], faces[i+5], faces[i+6]);
+        Real distance = 0.;
+        if(nb_face_nodes == 2)
+        {
+          distance = segment_distance(p, a, b);
+        }
+        else
+        {
+          const RealVector3 c(faces[i+7], faces[i+8], faces[i+9]);
+          distance = triangle_distance(p, a, b, c);
+          if(nb_face_nodes == 4)
+          {
+            const RealVector3 d(faces[i+10], faces[i+11], faces[i+12]);
+            distance = std::min(distance, triangle_distance(p, a, c, d));
+          }
+        }
+        result[node] = std::min(result[node], distance);
+      }
+    }
+
+    return result;
+  }
+
+  /// Check the computed distances against the brute force result
+  void check(const Field& distance, const std::vector<Real>& reference)
+  {
+    BOOST_REQUIRE_EQUAL(distance.size(), reference.size());
+    for(Uint i = 0; i != reference.size(); ++i)
+      BOOST_CHECK_SMALL(distance[i][0] - reference[i], 1e-12);
+  }
+
+  int m_argc;
+  char** m_argv;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_FIXTURE_TEST_SUITE( WallDistanceSuite, WallDistanceFixture )
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_CASE( Init )
+{
+  Core::instance().initiate(m_argc,m_argv);
+  PE::Comm::instance().init(m_argc,m_argv);
+}
+
+BOOST_AUTO_TEST_CASE( Segments2D )
+{
+  std::vector<Uint> nb_cells(2);
+  nb_cells[XX] = 20;
+  nb_cells[YY] = 16;
+
+  // The wall consists of two regions, meeting in a corner
+  Mesh& mesh = generate("Mesh2D", nb_cells);
+  std::vector< Handle<Region> > regions;
+  regions.push_back(Handle<Region>(mesh.topology().get_child("bottom")));
+  regions.push_back(Handle<Region>(mesh.topology().get_child("left")));
+
+  const Field& distance = compute(mesh, regions, 1);
+  check(distance, brute_force(mesh, regions));
+
+  // The result does not depend on the number of threads
+  Mesh& threaded_mesh = generate("Mesh2DThreaded", nb_cells);
+  std::vector< Handle<Region> > threaded_regions;
+  threaded_regions.push_back(Handle<Region>(threaded_mesh.topology().get_child("bottom")));
+  threaded_regions.push_back(Handle<Region>(threaded_mesh.topology().get_child("left")));
+  const Field& threaded_distance = compute(threaded_mesh, threaded_regions, 3);
+  BOOST_REQUIRE_EQUAL(threaded_distance.size(), distance.size());
+  for(Uint i = 0; i != distance.size(); ++i)
+    BOOST_CHECK_EQUAL(threaded_distance[i][0], distance[i][0]);
+}
+
+BOOST_AUTO_TEST_CASE( Triangles3D )
+{
+  // The quads of the deformed left wall are not planar, and are split into triangles
+  Mesh& mesh = generate("Mesh3D", std::vector<Uint>(3, 6));
+  std::vector< Handle<Region> > regions;
+  regions.push_back(Handle<Region>(mesh.topology().get_child("left")));
+
+  check(compute(mesh, regions, 2), brute_force(mesh, regions));
+}
+
+BOOST_AUTO_TEST_CASE( WallOnOtherPartition )
+{
+  // The generator partitions the elements in horizontal slabs, so only the last process holds the top wall
+  std::vector<Uint> nb_cells(2);
+  nb_cells[XX] = 10;
+  nb_cells[YY] = 24;
+  Mesh& mesh = generate("MeshPartitioned", nb_cells);
+  std::vector< Handle<Region> > regions;
+  regions.push_back(Handle<Region>(mesh.topology().get_child("top")));
+
+  const PE::Comm& comm = PE::Comm::instance();
+  Uint nb_local_faces = 0;
+  BOOST_FOREACH(const Faces& faces, find_components_recursively<Faces>(*regions.front()))
+    nb_local_faces += faces.size();
+  if(comm.size() > 1)
+    BOOST_CHECK_EQUAL(nb_local_faces == 0, comm.rank() != comm.size() - 1);
+
+  check(compute(mesh, regions, 0), brute_force(mesh, regions));
+}
+
+BOOST_AUTO_TEST_CASE( Terminate )
+{
+  PE::Comm::instance().finalize();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_SUITE_END()
+
+////////////////////////////////////////////////////////////////////////////////
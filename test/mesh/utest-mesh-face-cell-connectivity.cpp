@@ -114,6 +114,38 @@ BOOST_AUTO_TEST_CASE( face_elem_connectivity )
 
 ////////////////////////////////////////////////////////////////////////////////
 
+BOOST_AUTO_TEST_CASE( threaded_matching )
+{
+  Handle<FaceCellConnectivity> serial = m_mesh->create_component<FaceCellConnectivity>("serial_face_cell_connectivity");
+  serial->options().set("threads", 1u);
+  serial->setup( find_component<Region>(*m_mesh) );
+
+  Handle<FaceCellConnectivity> threaded = m_mesh->create_component<FaceCellConnectivity>("threaded_face_cell_connectivity");
+  threaded->options().set("threads", 4u);
+  threaded->setup( find_component<Region>(*m_mesh) );
+
+  // The face numbering must not depend on the number of threads
+  BOOST_CHECK_EQUAL(serial->size(), 40u);
+  BOOST_CHECK_EQUAL(threaded->size(), serial->size());
+  Uint nb_inner_faces = 0;
+  for (Uint f = 0; f != serial->size(); ++f)
+  {
+    BOOST_CHECK_EQUAL(threaded->is_bdry_face()[f], serial->is_bdry_face()[f]);
+    BOOST_CHECK_EQUAL(threaded->face_nodes(f)[0], serial->face_nodes(f)[0]);
+    BOOST_CHECK_EQUAL(threaded->face_number()[f][0], serial->face_number()[f][0]);
+    BOOST_CHECK_EQUAL(threaded->cell_rotation()[f][1], serial->cell_rotation()[f][1]);
+    if (!serial->is_bdry_face()[f])
+    {
+      ++nb_inner_faces;
+      BOOST_CHECK(threaded->connectivity()[f][1] == serial->connectivity()[f][1]);
+      BOOST_CHECK_EQUAL(serial->face_nodes(f).size(), 2u);
+    }
+  }
+  BOOST_CHECK_EQUAL(nb_inner_faces, 24u);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 BOOST_AUTO_TEST_SUITE_END()
 
 ////////////////////////////////////////////////////////////////////////////////
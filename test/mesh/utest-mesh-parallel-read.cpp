@@ -0,0 +1,166 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Test module for the parallel_read option of the gmsh and neu readers"
+
+#include <fstream>
+
+#include <boost/test/unit_test.hpp>
+
+#include "common/BasicExceptions.hpp"
+#include "common/Core.hpp"
+#include "common/FindComponents.hpp"
+#include "common/Foreach.hpp"
+#include "common/List.hpp"
+#include "common/Log.hpp"
+#include "common/OptionList.hpp"
+#include "common/PE/Comm.hpp"
+
+#include "mesh/Connectivity.hpp"
+#include "mesh/Dictionary.hpp"
+#include "mesh/Elements.hpp"
+#include "mesh/Field.hpp"
+#include "mesh/Mesh.hpp"
+#include "mesh/MeshReader.hpp"
+#include "mesh/Region.hpp"
+#include "mesh/Space.hpp"
+
+using namespace cf3;
+using namespace cf3::common;
+using namespace cf3::mesh;
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Read the file with and without the parallel_read option, and check that every processor gets the same part
+void check_parallel_read(const std::string& reader_builder, const URI& file)
+{
+  boost::shared_ptr< MeshReader > reader = build_component_abstract_type<MeshReader>(reader_builder,"reader");
+
+  Handle<Mesh> serial = Core::instance().root().create_component<Mesh>("serial");
+  reader->options().set("parallel_read",false);
+  reader->read_mesh_into(file,*serial);
+
+  Handle<Mesh> parallel = Core::instance().root().create_component<Mesh>("parallel");
+  reader->options().set("parallel_read",true);
+  reader->read_mesh_into(file,*parallel);
+
+  const Dictionary& serial_nodes = serial->geometry_fields();
+  const Dictionary& parallel_nodes = parallel->geometry_fields();
+  BOOST_REQUIRE_EQUAL(parallel_nodes.size(), serial_nodes.size());
+  for (Uint n=0; n<serial_nodes.size(); ++n)
+  {
+    BOOST_CHECK_EQUAL(parallel_nodes.glb_idx()[n], serial_nodes.glb_idx()[n]);
+    BOOST_CHECK_EQUAL(parallel_nodes.rank()[n], serial_nodes.rank()[n]);
+    for (Uint d=0; d<serial_nodes.coordinates().row_size(); ++d)
+      BOOST_CHECK_EQUAL(parallel_nodes.coordinates()[n][d], serial_nodes.coordinates()[n][d]);
+  }
+
+  std::vector< Handle<Elements> > serial_elements, parallel_elements;
+  boost_foreach(Elements& elements, find_components_recursively<Elements>(serial->topology()))
+    serial_elements.push_back(elements.handle<Elements>());
+  boost_foreach(Elements& elements, find_components_recursively<Elements>(parallel->topology()))
+    parallel_elements.push_back(elements.handle<Elements>());
+  BOOST_REQUIRE_EQUAL(parallel_elements.size(), serial_elements.size());
+  for (Uint i=0; i<serial_elements.size(); ++i)
+  {
+    BOOST_CHECK_EQUAL(parallel_elements[i]->parent()->name(), serial_elements[i]->parent()->name());
+    BOOST_CHECK_EQUAL(parallel_elements[i]->name(), serial_elements[i]->name());
+    BOOST_REQUIRE_EQUAL(parallel_elements[i]->size(), serial_elements[i]->size());
+    const Connectivity& serial_connectivity = serial_elements[i]->geometry_space().connectivity();
+    const Connectivity& parallel_connectivity = parallel_elements[i]->geometry_space().connectivity();
+    for (Uint e=0; e<serial_elements[i]->size(); ++e)
+    {
+      BOOST_CHECK_EQUAL(parallel_elements[i]->glb_idx()[e], serial_elements[i]->glb_idx()[e]);
+      for (Uint j=0; j<serial_connectivity.row_size(); ++j)
+        BOOST_CHECK_EQUAL(parallel_connectivity[e][j], serial_connectivity[e][j]);
+    }
+  }
+
+  Core::instance().root().remove_component("serial");
+  Core::instance().root().remove_component("parallel");
+}
+
+/// Copy a mesh file, replacing the line that starts with the given text, on the first processor only
+void write_bad_copy(const std::string& original, const std::string& copy, const std::string& line_start, const std::string& replacement)
+{
+  if (PE::Comm::instance().rank() == 0)
+  {
+    std::ifstream in(original.c_str());
+    std::ofstream out(copy.c_str());
+    bool replaced = false;
+    std::string line;
+    while (std::getline(in, line))
+    {
+      if (!replaced && line.compare(0, line_start.size(), line_start) == 0)
+      {
+        line = replacement;
+        replaced = true;
+      }
+      out << line << "\n";
+    }
+    BOOST_REQUIRE(replaced);
+  }
+  PE::Comm::instance().barrier();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_SUITE( ParallelReadSuite )
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_CASE( init_mpi )
+{
+  Core::instance().initiate(boost::unit_test::framework::master_test_suite().argc,boost::unit_test::framework::master_test_suite().argv);
+  PE::Comm::instance().init(boost::unit_test::framework::master_test_suite().argc,boost::unit_test::framework::master_test_suite().argv);
+}
+
+BOOST_AUTO_TEST_CASE( read_gmsh )
+{
+  check_parallel_read("cf3.mesh.gmsh.Reader", "../../resources/rectangle-mix-p1.msh");
+  check_parallel_read("cf3.mesh.gmsh.Reader", "../../resources/sqduct_3000e.msh");
+}
+
+BOOST_AUTO_TEST_CASE( read_neu )
+{
+  check_parallel_read("cf3.mesh.neu.Reader", "../../resources/quadtriag.neu");
+  // elements of this mesh continue on a second line
+  check_parallel_read("cf3.mesh.neu.Reader", "../../resources/hextet.neu");
+}
+
+// Errors found by a single processor must be thrown on all of them, instead of leaving the others in a collective
+BOOST_AUTO_TEST_CASE( read_neu_errors )
+{
+  // element 8 with an unknown element type
+  write_bad_copy("../../resources/quadtriag.neu", "quadtriag-bad-type.neu", "       8  3  3", "       8 99  3       11      15       8");
+  boost::shared_ptr< MeshReader > type_reader = build_component_abstract_type<MeshReader>("cf3.mesh.neu.Reader","type_reader");
+  type_reader->options().set("parallel_read",true);
+  Handle<Mesh> bad_type = Core::instance().root().create_component<Mesh>("bad_type");
+  BOOST_CHECK_THROW(type_reader->read_mesh_into(URI("quadtriag-bad-type.neu"),*bad_type), NotSupported);
+
+  // element 8 using node 99, which is not in the file
+  write_bad_copy("../../resources/quadtriag.neu", "quadtriag-bad-node.neu", "       8  3  3", "       8  3  3       99      15       8");
+  boost::shared_ptr< MeshReader > node_reader = build_component_abstract_type<MeshReader>("cf3.mesh.neu.Reader","node_reader");
+  node_reader->options().set("parallel_read",true);
+  Handle<Mesh> bad_node = Core::instance().root().create_component<Mesh>("bad_node");
+  BOOST_CHECK_THROW(node_reader->read_mesh_into(URI("quadtriag-bad-node.neu"),*bad_node), ParsingFailed);
+
+  Core::instance().root().remove_component("bad_type");
+  Core::instance().root().remove_component("bad_node");
+}
+
+BOOST_AUTO_TEST_CASE( finalize_mpi )
+{
+  PE::Comm::instance().finalize();
+  Core::instance().terminate();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_SUITE_END()
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,163 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Test module for the object weights of the mesh partitioners"
+
+#include <boost/test/unit_test.hpp>
+
+#include "common/Core.hpp"
+#include "common/Foreach.hpp"
+#include "common/List.hpp"
+#include "common/OptionList.hpp"
+#include "common/PropertyList.hpp"
+#include "common/PE/Comm.hpp"
+
+#include "mesh/Dictionary.hpp"
+#include "mesh/Entities.hpp"
+#include "mesh/Mesh.hpp"
+#include "mesh/MeshGenerator.hpp"
+#include "mesh/MeshPartitioner.hpp"
+#include "mesh/MeshTransformer.hpp"
+
+using namespace cf3;
+using namespace cf3::common;
+using namespace cf3::mesh;
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct PartitionerWeightsFixture
+{
+  /// The partitioner that LoadBalance uses, which is PT-Scotch or Zoltan depending on the build
+  Handle<MeshPartitioner> create_partitioner(const std::string& name)
+  {
+    Handle<Component> load_balance = Core::instance().root().create_component(name, "cf3.mesh.actions.LoadBalance");
+    return Handle<MeshPartitioner>(load_balance->get_child("partitioner"));
+  }
+
+  /// Sum of the weights of the objects owned by this processor
+  Real local_weight(const MeshPartitioner& p)
+  {
+    const Uint rank = PE::Comm::instance().rank();
+    std::vector<Real> weights(p.nb_objects_owned_by_part(rank));
+    p.list_of_object_weights_in_part(rank, weights);
+    Real sum = 0.;
+    boost_foreach(const Real w, weights)
+      sum += w;
+    return sum;
+  }
+
+  Uint nb_owned_nodes(const Mesh& mesh)
+  {
+    Uint nb_owned = 0;
+    for (Uint n=0; n<mesh.geometry_fields().size(); ++n)
+      if (!mesh.geometry_fields().is_ghost(n))
+        ++nb_owned;
+    return nb_owned;
+  }
+
+  static Handle<Mesh> mesh;
+};
+
+Handle<Mesh> PartitionerWeightsFixture::mesh;
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_SUITE( PartitionerWeightsSuite )
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_CASE( init_mpi )
+{
+  Core::instance().initiate(boost::unit_test::framework::master_test_suite().argc,boost::unit_test::framework::master_test_suite().argv);
+  PE::Comm::instance().init(boost::unit_test::framework::master_test_suite().argc,boost::unit_test::framework::master_test_suite().argv);
+}
+
+BOOST_FIXTURE_TEST_CASE( generate_mesh, PartitionerWeightsFixture )
+{
+  boost::shared_ptr< MeshGenerator > meshgenerator = build_component_abstract_type<MeshGenerator>("cf3.mesh.SimpleMeshGenerator","meshgenerator");
+  meshgenerator->options().set("mesh",URI("//rect"));
+  std::vector<Uint> nb_cells(2, 8u);
+  std::vector<Real> lengths(2, 1.);
+  meshgenerator->options().set("nb_cells",nb_cells);
+  meshgenerator->options().set("lengths",lengths);
+  meshgenerator->options().set("bdry",true);
+  mesh = meshgenerator->generate().handle<Mesh>();
+
+  build_component_abstract_type<MeshTransformer>("cf3.mesh.actions.GlobalNumbering","glb_numbering")->transform(*mesh);
+  build_component_abstract_type<MeshTransformer>("cf3.mesh.actions.GlobalConnectivity","glb_connectivity")->transform(*mesh);
+}
+
+BOOST_FIXTURE_TEST_CASE( configured_weights, PartitionerWeightsFixture )
+{
+  Handle<MeshPartitioner> p = create_partitioner("load_balance_configured");
+
+  std::vector<std::string> element_weights;
+  element_weights.push_back("Quad:3");
+  element_weights.push_back("bottom:5");
+  p->options().set("element_weights", element_weights);
+  p->options().set("node_weight", 0.5);
+  p->initialize(*mesh);
+
+  // Cells are weighed by shape, the bottom faces by region and the other faces by the default for a linear line
+  Real expected = 0.5 * nb_owned_nodes(*mesh);
+  boost_foreach(const Handle<Entities>& entities, mesh->elements())
+  {
+    const Real weight = entities->element_type().shape_name() == "Quad" ? 3. : entities->parent()->name() == "bottom" ? 5. : 1.;
+    expected += weight * entities->size();
+  }
+  BOOST_CHECK_CLOSE(local_weight(*p), expected, 1e-10);
+}
+
+BOOST_FIXTURE_TEST_CASE( measured_weights, PartitionerWeightsFixture )
+{
+  // Pretend the cells of processor r took r+1 times longer per element to assemble
+  Uint nb_cells = 0;
+  Real nb_faces = 0.;
+  boost_foreach(const Handle<Entities>& entities, mesh->elements())
+  {
+    if (entities->element_type().shape_name() == "Quad")
+    {
+      entities->properties().add("assembly_time", Real(PE::Comm::instance().rank()+1) * entities->size());
+      nb_cells += entities->size();
+    }
+    else
+    {
+      nb_faces += entities->size();
+    }
+  }
+
+  Handle<MeshPartitioner> p = create_partitioner("load_balance_measured");
+  std::vector<std::string> element_weights(1, "Quad:3");
+  p->options().set("element_weights", element_weights);
+  p->options().set("timing_property", std::string("assembly_time"));
+  p->initialize(*mesh);
+
+  // The timed cells of all processors keep their total configured weight
+  std::vector<Uint> nb_cells_per_rank;
+  PE::Comm::instance().all_gather(nb_cells, nb_cells_per_rank);
+  Real total_cells = 0.;
+  Real total_time = 0.;
+  for (Uint r=0; r<nb_cells_per_rank.size(); ++r)
+  {
+    total_cells += nb_cells_per_rank[r];
+    total_time += Real(r+1) * nb_cells_per_rank[r];
+  }
+  const Real cell_weight = 3. * total_cells / total_time * Real(PE::Comm::instance().rank()+1);
+  BOOST_CHECK_CLOSE(local_weight(*p), nb_owned_nodes(*mesh) + nb_faces + cell_weight * nb_cells, 1e-10);
+}
+
+BOOST_AUTO_TEST_CASE( finalize_mpi )
+{
+  PE::Comm::instance().finalize();
+  Core::instance().terminate();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_SUITE_END()
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,114 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Test module for the sum-factorized tensor-product kernels"
+
+#include <boost/test/unit_test.hpp>
+
+#include "mesh/Integrators/SumFactorization.hpp"
+#include "mesh/LagrangeP1/Hexa.hpp"
+#include "mesh/LagrangeP2/Quad.hpp"
+#include "mesh/LagrangeP3/Line.hpp"
+#include "mesh/LagrangeP3/Quad.hpp"
+
+using namespace cf3;
+using namespace cf3::mesh;
+using namespace cf3::mesh::Integrators;
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Compare the sum-factorized kernels with the direct evaluation of the shape functions
+template<typename SF, Uint NbPoints1D>
+void check_sum_factorization()
+{
+  typedef SumFactorization<SF, NbPoints1D> SumFactT;
+  const SumFactT& sumfact = SumFactT::instance();
+
+  typename SumFactT::NodalT nodal;
+  for(Uint i = 0; i != SF::nb_nodes; ++i)
+    nodal[i] = 1. + 0.5*i - 0.1*i*i;
+
+  typename SumFactT::PointValuesT values;
+  typename SumFactT::PointVectorsT gradients;
+  sumfact.interpolate(nodal, values);
+  sumfact.interpolate_gradient(nodal, gradients);
+
+  typename SF::ValueT sf_values;
+  typename SF::GradientT sf_gradient;
+  typename SF::MappedCoordsT mapped_coords;
+  Real weight_sum = 0.;
+  typename SumFactT::NodalT reference_integral = SumFactT::NodalT::Zero();
+  typename SumFactT::NodalT reference_gradient_integral = SumFactT::NodalT::Zero();
+  for(Uint q = 0; q != SumFactT::nb_points; ++q)
+  {
+    mapped_coords = sumfact.coords().col(q);
+    SF::compute_value(mapped_coords, sf_values);
+    SF::compute_gradient(mapped_coords, sf_gradient);
+    BOOST_CHECK_SMALL(sf_values.dot(nodal) - values[q], 1e-12);
+    for(Uint d = 0; d != SF::dimensionality; ++d)
+      BOOST_CHECK_SMALL(sf_gradient.row(d).dot(nodal) - gradients(d, q), 1e-12);
+
+    weight_sum += sumfact.weights()[q];
+    reference_integral += sumfact.weights()[q] * values[q] * sf_values.transpose();
+    reference_gradient_integral += sumfact.weights()[q] * sf_gradient.transpose() * gradients.col(q);
+  }
+
+  // Volume of the reference element
+  BOOST_CHECK_CLOSE(weight_sum, std::pow(2., static_cast<int>(SF::dimensionality)), 1e-10);
+
+  // Mass and Laplacian products
+  typename SumFactT::PointValuesT weighted_values = sumfact.weights().cwiseProduct(values);
+  typename SumFactT::PointVectorsT weighted_gradients = gradients;
+  for(Uint q = 0; q != SumFactT::nb_points; ++q)
+    weighted_gradients.col(q) *= sumfact.weights()[q];
+
+  typename SumFactT::NodalT integral, gradient_integral;
+  sumfact.integrate(weighted_values, integral);
+  sumfact.integrate_gradient(weighted_gradients, gradient_integral);
+  for(Uint i = 0; i != SF::nb_nodes; ++i)
+  {
+    BOOST_CHECK_SMALL(integral[i] - reference_integral[i], 1e-12);
+    BOOST_CHECK_SMALL(gradient_integral[i] - reference_gradient_integral[i], 1e-12);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_SUITE( SumFactorizationSuite )
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_CASE( LagrangeP3Line )
+{
+  check_sum_factorization<LagrangeP3::Line, 4>();
+}
+
+BOOST_AUTO_TEST_CASE( LagrangeP2Quad )
+{
+  check_sum_factorization<LagrangeP2::Quad, 4>();
+}
+
+BOOST_AUTO_TEST_CASE( LagrangeP3Quad )
+{
+  check_sum_factorization<LagrangeP3::Quad, 4>();
+}
+
+BOOST_AUTO_TEST_CASE( LagrangeP1Hexa )
+{
+  check_sum_factorization<LagrangeP1::Hexa, 2>();
+}
+
+BOOST_AUTO_TEST_CASE( LagrangeP1HexaOverIntegrated )
+{
+  check_sum_factorization<LagrangeP1::Hexa, 8>();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_SUITE_END()
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,59 @@
+import sys
+from coolfluid import *
+
+try:
+  import numpy as np
+except ImportError:
+  print 'numpy not found, skipping test'
+  sys.exit(0)
+
+root = Core.root()
+env = Core.environment()
+
+env.options().set('assertion_backtrace', False)
+env.options().set('exception_backtrace', False)
+env.options().set('regist_signal_handlers', False)
+env.options().set('exception_log_level', 0)
+env.options().set('log_level', 4)
+env.options().set('exception_outputs', False)
+
+table = root.create_component('table', 'cf3.common.Table<real>')
+table.set_row_size(3)
+table.resize(5)
+
+# the array shares the memory of the table
+a = table.array()
+cf_check_equal(a.shape, (5, 3), 'Incorrect array shape')
+cf_check_equal(a.dtype, np.float64, 'Incorrect array type')
+a[:,1] = np.arange(5.)
+cf_check_equal(table[3][1], 3., 'Array modification not seen by the table')
+table[4][2] = 7.
+cf_check_equal(a[4,2], 7., 'Table modification not seen by the array')
+
+# bulk assignment from a numpy array, also when it is not contiguous
+table.assign(np.arange(15.).reshape(5, 3))
+cf_check_equal(table[4][2], 14., 'Incorrect value after assign')
+table.assign(np.arange(15.).reshape(3, 5).T)
+cf_check_equal(table[0][1], 5., 'Incorrect value after assign from a transposed array')
+table.assign(a[::-1])
+cf_check_equal(table[0][1], 9., 'Incorrect value after assign from a reversed view of the table')
+
+# shape and type must match
+for bad in [np.zeros((3, 5)), np.zeros((5, 3), dtype=np.float32)]:
+  try:
+    table.assign(bad)
+    raise Exception('Assigning an array of shape {s} and type {t} did not fail'.format(s = bad.shape, t = bad.dtype))
+  except RuntimeError:
+    pass
+
+lst = root.create_component('list', 'cf3.common.List<unsigned>')
+lst.resize(4)
+lst.assign(np.array([4, 3, 2, 1], dtype=lst.array().dtype))
+cf_check_equal(lst[0], 4, 'Incorrect list value after assign')
+cf_check_equal(int(lst.array().sum()), 10, 'Incorrect list array')
+
+# the array keeps the table memory alive after the table is deleted
+values = table.array()
+expected = values.copy()
+table.delete_component()
+cf_check(np.array_equal(values, expected), 'Array changed after deleting the table')
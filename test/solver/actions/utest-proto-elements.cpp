@@ -7,12 +7,17 @@
 #define BOOST_TEST_DYN_LINK
 #define BOOST_TEST_MODULE "Test module for proto operators"
 
+#include <set>
+
 #include <boost/assign.hpp>
 #include <boost/foreach.hpp>
 #include <boost/test/unit_test.hpp>
 
 #include "common/Core.hpp"
+#include "common/Environment.hpp"
+#include "common/List.hpp"
 #include "common/Log.hpp"
+#include "common/OptionList.hpp"
 
 #include "math/MatrixTypes.hpp"
 #include "math/Consts.hpp"
@@ -25,6 +30,9 @@
 #include "mesh/ElementData.hpp"
 #include "mesh/FieldManager.hpp"
 #include "mesh/Dictionary.hpp"
+#include "mesh/Connectivity.hpp"
+#include "mesh/Field.hpp"
+#include "mesh/Space.hpp"
 
 #include "mesh/Integrators/Gauss.hpp"
 #include "mesh/ElementTypes.hpp"
@@ -33,6 +41,8 @@
 
 #include "mesh/BlockMesh/BlockData.hpp"
 
+#include "mesh/actions/LinkPeriodicNodes.hpp"
+
 #include "physics/PhysModel.hpp"
 
 #include "solver/Model.hpp"
@@ -40,12 +50,14 @@
 #include "solver/Tags.hpp"
 
 #include "solver/actions/Proto/ProtoAction.hpp"
+#include "solver/actions/Proto/ElementColoring.hpp"
 #include "solver/actions/Proto/ElementLooper.hpp"
 #include "solver/actions/Proto/Expression.hpp"
 #include "solver/actions/Proto/Functions.hpp"
 #include "solver/actions/Proto/NodeLooper.hpp"
 #include "solver/actions/Proto/Terminals.hpp"
 
+#include "Tools/MeshGeneration/MeshGeneration.hpp"
 #include "Tools/Testing/TimedTestFixture.hpp"
 
 using namespace cf3;
@@ -59,6 +71,56 @@ using namespace cf3::math::Consts;
 
 using namespace boost::assign;
 
+/// Adds one to each node of the element, resulting in the node valence
+struct AddNodalOnes
+{
+  typedef void result_type;
+
+  template<typename VarT>
+  void operator()(VarT& var) const
+  {
+    var.add_nodal_values(VarT::ElementVectorT::Ones());
+  }
+};
+
+static MakeSFOp<AddNodalOnes>::type const add_nodal_ones = {};
+
+/// Check that elements of the same color share no nodes, counting periodically linked nodes as the same node
+void check_coloring(const Mesh& mesh)
+{
+  const Dictionary& geometry = mesh.geometry_fields();
+  Handle< List<Uint> const > periodic_links_nodes(geometry.get_child("periodic_links_nodes"));
+  Handle< List<bool> const > periodic_links_active(geometry.get_child("periodic_links_active"));
+
+  BOOST_FOREACH(const Elements& elements, find_components_recursively<Elements>(mesh.topology()))
+  {
+    const ElementColoring::ColorsT& colors = ElementColoring::instance().colors(elements);
+    const Connectivity& connectivity = elements.geometry_space().connectivity();
+    Uint nb_colored = 0;
+    BOOST_FOREACH(const std::vector<Uint>& color, colors)
+    {
+      std::set<Uint> color_nodes;
+      BOOST_FOREACH(const Uint elem, color)
+      {
+        // Nodes of an element may be linked to each other, so count each of them once per element
+        std::set<Uint> elem_nodes;
+        BOOST_FOREACH(Uint node, connectivity[elem])
+        {
+          while(is_not_null(periodic_links_active) && (*periodic_links_active)[node])
+            node = (*periodic_links_nodes)[node];
+          elem_nodes.insert(node);
+        }
+        BOOST_FOREACH(const Uint node, elem_nodes)
+        {
+          BOOST_CHECK(color_nodes.insert(node).second);
+        }
+      }
+      nb_colored += color.size();
+    }
+    BOOST_CHECK_EQUAL(nb_colored, elements.size());
+  }
+}
+
 ////////////////////////////////////////////////////
 
 BOOST_AUTO_TEST_SUITE( ProtoOperatorsSuite )
@@ -236,6 +298,177 @@ BOOST_AUTO_TEST_CASE( ProtoVectorElementField )
   writer.execute();
 }
 
+// A threaded element loop must give the same result as the serial one
+BOOST_AUTO_TEST_CASE( ThreadedElementLoop )
+{
+  Mesh& mesh = *Core::instance().root().create_component<Mesh>("ThreadedMesh");
+  Tools::MeshGeneration::create_rectangle(mesh, 1., 1., 20, 20);
+
+  Field& valence = mesh.geometry_fields().create_field("valence", "Serial,Threaded,ThreadedExpression");
+  valence.add_tag("valence");
+
+  FieldVariable<0, ScalarField> serial("Serial", "valence");
+  FieldVariable<1, ScalarField> threaded("Threaded", "valence");
+  FieldVariable<2, ScalarField> threaded_expression("ThreadedExpression", "valence");
+
+  // Elements of the same color may not share nodes
+  check_coloring(mesh);
+
+  for_each_node(mesh.topology(), serial = 0.);
+  for_each_node(mesh.topology(), threaded = 0.);
+  for_each_node(mesh.topology(), threaded_expression = 0.);
+
+  for_each_element<mesh::LagrangeP1::CellTypes>(mesh.topology(), add_nodal_ones(serial));
+
+  // Threading is enabled per expression, since only expressions without shared state may use it
+  Core::instance().environment().options().set("assembly_threads", 4u);
+  for_each_element_threaded<mesh::LagrangeP1::CellTypes>(mesh.topology(), add_nodal_ones(threaded));
+  boost::shared_ptr<Expression> expression = elements_expression(add_nodal_ones(threaded_expression));
+  expression->set_threaded(true);
+  expression->loop(mesh.topology());
+  Core::instance().environment().options().set("assembly_threads", 1u);
+
+  Real max_valence = 0.;
+  for(Uint i = 0; i != valence.size(); ++i)
+  {
+    BOOST_CHECK_EQUAL(valence[i][0], valence[i][1]);
+    BOOST_CHECK_EQUAL(valence[i][0], valence[i][2]);
+    max_valence = std::max(max_valence, valence[i][0]);
+  }
+  BOOST_CHECK_EQUAL(max_valence, 4.);
+}
+
+// Elements that only share nodes through a periodic link must get different colors
+BOOST_AUTO_TEST_CASE( PeriodicColoring )
+{
+  Mesh& mesh = *Core::instance().root().create_component<Mesh>("PeriodicColoringMesh");
+  Tools::MeshGeneration::create_rectangle(mesh, 1., 1., 6, 4);
+  check_coloring(mesh);
+
+  // The coloring is recomputed once the links exist
+  Handle<mesh::actions::LinkPeriodicNodes> link = Core::instance().root().create_component<mesh::actions::LinkPeriodicNodes>("PeriodicColoringLink");
+  link->options().set("mesh", mesh.handle<Mesh>());
+  link->options().set("source_region", Handle<Region>(mesh.topology().get_child("right")));
+  link->options().set("destination_region", Handle<Region>(mesh.topology().get_child("left")));
+  std::vector<Real> translation(2, 0.);
+  translation[XX] = -1.;
+  link->options().set("translation_vector", translation);
+  link->execute();
+
+  BOOST_REQUIRE(is_not_null(mesh.geometry_fields().get_child("periodic_links_active")));
+  check_coloring(mesh);
+}
+
+// Jacobians computed for a batch of elements must match the ones computed element by element
+BOOST_AUTO_TEST_CASE( BatchedJacobians )
+{
+  Mesh& mesh = *Core::instance().root().create_component<Mesh>("BatchedMesh");
+  Tools::MeshGeneration::create_rectangle(mesh, 1., 1., 5, 5);
+
+  // Distort the mesh, so the jacobian varies inside the elements
+  Field& coords = mesh.geometry_fields().coordinates();
+  for(Uint i = 0; i != coords.size(); ++i)
+  {
+    const Real x = coords[i][0];
+    const Real y = coords[i][1];
+    coords[i][0] += 0.02*std::sin(7.*y);
+    coords[i][1] += 0.03*std::cos(5.*x);
+  }
+
+  typedef mesh::Integrators::GaussMappedCoords<2, GeoShape::QUAD> GaussT;
+
+  BOOST_FOREACH(const Elements& elements, find_components_recursively<Elements>(mesh.topology()))
+  {
+    if(!IsElementType<LagrangeP1::Quad2D>()(elements.element_type()))
+      continue;
+
+    GeometricSupport<LagrangeP1::Quad2D> batched(elements);
+    GeometricSupport<LagrangeP1::Quad2D> reference(elements);
+    const Uint nb_elems = elements.size();
+    std::vector<Uint> element_list(nb_elems);
+    for(Uint elem = 0; elem != nb_elems; ++elem)
+      element_list[elem] = elem;
+
+    for(Uint batch_begin = 0; batch_begin < nb_elems; batch_begin += CF3_PROTO_ELEMENT_BATCH_SIZE)
+    {
+      const Uint batch_end = std::min(nb_elems, batch_begin + CF3_PROTO_ELEMENT_BATCH_SIZE);
+      batched.set_batch(&element_list[batch_begin], batch_end - batch_begin);
+      for(Uint elem = batch_begin; elem != batch_end; ++elem)
+      {
+        batched.set_element(elem, elem - batch_begin);
+        reference.set_element(elem);
+        for(Uint i = 0; i != GaussT::nb_points; ++i)
+        {
+          const LagrangeP1::Quad2D::MappedCoordsT mapped_coords = GaussT::instance().coords.col(i);
+          batched.compute_jacobian(mapped_coords);
+          reference.compute_jacobian(mapped_coords);
+          BOOST_CHECK_CLOSE(batched.jacobian_determinant(), reference.jacobian_determinant(), 1e-10);
+          for(Uint j = 0; j != 4; ++j)
+          {
+            BOOST_CHECK_SMALL(batched.jacobian().data()[j] - reference.jacobian().data()[j], 1e-12);
+            BOOST_CHECK_SMALL(batched.jacobian_inverse().data()[j] - reference.jacobian_inverse().data()[j], 1e-10);
+          }
+        }
+      }
+    }
+  }
+}
+
+// Cached jacobians must match the computed ones, also after the coordinates change
+BOOST_AUTO_TEST_CASE( CachedGeometricFactors )
+{
+  Mesh& mesh = *Core::instance().root().create_component<Mesh>("CachedFactorsMesh");
+  Tools::MeshGeneration::create_rectangle(mesh, 1., 1., 5, 5);
+  Field& coords = mesh.geometry_fields().coordinates();
+
+  typedef mesh::Integrators::GaussMappedCoords<2, GeoShape::QUAD> GaussT;
+
+  Core::instance().environment().options().set("cache_geometric_factors", true);
+  for(Uint pass = 0; pass != 3; ++pass)
+  {
+    BOOST_FOREACH(const Elements& elements, find_components_recursively<Elements>(mesh.topology()))
+    {
+      if(!IsElementType<LagrangeP1::Quad2D>()(elements.element_type()))
+        continue;
+
+      // The supports are created after the coordinate change, as is the case for each element loop
+      GeometricSupport<LagrangeP1::Quad2D> cached(elements);
+      Core::instance().environment().options().set("cache_geometric_factors", false);
+      GeometricSupport<LagrangeP1::Quad2D> reference(elements);
+      Core::instance().environment().options().set("cache_geometric_factors", true);
+
+      for(Uint elem = 0; elem != elements.size(); ++elem)
+      {
+        cached.set_element(elem);
+        reference.set_element(elem);
+        for(Uint i = 0; i != GaussT::nb_points; ++i)
+        {
+          const LagrangeP1::Quad2D::MappedCoordsT mapped_coords = GaussT::instance().coords.col(i);
+          cached.compute_jacobian(mapped_coords);
+          reference.compute_jacobian(mapped_coords);
+          BOOST_CHECK_SMALL(cached.jacobian_determinant() - reference.jacobian_determinant(), 1e-14);
+          for(Uint j = 0; j != 4; ++j)
+          {
+            BOOST_CHECK_SMALL(cached.jacobian().data()[j] - reference.jacobian().data()[j], 1e-14);
+            BOOST_CHECK_SMALL(cached.jacobian_inverse().data()[j] - reference.jacobian_inverse().data()[j], 1e-12);
+          }
+        }
+      }
+    }
+
+    // Stretch the mesh, which must invalidate the cache. The second time no event is raised, as when a script
+    // modifies the coordinates, so the change must be detected from the coordinates themselves.
+    for(Uint i = 0; i != coords.size(); ++i)
+    {
+      coords[i][0] *= 2.;
+      coords[i][1] += 0.1*coords[i][0]*coords[i][0];
+    }
+    if(pass == 0)
+      mesh.raise_coordinates_changed();
+  }
+  Core::instance().environment().options().set("cache_geometric_factors", false);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -21,6 +21,7 @@
 
 #include "solver/actions/Proto/ElementGradDiv.hpp"
 #include "solver/actions/Proto/ElementLooper.hpp"
+#include "solver/actions/Proto/ElementSumFactorization.hpp"
 #include "solver/actions/Proto/Expression.hpp"
 #include "solver/actions/Proto/Functions.hpp"
 #include "solver/actions/Proto/NodeLooper.hpp"
@@ -28,6 +29,7 @@
 
 #include "common/Core.hpp"
 #include "common/Log.hpp"
+#include "common/OptionList.hpp"
 
 #include "math/MatrixTypes.hpp"
 
@@ -36,9 +38,11 @@
 #include "mesh/Region.hpp"
 #include "mesh/Elements.hpp"
 #include "mesh/MeshReader.hpp"
+#include "mesh/SimpleMeshGenerator.hpp"
 #include "mesh/ElementData.hpp"
 #include "mesh/FieldManager.hpp"
 #include "mesh/Dictionary.hpp"
+#include "mesh/Field.hpp"
 
 #include "mesh/Integrators/Gauss.hpp"
 #include "mesh/ElementTypes.hpp"
@@ -604,6 +608,38 @@ BOOST_AUTO_TEST_CASE( NodeExprFunctionParsing )
   BOOST_CHECK_EQUAL(total[0], 20.);
 }
 
+// Functions in node expressions are evaluated for all nodes at once, which must give the same result as evaluating per node
+BOOST_AUTO_TEST_CASE( NodeExprFunctionBatch )
+{
+  Handle<Mesh> mesh = Core::instance().root().create_component<Mesh>("line_batch");
+  Tools::MeshGeneration::create_line(*mesh, 4., 40);
+
+  Field& field = mesh->geometry_fields().create_field( "batch_solution", "Temperature" );
+  field.add_tag("batch_solution");
+
+  FieldVariable<0, ScalarField > T("Temperature", "batch_solution");
+
+  solver::actions::Proto::ScalarFunction f;
+  f.variables("x,t");
+  f.functions(std::vector<std::string>(1, "sin(x)*t+x^2"));
+  f.parse();
+  f.predefined_values.resize(2);
+  f.predefined_values[1] = 0.5;
+
+  nodes_expression(T = boost::proto::lit(f))->loop(mesh->topology());
+
+  BOOST_CHECK(f.value_nodes.empty());
+  const Field& coords = mesh->geometry_fields().coordinates();
+  std::vector<Real> vars(2, 0.5);
+  RealVector expected(1);
+  for(Uint i = 0; i != coords.size(); ++i)
+  {
+    vars[0] = coords[i][0];
+    f.evaluate(vars, expected);
+    BOOST_CHECK_EQUAL(field[i][0], expected[0]);
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 BOOST_AUTO_TEST_CASE( ProtoAccumulators )
@@ -927,6 +963,66 @@ BOOST_AUTO_TEST_CASE( NodeIdxOutput )
   BOOST_CHECK_EQUAL(idx_total, 6);
 }
 
+/// Check that two element matrices are equal up to round-off
+template<typename MatrixT>
+void check_matrix_close(const MatrixT& reference, const MatrixT& result)
+{
+  BOOST_CHECK_SMALL((result - reference).norm() / reference.norm(), 1e-12);
+}
+
+/// Compare the sum-factorized Laplacian with element_quadrature on each element of the given type, after deforming the
+/// mesh so the jacobian varies over the elements
+template<typename ElementT>
+void check_sumfact_laplacian(Mesh& mesh)
+{
+  typedef Eigen::Matrix<Real, ElementT::nb_nodes, ElementT::nb_nodes> MatrixT;
+
+  Field& coords = mesh.geometry_fields().coordinates();
+  for(Uint i = 0; i != coords.size(); ++i)
+  {
+    for(Uint d = 0; d != coords.row_size(); ++d)
+      coords[i][d] += 0.05*std::sin(3.*coords[i][(d+1) % coords.row_size()] + d);
+  }
+
+  mesh.geometry_fields().create_field("Temperature", "Temperature").add_tag("solution");
+  FieldVariable<0, ScalarField> T("Temperature", "solution");
+
+  boost::proto::terminal< void(*)(const MatrixT&, const MatrixT&) >::type const check_close_matrix = {&check_matrix_close<MatrixT>};
+
+  const MatrixT zero = MatrixT::Zero();
+  MatrixT reference;
+  MatrixT result;
+  for_each_element< boost::mpl::vector1<ElementT> >
+  (
+    mesh.topology(),
+    group
+    (
+      lit(reference) = zero,
+      lit(result) = zero,
+      element_quadrature(lit(reference) += 2.5 * transpose(nabla(T)) * nabla(T)),
+      sumfact_laplacian(T, 2.5, lit(result)),
+      check_close_matrix(lit(reference), lit(result))
+    )
+  );
+}
+
+BOOST_AUTO_TEST_CASE( SumFactorizedLaplacian )
+{
+  Handle<Mesh> line = Core::instance().root().create_component<Mesh>("SumFactLine");
+  Tools::MeshGeneration::create_line(*line, 1., 5);
+  check_sumfact_laplacian<LagrangeP1::Line1D>(*line);
+
+  Handle<Mesh> quads = Core::instance().root().create_component<Mesh>("SumFactQuads");
+  Tools::MeshGeneration::create_rectangle(*quads, 1., 2., 4, 5);
+  check_sumfact_laplacian<LagrangeP1::Quad2D>(*quads);
+
+  Handle<SimpleMeshGenerator> generator = Core::instance().root().create_component<SimpleMeshGenerator>("SumFactHexasGenerator");
+  generator->options().set("mesh", Core::instance().root().uri()/"SumFactHexas");
+  generator->options().set("nb_cells", std::vector<Uint>(3, 3));
+  generator->options().set("lengths", std::vector<Real>(3, 1.));
+  check_sumfact_laplacian<LagrangeP1::Hexa3D>(generator->generate());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,58 @@
+import sys
+import coolfluid as cf
+
+env = cf.Core.environment()
+env.log_level = 4
+env.only_cpu0_writes = True
+
+root = cf.Core.root()
+domain = root.create_component('Domain', 'cf3.mesh.Domain')
+mesh = domain.create_component('Mesh','cf3.mesh.Mesh')
+
+blocks = root.create_component('model', 'cf3.mesh.BlockMesh.BlockArrays')
+points = blocks.create_points(dimensions = 2, nb_points = 4)
+points[0]  = [0., 0.]
+points[1]  = [1., 0.]
+points[2]  = [1., 1.]
+points[3]  = [0., 1.]
+block_nodes = blocks.create_blocks(1)
+block_nodes[0] = [0, 1, 2, 3]
+block_subdivs = blocks.create_block_subdivisions()
+block_subdivs[0] = [16,16]
+gradings = blocks.create_block_gradings()
+gradings[0] = [1., 1., 1., 1.]
+blocks.create_patch_nb_faces(name = 'bottom', nb_faces = 1)[0] = [0, 1]
+blocks.create_patch_nb_faces(name = 'right', nb_faces = 1)[0] = [1, 2]
+blocks.create_patch_nb_faces(name = 'top', nb_faces = 1)[0] = [2, 3]
+blocks.create_patch_nb_faces(name = 'left', nb_faces = 1)[0] = [3, 0]
+blocks.partition_blocks(nb_partitions = cf.Core.nb_procs(), direction = 1)
+blocks.create_mesh(mesh.uri())
+
+# Linear field, which must still match the coordinates after migration
+coords = mesh.geometry.coordinates
+u = mesh.geometry.create_field(name = 'u', variables = 'u')
+for i in range(len(coords)):
+  u[i][0] = 1. + 2.*coords[i][0] + 3.*coords[i][1]
+
+balancer = domain.create_component('Balancer', 'cf3.solver.actions.DynamicLoadBalance')
+balancer.mesh = mesh
+balancer.check_interval = 2
+# Any measured time exceeds half the mean, so the second execution rebalances
+balancer.imbalance_threshold = 0.5
+balancer.create_component('Work', 'cf3.common.ActionDirector')
+
+balancer.execute()
+if balancer.properties()['nb_rebalances'] != 0:
+  raise Exception('Rebalanced before the check interval')
+
+balancer.execute()
+if balancer.properties()['nb_rebalances'] != 1:
+  raise Exception('Mesh was not rebalanced')
+
+coords = mesh.geometry.coordinates
+if len(u) != len(coords):
+  raise Exception('Field has ' + str(len(u)) + ' rows for ' + str(len(coords)) + ' nodes')
+for i in range(len(coords)):
+  expected = 1. + 2.*coords[i][0] + 3.*coords[i][1]
+  if abs(u[i][0] - expected) > 1e-10:
+    raise Exception('Bad value ' + str(u[i][0]) + ' for node ' + str(i) + ', expected ' + str(expected))
@@ -0,0 +1,70 @@
+import sys
+import struct
+import coolfluid as cf
+
+env = cf.Core.environment()
+env.log_level = 4
+env.only_cpu0_writes = True
+
+root = cf.Core.root()
+domain = root.create_component('Domain', 'cf3.mesh.Domain')
+mesh = domain.create_component('Mesh','cf3.mesh.Mesh')
+
+blocks = root.create_component('model', 'cf3.mesh.BlockMesh.BlockArrays')
+points = blocks.create_points(dimensions = 2, nb_points = 4)
+points[0]  = [0., 0.]
+points[1]  = [1., 0.]
+points[2]  = [1., 1.]
+points[3]  = [0., 1.]
+block_nodes = blocks.create_blocks(1)
+block_nodes[0] = [0, 1, 2, 3]
+block_subdivs = blocks.create_block_subdivisions()
+block_subdivs[0] = [16,16]
+gradings = blocks.create_block_gradings()
+gradings[0] = [1., 1., 1., 1.]
+blocks.create_patch_nb_faces(name = 'bottom', nb_faces = 1)[0] = [0, 1]
+blocks.create_patch_nb_faces(name = 'right', nb_faces = 1)[0] = [1, 2]
+blocks.create_patch_nb_faces(name = 'top', nb_faces = 1)[0] = [2, 3]
+blocks.create_patch_nb_faces(name = 'left', nb_faces = 1)[0] = [3, 0]
+blocks.partition_blocks(nb_partitions = cf.Core.nb_procs(), direction = 1)
+blocks.create_mesh(mesh.uri())
+
+# Linear field, which is interpolated exactly
+coords = mesh.geometry.coordinates
+u = mesh.geometry.create_field(name = 'u', variables = 'u')
+for i in range(len(coords)):
+  u[i][0] = 1. + 2.*coords[i][0] + 3.*coords[i][1]
+
+probe_coords = []
+for i in range(10):
+  for j in range(10):
+    probe_coords += [0.05 + 0.1*i, 0.03 + 0.1*j]
+
+probes = domain.create_component('Probes', 'cf3.solver.actions.ProbeArray')
+probes.dict = mesh.geometry
+probes.fields = [u]
+probes.coordinates = probe_coords
+probes.buffer_size = 2
+probes.file = cf.URI('probes.xml')
+
+# Four executions fill the buffer twice, so four records are written
+for step in range(4):
+  for i in range(len(coords)):
+    u[i][0] = step + 1. + 2.*coords[i][0] + 3.*coords[i][1]
+  probes.execute()
+
+if cf.Core.rank() == 0:
+  nb_probes = len(probe_coords) // 2
+  record_size = 1 + nb_probes
+  data = open('probes.cfprobes', 'rb').read()
+  if len(data) != 4*record_size*8:
+    raise Exception('Wrong size for the probe file: ' + str(len(data)))
+  values = struct.unpack(str(4*record_size) + 'd', data)
+  for step in range(4):
+    record = values[step*record_size:(step+1)*record_size]
+    if record[0] != step + 1:
+      raise Exception('Bad time stamp ' + str(record[0]) + ' for record ' + str(step))
+    for p in range(nb_probes):
+      expected = step + 1. + 2.*probe_coords[2*p] + 3.*probe_coords[2*p+1]
+      if abs(record[1+p] - expected) > 1e-10:
+        raise Exception('Bad value ' + str(record[1+p]) + ' for probe ' + str(p) + ', expected ' + str(expected))
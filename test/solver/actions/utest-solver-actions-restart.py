@@ -101,4 +101,28 @@ if not differ.properties()['arrays_equal']:
   raise Exception('Element GIDS do not match')
 
 if time.current_time != 2. or time.time_step != 0.2 or time.iteration != 10:
-  raise Exception('Error in time data')
\ No newline at end of file
+  raise Exception('Error in time data')
+
+# Same round trip using the shared file format
+shared_restart_file = cf.URI('restart-test-shared.cf3restart')
+writer.file = shared_restart_file
+writer.shared_file = True
+writer.execute()
+
+copy_and_reset(mesh.geometry.node_gids, domain.create_component('SharedRefs', 'cf3.common.Group'))
+copy_and_reset(mesh.elems_P0.element_gids, domain.SharedRefs)
+
+reader.file = shared_restart_file
+reader.execute()
+
+differ.left = ref_node_gids
+differ.right = mesh.geometry.node_gids
+differ.execute()
+if not differ.properties()['arrays_equal']:
+  raise Exception('Node GIDS do not match after shared file restart')
+
+differ.left = ref_element_gids
+differ.right = mesh.elems_P0.element_gids
+differ.execute()
+if not differ.properties()['arrays_equal']:
+  raise Exception('Element GIDS do not match after shared file restart')
@@ -0,0 +1,195 @@
+// Copyright (C) 2010-2013 von Karman Institute for Fluid Dynamics, Belgium
+//
+// This software is distributed under the terms of the
+// GNU Lesser General Public License version 3 (LGPLv3).
+// See doc/lgpl.txt and doc/gpl.txt for the license text.
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Test module for restart files shared by all processes"
+
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "common/Core.hpp"
+#include "common/Environment.hpp"
+#include "common/List.hpp"
+#include "common/OptionList.hpp"
+#include "common/PE/Comm.hpp"
+
+#include "mesh/ContinuousDictionary.hpp"
+#include "mesh/Field.hpp"
+#include "mesh/Mesh.hpp"
+
+#include "solver/Time.hpp"
+#include "solver/actions/ReadRestartFile.hpp"
+#include "solver/actions/WriteRestartFile.hpp"
+
+using namespace cf3;
+using namespace cf3::common;
+using namespace cf3::mesh;
+using namespace cf3::solver;
+using namespace cf3::solver::actions;
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Builds dictionaries whose global numbering does not depend on the number of processes, so a restart file written
+/// on one number of processes can be read on another one.
+/// The test is run with the argument "write" to write the file and read it back on the same processes, and with
+/// "read" to read a file written by an earlier run, possibly on a different number of processes.
+struct SharedRestartFixture
+{
+  SharedRestartFixture() :
+    nb_procs(PE::Comm::instance().size()),
+    rank(PE::Comm::instance().rank()),
+    restart_file("shared-restart-test.cf3restart")
+  {
+    int argc = boost::unit_test::framework::master_test_suite().argc;
+    char** argv = boost::unit_test::framework::master_test_suite().argv;
+    mode = argc > 1 ? argv[1] : "write";
+  }
+
+  /// Process owning the given global index, scattered over the processes
+  Uint owner(const Uint gid) const
+  {
+    return (gid*7 + 3) % nb_procs;
+  }
+
+  /// Value stored in column col of the row with global index gid
+  static Real value(const Uint gid, const Uint col)
+  {
+    return 0.5*static_cast<Real>(gid) + 1000.*static_cast<Real>(col);
+  }
+
+  /// Create a dictionary holding the owned rows among the given global indices in reverse order, and every
+  /// ghost_stride-th index owned by another process as ghost. The field gets the correct values if fill is true,
+  /// and zeros otherwise.
+  Field& create_dictionary(Mesh& mesh, const std::string& name, const std::vector<Uint>& gids, const Uint ghost_stride, const Uint row_size, const bool fill)
+  {
+    std::vector<Uint> local_gids;
+    for(Uint i = gids.size(); i != 0; --i)
+    {
+      const Uint gid = gids[i-1];
+      if(owner(gid) == rank || (i-1) % ghost_stride == rank % ghost_stride)
+        local_gids.push_back(gid);
+    }
+
+    Dictionary& dict = *mesh.create_component<ContinuousDictionary>(name);
+    dict.resize(local_gids.size());
+    Field& field = dict.create_field(name + "_values", row_size);
+    for(Uint i = 0; i != local_gids.size(); ++i)
+    {
+      dict.glb_idx()[i] = local_gids[i];
+      dict.rank()[i] = owner(local_gids[i]);
+      for(Uint j = 0; j != row_size; ++j)
+      {
+        // Ghost rows are not written, so give them values that would be noticed
+        field[i][j] = !fill ? 0. : dict.is_ghost(i) ? -1. : value(local_gids[i], j);
+      }
+    }
+
+    return field;
+  }
+
+  /// Create the test mesh and return its fields. The "nodes" dictionary has 50 rows with gaps in the global numbering,
+  /// the "tiny" dictionary has fewer rows than most process counts, leaving some slabs of the file empty.
+  std::vector< Handle<Field> > create_mesh(const std::string& mesh_name, const bool fill)
+  {
+    Mesh& mesh = *Core::instance().root().create_component<Mesh>(mesh_name);
+
+    std::vector<Uint> node_gids;
+    for(Uint i = 0; i != 50; ++i)
+      node_gids.push_back(3*i + 1);
+
+    std::vector<Uint> tiny_gids;
+    tiny_gids.push_back(4);
+    tiny_gids.push_back(9);
+
+    std::vector< Handle<Field> > fields;
+    fields.push_back(create_dictionary(mesh, "nodes", node_gids, 4, 2, fill).handle<Field>());
+    fields.push_back(create_dictionary(mesh, "tiny", tiny_gids, 1, 1, fill).handle<Field>());
+    return fields;
+  }
+
+  /// Read the restart file into a new mesh and check all rows, including the ghosts
+  void read_and_check(const std::string& mesh_name)
+  {
+    const std::vector< Handle<Field> > fields = create_mesh(mesh_name, false);
+    Handle<Mesh> mesh = fields.front()->dict().parent()->handle<Mesh>();
+
+    Handle<Time> time = Core::instance().root().create_component<Time>(mesh_name + "Time");
+    Handle<ReadRestartFile> reader = Core::instance().root().create_component<ReadRestartFile>(mesh_name + "Reader");
+    reader->options().set("mesh", mesh);
+    reader->options().set("file", restart_file);
+    reader->options().set("time", time);
+    reader->execute();
+
+    BOOST_CHECK_EQUAL(time->iter(), 10u);
+    for(Uint f = 0; f != fields.size(); ++f)
+    {
+      const Field& field = *fields[f];
+      const Dictionary& dict = field.dict();
+      for(Uint i = 0; i != dict.size(); ++i)
+      {
+        for(Uint j = 0; j != field.row_size(); ++j)
+          BOOST_CHECK_EQUAL(field[i][j], value(dict.glb_idx()[i], j));
+      }
+    }
+  }
+
+  const Uint nb_procs;
+  const Uint rank;
+  const URI restart_file;
+  std::string mode;
+};
+
+BOOST_FIXTURE_TEST_SUITE( SharedRestartSuite, SharedRestartFixture )
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_CASE( InitMPI )
+{
+  Core::instance().initiate(boost::unit_test::framework::master_test_suite().argc, boost::unit_test::framework::master_test_suite().argv);
+  PE::Comm::instance().init(boost::unit_test::framework::master_test_suite().argc, boost::unit_test::framework::master_test_suite().argv);
+  BOOST_CHECK(mode == "write" || mode == "read");
+}
+
+BOOST_AUTO_TEST_CASE( Write )
+{
+  if(mode != "write")
+    return;
+
+  const std::vector< Handle<Field> > fields = create_mesh("WrittenMesh", true);
+
+  Handle<Time> time = Core::instance().root().create_component<Time>("Time");
+  time->options().set("iteration", 10u);
+
+  Handle<WriteRestartFile> writer = Core::instance().root().create_component<WriteRestartFile>("Writer");
+  writer->options().set("fields", fields);
+  writer->options().set("file", restart_file);
+  writer->options().set("time", time);
+  writer->options().set("shared_file", true);
+  writer->execute();
+  PE::Comm::instance().barrier();
+
+  // Read back on the same processes, which read equal slabs instead of the ranges of global indices used for writing
+  read_and_check("SameProcsMesh");
+}
+
+BOOST_AUTO_TEST_CASE( Read )
+{
+  // Data written by the write run, possibly on a different number of processes
+  read_and_check("ReadMesh");
+}
+
+BOOST_AUTO_TEST_CASE( FinalizeMPI )
+{
+  PE::Comm::instance().finalize();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_SUITE_END()
+
+////////////////////////////////////////////////////////////////////////////////